@@ -8,6 +8,11 @@ https://www.aclweb.org/anthology/W16-2316
 usage:
 
 ./average.py -m model.1.npz model.2.npz --output model.avg.npz
+
+This loads all models into memory. For large models use marian-conv, which reads one tensor at a
+time, also accepts *.bin models and weights, and can convert the result directly:
+
+./marian-conv --average model.1.npz model.2.npz --to model.avg.npz
 """
 
 from __future__ import print_function
@@ -15,11 +15,31 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("-b", "--batch-size", type=int, default=1)
     parser.add_argument("-p", "--port", type=int, default=8080)
+    parser.add_argument("-s", "--stream", action="store_true",
+                        help="server runs with --stream, reassemble the streamed sentences")
     args = parser.parse_args()
 
     # open connection
     ws = create_connection("ws://localhost:{}/translate".format(args.port))
 
+    def translate(batch):
+        ws.send(batch)
+        if not args.stream:
+            return ws.recv().rstrip()
+        # messages are 'final|partial<TAB>line<TAB>text' until 'done<TAB>lines<TAB>seconds'
+        lines = {}
+        while True:
+            message = ws.recv().rstrip("\n")
+            if message.startswith("error\t"):
+                return message
+            kind, num, text = message.split("\t", 2)
+            if kind == "done":
+                return "\n".join(lines[i] for i in sorted(lines))
+            if kind == "final":
+                lines[int(num)] = text
+            else:
+                print("[{}] {}".format(num, text), file=sys.stderr)
+
     count = 0
     batch = ""
     for line in sys.stdin:
@@ -27,18 +47,14 @@ if __name__ == "__main__":
         batch += line.decode('utf-8') if sys.version_info < (3, 0) else line
         if count == args.batch_size:
             # translate the batch
-            ws.send(batch)
-            result = ws.recv()
-            print(result.rstrip())
+            print(translate(batch))
 
             count = 0
             batch = ""
 
     if count:
         # translate the remaining sentences
-        ws.send(batch)
-        result = ws.recv()
-        print(result.rstrip())
+        print(translate(batch))
 
     # close connection
     ws.close()
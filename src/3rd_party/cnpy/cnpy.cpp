@@ -170,6 +170,21 @@ cnpy::NpyArrayPtr load_the_npy_file(FILE* fp) {
     return arr;
 }
 
+//skips an array by the size in its npy header, the local header of a zip64 entry
+//(as written by numpy.savez) does not hold the size
+void skip_the_npy_file(FILE* fp) {
+    unsigned int* shape;
+    unsigned int ndims, word_size;
+    char type;
+    bool fortran_order;
+    cnpy::parse_npy_header(fp, type, word_size, shape, ndims, fortran_order);
+    long long size = word_size;
+    for(unsigned int i = 0; i < ndims; i++)
+        size *= shape[i];
+    delete[] shape;
+    fseek(fp,size,SEEK_CUR);
+}
+
 cnpy::npz_t cnpy::npz_load(std::string fname) {
     FILE* fp = fopen(fname.c_str(),"rb");
 
@@ -249,8 +264,7 @@ cnpy::NpyArrayPtr cnpy::npz_load(std::string fname, std::string varname) {
         }
         else {
             //skip past the data
-            unsigned int size = *(unsigned int*) &local_header[22];
-            fseek(fp,size,SEEK_CUR);
+            skip_the_npy_file(fp);
         }
     }
 
@@ -267,6 +281,43 @@ cnpy::NpyArrayPtr cnpy::npz_load(std::string fname, std::string varname) {
     throw std::runtime_error(ss.str());
 }
 
+std::vector<std::string> cnpy::npz_names(std::string fname) {
+    FILE* fp = fopen(fname.c_str(),"rb");
+
+    if(!fp) {
+        printf("npz_names: Error! Unable to open file %s!\n",fname.c_str());
+        abort();
+    }
+
+    std::vector<std::string> names;
+    while(1) {
+        std::vector<char> local_header(30);
+        size_t header_res = fread(&local_header[0],sizeof(char),30,fp);
+        if(header_res != 30)
+            throw std::runtime_error("npz_names: failed fread");
+
+        //if we've reached the global header, stop reading
+        if(local_header[2] != 0x03 || local_header[3] != 0x04) break;
+
+        //read in the variable name
+        unsigned short name_len = *(unsigned short*) &local_header[26];
+        std::string vname(name_len,' ');
+        size_t vname_res = fread(&vname[0],sizeof(char),name_len,fp);
+        if(vname_res != name_len)
+            throw std::runtime_error("npz_names: failed fread");
+        vname.erase(vname.end()-4,vname.end()); //erase the lagging .npy
+        names.push_back(vname);
+
+        //skip past the extra field and the data
+        unsigned short extra_field_len = *(unsigned short*) &local_header[28];
+        fseek(fp,extra_field_len,SEEK_CUR);
+        skip_the_npy_file(fp);
+    }
+
+    fclose(fp);
+    return names;
+}
+
 cnpy::NpyArrayPtr cnpy::npy_load(std::string fname) {
 
     FILE* fp = fopen(fname.c_str(), "rb");
@@ -0,0 +1,360 @@
+#include "marian.h"
+
+#include "common/cli_wrapper.h"
+#include "common/filesystem.h"
+#include "common/timer.h"
+#include "tensors/cpu/expression_graph_packable.h"
+#include "training/graph_group_sync.h"
+#include "training/training.h"
+#include "translator/beam_search.h"
+#include "translator/translator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+namespace marian {
+namespace bench {
+
+// Synthetic parallel corpus over the words w0...wN with a Zipf unigram distribution. Source lengths
+// follow the requested distribution, target lengths are the source length times U(0.8, 1.2).
+class SyntheticCorpus {
+public:
+  SyntheticCorpus(Ptr<Options> options)
+      : vocabSize_(options->get<size_t>("vocab-size")),
+        sentences_(options->get<size_t>("sentences")),
+        dist_(options->get<std::string>("length-dist")),
+        mean_(options->get<float>("length-mean")),
+        std_(options->get<float>("length-std")),
+        maxLength_(options->get<size_t>("max-length")),
+        rng_(options->get<size_t>("seed")) {
+    ABORT_IF(vocabSize_ < 3, "--vocab-size must be at least 3");
+    ABORT_IF(maxLength_ < 1 || mean_ < 1, "--max-length and --length-mean must be at least 1");
+    std::vector<double> weights(vocabSize_ - 2);
+    for(size_t i = 0; i < weights.size(); ++i)
+      weights[i] = 1.0 / (i + 1);
+    words_ = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+  }
+
+  // Writes the vocabulary and both sides of the corpus, returns the source sentences
+  std::vector<std::string> write(const std::string& vocabPath,
+                                 const std::string& srcPath,
+                                 const std::string& trgPath) {
+    std::ofstream vocab(vocabPath);
+    vocab << "\"</s>\": 0\n\"<unk>\": 1\n";
+    for(size_t i = 0; i < vocabSize_ - 2; ++i)
+      vocab << "w" << i << ": " << i + 2 << "\n";
+
+    std::ofstream src(srcPath), trg(trgPath);
+    std::vector<std::string> lines;
+    std::uniform_real_distribution<float> ratio(0.8f, 1.2f);
+    for(size_t i = 0; i < sentences_; ++i) {
+      size_t length = sampleLength();
+      lines.push_back(sentence(length));
+      src << lines.back() << "\n";
+      trg << sentence(clip(length * ratio(rng_))) << "\n";
+    }
+    ABORT_IF(!vocab || !src || !trg, "Could not write the synthetic corpus");
+    return lines;
+  }
+
+private:
+  size_t sampleLength() {
+    if(dist_ == "fixed")
+      return clip(mean_);
+    if(dist_ == "uniform")
+      return clip(std::uniform_real_distribution<float>(mean_ - std_ * 1.7320508f, mean_ + std_ * 1.7320508f)(rng_));
+    if(dist_ == "lognormal") {
+      // parameters of the underlying normal distribution for the given mean and standard deviation
+      float sigma2 = std::log(1.f + (std_ * std_) / (mean_ * mean_));
+      return clip(std::lognormal_distribution<float>(std::log(mean_) - 0.5f * sigma2, std::sqrt(sigma2))(rng_));
+    }
+    ABORT_IF(dist_ != "normal", "Unknown length distribution '{}'", dist_);
+    return clip(std::normal_distribution<float>(mean_, std_)(rng_));
+  }
+
+  size_t clip(float length) const {
+    return std::min(maxLength_, (size_t)std::max(1.f, std::round(length)));
+  }
+
+  std::string sentence(size_t length) {
+    std::string line;
+    for(size_t i = 0; i < length; ++i)
+      line += (i > 0 ? " w" : "w") + std::to_string(words_(rng_));
+    return line;
+  }
+
+  size_t vocabSize_;
+  size_t sentences_;
+  std::string dist_;
+  float mean_;
+  float std_;
+  size_t maxLength_;
+  std::mt19937 rng_;
+  std::discrete_distribution<size_t> words_;
+};
+
+// Peak resident memory since the last resetPeakMemory(). Resetting needs Linux >= 4.0, elsewhere the
+// peak of the whole process is reported.
+void resetPeakMemory() {
+#ifdef __linux__
+  std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+double peakMemoryMB() {
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while(std::getline(status, line))
+    if(line.compare(0, 6, "VmHWM:") == 0)
+      return std::stod(line.substr(6)) / 1024.0;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+#else
+  return 0;
+#endif
+}
+
+// Nearest-rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p) {
+  if(sorted.empty())
+    return 0;
+  size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+  return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+size_t countWords(const std::string& text) {
+  std::istringstream in(text);
+  size_t words = 0;
+  std::string word;
+  while(in >> word)
+    words++;
+  return words;
+}
+
+Ptr<Options> parseMarianOptions(const std::vector<std::string>& args, cli::mode mode) {
+  std::vector<char*> argv;
+  for(const auto& arg : args)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  return parseOptions((int)argv.size(), argv.data(), mode);
+}
+
+// Runs SyncGraphGroup training for the given number of updates, returns the wall time in seconds
+double train(Ptr<Options> trainOptions, size_t updates) {
+  auto options = New<Options>(trainOptions->clone());
+  options->set("after", std::to_string(updates) + "u");
+  timer::Timer timer;
+  New<Train<SyncGraphGroup>>(options)->run();
+  return timer.elapsed();
+}
+
+void writeModel(const std::string& modelFrom, const std::string& modelTo, const std::string& gemmType) {
+  YAML::Node config;
+  std::stringstream configStr;
+  io::getYamlFromModel(config, "special:model.yml", modelFrom);
+  configStr << config;
+
+  auto graph = New<ExpressionGraphPackable>();
+  graph->setDevice(CPU0);
+  graph->load(modelFrom);
+  graph->forward();  // run the initializers
+  graph->packAndSave(modelTo, configStr.str(), typeFromString(gemmType), Type::float32);
+}
+
+}  // namespace bench
+}  // namespace marian
+
+int main(int argc, char** argv) {
+  using namespace marian;
+  using namespace marian::bench;
+
+  createLoggers();
+
+  auto options = New<Options>();
+  {
+    YAML::Node config; // @TODO: get rid of YAML::Node here entirely to avoid the pattern. Currently not fixing as it requires more changes to the Options object.
+    auto cli = New<cli::CLIWrapper>(
+        config,
+        "Benchmark decoding and training of randomly initialized models on a synthetic corpus. "
+        "Every combination of the swept options is run and reported as one JSON line",
+        "Allowed options",
+        "Examples:\n"
+        "  ./marian-bench --preset transformer-base --mini-batch 1 16 64 --beam-size 1 4 --gemm-type float32 intgemm8\n"
+        "  ./marian-bench --preset rnn --mode train --mini-batch 32 64 --threads 1 8 -o train.jsonl");
+    cli->add<std::string>("--preset",
+        "Model architecture: transformer-base, transformer-big, transformer-base-prenorm, "
+        "transformer-big-prenorm, or rnn (deep RNN as with --best-deep)",
+        "transformer-base");
+    cli->add<std::vector<std::string>>("--mode",
+        "What to benchmark: decode, train", {"decode"});
+    cli->add<size_t>("--vocab-size", "Size of the synthetic vocabulary", 8000);
+    cli->add<size_t>("--sentences", "Number of sentences in the synthetic corpus", 500);
+    cli->add<std::string>("--length-dist",
+        "Distribution of sentence lengths: normal, lognormal, uniform, fixed", "normal");
+    cli->add<float>("--length-mean", "Mean sentence length in words", 25);
+    cli->add<float>("--length-std", "Standard deviation of the sentence length in words", 10);
+    cli->add<size_t>("--max-length", "Sentences are at most arg words long", 100);
+    cli->add<size_t>("--seed", "Seed for the corpus and the model parameters", 1234);
+    cli->add<std::vector<int>>("--mini-batch", "Mini-batch sizes in sentences to sweep", {1, 16, 64});
+    cli->add<std::vector<size_t>>("--beam-size", "Beam sizes to sweep when decoding", {1, 4});
+    cli->add<std::vector<size_t>>("--threads", "Numbers of CPU worker threads (--cpu-threads) to sweep", {1});
+    cli->add<std::vector<std::string>>("--gemm-type",
+        "GEMM types to sweep when decoding, the model is converted as with marian-conv: "
+        "float32, packed16, packed8avx2, packed8avx512, intgemm8, intgemm16, ...", {"float32"});
+    cli->add<float>("--max-length-factor",
+        "Maximum target length as source length times arg, random models rarely stop early", 1.f);
+    cli->add<size_t>("--latency-requests",
+        "Number of sequential requests of one mini-batch each to measure latency percentiles", 20);
+    cli->add<size_t>("--train-updates", "Number of timed updates per training benchmark", 20);
+    cli->add<size_t>("--workspace,-w", "Preallocate arg MB of work space", 1024);
+    cli->add<std::string>("--workdir", "Directory for the synthetic data and models", "marian-bench.tmp");
+    cli->add<std::string>("--output,-o", "Write the JSON lines to this file", "stdout");
+    cli->parse(argc, argv);
+    options->merge(config);
+  }
+
+  auto preset = options->get<std::string>("preset");
+  auto modes = options->get<std::vector<std::string>>("mode");
+  auto workdir = options->get<std::string>("workdir");
+  for(const auto& mode : modes)
+    ABORT_IF(mode != "decode" && mode != "train", "Unknown benchmark mode '{}'", mode);
+  if(!filesystem::exists(workdir))
+    filesystem::createDirectories(workdir);
+
+  auto vocab = workdir + "/vocab.yml";
+  auto src = workdir + "/corpus.src";
+  auto trg = workdir + "/corpus.trg";
+  LOG(info, "[bench] Writing {} synthetic sentence pairs to {}", options->get<size_t>("sentences"), workdir);
+  auto lines = SyntheticCorpus(options).write(vocab, src, trg);
+  size_t srcWords = 0;
+  for(const auto& line : lines)
+    srcWords += countWords(line);
+
+  std::ofstream file;
+  auto outputPath = options->get<std::string>("output");
+  if(outputPath != "stdout")
+    file.open(outputPath);
+  std::ostream& out = outputPath != "stdout" ? file : std::cout;
+  ABORT_IF(!out, "Could not open {}", outputPath);
+
+  // The preset is expanded by the usual training option parser, the sweeps are applied on top
+  std::vector<std::string> trainArgs = {"marian", "--model", workdir + "/model.npz",
+      "--train-sets", src, trg, "--vocabs", vocab, vocab,
+      "--seed", std::to_string(options->get<size_t>("seed")),
+      "--max-length", std::to_string(options->get<size_t>("max-length")),
+      "--workspace", std::to_string(options->get<size_t>("workspace")),
+      "--cpu-threads", "1", "--disp-freq", "1000000", "--no-reload"};
+  if(preset == "rnn") {
+    trainArgs.insert(trainArgs.end(), {"--type", "s2s", "--best-deep"});
+  } else {
+    trainArgs.insert(trainArgs.end(), {"--task", preset});
+  }
+  auto trainOptions = parseMarianOptions(trainArgs, cli::mode::training);
+  trainOptions->set("mini-batch-fit", false);
+
+  auto json = [&](const std::string& mode) {
+    std::stringstream ss;
+    ss << "{\"mode\": \"" << mode << "\", \"preset\": \"" << preset << "\", \"sentences\": " << lines.size()
+       << ", \"source-words\": " << srcWords;
+    return ss.str();
+  };
+
+  if(std::find(modes.begin(), modes.end(), "train") != modes.end()) {
+    const size_t warmup = 2;
+    auto updates = options->get<size_t>("train-updates");
+    for(auto threads : options->get<std::vector<size_t>>("threads")) {
+      for(auto miniBatch : options->get<std::vector<int>>("mini-batch")) {
+        auto point = New<Options>(trainOptions->clone());
+        point->set("model", workdir + "/train.npz", "cpu-threads", threads, "mini-batch", miniBatch);
+
+        // the difference of a short and a long run leaves out corpus loading, graph building and saving
+        resetPeakMemory();
+        double base = train(point, warmup);
+        double total = train(point, warmup + updates);
+        double seconds = std::max(total - base, 1e-9);
+        double sentences = (double)updates * miniBatch;
+
+        out << json("train")
+            << ", \"threads\": " << threads << ", \"mini-batch\": " << miniBatch
+            << ", \"updates\": " << updates << ", \"seconds\": " << seconds
+            << ", \"updates-per-second\": " << updates / seconds
+            << ", \"sentences-per-second\": " << sentences / seconds
+            << ", \"source-words-per-second\": " << sentences * srcWords / lines.size() / seconds
+            << ", \"peak-memory-mb\": " << peakMemoryMB() << "}" << std::endl;
+      }
+    }
+  }
+
+  if(std::find(modes.begin(), modes.end(), "decode") == modes.end())
+    return 0;
+
+  LOG(info, "[bench] Creating a randomly initialized {} model", preset);
+  auto initOptions = New<Options>(trainOptions->clone());
+  initOptions->set("mini-batch", 1);
+  train(initOptions, 1);
+
+  for(auto gemmType : options->get<std::vector<std::string>>("gemm-type")) {
+    auto model = workdir + "/model." + gemmType + ".bin";
+    LOG(info, "[bench] Converting the model to {}", model);
+    writeModel(workdir + "/model.npz", model, gemmType);
+
+    auto translateOptions = parseMarianOptions({"marian-decoder", "--models", model, "--vocabs", vocab, vocab,
+        "--workspace", std::to_string(options->get<size_t>("workspace")),
+        "--max-length", std::to_string(options->get<size_t>("max-length")),
+        "--cpu-threads", "1", "--quiet-translation"}, cli::mode::translation);
+    translateOptions->set("max-length-factor", options->get<float>("max-length-factor"));
+
+    for(auto threads : options->get<std::vector<size_t>>("threads")) {
+      for(auto miniBatch : options->get<std::vector<int>>("mini-batch")) {
+        for(auto beamSize : options->get<std::vector<size_t>>("beam-size")) {
+          auto point = New<Options>(translateOptions->clone());
+          point->set("cpu-threads", threads, "mini-batch", miniBatch, "beam-size", beamSize);
+
+          resetPeakMemory();
+          auto service = New<TranslateService<BeamSearch>>(point);
+
+          std::vector<std::string> requests;
+          for(size_t i = 0; i < lines.size(); i += miniBatch) {
+            auto end = std::min(lines.size(), i + miniBatch);
+            requests.push_back(utils::join(std::vector<std::string>(lines.begin() + i, lines.begin() + end), "\n"));
+          }
+          service->run(requests.front());  // warm-up, e.g. allocates the workspace
+
+          timer::Timer timer;
+          auto output = service->run(utils::join(lines, "\n"));
+          double seconds = timer.elapsed();
+          size_t trgWords = countWords(output);
+
+          std::vector<double> latencies;
+          for(size_t i = 0; i < requests.size() && i < options->get<size_t>("latency-requests"); ++i) {
+            timer::Timer request;
+            service->run(requests[i]);
+            latencies.push_back(request.elapsed() * 1000);
+          }
+          std::sort(latencies.begin(), latencies.end());
+
+          out << json("decode")
+              << ", \"gemm-type\": \"" << gemmType << "\", \"threads\": " << threads
+              << ", \"mini-batch\": " << miniBatch << ", \"beam-size\": " << beamSize
+              << ", \"target-words\": " << trgWords << ", \"seconds\": " << seconds
+              << ", \"sentences-per-second\": " << lines.size() / seconds
+              << ", \"source-words-per-second\": " << srcWords / seconds
+              << ", \"target-words-per-second\": " << trgWords / seconds
+              << ", \"latency-p50-ms\": " << percentile(latencies, 50)
+              << ", \"latency-p90-ms\": " << percentile(latencies, 90)
+              << ", \"latency-p99-ms\": " << percentile(latencies, 99)
+              << ", \"peak-memory-mb\": " << peakMemoryMB() << "}" << std::endl;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -4,7 +4,38 @@
 #include "onnx/expression_graph_onnx_exporter.h"
 #include "layers/lsh.h"
 #include "data/shortlist.h"
+
+#include <cmath>
 #include <sstream>
+#include <thread>
+
+namespace marian {
+
+// Weights of --average: given by --average-weights, exponentially decaying from the last checkpoint
+// with --average-decay or equal, normalized to sum to 1
+static std::vector<double> averageWeights(Ptr<Options> options, size_t checkpoints) {
+  std::vector<double> weights(checkpoints, 1.0);
+  auto given = options->get<std::vector<float>>("average-weights", {});
+  auto decay = options->get<float>("average-decay", 0.f);
+  if(!given.empty()) {
+    ABORT_IF(given.size() != checkpoints, "--average-weights needs {} weights", checkpoints);
+    weights.assign(given.begin(), given.end());
+  } else if(decay > 0) {
+    ABORT_IF(decay > 1, "--average-decay has to be between 0 and 1");
+    for(size_t j = 0; j < checkpoints; ++j)
+      weights[j] = std::pow((double)decay, (double)(checkpoints - 1 - j));
+  }
+
+  double total = 0;
+  for(auto weight : weights)
+    total += weight;
+  ABORT_IF(total <= 0, "Checkpoint weights have to sum to a positive value");
+  for(auto& weight : weights)
+    weight /= total;
+  return weights;
+}
+
+}  // namespace marian
 
 int main(int argc, char** argv) {
   using namespace marian;
@@ -17,15 +48,17 @@ int main(int argc, char** argv) {
     auto cli = New<cli::CLIWrapper>(
         config,
         "Convert a model in the .npz format and normal memory layout to a mmap-able binary model which could be in normal memory layout or packed memory layout\n"
-        "or convert a text lexical shortlist to a binary shortlist with {--shortlist,-s} option",
+        "or convert a text lexical shortlist to a binary shortlist with {--shortlist,-s} option\n"
+        "or average checkpoints with {--average,-a} and convert the result",
         "Allowed options",
         "Examples:\n"
-        "  ./marian-conv -f model.npz -t model.bin --gemm-type packed16");
+        "  ./marian-conv -f model.npz -t model.bin --gemm-type packed16\n"
+        "  ./marian-conv -a model.iter1000.npz model.iter2000.npz model.iter3000.npz -t model.avg.npz");
     cli->add<std::string>("--from,-f", "Input model", "model.npz");
     cli->add<std::string>("--to,-t", "Output model", "model.bin");
     cli->add<std::string>("--export-as", "Kind of conversion: marian-bin or onnx-{encode,decoder-step,decoder-init,decoder-stop}", "marian-bin");
     cli->add<std::string>("--gemm-type,-g", "GEMM Type to be used: float32, packed16, packed8avx2, packed8avx512, "
-                          "intgemm8, intgemm8ssse3, intgemm8avx2, intgemm8avx512, intgemm16, intgemm16sse2, intgemm16avx2, intgemm16avx512", 
+                          "intgemm8, intgemm8ssse3, intgemm8avx2, intgemm8avx512, intgemm16, intgemm16sse2, intgemm16avx2, intgemm16avx512, bfloat16", 
                           "float32");
     cli->add<std::vector<std::string>>("--add-lsh", 
                                        "Encode output matrix and optional rotation matrix into model file. "
@@ -33,6 +66,15 @@ int main(int argc, char** argv) {
     cli->add<std::vector<std::string>>("--vocabs,-V", "Vocabulary file, required for ONNX export");
     cli->add<std::vector<std::string>>("--shortlist,-s", "Shortlist conversion: filePath firstNum bestNum threshold");
     cli->add<std::string>("--dump-shortlist,-d", "Binary shortlist dump path","lex.bin");
+    cli->add<std::vector<std::string>>("--average,-a",
+                                       "Checkpoints (.npz or .bin) to average item by item instead of converting --from. "
+                                       "The configuration is taken from the last one");
+    cli->add<std::vector<float>>("--average-weights", "Weight of every checkpoint of --average, normalized to sum to 1");
+    cli->add<float>("--average-decay",
+                    "Weight the checkpoints of --average exponentially: the i-th of N gets decay^(N-i), normalized. "
+                    "0 weights them equally",
+                    0.f);
+    cli->add<size_t>("--threads", "Number of threads used by --average, 0 for one per core", 0);
     cli->parse(argc, argv);
     options->merge(config);
   }
@@ -76,15 +118,42 @@ int main(int argc, char** argv) {
 
   LOG(info, "Outputting {}, precision: {}", modelTo, saveGemmType);
 
+  // averaged checkpoints are converted from memory instead of --from
+  std::vector<io::Item> averaged;
+  if(options->hasAndNotEmpty("average")) {
+    auto checkpoints = options->get<std::vector<std::string>>("average");
+    auto weights = averageWeights(options, checkpoints.size());
+    size_t threads = options->get<size_t>("threads");
+    if(threads == 0)
+      threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    if(exportAs == "marian-bin" && saveGemmType == Type::float32 && !addLsh) {
+      // nothing to pack, write the items as they are averaged without copying them into a graph
+      io::saveAveragedCheckpoints(modelTo, checkpoints, weights, threads);
+      LOG(info, "Finished");
+      return 0;
+    }
+    averaged = io::averageCheckpoints(checkpoints, weights, threads);
+  }
+  auto load = [&](Ptr<ExpressionGraph> graph) {
+    if(averaged.empty())
+      graph->load(modelFrom);
+    else
+      graph->load(averaged);
+  };
+
   YAML::Node config;
   std::stringstream configStr;
-  marian::io::getYamlFromModel(config, "special:model.yml", modelFrom);
+  if(averaged.empty())
+    marian::io::getYamlFromModel(config, "special:model.yml", modelFrom);
+  else
+    marian::io::getYamlFromModel(config, "special:model.yml", averaged);
   configStr << config;
 
   if (exportAs == "marian-bin") {
     auto graph = New<ExpressionGraphPackable>();
     graph->setDevice(CPU0);
-    graph->load(modelFrom);
+    load(graph);
 
     if(addLsh) {
       // Add dummy parameters for the LSH before the model gets actually initialized.
@@ -109,7 +178,7 @@ int main(int argc, char** argv) {
 #ifdef USE_ONNX
     auto graph = New<ExpressionGraphONNXExporter>();
     graph->setDevice(CPU0);
-    graph->load(modelFrom);
+    load(graph);
     graph->forward();  // run the initializers
     auto modelOptions = New<Options>(config)->with("vocabs", vocabPaths, "inference", true);
 
@@ -0,0 +1,79 @@
+#include "marian.h"
+#include "common/cli_wrapper.h"
+#include "common/file_stream.h"
+#include "common/timer.h"
+#include "embedder/knn.h"
+#include "tensors/cpu/parallel.h"
+
+#include <thread>
+
+int main(int argc, char** argv) {
+  using namespace marian;
+
+  createLoggers();
+
+  auto options = New<Options>();
+  {
+    YAML::Node config;
+    auto cli = New<cli::CLIWrapper>(
+        config,
+        "Mine parallel sentences from two sets of sentence embeddings written by marian-embedder with "
+        "--embedding-format npy: for every source sentence print the target sentence with the best ratio "
+        "margin among its k nearest neighbours",
+        "Allowed options",
+        "Examples:\n"
+        "  ./marian-knn -s src.npy -t trg.npy -k 4 --nlist 4096 --nprobe 16 > candidates.tsv");
+    cli->add<std::string>("--source,-s", "Source embeddings (.npy)");
+    cli->add<std::string>("--target,-t", "Target embeddings (.npy)");
+    cli->add<std::string>("--output,-o", "Output: source line, target line, margin and cosine per line", "stdout");
+    cli->add<size_t>("--k,-k", "Number of nearest neighbours for the margin", 4);
+    cli->add<size_t>("--nlist",
+                     "Number of inverted lists of the index, trained with k-means. 0 searches exhaustively", 0);
+    cli->add<size_t>("--nprobe", "Number of lists that are searched for each query", 8);
+    cli->add<size_t>("--kmeans-iterations", "Number of k-means iterations to train the lists", 10);
+    cli->add<float>("--threshold", "Only print candidates with at least this margin", 0.f);
+    cli->add<size_t>("--threads", "Number of threads, 0 for one per core", 0);
+    cli->add<size_t>("--seed", "Seed for sampling the k-means training vectors", 1234);
+    cli->parse(argc, argv);
+    options->merge(config);
+  }
+
+  size_t threads = options->get<size_t>("threads");
+  cpu::setIntraOpThreads(threads > 0 ? threads : std::max(std::thread::hardware_concurrency(), 1u));
+
+  timer::Timer timer;
+  auto sources = New<knn::Embeddings>(options->get<std::string>("source"));
+  auto targets = New<knn::Embeddings>(options->get<std::string>("target"));
+  ABORT_IF(sources->dim() != targets->dim(),
+           "Source embeddings have dimension {}, target embeddings {}",
+           sources->dim(),
+           targets->dim());
+
+  size_t nlist = options->get<size_t>("nlist");
+  size_t iterations = options->get<size_t>("kmeans-iterations");
+  size_t seed = options->get<size_t>("seed");
+  knn::Index sourceIndex(sources, std::min(nlist, sources->rows()), iterations, seed);
+  knn::Index targetIndex(targets, std::min(nlist, targets->rows()), iterations, seed);
+  LOG(info, "[knn] Indexed in {:.2f}s", timer.elapsed());
+
+  auto candidates = knn::mineMargin(*sources, *targets, sourceIndex, targetIndex,
+                                    options->get<size_t>("k"), options->get<size_t>("nprobe"));
+  LOG(info, "[knn] Searched in {:.2f}s", timer.elapsed());
+
+  auto outFile = options->get<std::string>("output");
+  UPtr<std::ostream> out(outFile == "stdout" ? new std::ostream(std::cout.rdbuf())
+                                             : new io::OutputFileStream(outFile));
+  float threshold = options->get<float>("threshold");
+  size_t printed = 0;
+  for(size_t i = 0; i < candidates.size(); ++i) {
+    const auto& candidate = candidates[i];
+    if(candidate.target < 0 || candidate.margin < threshold)
+      continue;
+    *out << i << "\t" << candidate.target << "\t" << candidate.margin << "\t" << candidate.cosine << "\n";
+    printed++;
+  }
+  out->flush();
+
+  LOG(info, "[knn] Printed {} of {} candidates, total time {:.2f}s", printed, candidates.size(), timer.elapsed());
+  return 0;
+}
@@ -1,52 +1,267 @@
 #include "marian.h"
 #include "translator/beam_search.h"
+#include "translator/model_registry.h"
+#include "translator/request_queue.h"
 #include "translator/translator.h"
 #include "common/timer.h"
 #include "common/utils.h"
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+
 #include "3rd_party/simple-websocket-server/server_ws.hpp"
 
 typedef SimpleWeb::SocketServer<SimpleWeb::WS> WSServer;
 
+namespace marian {
+
+// A queued request together with the connection to answer on
+struct ServerRequest : public ServiceRequest {
+  Ptr<WSServer::Connection> connection;
+  std::string model;  // empty for the default model
+};
+
+// The queued and running requests of every open connection, so that they can be cancelled when
+// their client goes away
+class ConnectionRequests {
+public:
+  void add(Ptr<ServerRequest> request) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& requests = requests_[request->connection.get()];
+    // forget the requests that have been answered already
+    requests.erase(std::remove_if(requests.begin(), requests.end(),
+                                  [](const std::weak_ptr<ServerRequest>& r) { return r.expired(); }),
+                   requests.end());
+    requests.push_back(request);
+  }
+
+  void cancel(const WSServer::Connection* connection) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = requests_.find(connection);
+    if(it == requests_.end())
+      return;
+    for(auto& weak : it->second)
+      if(auto request = weak.lock())
+        request->cancelled = true;
+    requests_.erase(it);
+  }
+
+private:
+  std::mutex mutex_;
+  std::map<const WSServer::Connection*, std::vector<std::weak_ptr<ServerRequest>>> requests_;
+};
+
+// Reads an optional first line '#request priority=<n> deadline=<seconds> model=<name>' from the input,
+// returns an error message or an empty string
+static std::string parseRequestHeader(ServerRequest& request, double defaultDeadline) {
+  double deadline = defaultDeadline;
+  const std::string header = "#request";
+  if(request.input.compare(0, header.size(), header) == 0) {
+    auto end = request.input.find('\n');
+    std::string line = request.input.substr(0, end);
+    request.input = end == std::string::npos ? "" : request.input.substr(end + 1);
+    for(auto field : utils::split(line.substr(header.size()), " ")) {
+      auto kv = utils::split(field, "=");
+      try {
+        if(kv.size() == 2 && kv[0] == "priority")
+          request.priority = std::stoul(kv[1]);
+        else if(kv.size() == 2 && kv[0] == "deadline")
+          deadline = std::stod(kv[1]);
+        else if(kv.size() == 2 && kv[0] == "model")
+          request.model = kv[1];
+        else
+          return "invalid request header field '" + field + "'";
+      } catch(const std::exception&) {
+        return "invalid request header field '" + field + "'";
+      }
+    }
+  }
+  if(deadline > 0)
+    request.deadline = request.arrival + std::chrono::duration_cast<ServiceRequest::Clock::duration>(std::chrono::duration<double>(deadline));
+  return "";
+}
+
+}  // namespace marian
+
 int main(int argc, char **argv) {
   using namespace marian;
 
   // Initialize translation task
   auto options = parseOptions(argc, argv, cli::mode::server, true);
-  auto task = New<TranslateService<BeamSearch>>(options);
+  ModelRegistry<TranslateService<BeamSearch>> registry(options);
+  auto admin = options->get<bool>("model-admin");
   auto quiet = options->get<bool>("quiet-translation");
+  auto stream = options->get<bool>("stream");
+  auto streamPartial = options->get<bool>("stream-partial");
+  auto defaultDeadline = options->get<float>("request-deadline");
 
   // Initialize web server
   WSServer server;
   server.config.port = (short)options->get<size_t>("port", 8080);
 
   auto &translate = server.endpoint["^/translate/?$"];
+  auto &metrics = server.endpoint["^/metrics/?$"];
+  auto &models = server.endpoint["^/models/?$"];
 
-  translate.on_message = [&task, quiet](Ptr<WSServer::Connection> connection,
-                                        Ptr<WSServer::InMessage> message) {
-    // Get input text
-    auto inputText = message->string();
+  auto send = [](Ptr<WSServer::Connection> connection, const std::string& text) {
     auto sendStream = std::make_shared<WSServer::OutMessage>();
-
-    // Translate
-    timer::Timer timer;
-    auto outputText = task->run(inputText);
-    *sendStream << outputText << std::endl;
-    if(!quiet)
-      LOG(info, "Translation took: {:.5f}s", timer.elapsed());
-
-    // Send translation back
+    *sendStream << text << std::endl;
     connection->send(sendStream, [](const SimpleWeb::error_code &ec) {
       if(ec)
         LOG(error, "Error sending message: ({}) {}", ec.value(), ec.message());
     });
   };
 
+  auto process = [&registry, &send, quiet, stream, streamPartial](Ptr<ServiceRequest> serviceRequest) {
+    auto request = std::static_pointer_cast<ServerRequest>(serviceRequest);
+    auto connection = request->connection;
+    auto cancelled = [request]() { return request->expired(); };
+
+    // the request keeps this model even if it is replaced or unloaded meanwhile
+    auto model = registry.get(request->model);
+    if(!model) {
+      send(connection, "error\tunknown model '" + request->model + "'");
+      return;
+    }
+    auto task = model->service;
+
+    timer::Timer timer;
+    if(!stream) {
+      // Translate and send the whole translation back
+      auto outputText = task->run(request->input, nullptr, /*partial=*/false, cancelled);
+      if(request->cancelled)
+        return; // nobody to answer
+      if(request->expired())
+        send(connection, "error\tdeadline exceeded");
+      else
+        send(connection, outputText);
+      if(!quiet)
+        LOG(info, "Translation took: {:.5f}s", timer.elapsed());
+      return;
+    }
+
+    // Translate and send each sentence as soon as it is finished; the workers of the translation
+    // service call this concurrently, hence the lock
+    std::mutex sendMutex;
+    size_t lines = 0;
+    double firstSentence = 0;
+    task->run(request->input, [&](size_t lineNum, const std::string& text, bool final) {
+      std::lock_guard<std::mutex> lock(sendMutex);
+      if(final && lines++ == 0)
+        firstSentence = timer.elapsed();
+      send(connection, (final ? "final\t" : "partial\t") + std::to_string(lineNum) + "\t" + text);
+    }, streamPartial, cancelled);
+
+    double seconds = timer.elapsed();
+    if(request->cancelled)
+      return;
+    if(request->expired())
+      send(connection, "error\tdeadline exceeded");
+    else
+      send(connection, "done\t" + std::to_string(lines) + "\t" + std::to_string(seconds));
+    if(!quiet)
+      LOG(info, "Translation took: {:.5f}s, first sentence after {:.5f}s", seconds, firstSentence);
+  };
+
+  auto expire = [&send](Ptr<ServiceRequest> request) {
+    if(!request->cancelled)
+      send(std::static_pointer_cast<ServerRequest>(request)->connection, "error\tdeadline exceeded");
+  };
+
+  // Requests are queued by priority and translated one at a time by the queue's worker thread, so
+  // the server thread stays free to admit or reject new requests
+  RequestQueue queue(process,
+                     expire,
+                     options->get<size_t>("queue-size"),
+                     options->get<float>("queue-max-wait"));
+
+  // requests of closed connections are dropped from the queue or stopped, see ServiceRequest::expired()
+  ConnectionRequests connectionRequests;
+
+  translate.on_message = [&queue, &registry, &send, &connectionRequests, defaultDeadline](
+                             Ptr<WSServer::Connection> connection, Ptr<WSServer::InMessage> message) {
+    auto request = New<ServerRequest>();
+    request->connection = connection;
+    request->input = message->string();
+    std::string reason = parseRequestHeader(*request, defaultDeadline);
+    if(reason.empty() && !registry.get(request->model))
+      reason = "unknown model '" + request->model + "'";
+    if(!reason.empty()) {
+      send(connection, "error\t" + reason);
+      return;
+    }
+    connectionRequests.add(request);
+    if(!queue.submit(request, reason)) {
+      LOG(warn, "Rejected request: {}", reason);
+      send(connection, "error\t" + reason);
+    }
+  };
+
+  metrics.on_message = [&queue, &send](Ptr<WSServer::Connection> connection,
+                                       Ptr<WSServer::InMessage> /*message*/) {
+    send(connection, queue.metrics().toString());
+  };
+
+  // 'list' (or an empty message) answers with a line 'name<TAB>generation<TAB>seconds to load' per
+  // model. With --model-admin, 'load <name> <config file>', 'reload <name>' and 'unload <name>'
+  // change the models; loads are answered with 'loading<TAB>name' and, once the model receives
+  // requests, 'loaded<TAB>name<TAB>generation'
+  models.on_message = [&registry, &send, admin](Ptr<WSServer::Connection> connection,
+                                                Ptr<WSServer::InMessage> message) {
+    auto command = utils::splitAny(message->string(), " \t\n");
+    if(command.empty() || (command[0] == "list" && command.size() == 1)) {
+      std::string list;
+      for(auto model : registry.list())
+        list += (list.empty() ? "" : "\n") + model->name + "\t" + std::to_string(model->generation) + "\t"
+                + std::to_string(model->seconds);
+      send(connection, list);
+      return;
+    }
+
+    if(!admin) {
+      send(connection, "error\tchanging models is disabled, see --model-admin");
+      return;
+    }
+
+    auto done = [&send, connection](const std::string& error, Ptr<const ModelRegistry<TranslateService<BeamSearch>>::Model> model) {
+      if(model)
+        send(connection, "loaded\t" + model->name + "\t" + std::to_string(model->generation));
+      else
+        send(connection, "error\t" + error);
+    };
+
+    std::string error;
+    if(command[0] == "load" && command.size() == 3) {
+      send(connection, "loading\t" + command[1]);
+      registry.load(command[1], YAML::Node(command[2]), done);
+    } else if(command[0] == "reload" && command.size() == 2) {
+      if(registry.reload(command[1], done, error))
+        send(connection, "loading\t" + command[1]);
+      else
+        send(connection, "error\t" + error);
+    } else if(command[0] == "unload" && command.size() == 2) {
+      if(registry.unload(command[1], error))
+        send(connection, "unloaded\t" + command[1]);
+      else
+        send(connection, "error\t" + error);
+    } else {
+      send(connection, "error\tunknown command '" + message->string() + "'");
+    }
+  };
+
   // Error Codes for error code meanings
   // http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html
-  translate.on_error = [](Ptr<WSServer::Connection> /*connection*/,
-                          const SimpleWeb::error_code &ec) {
+  translate.on_error = [&connectionRequests](Ptr<WSServer::Connection> connection,
+                                              const SimpleWeb::error_code &ec) {
     LOG(error, "Connection error: ({}) {}", ec.value(), ec.message());
+    connectionRequests.cancel(connection.get());
+  };
+
+  translate.on_close = [&connectionRequests](Ptr<WSServer::Connection> connection,
+                                             int /*status*/,
+                                             const std::string& /*reason*/) {
+    connectionRequests.cancel(connection.get());
   };
 
   // Start server thread
@@ -176,6 +176,61 @@ void saveItems(const std::string& fileName,
                                                       // No version-bump required. Gets 5-8% of speed back when mmapped.
 }
 
+ItemWriter::ItemWriter(const std::string& fileName, const std::vector<io::Item>& headers)
+    : out_(new io::OutputFileStream(fileName)) {
+  uint64_t pos = 0;
+
+  uint64_t binaryFileVersion = BINARY_FILE_VERSION;
+  pos += out_->write(&binaryFileVersion);
+
+  // the values are written without padding
+  std::vector<Header> binaryHeaders;
+  for(const auto& item : headers) {
+    binaryHeaders.push_back(Header{item.name.size() + 1,
+                                   (uint64_t)item.type,
+                                   item.shape.size(),
+                                   item.size()});
+    headers_.push_back({});
+    headers_.back().name = item.name;
+    headers_.back().shape = item.shape;
+    headers_.back().type = item.type;
+  }
+
+  uint64_t headerSize = binaryHeaders.size();
+  pos += out_->write(&headerSize);
+  pos += out_->write(binaryHeaders.data(), binaryHeaders.size());
+
+  for(const auto& item : headers)
+    pos += out_->write(item.name.data(), item.name.size() + 1);
+  for(const auto& item : headers)
+    pos += out_->write(item.shape.data(), item.shape.size());
+
+  // align to next 256-byte boundary, see saveItems()
+  uint64_t nextpos = ((pos + sizeof(uint64_t)) / 256 + 1) * 256;
+  uint64_t offset = nextpos - pos - sizeof(uint64_t);
+
+  pos += out_->write(&offset);
+  for(uint64_t i = 0; i < offset; i++) {
+    char padding = 0;
+    pos += out_->write(&padding);
+  }
+}
+
+ItemWriter::~ItemWriter() {
+  if(written_ != headers_.size())
+    LOG(warn, "[io] Binary model was closed after {} of {} items", written_, headers_.size());
+}
+
+void ItemWriter::write(const io::Item& item) {
+  ABORT_IF(written_ >= headers_.size(), "All {} items have been written already", headers_.size());
+  const auto& header = headers_[written_];
+  ABORT_IF(item.name != header.name || item.type != header.type || item.shape != header.shape,
+           "Expected item {} {} {}, got {} {} {}",
+           header.name, header.type, header.shape, item.name, item.type, item.shape);
+  out_->write(item.data(), item.size());
+  written_++;
+}
+
 }  // namespace binary
 }  // namespace io
 }  // namespace marian
@@ -2,6 +2,7 @@
 
 #include "common/io_item.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -10,6 +11,9 @@ namespace marian {
 const static int BINARY_FILE_VERSION = 1;
 
 namespace io {
+
+class OutputFileStream;
+
 namespace binary {
 
 void loadItems(const void* current,
@@ -22,6 +26,24 @@ io::Item getItem(const std::string& fileName, const std::string& vName);
 
 void saveItems(const std::string& fileName, const std::vector<io::Item>& items);
 
+/**
+ * Writes a binary model one item at a time. The constructor writes the headers from the names,
+ * types and shapes of 'headers', their values are ignored. write() then has to be called with
+ * the items in the same order, hence only one of them needs to be in memory.
+ */
+class ItemWriter {
+public:
+  ItemWriter(const std::string& fileName, const std::vector<io::Item>& headers);
+  ~ItemWriter();
+
+  void write(const io::Item& item);
+
+private:
+  std::unique_ptr<io::OutputFileStream> out_;
+  std::vector<io::Item> headers_;
+  size_t written_{0};
+};
+
 }  // namespace binary
 }  // namespace io
 }  // namespace marian
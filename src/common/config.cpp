@@ -6,6 +6,8 @@
 #include "common/regex.h"
 #include "common/utils.h"
 #include "common/version.h"
+#include "graph/profiler.h"
+#include "tensors/cpu/parallel.h"
 
 #include <algorithm>
 #include <set>
@@ -48,6 +50,18 @@ void Config::initialize(ConfigParser const& cp) {
     seed = get<size_t>("seed");
   }
 
+#if COMPILE_CPU
+  if(has("cpu-intra-op-threads"))
+    cpu::setIntraOpThreads(get<size_t>("cpu-intra-op-threads"));
+  if(has("deterministic"))
+    cpu::setDeterministic(get<bool>("deterministic"));
+#endif
+
+  if(get<bool>("profile", false) || !get<std::string>("profile-trace", "").empty())
+    GraphProfiler::enable(get<std::string>("profile-trace", ""), get<size_t>("profile-top", 20));
+  if(get<bool>("memory-stats", false))
+    GraphMemoryStats::enable(get<size_t>("profile-top", 20));
+
   // load model parameters
   bool loaded = false;
   if(mode == cli::mode::translation || mode == cli::mode::server) {
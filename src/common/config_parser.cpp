@@ -162,6 +162,36 @@ void ConfigParser::addOptionsServer(cli::CLIWrapper& cli) {
   cli.add<size_t>("--port,-p",
       "Port number for web socket server",
       8080);
+  cli.add<bool>("--stream",
+      "Send every translated sentence as its own message as soon as it is finished: "
+      "'final<TAB>line number<TAB>translation', followed by 'done<TAB>lines<TAB>seconds'");
+  cli.add<bool>("--stream-partial",
+      "With --stream also send the best partial translation of every unfinished sentence after each "
+      "decoding step: 'partial<TAB>line number<TAB>prefix'. Prefixes may change with beam sizes above 1");
+  cli.add<size_t>("--queue-size",
+      "Reject new requests while this many requests are waiting, 0 means no limit",
+      0);
+  cli.add<float>("--queue-max-wait",
+      "Reject new requests whose expected wait in seconds, estimated from the average translation time "
+      "of the requests ahead of them, exceeds this value. 0 means no limit",
+      0);
+  cli.add<float>("--request-deadline",
+      "Default deadline in seconds after arrival for requests without one. Requests past their deadline "
+      "are answered with 'error<TAB>deadline exceeded' and their translation is stopped. A request may "
+      "start with a line '#request priority=<n> deadline=<seconds>', lower priorities are served first. "
+      "0 means no deadline",
+      0);
+  cli.add<std::string>("--model-registry",
+      "YAML file mapping model names to config files or maps of options. These models are served in "
+      "addition to the one given with --models, called 'default'. A request chooses a model with "
+      "'#request model=<name>', see /models for the loaded ones");
+  cli.add<bool>("--model-admin",
+      "Accept 'load <name> <config file>', 'reload <name>' and 'unload <name>' on /models. Models are "
+      "loaded and warmed up in the background and replace the model of that name once ready, while "
+      "running requests finish with the previous one");
+  cli.add<std::string>("--model-warmup",
+      "Sentence that every model translates after loading, before it receives requests. Empty for none",
+      "Hello world");
   cli.switchGroup(previous_group);
   // clang-format on
 }
@@ -451,9 +481,16 @@ void ConfigParser::addOptionsTraining(cli::CLIWrapper& cli) {
      "SGD update delay (#batches between updates). 1 = no delay. "
      "Can be fractional, e.g. 0.1 to use only 10% of each batch",
      1.f);
+  cli.add<bool>("--lazy-embedding-updates",
+     "Adam only: update embedding matrices (*Wemb) row by row and skip rows without gradient. "
+     "Skipped steps are caught up by decaying the row's moments when it is seen next. Requires --sync-sgd");
 
   cli.add<bool>("--sync-sgd",
      "Use synchronous SGD instead of asynchronous for multi-gpu training");
+  cli.add<bool>("--cpu-shared-params",
+     "Let all local CPU workers (--cpu-threads) read one shared copy of the model parameter values instead of one copy each. "
+     "Requires --sync-sgd. This saves one copy of the model per additional worker. "
+     "Gradients are not partitioned, every worker keeps full-size gradients");
 
   // learning rate options
   cli.add<float>("--learn-rate,-l",
@@ -724,6 +761,12 @@ void ConfigParser::addOptionsTranslation(cli::CLIWrapper& cli) {
   cli.add<float>("--quantize-range",
      "Range for the on-line quantiziation of weight matrix in multiple of this range and standard deviation, 0.0 means min/max quantization",
      0.f);
+  cli.add<bool>("--fuse-elementwise",
+     "Fuse chains of element-wise operations on the CPU and compute them in cache-sized tiles");
+  cli.add<bool>("--fused-attention",
+     "Compute transformer attention on the CPU in one fused operation without materializing attention weights");
+  cli.add<bool>("--int8-activations",
+     "Compute attention products and the short-listed output layer on the CPU with on-line int8 quantization");
 
 #if 0 // @TODO: Ask Hany if there are any decoding-time options
   // add ULR settings
@@ -809,7 +852,15 @@ void ConfigParser::addOptionsEmbedding(cli::CLIWrapper& cli) {
   cli.add<bool>("--compute-similarity",
       "Expect two inputs and compute cosine similarity instead of outputting embedding vector");
   cli.add<bool>("--binary",
-      "Output vectors as binary floats");
+      "Output vectors as binary floats, same as --embedding-format binary");
+  cli.add<std::string>("--embedding-format",
+      "Output format of the vectors: text, binary (without header) or npy (a numpy array that can be "
+      "memory-mapped, requires --output)",
+      "text");
+  cli.add<std::string>("--embedding-type",
+      "Type of binary and npy vectors: float32, float16 or int8. int8 vectors are scaled to their largest "
+      "absolute value, which keeps their cosine similarities",
+      "float32");
 
   addSuboptionsInputLength(cli);
   addSuboptionsTSV(cli);
@@ -833,17 +884,23 @@ void ConfigParser::addSuboptionsDevices(cli::CLIWrapper& cli) {
       {"0"});
   cli.add<size_t>("--num-devices",
       "Number of GPUs to use for this process. Defaults to length(devices) or 1");
-#ifdef USE_NCCL
+#if defined(USE_NCCL) || MPI_FOUND
   if(mode_ == cli::mode::training) {
+#ifdef USE_NCCL
     cli.add<bool>("--no-nccl",
       "Disable inter-GPU communication via NCCL");
+#endif
     cli.add<std::string>("--sharding",
       "When using NCCL and MPI for multi-process training use 'global' (default, less memory usage) "
-      "or 'local' (more memory usage but faster) sharding",
+      "or 'local' (more memory usage but faster) sharding. Without NCCL only 'local' supports multiple processes",
       {"global"});
     cli.add<std::string/*SchedulerPeriod*/>("--sync-freq",
       "When sharding is local sync all shards across processes once every n steps (possible units u=updates, t=target labels, e=epochs)",
       "200u");
+    cli.add<std::vector<std::string>>("--gradient-compression",
+      "Compress gradients exchanged between MPI processes with error feedback (requires --sharding local): "
+      "'topk' fraction of largest entries to send (e.g. topk 0.01) or '8bit' bucket size (e.g. 8bit 512)")
+      ->implicit_val("topk 0.01");
   }
 #endif
 #ifdef CUDA_FOUND
@@ -856,6 +913,30 @@ void ConfigParser::addSuboptionsDevices(cli::CLIWrapper& cli) {
       "Use CPU-based computation with this many independent threads, 0 means GPU-based computation",
       1);
 #endif
+  cli.add<size_t>("--cpu-intra-op-threads",
+      "Split large element-wise and reduction operators on CPU across this many threads. "
+      "The threads are shared between all independent threads from --cpu-threads",
+      1);
+  cli.add<bool>("--deterministic",
+      "Pin MKL to a reproducible code path (conditional numerical reproducibility), so that GEMM results "
+      "do not depend on the CPU model. No effect in builds without MKL. Marian's own CPU reductions use "
+      "a fixed order regardless, their results never depend on --cpu-intra-op-threads",
+#if DETERMINISTIC
+      true);
+#else
+      false);
+#endif
+  cli.add<bool>("--profile",
+      "Time every operator of the forward and backward passes, log the most expensive ones by type, "
+      "shape and name prefix at exit");
+  cli.add<std::string>("--profile-trace",
+      "Also write all profiled operators to this file as Chrome trace events, implies --profile");
+  cli.add<size_t>("--profile-top",
+      "Number of entries in the profiler and memory statistics tables",
+      20);
+  cli.add<bool>("--memory-stats",
+      "Log the workspace memory statistics of every graph when it is released: peak use, growth, "
+      "fragmentation, allocations per step and the bytes at the peak by node type and name prefix");
   // clang-format on
 }
 
@@ -882,8 +963,15 @@ void ConfigParser::addSuboptionsBatching(cli::CLIWrapper& cli) {
     cli.add<size_t>("--mini-batch-fit-step",
       "Step size for mini-batch-fit statistics",
       10);
+    cli.add<bool>("--mini-batch-fit-analytic",
+      "Estimate memory usage for mini-batch-fit from the graph instead of running each fake batch. "
+      "The estimate is calibrated once against the longest fake batch");
     cli.add<bool>("--gradient-checkpointing",
       "Enable gradient-checkpointing to minimize memory usage");
+    cli.add<size_t>("--gradient-checkpointing-budget",
+      "Memory budget in MB for activations with --gradient-checkpointing. Layers are only recomputed "
+      "if their outputs do not fit into the budget. 0 recomputes all layers",
+      0);
   }
 
   cli.add<int>("--maxi-batch",
@@ -163,6 +163,24 @@ void ConfigValidator::validateOptionsTraining() const {
   ABORT_IF(bits > 32, "Invalid quantization bits. Must be from 0 to 32 bits");
 
   ABORT_IF(bits > 0 && !get<bool>("sync-sgd"), "Model quantization only works with synchronous training (--sync-sgd)");
+
+  ABORT_IF(get<size_t>("gradient-checkpointing-budget") > 0 && !get<bool>("gradient-checkpointing"),
+           "A memory budget for gradient checkpointing requires --gradient-checkpointing");
+
+  ABORT_IF(get<bool>("mini-batch-fit-analytic") && !get<bool>("mini-batch-fit"),
+           "Option --mini-batch-fit-analytic requires --mini-batch-fit");
+
+  // validate parameter sharing between CPU workers
+  if(get<bool>("cpu-shared-params")) {
+    ABORT_IF(!get<bool>("sync-sgd"), "Sharing parameters between CPU workers only works with synchronous training (--sync-sgd)");
+    ABORT_IF(bits > 0, "Sharing parameters between CPU workers is not supported with model quantization (--quantize-bits)");
+  }
+
+  // validate lazy embedding updates
+  if(get<bool>("lazy-embedding-updates")) {
+    ABORT_IF(!get<bool>("sync-sgd"), "Lazy embedding updates only work with synchronous training (--sync-sgd)");
+    ABORT_IF(get<std::string>("optimizer") != "adam", "Lazy embedding updates are only implemented for the Adam optimizer");
+  }
 }
 
 void ConfigValidator::validateModelExtension(cli::mode mode) const {
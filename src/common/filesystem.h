@@ -109,6 +109,11 @@ namespace filesystem {
     return p.getImpl().is_directory();
   }
 
+  // Creates the directory and its missing parents
+  static inline void createDirectories(const Path& p) {
+    p.getImpl().mktree();
+  }
+
   static inline Path operator/ (const Path& lhs, const Path& rhs) {
     return Path(lhs.getImpl() / rhs.getImpl());
   }
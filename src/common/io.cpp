@@ -1,12 +1,21 @@
 #include "common/io.h"
 
 #include "3rd_party/cnpy/cnpy.h"
+#include "3rd_party/mio/mio.hpp"
+#include "3rd_party/threadpool.h"
 #include "common/shape.h"
 #include "common/types.h"
 
 #include "common/binary.h"
+#include "common/definitions.h"
 #include "common/io_item.h"
 
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+
 namespace marian {
 namespace io {
 
@@ -87,36 +96,39 @@ void addMetaToItems(const std::string& meta,
   items.push_back(item);
 }
 
+Item itemFromNpy(const std::string& name, cnpy::NpyArrayPtr array) {
+  Shape shape;
+  shape.resize(array->shape.size());
+  for(size_t i = 0; i < array->shape.size(); ++i)
+    shape.set(i, (size_t)array->shape[i]);
+
+  Item item;
+  item.name = name;
+  item.shape = shape;
+
+  char npzType = array->type;
+  int wordSize = array->word_size;
+  if     (npzType == 'f' && wordSize == 2) item.type = Type::float16;
+  else if(npzType == 'f' && wordSize == 4) item.type = Type::float32;
+  else if(npzType == 'f' && wordSize == 8) item.type = Type::float64;
+  else if(npzType == 'i' && wordSize == 1) item.type = Type::int8;
+  else if(npzType == 'i' && wordSize == 2) item.type = Type::int16;
+  else if(npzType == 'i' && wordSize == 4) item.type = Type::int32;
+  else if(npzType == 'i' && wordSize == 8) item.type = Type::uint64;
+  else if(npzType == 'u' && wordSize == 1) item.type = Type::uint8;
+  else if(npzType == 'u' && wordSize == 2) item.type = Type::uint16;
+  else if(npzType == 'u' && wordSize == 4) item.type = Type::uint32;
+  else if(npzType == 'u' && wordSize == 8) item.type = Type::uint64;
+  else ABORT("Numpy item '{}' type '{}' with size {} not supported", name, npzType, wordSize);
+
+  item.bytes.swap(array->bytes);
+  return item;
+}
+
 void loadItemsFromNpz(const std::string& fileName, std::vector<Item>& items) {
   auto numpy = cnpy::npz_load(fileName);
-  for(auto it : numpy) {
-    Shape shape;
-    shape.resize(it.second->shape.size());
-    for(size_t i = 0; i < it.second->shape.size(); ++i)
-      shape.set(i, (size_t)it.second->shape[i]);
-
-    Item item;
-    item.name = it.first;
-    item.shape = shape;
-
-    char npzType = it.second->type;
-    int wordSize = it.second->word_size;
-    if     (npzType == 'f' && wordSize == 2) item.type = Type::float16;
-    else if(npzType == 'f' && wordSize == 4) item.type = Type::float32;
-    else if(npzType == 'f' && wordSize == 8) item.type = Type::float64;
-    else if(npzType == 'i' && wordSize == 1) item.type = Type::int8;
-    else if(npzType == 'i' && wordSize == 2) item.type = Type::int16;
-    else if(npzType == 'i' && wordSize == 4) item.type = Type::int32;
-    else if(npzType == 'i' && wordSize == 8) item.type = Type::uint64;
-    else if(npzType == 'u' && wordSize == 1) item.type = Type::uint8;
-    else if(npzType == 'u' && wordSize == 2) item.type = Type::uint16;
-    else if(npzType == 'u' && wordSize == 4) item.type = Type::uint32;
-    else if(npzType == 'u' && wordSize == 8) item.type = Type::uint64;
-    else ABORT("Numpy item '{}' type '{}' with size {} not supported", it.first, npzType, wordSize);
-
-    item.bytes.swap(it.second->bytes);
-    items.emplace_back(std::move(item));
-  }
+  for(auto it : numpy)
+    items.emplace_back(itemFromNpy(it.first, it.second));
 }
 
 std::vector<Item> loadItems(const std::string& fileName) {
@@ -180,5 +192,176 @@ void saveItems(const std::string& fileName, const std::vector<Item>& items) {
   }
 }
 
+struct ItemReader::MappedFile {
+  mio::mmap_source mmap;
+  std::map<std::string, Item> items;
+};
+
+ItemReader::ItemReader(const std::string& fileName) : fileName_(fileName) {
+  if(isNpz(fileName)) {
+    names_ = cnpy::npz_names(fileName);
+  } else if(isBin(fileName)) {
+    mapped_.reset(new MappedFile());
+    mapped_->mmap = mio::mmap_source(fileName);
+    for(auto& item : mmapItems(mapped_->mmap.data())) {
+      names_.push_back(item.name);
+      mapped_->items[item.name] = std::move(item);
+    }
+  } else {
+    ABORT("Unknown model file format for file {}", fileName);
+  }
+}
+
+ItemReader::~ItemReader() {}
+
+bool ItemReader::has(const std::string& name) const {
+  return std::find(names_.begin(), names_.end(), name) != names_.end();
+}
+
+Item ItemReader::get(const std::string& name) const {
+  ABORT_IF(!has(name), "Item {} not found in {}", name, fileName_);
+  if(mapped_)
+    return mapped_->items.at(name);
+  return itemFromNpy(name, cnpy::npz_load(fileName_, name));
+}
+
+// half-precision types convert through float, double is taken as it is
+template <typename T>
+static double toDouble(T x) { return (double)(float)x; }
+static double toDouble(double x) { return x; }
+
+template <typename T>
+static void accumulate(const Item& item, double weight, std::vector<double>& sum) {
+  const T* in = (const T*)item.data();
+  for(size_t i = 0; i < sum.size(); ++i)
+    sum[i] += weight * toDouble(in[i]);
+}
+
+// Reads the item 'name' from all checkpoints and averages it, the result has the type of the inputs
+static Item averageItem(const std::vector<Ptr<ItemReader>>& readers,
+                        const std::vector<std::string>& paths,
+                        const std::vector<double>& weights,
+                        const std::string& name) {
+  auto last = readers.back()->get(name);
+  Type type = last.type;
+  Item out;
+  out.name = last.name;
+  out.shape = last.shape;
+  out.type = type;
+  if(name.substr(0, 8) == "special:") {
+    out.bytes.assign(last.data(), last.data() + last.size());
+    return out;
+  }
+  ABORT_IF(!isFloat(type), "Cannot average item {} of type {}", name, type);
+
+  std::vector<double> sum(last.shape.elements(), 0.0);
+  for(size_t j = 0; j < readers.size(); ++j) {
+    auto item = j + 1 < readers.size() ? readers[j]->get(name) : std::move(last);
+    ABORT_IF(item.shape != out.shape || item.type != out.type,
+             "Item {} is {} {} in {} but {} {} in {}",
+             name, item.type, item.shape, paths[j], out.type, out.shape, paths.back());
+    if(item.type == Type::float32)
+      accumulate<float>(item, weights[j], sum);
+    else if(item.type == Type::float16)
+      accumulate<float16>(item, weights[j], sum);
+    else if(item.type == Type::bfloat16)
+      accumulate<bfloat16>(item, weights[j], sum);
+    else if(item.type == Type::float64)
+      accumulate<double>(item, weights[j], sum);
+    else
+      ABORT("Averaging items of type {} is not supported", item.type);
+  }
+
+  if(type == Type::float64) {
+    out.bytes.resize(out.size());
+    std::copy(sum.begin(), sum.end(), (double*)out.bytes.data());
+    return out;
+  }
+  out.type = Type::float32;
+  out.bytes.resize(out.size());
+  float* data = (float*)out.bytes.data();
+  for(size_t k = 0; k < sum.size(); ++k)
+    data[k] = (float)sum[k];
+  if(type != Type::float32)
+    out.convert(type);
+  return out;
+}
+
+static std::vector<Ptr<ItemReader>> openCheckpoints(const std::vector<std::string>& paths) {
+  std::vector<Ptr<ItemReader>> readers;
+  for(const auto& path : paths)
+    readers.push_back(New<ItemReader>(path));
+
+  const auto& names = readers.back()->names();
+  for(size_t j = 0; j < readers.size(); ++j)
+    ABORT_IF(readers[j]->names().size() != names.size(),
+             "Checkpoint {} has {} items, {} has {}",
+             paths[j], readers[j]->names().size(), paths.back(), names.size());
+  return readers;
+}
+
+static void averageCheckpoints(const std::vector<Ptr<ItemReader>>& readers,
+                               const std::vector<std::string>& paths,
+                               const std::vector<double>& weights,
+                               size_t threads,
+                               const std::function<void(Item&&)>& write) {
+  const auto& names = readers.back()->names();
+  {
+    // at most 2 * threads items are averaged or waiting to be written
+    ThreadPool threadPool(threads, threads);
+    std::deque<std::future<Item>> pending;
+    for(size_t i = 0; i < names.size(); ++i) {
+      pending.push_back(threadPool.enqueue([&](size_t i) {
+        return averageItem(readers, paths, weights, names[i]);
+      }, i));
+      if(pending.size() == 2 * threads) {
+        write(pending.front().get());
+        pending.pop_front();
+      }
+    }
+    for(; !pending.empty(); pending.pop_front())
+      write(pending.front().get());
+  }  // ~ThreadPool waits for all items
+
+  LOG(info, "Averaged {} items of {} checkpoints", names.size(), paths.size());
+}
+
+std::vector<Item> averageCheckpoints(const std::vector<std::string>& paths,
+                                     const std::vector<double>& weights,
+                                     size_t threads) {
+  std::vector<Item> averaged;
+  averageCheckpoints(openCheckpoints(paths), paths, weights, threads, [&](Item&& item) {
+    averaged.push_back(std::move(item));
+  });
+  return averaged;
+}
+
+void saveAveragedCheckpoints(const std::string& fileName,
+                             const std::vector<std::string>& paths,
+                             const std::vector<double>& weights,
+                             size_t threads) {
+  auto readers = openCheckpoints(paths);
+  if(!isBin(fileName)) { // a *.npz file is written in one go
+    std::vector<Item> averaged;
+    averageCheckpoints(readers, paths, weights, threads, [&](Item&& item) {
+      averaged.push_back(std::move(item));
+    });
+    saveItems(fileName, averaged);
+    return;
+  }
+
+  // the averaged items have the names, types and shapes of the last checkpoint
+  std::vector<Item> headers;
+  for(const auto& name : readers.back()->names()) {
+    auto item = readers.back()->get(name);
+    headers.push_back({});
+    headers.back().name = item.name;
+    headers.back().shape = item.shape;
+    headers.back().type = item.type;
+  }
+  binary::ItemWriter writer(fileName, headers);
+  averageCheckpoints(readers, paths, weights, threads, [&](Item&& item) { writer.write(item); });
+}
+
 }  // namespace io
 }  // namespace marian
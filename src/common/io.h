@@ -3,6 +3,7 @@
 #include "3rd_party/yaml-cpp/yaml.h"
 #include "common/io_item.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -34,6 +35,50 @@ std::vector<Item> mmapItems(const void* ptr);
 
 void saveItems(const std::string& fileName, const std::vector<Item>& items);
 
+/**
+ * Reads single items of a model file without loading the others. *.bin files are memory-mapped and
+ * their items point into the mapping, the items of *.npz files are read from the file when requested.
+ */
+class ItemReader {
+public:
+  ItemReader(const std::string& fileName);
+  ~ItemReader();
+
+  const std::vector<std::string>& names() const { return names_; }
+  bool has(const std::string& name) const;
+  Item get(const std::string& name) const;
+
+private:
+  struct MappedFile;
+
+  std::string fileName_;
+  std::vector<std::string> names_;
+  std::unique_ptr<MappedFile> mapped_;
+};
+
+/**
+ * Averages the float items of the checkpoints with the given weights. Items are processed in
+ * parallel and every one is read from all checkpoints before the next; items of *.bin checkpoints
+ * are memory-mapped. float64 items are accumulated and returned in double precision, the others
+ * keep their type. Items named special:*, e.g. the model configuration, are copied from the last
+ * checkpoint, any other non-float item is an error. The result is kept in memory, so memory use is
+ * O(model + threads * checkpoints * tensor).
+ */
+std::vector<Item> averageCheckpoints(const std::vector<std::string>& paths,
+                                     const std::vector<double>& weights,
+                                     size_t threads);
+
+/**
+ * Averages like averageCheckpoints() and saves the result to fileName. A *.bin file is written
+ * item by item as the items are averaged, so memory use is O(threads * checkpoints * tensor). The
+ * headers are taken from the last checkpoint first, for a *.npz checkpoint that reads its items
+ * twice. A *.npz file is written in one go after averaging all items.
+ */
+void saveAveragedCheckpoints(const std::string& fileName,
+                             const std::vector<std::string>& paths,
+                             const std::vector<double>& weights,
+                             size_t threads);
+
 /**
  * Creates a flat io::Item from a given std::vector so that it can be saved in a npz file 
  * or Marian's native binary format with the given name.
@@ -18,6 +18,13 @@ namespace marian {
   static bool throwExceptionOnAbort = false;
   bool getThrowExceptionOnAbort() { return throwExceptionOnAbort; }
   void setThrowExceptionOnAbort(bool doThrowExceptionOnAbort) { throwExceptionOnAbort = doThrowExceptionOnAbort; };
+
+  static thread_local bool throwExceptionOnAbortInThisThread = false;
+  bool getThrowExceptionOnAbortInThisThread() { return throwExceptionOnAbort || throwExceptionOnAbortInThisThread; }
+  ScopedThrowExceptionOnAbort::ScopedThrowExceptionOnAbort() : previous_(throwExceptionOnAbortInThisThread) {
+    throwExceptionOnAbortInThisThread = true;
+  }
+  ScopedThrowExceptionOnAbort::~ScopedThrowExceptionOnAbort() { throwExceptionOnAbortInThisThread = previous_; }
 }
 
 std::shared_ptr<spdlog::logger> createStderrLogger(const std::string& name,
@@ -37,6 +44,8 @@ std::shared_ptr<spdlog::logger> createStderrLogger(const std::string& name,
 
   auto logger = std::make_shared<spdlog::logger>(name, begin(sinks), end(sinks));
 
+  // options may be parsed more than once per process (e.g. marian-bench), the last loggers win
+  spdlog::drop(name);
   spdlog::register_logger(logger);
   logger->set_pattern(pattern);
   return logger;
@@ -37,6 +37,21 @@ namespace marian {
 
   // Set the state of throwExceptionOnAbort (see logging.cpp)
   void setThrowExceptionOnAbort(bool);
+
+  // Whether ABORT throws on the calling thread: throwExceptionOnAbort or a ScopedThrowExceptionOnAbort
+  bool getThrowExceptionOnAbortInThisThread();
+
+  // ABORT throws a MarianRuntimeException on the calling thread while an object of this class exists,
+  // e.g. to report a model that fails to load without terminating a server. Other threads, including
+  // the ones of a ThreadPool created in the scope, still abort.
+  class ScopedThrowExceptionOnAbort {
+  public:
+    ScopedThrowExceptionOnAbort();
+    ~ScopedThrowExceptionOnAbort();
+
+  private:
+    bool previous_;
+  };
 }
 
 /**
@@ -110,7 +125,7 @@ namespace marian {
     logger->set_pattern("%v");                                                   \
     auto callStack = marian::getCallStack(/*skipLevels=*/0);                     \
     checkedLog("general", "critical", callStack);                                \
-    if(marian::getThrowExceptionOnAbort())                                       \
+    if(marian::getThrowExceptionOnAbortInThisThread())                           \
       throw marian::MarianRuntimeException(fmt::format(__VA_ARGS__), callStack); \
     else                                                                         \
       std::abort();                                                              \
@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ * File project_version.h is generated using CMake. Do NOT modify it manually! Edit
+ * project_version.h.in file instead.
+ */
+
+// e.g. v1.2.3-beta+1.abc123d
+#define PROJECT_VERSION_FULL  "v1.11.0+01e7346"
+// e.g. v1.2.3-beta
+#define PROJECT_VERSION       "v1.11.0"
+#define PROJECT_VERSION_MAJOR 1
+#define PROJECT_VERSION_MINOR 11
+#define PROJECT_VERSION_PATCH 0
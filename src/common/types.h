@@ -11,6 +11,7 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <functional>
@@ -65,6 +66,7 @@ do { \
     case Type::uint32:  return func<uint32_t>(); \
     case Type::uint64:  return func<uint64_t>(); \
     case Type::float16: ABORT("Broken type {}", type);/*return func<float16 >();*/ \
+    case Type::bfloat16: return func<bfloat16>(); \
     case Type::float32: return func<float   >(); \
     case Type::float64: return func<double  >(); \
     default: ABORT("Unknown type {}", type); \
@@ -83,6 +85,7 @@ do { \
     case Type::uint32:  return func<uint32_t>(arg1); \
     case Type::uint64:  return func<uint64_t>(arg1); \
     case Type::float16: ABORT("Broken type {}", type);/*return func<float16 >(arg1);*/ \
+    case Type::bfloat16: return func<bfloat16>(arg1); \
     case Type::float32: return func<float   >(arg1); \
     case Type::float64: return func<double  >(arg1); \
     default: ABORT("Unknown type {}", type); \
@@ -101,6 +104,7 @@ do { \
     case Type::uint32:  return func<uint32_t>(); \
     case Type::uint64:  return func<uint64_t>(); \
     case Type::float16: return func<float16 >(); \
+    case Type::bfloat16: return func<bfloat16>(); \
     case Type::float32: return func<float   >(); \
     case Type::float64: return func<double  >(); \
     default: ABORT("Unknown type {}", type); \
@@ -119,6 +123,7 @@ do { \
     case Type::uint32:  return func<uint32_t>(arg1); \
     case Type::uint64:  return func<uint64_t>(arg1); \
     case Type::float16: return func<float16 >(arg1); \
+    case Type::bfloat16: return func<bfloat16>(arg1); \
     case Type::float32: return func<float   >(arg1); \
     case Type::float64: return func<double  >(arg1); \
     default: ABORT("Unknown type {}", type); \
@@ -138,6 +143,7 @@ do { \
     case Type::uint32  : return func<uint32_t>(arg1, arg2); \
     case Type::uint64  : return func<uint64_t>(arg1, arg2); \
     case Type::float16 : return func<float16 >(arg1, arg2); \
+    case Type::bfloat16: return func<bfloat16>(arg1, arg2); \
     case Type::float32 : return func<float   >(arg1, arg2); \
     case Type::float64 : return func<double  >(arg1, arg2); \
     default: ABORT("Unknown type {}", type); \
@@ -167,6 +173,44 @@ struct intgemm8avx2        { int8_t x;  };
 struct intgemm8avx512      { int8_t x;  };
 struct intgemm8avx512vnni  { int8_t x;  };
 
+// bfloat16 ("brain floating point") is the upper half of an IEEE-754 float32: it keeps the 8-bit exponent,
+// hence the range of float32, but only has 7 bits of mantissa. It is a storage type only, all arithmetic
+// goes through float32, i.e. values are converted on load and accumulation happens in float32.
+struct bfloat16 {
+  uint16_t x;
+
+  bfloat16() = default;
+  bfloat16(float f) : x(fromFloat(f)) {}
+
+  operator float() const {
+    uint32_t bits = (uint32_t)x << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+
+  // round-to-nearest-even, NaNs stay (quiet) NaNs
+  static uint16_t fromFloat(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if((bits & 0x7FFFFFFFu) > 0x7F800000u)
+      return (uint16_t)((bits >> 16) | 0x0040u);
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return (uint16_t)(bits >> 16);
+  }
+
+  bfloat16& operator+=(float f) {
+    x = fromFloat((float)*this + f);
+    return *this;
+  }
+
+  static bfloat16 fromBits(uint16_t bits) {
+    bfloat16 b;
+    b.x = bits;
+    return b;
+  }
+};
+
 
 #ifndef __CUDACC__ // vectorized types not available from .cu files
 
@@ -229,6 +273,34 @@ public:
 struct float32x8 {
 };
 #endif
+
+#ifdef __AVX512F__
+struct float32x16 {
+private:
+  __m512 f_;
+
+public:
+  float32x16() {}
+  float32x16(const __m512& f) : f_(f) {}
+  float32x16(const float& f) : f_(_mm512_set1_ps(f)) {} // __m512 _mm512_set1_ps(float) copies value into all slots
+
+  operator const __m512&() const { return f_; }
+  operator __m512&() { return f_; }
+
+  float operator[] (size_t i) const {
+    return *(((float*)&f_) + i); // potentially undefined, but efficient. In practice __m512 is an array of floats
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, float32x16 f16) {
+    float* a = (float*)&f16;
+    out << "[" << a[0];
+    for(int i = 1; i < 16; i++)
+      out << " " << a[i];
+    out << "]";
+    return out;
+  }
+};
+#endif
 #endif
 
 #if COMPILE_FP16
@@ -276,6 +348,7 @@ enum class TypeClass : size_t { // size_type has 8 bytes, so we can have 16 fiel
 
   packed_type   = 0x00800, // special packed (CPU cache friendly) type class, used in FBGEMM. Annoyingly we need to keep 0x800 for back-compat, would be nicer to align with intgemm
   intgemm_type  = 0x10000, // intgemm quantized architecture agnostic models
+  bfloat_type   = 0x20000, // float variant with float32 exponent range (bfloat16), a separate class so it is not silently converted on load
 
   size_mask     = 0x000FF, // maximum allowed size is 256 bytes right now; if more are required, extend the size field
   class_mask    = 0xFFF00, // three fields for different type classes, if more classes are added we need to increase the number of fields here
@@ -306,6 +379,8 @@ enum class Type : size_t {
   float32  = TypeClass::float_type + 4u,       ///< float32 type
   float64  = TypeClass::float_type + 8u,       ///< float64 type
 
+  bfloat16 = TypeClass::float_type + 2u + TypeClass::bfloat_type, ///< bfloat16 type, storage only, computations happen in float32
+
   packed16            = TypeClass::packed_type + 2u,                                   ///< special type for FBGEMM, not meant to be used anywhere else, not meant to be accessed invidually. Internal actual type (uint16) is meaningless.
   packed8avx2         = TypeClass::packed_type + 1u + TypeClass::avx2_type,            ///< special type for FBGEMM with AVX2, not meant to be used anywhere else, not meant to be accessed invidually. Internal actual type (uint8) is meaningless.
   packed8avx512       = TypeClass::packed_type + 1u + TypeClass::avx512_type,          ///< special type for FBGEMM with AVX512, not meant to be used anywhere else, not meant to be accessed invidually. Internal actual type (uint8) is meaningless.
@@ -375,6 +450,10 @@ static inline bool isIntgemm(Type type) {
   return (TypeClass::intgemm_type & type) != 0;
 }
 
+static inline bool isBFloat(Type type) {
+  return (TypeClass::bfloat_type & type) != 0;
+}
+
 size_t requiredBytes(const Shape& shape, Type type); // towards Frank's vision of joint Shape/Type
 
 template <typename T>
@@ -395,6 +474,7 @@ template <> inline bool matchType<uint64_t>(Type type) { return type == Type::ui
 template <> inline bool matchType<float16>(Type type)              { return type == Type::float16;             }
 template <> inline bool matchType<float>(Type type)                { return type == Type::float32;             }
 template <> inline bool matchType<double>(Type type)               { return type == Type::float64;             }
+template <> inline bool matchType<bfloat16>(Type type)             { return type == Type::bfloat16;            }
 
 template <> inline bool matchType<packed16>(Type type)             { return type == Type::packed16;            }
 template <> inline bool matchType<packed8avx2>(Type type)          { return type == Type::packed8avx2;         }
@@ -428,6 +508,8 @@ static inline std::ostream& operator<<(std::ostream& out, Type type) {
     case Type::float32 : out << "float32"; break;
     case Type::float64 : out << "float64"; break;
 
+    case Type::bfloat16 : out << "bfloat16"; break;
+
     case Type::packed16      : out << "packed16"; break;
     case Type::packed8avx2   : out << "packed8avx2"; break;
     case Type::packed8avx512 : out << "packed8avx512"; break;
@@ -462,6 +544,7 @@ template <> inline std::string request<uint64_t>() { return "uint64"; }
 template <> inline std::string request<float16>()  { return "float16"; }
 template <> inline std::string request<float>()    { return "float32"; }
 template <> inline std::string request<double>()   { return "float64"; }
+template <> inline std::string request<bfloat16>() { return "bfloat16"; }
 
 template <> inline std::string request<packed16>()      { return "packed16";      }
 template <> inline std::string request<packed8avx2>()   { return "packed8avx2";   }
@@ -504,6 +587,9 @@ static Type inline typeFromString(const std::string& str) {
   if(str == "float64")
     return Type::float64;
 
+  if(str == "bfloat16")
+    return Type::bfloat16;
+
   if(str == "packed16")
     return Type::packed16;
   if(str == "packed8avx2")
@@ -550,6 +636,7 @@ template <> inline Type typeId<uint64_t>() { return Type::uint64; }
 template <> inline Type typeId<float16>()  { return Type::float16; }
 template <> inline Type typeId<float>()    { return Type::float32; }
 template <> inline Type typeId<double>()   { return Type::float64; }
+template <> inline Type typeId<bfloat16>() { return Type::bfloat16; }
 
 template <> inline Type typeId<packed16>()      { return Type::packed16;      }
 template <> inline Type typeId<packed8avx2>()   { return Type::packed8avx2;   }
@@ -581,7 +668,7 @@ namespace typeFitting { // own namespace instead of in class, otherwise we get e
   // Returns the 'capacity' of a type: number of digits for integers,
   // max_exponent for floats. We ignore the mantissa for floats.
   template<typename X> constexpr int capacity() {
-    static_assert(std::is_arithmetic<X>::value || std::is_same<X,HalfFloat>::value,
+    static_assert(std::is_arithmetic<X>::value || std::is_same<X,HalfFloat>::value || std::is_same<X,bfloat16>::value,
                   "Wrong type for this template");
     return (std::is_integral<X>::value
             ? std::numeric_limits<X>::digits
@@ -651,3 +738,19 @@ namespace std {
     }
   };
 }
+
+// limits of bfloat16 as needed by NumericLimits<T> above, exponent range is the one of float32
+namespace std {
+  template<> class numeric_limits<::marian::bfloat16> {
+  public:
+    static const bool is_specialized = true;
+    static const bool is_signed      = true;
+    static const bool is_integer     = false;
+    static const int  digits         = 8;
+    static const int  max_exponent   = 128;
+
+    static ::marian::bfloat16 min()    { return ::marian::bfloat16::fromBits(0x0080); } // smallest positive normal
+    static ::marian::bfloat16 max()    { return ::marian::bfloat16::fromBits(0x7F7F); }
+    static ::marian::bfloat16 lowest() { return ::marian::bfloat16::fromBits(0xFF7F); }
+  };
+}
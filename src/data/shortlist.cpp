@@ -2,6 +2,7 @@
 #include "microsoft/shortlist/utils/ParameterTree.h"
 #include "marian.h"
 #include "layers/lsh.h"
+#include "tensors/cpu/intgemm_interface.h"
 
 #include <queue>
 
@@ -62,8 +63,13 @@ void Shortlist::createCachedTensors(Expr weights,
                           Expr lemmaEt,
                           int k) {
   ABORT_IF(isLegacyUntransposedW, "Legacy untranspose W not yet tested");
-  cachedShortWt_ = index_select(weights, isLegacyUntransposedW ? -1 : 0, indicesExpr_);
-  cachedShortWt_ = reshape(cachedShortWt_, {1, 1, cachedShortWt_->shape()[0], cachedShortWt_->shape()[1]});
+  if(weightsInt8_) {
+    // gather rows of the int8 matrix that was quantized once for the whole vocabulary
+    cachedShortWt_ = cpu::integer::selectRowsInt8(weightsInt8_, indicesExpr_);
+  } else {
+    cachedShortWt_ = index_select(weights, isLegacyUntransposedW ? -1 : 0, indicesExpr_);
+    cachedShortWt_ = reshape(cachedShortWt_, {1, 1, cachedShortWt_->shape()[0], cachedShortWt_->shape()[1]});
+  }
 
   if (b) {
     cachedShortb_ = index_select(b, -1, indicesExpr_);
@@ -115,6 +121,7 @@ void LSHShortlist::createCachedTensors(Expr weights,
   int currBeamSize = indicesExpr_->shape()[0];
   int batchSize = indicesExpr_->shape()[1];
   ABORT_IF(isLegacyUntransposedW, "Legacy untranspose W not yet tested");
+  ABORT_IF(weightsInt8_, "Int8 output embeddings are not supported with LSH");
 
   Expr indicesExprFlatten = reshape(indicesExpr_, {indicesExpr_->shape().elements()});
 
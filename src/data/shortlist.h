@@ -30,6 +30,7 @@ protected:
   Expr cachedShortWt_;  // short-listed version, cached (cleared by clear())
   Expr cachedShortb_;   // these match the current value of shortlist_
   Expr cachedShortLemmaEt_;
+  Expr weightsInt8_;    // optional output embeddings quantized by cpu::integer::quantizeRowsInt8()
   bool initialized_; // used by batch-level shortlist. Only initialize with 1st call then skip all subsequent calls for same batch
   
   void createCachedTensors(Expr weights,
@@ -47,6 +48,10 @@ public:
   virtual WordIndex reverseMap(int beamIdx, int batchIdx, int idx) const;
   virtual WordIndex tryForwardMap(WordIndex wIdx) const;
 
+  // Select the short-listed rows from pre-quantized int8 output embeddings instead of the float
+  // weights passed to filter(), getCachedShortWt() then returns an int8 matrix. Call before filter().
+  void setQuantizedWeights(Expr weightsInt8) { weightsInt8_ = weightsInt8; }
+
   virtual void filter(Expr input, Expr weights, bool isLegacyUntransposedW, Expr b, Expr lemmaEt);
   virtual Expr getIndicesExpr() const;
   virtual Expr getCachedShortWt() const { return cachedShortWt_; }
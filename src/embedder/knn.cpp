@@ -0,0 +1,333 @@
+#include "embedder/knn.h"
+
+#include "common/logging.h"
+#include "common/types.h"
+#include "tensors/cpu/parallel.h"
+#include "tensors/cpu/prod_blas.h"
+
+#include "3rd_party/faiss/utils/Heap.h"
+#include "3rd_party/mio/mio.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+namespace marian {
+namespace knn {
+
+namespace {
+
+// Rows and columns of the blocks of the similarity matrix in the exact search
+const size_t QUERY_BLOCK = 256;
+const size_t BASE_BLOCK = 4096;
+
+inline void push(size_t k, float* scores, int64_t* ids, float score, int64_t id) {
+  if(score > scores[0]) {
+    faiss::minheap_pop(k, scores, ids);
+    faiss::minheap_push(k, scores, ids, score, id);
+  }
+}
+
+inline float dot(const float* a, const float* b, size_t dim) {
+  float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for(; i + 4 <= dim; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for(; i < dim; ++i)
+    s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+template <typename T>
+void convertRows(const char* in, float* out, size_t elements) {
+  const T* values = (const T*)in;
+  for(size_t i = 0; i < elements; ++i)
+    out[i] = (float)values[i];
+}
+
+}  // namespace
+
+Embeddings::Embeddings(const std::string& npyFile) {
+  mio::mmap_source mmap(npyFile);
+  const char* data = mmap.data();
+  ABORT_IF(mmap.size() < 10 || std::string(data, 6) != "\x93NUMPY", "{} is not an npy file", npyFile);
+
+  size_t offset, length;
+  if(data[6] == 1) {
+    uint16_t headerLength;
+    std::memcpy(&headerLength, data + 8, sizeof(headerLength));
+    offset = 10;
+    length = headerLength;
+  } else {
+    uint32_t headerLength;
+    std::memcpy(&headerLength, data + 8, sizeof(headerLength));
+    offset = 12;
+    length = headerLength;
+  }
+  std::string header(data + offset, length);
+
+  // the header is a python dict literal: {'descr': '<f4', 'fortran_order': False, 'shape': (3, 4), }
+  auto value = [&](const std::string& key) {
+    auto pos = header.find("'" + key + "'");
+    ABORT_IF(pos == std::string::npos, "npy header of {} has no {}", npyFile, key);
+    return header.substr(header.find(':', pos) + 1);
+  };
+  auto descr = value("descr");
+  descr = descr.substr(descr.find('\'') + 1);
+  descr = descr.substr(0, descr.find('\''));
+  auto fortranOrder = value("fortran_order");
+  ABORT_IF(fortranOrder.compare(fortranOrder.find_first_not_of(' '), 4, "True") == 0,
+           "npy file {} is in Fortran order",
+           npyFile);
+  auto shape = value("shape");
+  ABORT_IF(std::sscanf(shape.c_str(), " (%zu, %zu)", &rows_, &dim_) != 2,
+           "npy file {} does not contain a matrix",
+           npyFile);
+
+  size_t elements = rows_ * dim_;
+  size_t wordSize = descr == "<f4" ? 4 : descr == "<f2" ? 2 : descr == "|i1" || descr == "<i1" ? 1 : 0;
+  ABORT_IF(wordSize == 0, "npy file {} has unsupported type {}", npyFile, descr);
+  ABORT_IF(mmap.size() < offset + length + elements * wordSize, "npy file {} is truncated", npyFile);
+
+  const char* values = data + offset + length;
+  data_.resize(elements);
+  cpu::parallelFor(rows_, 1024, [&](size_t begin, size_t end) {
+    size_t n = (end - begin) * dim_;
+    const char* in = values + begin * dim_ * wordSize;
+    float* out = data_.data() + begin * dim_;
+    if(wordSize == 4)
+      convertRows<float>(in, out, n);
+    else if(wordSize == 2)
+      convertRows<float16>(in, out, n);
+    else
+      convertRows<int8_t>(in, out, n);
+  });
+  normalize();
+  LOG(info, "[knn] Loaded {} embeddings of dimension {} ({}) from {}", rows_, dim_, descr, npyFile);
+}
+
+Embeddings::Embeddings(std::vector<float>&& data, size_t dim)
+    : data_(std::move(data)), rows_(data_.size() / dim), dim_(dim) {
+  normalize();
+}
+
+void Embeddings::normalize() {
+  cpu::parallelFor(rows_, 1024, [&](size_t begin, size_t end) {
+    for(size_t i = begin; i < end; ++i) {
+      float* row = data_.data() + i * dim_;
+      float norm = std::sqrt(dot(row, row, dim_));
+      if(norm > 0)
+        for(size_t j = 0; j < dim_; ++j)
+          row[j] /= norm;
+    }
+  });
+}
+
+Index::Index(Ptr<const Embeddings> base, size_t nlist, size_t iterations, size_t seed) : base_(base) {
+  if(nlist > 0)
+    train(nlist, iterations, seed);
+}
+
+void Index::train(size_t nlist, size_t iterations, size_t seed) {
+  size_t rows = base_->rows(), dim = base_->dim();
+  ABORT_IF(nlist > rows, "More lists ({}) than vectors ({})", nlist, rows);
+
+  // spherical k-means on a sample of up to 256 vectors per list
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<size_t> randomRow(0, rows - 1);
+  size_t sampleSize = std::min(rows, nlist * 256);
+  std::vector<float> sampleData(sampleSize * dim);
+  for(size_t i = 0; i < sampleSize; ++i) {
+    const float* row = base_->row(sampleSize == rows ? i : randomRow(rng));
+    std::copy(row, row + dim, sampleData.begin() + i * dim);
+  }
+  Embeddings sample(std::move(sampleData), dim);
+
+  std::vector<float> centroids(nlist * dim);
+  std::vector<size_t> order(sampleSize);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), rng);
+  for(size_t c = 0; c < nlist; ++c)
+    std::copy(sample.row(order[c]), sample.row(order[c]) + dim, centroids.begin() + c * dim);
+  centroids_ = New<Embeddings>(std::move(centroids), dim);
+
+  std::vector<float> scores;
+  std::vector<int64_t> assigned;
+  for(size_t iteration = 0; iteration < iterations; ++iteration) {
+    Index(centroids_, 0).searchExact(sample, 1, scores, assigned);
+
+    std::vector<float> sums(nlist * dim, 0.f);
+    std::vector<size_t> counts(nlist, 0);
+    double objective = 0;
+    for(size_t i = 0; i < sampleSize; ++i) {
+      float* sum = sums.data() + assigned[i] * dim;
+      const float* row = sample.row(i);
+      for(size_t j = 0; j < dim; ++j)
+        sum[j] += row[j];
+      counts[assigned[i]]++;
+      objective += scores[i];
+    }
+    // empty lists restart from a random sample vector
+    for(size_t c = 0; c < nlist; ++c) {
+      if(counts[c] == 0) {
+        const float* row = sample.row(randomRow(rng) % sampleSize);
+        std::copy(row, row + dim, sums.begin() + c * dim);
+      }
+    }
+    centroids_ = New<Embeddings>(std::move(sums), dim);
+    LOG(info, "[knn] k-means iteration {}: mean similarity to the centroid {:.4f}", iteration + 1, objective / sampleSize);
+  }
+
+  // distribute the database over the lists
+  Index(centroids_, 0).searchExact(*base_, 1, scores, assigned);
+  listOffsets_.assign(nlist + 1, 0);
+  for(auto list : assigned)
+    listOffsets_[list + 1]++;
+  for(size_t c = 0; c < nlist; ++c)
+    listOffsets_[c + 1] += listOffsets_[c];
+
+  vectorIds_.resize(rows);
+  std::vector<size_t> next(listOffsets_.begin(), listOffsets_.end() - 1);
+  for(size_t i = 0; i < rows; ++i)
+    vectorIds_[next[assigned[i]]++] = (int64_t)i;
+  LOG(info, "[knn] Built an index of {} vectors in {} lists", rows, nlist);
+}
+
+void Index::search(const Embeddings& queries,
+                   size_t k,
+                   size_t nprobe,
+                   std::vector<float>& scores,
+                   std::vector<int64_t>& ids) const {
+  ABORT_IF(queries.dim() != base_->dim(),
+           "Queries have dimension {}, the index {}",
+           queries.dim(),
+           base_->dim());
+  if(centroids_)
+    searchLists(queries, k, nprobe, scores, ids);
+  else
+    searchExact(queries, k, scores, ids);
+}
+
+void Index::searchExact(const Embeddings& queries,
+                        size_t k,
+                        std::vector<float>& scores,
+                        std::vector<int64_t>& ids) const {
+  size_t dim = base_->dim(), rows = base_->rows();
+  scores.resize(queries.rows() * k);
+  ids.resize(queries.rows() * k);
+
+  size_t blocks = (queries.rows() + QUERY_BLOCK - 1) / QUERY_BLOCK;
+  cpu::parallelFor(blocks, 1, [&](size_t begin, size_t end) {
+    std::vector<float> similarities(QUERY_BLOCK * BASE_BLOCK);
+    for(size_t block = begin; block < end; ++block) {
+      size_t q0 = block * QUERY_BLOCK;
+      size_t qn = std::min(QUERY_BLOCK, queries.rows() - q0);
+      for(size_t i = 0; i < qn; ++i)
+        faiss::minheap_heapify(k, &scores[(q0 + i) * k], &ids[(q0 + i) * k]);
+
+      for(size_t r0 = 0; r0 < rows; r0 += BASE_BLOCK) {
+        size_t rn = std::min(BASE_BLOCK, rows - r0);
+        sgemm(false, true, (int)qn, (int)rn, (int)dim,
+              1.f, (float*)queries.row(q0), (int)dim,
+              (float*)base_->row(r0), (int)dim,
+              0.f, similarities.data(), (int)rn);
+        for(size_t i = 0; i < qn; ++i) {
+          float* queryScores = &scores[(q0 + i) * k];
+          int64_t* queryIds = &ids[(q0 + i) * k];
+          const float* row = similarities.data() + i * rn;
+          for(size_t j = 0; j < rn; ++j)
+            push(k, queryScores, queryIds, row[j], (int64_t)(r0 + j));
+        }
+      }
+
+      for(size_t i = 0; i < qn; ++i)
+        faiss::minheap_reorder(k, &scores[(q0 + i) * k], &ids[(q0 + i) * k]);
+    }
+  });
+}
+
+void Index::searchLists(const Embeddings& queries,
+                        size_t k,
+                        size_t nprobe,
+                        std::vector<float>& scores,
+                        std::vector<int64_t>& ids) const {
+  size_t dim = base_->dim();
+  nprobe = std::max<size_t>(1, std::min(nprobe, centroids_->rows()));
+
+  std::vector<float> listScores;
+  std::vector<int64_t> lists;
+  Index(centroids_, 0).searchExact(queries, nprobe, listScores, lists);
+
+  scores.resize(queries.rows() * k);
+  ids.resize(queries.rows() * k);
+  cpu::parallelFor(queries.rows(), 64, [&](size_t begin, size_t end) {
+    for(size_t q = begin; q < end; ++q) {
+      float* queryScores = &scores[q * k];
+      int64_t* queryIds = &ids[q * k];
+      faiss::minheap_heapify(k, queryScores, queryIds);
+      for(size_t p = 0; p < nprobe; ++p) {
+        int64_t list = lists[q * nprobe + p];
+        if(list < 0)
+          continue;
+        for(size_t v = listOffsets_[list]; v < listOffsets_[list + 1]; ++v)
+          push(k, queryScores, queryIds, dot(queries.row(q), base_->row(vectorIds_[v]), dim), vectorIds_[v]);
+      }
+      faiss::minheap_reorder(k, queryScores, queryIds);
+    }
+  });
+}
+
+std::vector<Candidate> mineMargin(const Embeddings& sources,
+                                  const Embeddings& targets,
+                                  const Index& sourceIndex,
+                                  const Index& targetIndex,
+                                  size_t k,
+                                  size_t nprobe) {
+  std::vector<float> forwardScores, backwardScores;
+  std::vector<int64_t> forwardIds, backwardIds;
+  targetIndex.search(sources, k, nprobe, forwardScores, forwardIds);
+  sourceIndex.search(targets, k, nprobe, backwardScores, backwardIds);
+
+  // mean similarity to the k nearest neighbours in the other language
+  auto means = [k](const std::vector<float>& scores, const std::vector<int64_t>& ids) {
+    std::vector<float> mean(scores.size() / k, 0.f);
+    for(size_t i = 0; i < mean.size(); ++i) {
+      size_t n = 0;
+      for(size_t j = 0; j < k && ids[i * k + j] >= 0; ++j, ++n)
+        mean[i] += scores[i * k + j];
+      mean[i] = n > 0 ? mean[i] / n : 0.f;
+    }
+    return mean;
+  };
+  auto sourceMeans = means(forwardScores, forwardIds);
+  auto targetMeans = means(backwardScores, backwardIds);
+
+  std::vector<Candidate> best(sources.rows());
+  cpu::parallelFor(sources.rows(), 1024, [&](size_t begin, size_t end) {
+    for(size_t i = begin; i < end; ++i) {
+      for(size_t j = 0; j < k; ++j) {
+        int64_t target = forwardIds[i * k + j];
+        if(target < 0)
+          break;
+        float cosine = forwardScores[i * k + j];
+        float margin = cosine / (0.5f * (sourceMeans[i] + targetMeans[target]));
+        if(best[i].target < 0 || margin > best[i].margin) {
+          best[i].target = target;
+          best[i].margin = margin;
+          best[i].cosine = cosine;
+        }
+      }
+    }
+  });
+  return best;
+}
+
+}  // namespace knn
+}  // namespace marian
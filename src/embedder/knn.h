@@ -0,0 +1,91 @@
+#pragma once
+
+#include "common/definitions.h"
+
+#include <string>
+#include <vector>
+
+namespace marian {
+namespace knn {
+
+/**
+ * Sentence embeddings read from an npy file as written by marian-embedder --embedding-format npy
+ * (float32, float16 or int8 rows). Rows are converted to float32 and L2-normalized, so that dot
+ * products are cosine similarities.
+ */
+class Embeddings {
+public:
+  Embeddings(const std::string& npyFile);
+  Embeddings(std::vector<float>&& data, size_t dim);  // normalizes the rows of data
+
+  size_t rows() const { return rows_; }
+  size_t dim() const { return dim_; }
+  const float* data() const { return data_.data(); }
+  const float* row(size_t i) const { return data_.data() + i * dim_; }
+
+private:
+  void normalize();
+
+  std::vector<float> data_;
+  size_t rows_{0};
+  size_t dim_{0};
+};
+
+/**
+ * Nearest neighbours by cosine similarity. With nlist = 0 the search is exact: blocks of queries are
+ * multiplied with blocks of the database with a matrix product and a heap keeps the best k per
+ * query. Otherwise it is an inverted file index (IVF): spherical k-means on a sample of the database
+ * finds nlist centroids, every vector is stored in the list of its nearest centroid, and a query
+ * only visits the vectors in the lists of its nprobe nearest centroids. The lists only hold row
+ * numbers, hence the index does not copy the database.
+ *
+ * All loops run on cpu::parallelFor, see --cpu-intra-op-threads for the number of threads.
+ */
+class Index {
+public:
+  Index(Ptr<const Embeddings> base, size_t nlist, size_t iterations = 10, size_t seed = 1234);
+
+  // Fills scores and ids with the k most similar database rows of every query, best first. ids are
+  // -1 and scores -inf where the database or the visited lists have fewer than k vectors.
+  void search(const Embeddings& queries,
+              size_t k,
+              size_t nprobe,
+              std::vector<float>& scores,
+              std::vector<int64_t>& ids) const;
+
+private:
+  void train(size_t nlist, size_t iterations, size_t seed);
+  void searchExact(const Embeddings& queries, size_t k, std::vector<float>& scores, std::vector<int64_t>& ids) const;
+  void searchLists(const Embeddings& queries,
+                   size_t k,
+                   size_t nprobe,
+                   std::vector<float>& scores,
+                   std::vector<int64_t>& ids) const;
+
+  Ptr<const Embeddings> base_;
+  Ptr<Embeddings> centroids_;              // empty for an exact index
+  std::vector<size_t> listOffsets_;         // list i holds vectorIds_[listOffsets_[i]..listOffsets_[i+1])
+  std::vector<int64_t> vectorIds_;          // row numbers in the database ordered by list, rows are read from base_
+};
+
+/**
+ * Ratio margin scores for bitext mining (Artetxe and Schwenk, 2019): the cosine similarity of x and
+ * y divided by the average of the mean similarity of x to its k nearest neighbours among the targets
+ * and that of y to its k nearest neighbours among the sources. For every source the candidates are
+ * its k nearest targets; the best one by margin is returned with its margin and cosine.
+ */
+struct Candidate {
+  int64_t target{-1};
+  float margin{0};
+  float cosine{0};
+};
+
+std::vector<Candidate> mineMargin(const Embeddings& sources,
+                                  const Embeddings& targets,
+                                  const Index& sourceIndex,
+                                  const Index& targetIndex,
+                                  size_t k,
+                                  size_t nprobe);
+
+}  // namespace knn
+}  // namespace marian
@@ -3,69 +3,156 @@
 #include "common/logging.h"
 #include "common/utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 
 namespace marian {
 
-// This class manages multi-threaded writing of embedded vectors to stdout or an output file.
-// It will either output string versions of float vectors or binary equal length versions depending
-// on its binary_ flag.
-
 VectorCollector::VectorCollector(const Ptr<Options>& options)
-    : nextId_(0), binary_{options->get<bool>("binary", false)} {
-    if(options->get<std::string>("output") == "stdout")
-      outStrm_.reset(new std::ostream(std::cout.rdbuf()));
-    else
-      outStrm_.reset(new io::OutputFileStream(options->get<std::string>("output")));
+    : nextId_(0),
+      outFile_(options->get<std::string>("output")),
+      type_(typeFromString(options->get<std::string>("embedding-type", "float32"))) {
+  auto format = options->get<std::string>("embedding-format", "text");
+  if(format == "npy")
+    format_ = Format::npy;
+  else if(format == "binary" || options->get<bool>("binary", false))
+    format_ = Format::binary;
+  else if(format == "text")
+    format_ = Format::text;
+  else
+    ABORT("Unknown embedding format {}", format);
+  ABORT_IF(type_ != Type::float32 && type_ != Type::float16 && type_ != Type::int8,
+           "Embeddings can be stored as float32, float16 or int8, not {}",
+           type_);
+  ABORT_IF(format_ == Format::npy && (outFile_ == "stdout" || utils::endsWith(outFile_, ".gz")),
+           "npy embeddings have to be written to an uncompressed --output file");
+
+  if(outFile_ == "stdout")
+    outStrm_.reset(new std::ostream(std::cout.rdbuf()));
+  else
+    outStrm_.reset(new io::OutputFileStream(outFile_));
+
+  // the row count of the npy header is filled in at the end
+  if(format_ == Format::npy)
+    *outStrm_ << npyHeader(0);
+
+  writer_ = std::thread([this]() { writeLoop(); });
+}
+
+VectorCollector::~VectorCollector() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
   }
+  written_.notify_one();
+  writer_.join();
+
+  if(!outputs_.empty())
+    LOG(warn, "{} embeddings were not written, the one of sentence {} is missing", outputs_.size(), nextId_);
+  outStrm_.reset();
+
+  if(format_ == Format::npy) {
+    std::fstream npy(outFile_, std::ios::in | std::ios::out | std::ios::binary);
+    auto header = npyHeader(nextId_);
+    npy.write(header.data(), header.size());
+    if(npy.fail())
+      LOG(error, "Error writing the npy header of {}", outFile_);
+  }
+}
 
 void VectorCollector::Write(long id, const std::vector<float>& vec) {
+  std::string bytes;
+  WriteVector(vec, bytes);
+
   std::lock_guard<std::mutex> lock(mutex_);
-  if(id == nextId_) {
-    WriteVector(vec);
+  if(dimension_ < 0)
+    dimension_ = (int)vec.size();
+  ABORT_IF(format_ == Format::npy && dimension_ != (int)vec.size(),
+           "Embeddings of different dimensions {} and {}",
+           dimension_,
+           vec.size());
 
+  if(id != nextId_) {
+    // save for later
+    outputs_[id] = std::move(bytes);
+    return;
+  }
+
+  pending_.push_back(std::move(bytes));
+  ++nextId_;
+
+  // the first elements in the map are the next
+  auto iter = outputs_.begin();
+  while(iter != outputs_.end() && iter->first == nextId_) {
+    pending_.push_back(std::move(iter->second));
     ++nextId_;
+    iter = outputs_.erase(iter);
+  }
+  written_.notify_one();
+}
 
-    typename Outputs::const_iterator iter, iterNext;
-    iter = outputs_.begin();
-    while(iter != outputs_.end()) {
-      long currId = iter->first;
-
-      if(currId == nextId_) {
-        // 1st element in the map is the next
-        WriteVector(iter->second);
-        
-        ++nextId_;
-
-        // delete current record, move iter on 1
-        iterNext = iter;
-        ++iterNext;
-        outputs_.erase(iter);
-        iter = iterNext;
-      } else {
-        // not the next. stop iterating
-        assert(nextId_ < currId);
+void VectorCollector::writeLoop() {
+  std::vector<std::string> writing;
+  for(;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      written_.wait(lock, [this]() { return done_ || !pending_.empty(); });
+      if(pending_.empty())
         break;
-      }
+      std::swap(writing, pending_);
     }
-
-  } else {
-    // save for later
-    outputs_[id] = vec;
+    for(const auto& bytes : writing)
+      outStrm_->write(bytes.data(), bytes.size());
+    outStrm_->flush();
+    writing.clear();
   }
 }
 
-void VectorCollector::WriteVector(const std::vector<float>& vec) {
-  if(binary_) {
-    outStrm_->write((char*)vec.data(), vec.size() * sizeof(float));
-  } else {
+void VectorCollector::WriteVector(const std::vector<float>& vec, std::string& bytes) {
+  if(format_ == Format::text) {
     std::stringstream ss;
-    ss << std::fixed << std::setprecision(8);
     for(auto v : vec)
-      *outStrm_ << v << " ";
-    *outStrm_ << std::endl;
+      ss << v << " ";
+    ss << std::endl;
+    bytes = ss.str();
+  } else if(type_ == Type::float32) {
+    bytes.assign((const char*)vec.data(), vec.size() * sizeof(float));
+  } else if(type_ == Type::float16) {
+    bytes.resize(vec.size() * sizeof(float16));
+    float16* out = (float16*)&bytes[0];
+    for(size_t i = 0; i < vec.size(); ++i)
+      out[i] = float16(vec[i]);
+  } else {  // int8
+    float max = 0;
+    for(auto v : vec)
+      max = std::max(max, std::abs(v));
+    float scale = max > 0 ? 127.f / max : 0.f;
+    bytes.resize(vec.size());
+    for(size_t i = 0; i < vec.size(); ++i)
+      bytes[i] = (char)(int8_t)std::round(vec[i] * scale);
   }
 }
 
+// npy format version 1.0: magic, header length and a padded python dict literal. The header always
+// has the same length, so it can be rewritten once the number of rows is known.
+std::string VectorCollector::npyHeader(size_t rows) const {
+  std::string descr = type_ == Type::float32 ? "<f4" : type_ == Type::float16 ? "<f2" : "|i1";
+  std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': ("
+                     + std::to_string(rows) + ", " + std::to_string(std::max(dimension_, 0)) + "), }";
+  const size_t length = 128;  // including the 10 bytes of magic and length, a multiple of 64
+  dict.resize(length - 10 - 1, ' ');
+  dict += '\n';
+
+  std::string header = "\x93NUMPY";
+  header += (char)1;
+  header += (char)0;
+  uint16_t dictLength = (uint16_t)dict.size();
+  header.append((const char*)&dictLength, sizeof(dictLength));
+  return header + dict;
+}
+
 }  // namespace marian
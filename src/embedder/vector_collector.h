@@ -3,32 +3,53 @@
 #include "common/options.h"
 #include "common/definitions.h"
 #include "common/file_stream.h"
+#include "common/types.h"
 
+#include <condition_variable>
 #include <map>
 #include <mutex>
+#include <thread>
 
 namespace marian {
 
-// This class manages multi-threaded writing of embedded vectors to stdout or an output file.
-// It will either output string versions of float vectors or binary equal length versions depending
-// on its binary_ flag.
+// This class manages multi-threaded writing of embedded vectors to stdout or an output file, in the
+// order of their sentence ids. Depending on --embedding-format it outputs
+//  * text: string versions of the float vectors, one per line;
+//  * binary: equal length binary vectors without any header (also --binary);
+//  * npy: a numpy array of shape (sentences, dimension) that can be memory-mapped, e.g. with
+//    numpy.load(file, mmap_mode='r') or by marian-knn; requires an output file.
+// Binary vectors are stored as --embedding-type: float32, float16 or int8. int8 vectors are scaled
+// by 127 over their largest absolute value, which keeps cosine similarities but not the lengths.
+//
+// Vectors are encoded by the calling threads, a separate thread writes them.
 class VectorCollector {
 public:
   VectorCollector(const Ptr<Options>& options);
-  virtual ~VectorCollector() {}
-  
+  virtual ~VectorCollector();
+
   virtual void Write(long id, const std::vector<float>& vec);
 
 protected:
+  enum class Format { text, binary, npy };
+
   long nextId_{0};
   UPtr<std::ostream> outStrm_;
-  bool binary_; // output binary floating point vectors if set
+  std::string outFile_;
+  Format format_;
+  Type type_;        // of binary vectors
+  int dimension_{-1};
 
   std::mutex mutex_;
 
-  typedef std::map<long, std::vector<float>> Outputs;
-  Outputs outputs_;
+  typedef std::map<long, std::string> Outputs;
+  Outputs outputs_;                    // encoded vectors that are waiting for their predecessors
+  std::vector<std::string> pending_;   // encoded vectors in order, not written yet
+  std::condition_variable written_;
+  bool done_{false};
+  std::thread writer_;
 
-  virtual void WriteVector(const std::vector<float>& vec);
+  virtual void WriteVector(const std::vector<float>& vec, std::string& bytes);
+  void writeLoop();
+  std::string npyHeader(size_t rows) const;
 };
 }  // namespace marian
@@ -19,6 +19,7 @@ struct Ops {
   static HOST_DEVICE_INLINE T tan(const T&)  { ABORT("Unknown type"); }
   static HOST_DEVICE_INLINE T log(const T&)  { ABORT("Unknown type"); }
   static HOST_DEVICE_INLINE T exp(const T&)  { ABORT("Unknown type"); }
+  static HOST_DEVICE_INLINE T erf(const T&)  { ABORT("Unknown type"); }
   static HOST_DEVICE_INLINE T abs(const T&)  { ABORT("Unknown type"); }
   static HOST_DEVICE_INLINE T sqr(const T&)  { ABORT("Unknown type"); }
   static HOST_DEVICE_INLINE T sqrt(const T&) { ABORT("Unknown type"); }
@@ -77,6 +78,7 @@ struct Ops<float> {
   static HOST_DEVICE_INLINE float tan(const float& x)  { return tanf(x); }
   static HOST_DEVICE_INLINE float log(const float& x)  { return logf(x); }
   static HOST_DEVICE_INLINE float exp(const float& x)  { return expf(x); }
+  static HOST_DEVICE_INLINE float erf(const float& x)  { return erff(x); }
   static HOST_DEVICE_INLINE float abs(const float& x)  { return fabs(x); }
   static HOST_DEVICE_INLINE float sqr(const float& x)  { return x * x; }
   static HOST_DEVICE_INLINE float sqrt(const float& x) { return sqrtf(x); }
@@ -146,6 +148,7 @@ struct Ops<double> {
   static HOST_DEVICE_INLINE double tan(const double& x)  { return std::tan(x); }
   static HOST_DEVICE_INLINE double log(const double& x)  { return std::log(x); }
   static HOST_DEVICE_INLINE double exp(const double& x)  { return std::exp(x); }
+  static HOST_DEVICE_INLINE double erf(const double& x)  { return std::erf(x); }
   static HOST_DEVICE_INLINE double abs(const double& x)  { return std::abs(x); }
   static HOST_DEVICE_INLINE double sqr(const double& x)  { return x * x; }
   static HOST_DEVICE_INLINE double sqrt(const double& x) { return std::sqrt(x); }
@@ -214,6 +217,7 @@ struct Ops<double> {
 #ifndef __CUDACC__
 
 #include "3rd_party/sse_mathfun.h"
+#include "functional/vmath.h"
 
 namespace marian {
 namespace functional {
@@ -244,18 +248,22 @@ struct Ops<float32x4> {
     return out;
   }
 
-  // @TODO: why is this slow?
-  static inline float32x4 tanh(const float32x4& x) {
-    // ( e^x - e^-x )/( e^x + e^-x ) = (e^2x - 1) / (e^2x + 1)
-    float32x4 e2x = exp(mul(2.f, x));
-    return div(sub(e2x, 1.f), add(e2x, 1.f));
-  }
+#if defined(__SSE4_1__)
+  // bounded-error implementations from functional/vmath.h
+  static inline float32x4 tanh(const float32x4& x) { return vmath::tanh<4>(x); }
+  static inline float32x4 log(const float32x4& x)  { return vmath::log<4>(x); }
+  static inline float32x4 exp(const float32x4& x)  { return vmath::exp<4>(x); }
+  static inline float32x4 erf(const float32x4& x)  { return vmath::erf<4>(x); }
+#else
+  static inline float32x4 tanh(const float32x4& x) { return loop4(Ops<float>::tanh, x); }
+  static inline float32x4 log(const float32x4& x) { return log_ps(x); }
+  static inline float32x4 exp(const float32x4& x) { return exp_ps(x); }
+  static inline float32x4 erf(const float32x4& x) { return loop4(Ops<float>::erf, x); }
+#endif
 
   static inline float32x4 sin(const float32x4& x) { return sin_ps(x); }
   static inline float32x4 cos(const float32x4& x) { return cos_ps(x); }
   static inline float32x4 tan(const float32x4& x) { return div(sin(x), cos(x)); }
-  static inline float32x4 log(const float32x4& x) { return log_ps(x); }
-  static inline float32x4 exp(const float32x4& x) { return exp_ps(x); }
 
   // @TODO: get rid of loop4 with proper intrisics
   static inline float32x4 abs(const float32x4& x)  { return loop4(Ops<float>::abs, x); }
@@ -292,11 +300,11 @@ struct Ops<float32x4> {
   static inline float32x4 or_(const float32x4& x, const float32x4& y)  { return loop4(Ops<float>::or_, x, y); } // 'or' is used by gcc
 
   // Neural Networks specific functions
-  // @TODO: this is unsafe
-  static inline float32x4 sigmoid(const float32x4& x) {
-    float32x4 e = exp(x);
-    return div(e, add(1.f, e));
-  }
+#if defined(__SSE4_1__)
+  static inline float32x4 sigmoid(const float32x4& x) { return vmath::sigmoid<4>(x); }
+#else
+  static inline float32x4 sigmoid(const float32x4& x) { return loop4(Ops<float>::sigmoid, x); }
+#endif
 
   // // Neural Networks specific functions
   // static HOST_DEVICE_INLINE float sigmoid(const float& x) {
@@ -375,16 +383,26 @@ struct Ops<float32x8> {
     return out;
   }
 
+#if defined(__AVX2__) && defined(__FMA__)
+  // bounded-error implementations from functional/vmath.h
+  static inline float32x8 tanh(const float32x8& x) { return vmath::tanh<8>(x); }
+  static inline float32x8 log(const float32x8& x)  { return vmath::log<8>(x); }
+  static inline float32x8 exp(const float32x8& x)  { return vmath::exp<8>(x); }
+  static inline float32x8 erf(const float32x8& x)  { return vmath::erf<8>(x); }
+#else
   static inline float32x8 tanh(const float32x8& x) { // ( e^x - e^-x )/( e^x + e^-x )
     float32x8 e2x = exp(mul(2.f, x));
     return div(sub(e2x, 1.f), add(e2x, 1.f));
   }
 
+  static inline float32x8 log(const float32x8& x) { return log256_ps(x); }
+  static inline float32x8 exp(const float32x8& x) { return exp256_ps(x); }
+  static inline float32x8 erf(const float32x8& x) { return loop8(Ops<float>::erf, x); }
+#endif
+
   static inline float32x8 sin(const float32x8& x) { return sin256_ps(x); }
   static inline float32x8 cos(const float32x8& x) { return cos256_ps(x); }
   static inline float32x8 tan(const float32x8& x) { return div(sin(x), cos(x)); } // @TODO: use sincos256_ps
-  static inline float32x8 log(const float32x8& x) { return log256_ps(x); }
-  static inline float32x8 exp(const float32x8& x) { return exp256_ps(x); }
 
   // @TODO: get rid of loop8 with proper intrisics
   static inline float32x8 abs(const float32x8& x)  { return loop8(Ops<float>::abs, x); }
@@ -422,11 +440,15 @@ struct Ops<float32x8> {
 
 
   // Neural Networks specific functions
+#if defined(__AVX2__) && defined(__FMA__)
+  static inline float32x8 sigmoid(const float32x8& x) { return vmath::sigmoid<8>(x); }
+#else
   // @TODO: this is unsafe
   static inline float32x8 sigmoid(const float32x8& x) {
     float32x8 e = exp(x);
     return div(e, add(1.f, e));
   }
+#endif
 
   static inline float32x8 logaddexp(const float32x8& x, const float32x8& y)  { return loop8(Ops<float>::logaddexp, x, y); }
 
@@ -465,6 +487,134 @@ struct Ops<float32x8> {
 
 } // end namespace functional
 } // end namespace marian
+
+#ifdef __AVX512F__
+namespace marian {
+namespace functional {
+
+//*******************************************************************************************
+// Specialization for float32x16 (=__m512, CPU AVX-512 intrisics)
+// exp, log, tanh, sigmoid and erf come from functional/vmath.h, sin and cos are computed on both AVX
+// halves with avx_mathfun.h
+template <>
+struct Ops<float32x16> {
+  typedef float Single;
+
+  // split into and join from AVX halves through memory, the cast intrinsics trigger -Wuninitialized in GCC
+  static inline float32x8 lo(const float32x16& x) { return _mm256_loadu_ps((const float*)&x); }
+  static inline float32x8 hi(const float32x16& x) { return _mm256_loadu_ps((const float*)&x + 8); }
+  static inline float32x16 join(const float32x8& lo, const float32x8& hi) {
+    alignas(64) float out[16];
+    _mm256_store_ps(out, lo);
+    _mm256_store_ps(out + 8, hi);
+    return _mm512_load_ps(out);
+  }
+
+  static inline float32x16 loop16(const std::function<float(const float&)>& f, const float32x16& x) {
+    float32x16 out;
+    for(int i = 0; i < 16; i++)
+      ((float*)&out)[i] = f(((const float*)&x)[i]);
+    return out;
+  }
+
+  static inline float32x16 loop16(const std::function<float(const float&, const float&)>& f, const float32x16& x, const float32x16& y) {
+    float32x16 out;
+    for(int i = 0; i < 16; i++)
+      ((float*)&out)[i] = f(((const float*)&x)[i], ((const float*)&y)[i]);
+    return out;
+  }
+
+  static inline float32x16 loop16(const std::function<float(const float&, const float&, const float&)>& f, const float32x16& x, const float32x16& y, const float32x16& z) {
+    float32x16 out;
+    for(int i = 0; i < 16; i++)
+      ((float*)&out)[i] = f(((const float*)&x)[i], ((const float*)&y)[i], ((const float*)&z)[i]);
+    return out;
+  }
+
+  static inline float32x16 tanh(const float32x16& x) { return vmath::tanh<16>(x); }
+  static inline float32x16 sin(const float32x16& x)  { return join(sin256_ps(lo(x)), sin256_ps(hi(x))); }
+  static inline float32x16 cos(const float32x16& x)  { return join(cos256_ps(lo(x)), cos256_ps(hi(x))); }
+  static inline float32x16 tan(const float32x16& x)  { return div(sin(x), cos(x)); }
+  static inline float32x16 log(const float32x16& x)  { return vmath::log<16>(x); }
+  static inline float32x16 exp(const float32x16& x)  { return vmath::exp<16>(x); }
+  static inline float32x16 erf(const float32x16& x)  { return vmath::erf<16>(x); }
+
+  static inline float32x16 abs(const float32x16& x)  { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x7fffffff))); }
+  static inline float32x16 sqr(const float32x16& x)  { return _mm512_mul_ps(x, x); }
+  static inline float32x16 sqrt(const float32x16& x) { return _mm512_mask_sqrt_ps(x, 0xFFFF, x); } // masked like round()
+  static inline float32x16 neg(const float32x16& x)  { return sub(0.f, x); }
+
+  // @TODO: get rid of loop16 with proper intrisics
+  static inline float32x16 sgn(const float32x16& x)  { return loop16(Ops<float>::sgn, x); }
+
+  // masked variants, the unmasked ones trigger -Wmaybe-uninitialized in GCC
+  static inline float32x16 round(const float32x16& x)  { return _mm512_mask_roundscale_ps(x, 0xFFFF, x, _MM_FROUND_TO_NEAREST_INT); }
+  static inline float32x16 floor(const float32x16& x)  { return _mm512_mask_roundscale_ps(x, 0xFFFF, x, _MM_FROUND_TO_NEG_INF); }
+  static inline float32x16 ceil(const float32x16& x)   { return _mm512_mask_roundscale_ps(x, 0xFFFF, x, _MM_FROUND_TO_POS_INF); }
+
+  static inline float32x16 add(const float32x16& x, const float32x16& y) { return _mm512_add_ps(x, y); }
+  static inline float32x16 sub(const float32x16& x, const float32x16& y) { return _mm512_sub_ps(x, y); }
+  static inline float32x16 mul(const float32x16& x, const float32x16& y) { return _mm512_mul_ps(x, y); }
+  static inline float32x16 div(const float32x16& x, const float32x16& y) { return _mm512_div_ps(x, y); }
+
+  // masked like round()
+  static inline float32x16 max(const float32x16& x, const float32x16& y) { return _mm512_mask_max_ps(x, 0xFFFF, x, y); }
+  static inline float32x16 min(const float32x16& x, const float32x16& y) { return _mm512_mask_min_ps(x, 0xFFFF, x, y); }
+  static inline float32x16 pow(const float32x16& x, const float32x16& y) { return exp(mul(y, log(x))); }
+
+  // @TODO: get rid of loop16 with proper intrisics
+  static inline float32x16 negate(float32x16& x)  { return loop16(Ops<float>::negate, x); }
+
+  static inline float32x16 eq(const float32x16& x, const float32x16& y)   { return loop16(Ops<float>::eq, x, y); }
+  static inline float32x16 neq(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::neq, x, y); }
+  static inline float32x16 gt(const float32x16& x, const float32x16& y)   { return loop16(Ops<float>::gt, x, y); }
+  static inline float32x16 lt(const float32x16& x, const float32x16& y)   { return loop16(Ops<float>::lt, x, y); }
+  static inline float32x16 geq(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::geq, x, y); }
+  static inline float32x16 leq(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::leq, x, y); }
+  static inline float32x16 and_(const float32x16& x, const float32x16& y) { return loop16(Ops<float>::and_, x, y); } // 'and' is used by gcc
+  static inline float32x16 or_(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::or_, x, y); } // 'or' is used by gcc
+
+  // Neural Networks specific functions
+  static inline float32x16 sigmoid(const float32x16& x) { return vmath::sigmoid<16>(x); }
+
+  static inline float32x16 logaddexp(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::logaddexp, x, y); }
+
+  static inline float32x16 clip(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::clip, x, y); }
+  static inline float32x16 bump(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::bump, x, y); }
+
+  static inline float32x16 relu(const float32x16& x)  { return max(0.f, x); }
+
+  static inline float32x16 reluBack(const float32x16& x)  { return loop16(Ops<float>::reluBack, x); }
+  static inline float32x16 prelu(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::prelu, x, y); }
+  static inline float32x16 preluBack(const float32x16& x, const float32x16& y)  { return loop16(Ops<float>::preluBack, x, y); }
+
+  static inline float32x16 if_then_else(const float32x16& x, const float32x16& y, const float32x16& z) { return loop16(Ops<float>::if_then_else, x, y, z);  }
+
+  static inline Single sumReduce(const float32x16& x) {
+    Single sum = 0;
+    for(int i = 0; i < 16; ++i)
+      sum = Ops<Single>::add(sum, x[i]);
+    return sum;
+  }
+
+  static inline Single maxReduce(const float32x16& x) {
+    Single maxs = x[0];
+    for(int i = 1; i < 16; ++i)
+      maxs = Ops<Single>::max(maxs, x[i]);
+    return maxs;
+  }
+
+  static inline Single minReduce(const float32x16& x) {
+    Single mins = x[0];
+    for(int i = 1; i < 16; ++i)
+      mins = Ops<Single>::min(mins, x[i]);
+    return mins;
+  }
+};
+
+} // end namespace functional
+} // end namespace marian
+#endif
 #endif
 #endif // of "#ifndef __CUDACC__"
 
@@ -709,6 +859,7 @@ UNARY(Cos,     cos,        Ops<ElementType>::cos(x));
 UNARY(Tan,     tan,        Ops<ElementType>::tan(x));
 UNARY(Log,     log,        Ops<ElementType>::log(x));
 UNARY(Exp,     exp,        Ops<ElementType>::exp(x));
+UNARY(Erf,     erf,        Ops<ElementType>::erf(x));
 UNARY(Abs,     abs,        Ops<ElementType>::abs(x));
 UNARY(Sqr,     sqr,        Ops<ElementType>::sqr(x));
 UNARY(Sqrt,    sqrt,       Ops<ElementType>::sqrt(x));
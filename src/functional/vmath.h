@@ -0,0 +1,299 @@
+#pragma once
+
+// Vectorized single precision exp, log, tanh, sigmoid and erf for SSE4.1, AVX2 (with FMA) and AVX-512.
+//
+// The algorithms are written once on top of the thin Simd<Width> wrappers below and are instantiated
+// for 4 (__m128), 8 (__m256) and 16 (__m512) floats, e.g. vmath::exp<8>(x). Polynomials are the Cephes ones for
+// exp, log and tanh and minimax-style fits for erf. Maximum errors against double precision, checked by src/tests/units/vmath_tests.cpp:
+//
+//   exp      1.5 ulp, results below FLT_MIN flush to zero, inf above 88.72
+//   log      1 ulp, -inf for 0, NaN for negative inputs, denormals are handled
+//   tanh     1.5 ulp
+//   sigmoid  3.5 ulp where the result is a normal number, does not overflow for large |x|
+//   erf      3.5 ulp
+//
+// NaN inputs propagate to NaN outputs. Without FMA the 4-wide versions round the multiply-adds
+// separately, the bounds above are only checked with FMA.
+
+#include <immintrin.h>
+#include <limits>
+
+namespace marian {
+namespace functional {
+namespace vmath {
+
+template <int Width> struct Simd;
+
+#if defined(__SSE4_1__)
+template <>
+struct Simd<4> {
+  typedef __m128 V;
+  typedef __m128 Mask;
+
+  static inline V set1(float x) { return _mm_set1_ps(x); }
+  static inline V add(V x, V y) { return _mm_add_ps(x, y); }
+  static inline V sub(V x, V y) { return _mm_sub_ps(x, y); }
+  static inline V mul(V x, V y) { return _mm_mul_ps(x, y); }
+  static inline V div(V x, V y) { return _mm_div_ps(x, y); }
+#ifdef __FMA__
+  static inline V fma(V x, V y, V z) { return _mm_fmadd_ps(x, y, z); } // x * y + z
+#else
+  static inline V fma(V x, V y, V z) { return _mm_add_ps(_mm_mul_ps(x, y), z); }
+#endif
+  static inline V max(V x, V y) { return _mm_max_ps(x, y); }
+  static inline V min(V x, V y) { return _mm_min_ps(x, y); }
+  static inline V round(V x) { return _mm_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline V abs(V x) { return _mm_andnot_ps(_mm_set1_ps(-0.f), x); }
+  static inline V copysign(V x, V sign) {
+    V signBit = _mm_set1_ps(-0.f);
+    return _mm_or_ps(_mm_andnot_ps(signBit, x), _mm_and_ps(signBit, sign));
+  }
+
+  static inline Mask lt(V x, V y) { return _mm_cmplt_ps(x, y); }
+  static inline Mask gt(V x, V y) { return _mm_cmpgt_ps(x, y); }
+  static inline Mask eq(V x, V y) { return _mm_cmpeq_ps(x, y); }
+  static inline Mask isnan(V x)   { return _mm_cmpunord_ps(x, x); }
+  static inline V select(Mask m, V x, V y) { return _mm_blendv_ps(y, x, m); } // m ? x : y
+
+  // x * 2^n for integral n in [-252, 254], the factor is split in two to avoid overflowing the exponent
+  static inline V ldexp(V x, V n) {
+    __m128i ni = _mm_cvtps_epi32(n);
+    __m128i half = _mm_srai_epi32(ni, 1);
+    V f1 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(half, _mm_set1_epi32(127)), 23));
+    V f2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_sub_epi32(ni, half), _mm_set1_epi32(127)), 23));
+    return _mm_mul_ps(_mm_mul_ps(x, f1), f2);
+  }
+
+  // x = m * 2^e with m in [0.5, 1) for positive finite x
+  static inline V frexp(V x, V& e) {
+    // scale denormals into the normal range first
+    Mask denormal = lt(x, set1(1.17549435e-38f));
+    x = select(denormal, mul(x, set1(8388608.f)), x);
+    __m128i bits = _mm_castps_si128(x);
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126));
+    e = sub(_mm_cvtepi32_ps(exponent), select(denormal, set1(23.f), set1(0.f)));
+    bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000));
+    return _mm_castsi128_ps(bits);
+  }
+};
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+template <>
+struct Simd<8> {
+  typedef __m256 V;
+  typedef __m256 Mask;
+
+  static inline V set1(float x) { return _mm256_set1_ps(x); }
+  static inline V add(V x, V y) { return _mm256_add_ps(x, y); }
+  static inline V sub(V x, V y) { return _mm256_sub_ps(x, y); }
+  static inline V mul(V x, V y) { return _mm256_mul_ps(x, y); }
+  static inline V div(V x, V y) { return _mm256_div_ps(x, y); }
+  static inline V fma(V x, V y, V z) { return _mm256_fmadd_ps(x, y, z); } // x * y + z
+  static inline V max(V x, V y) { return _mm256_max_ps(x, y); }
+  static inline V min(V x, V y) { return _mm256_min_ps(x, y); }
+  static inline V round(V x) { return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline V abs(V x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x); }
+  static inline V copysign(V x, V sign) {
+    V signBit = _mm256_set1_ps(-0.f);
+    return _mm256_or_ps(_mm256_andnot_ps(signBit, x), _mm256_and_ps(signBit, sign));
+  }
+
+  static inline Mask lt(V x, V y) { return _mm256_cmp_ps(x, y, _CMP_LT_OQ); }
+  static inline Mask gt(V x, V y) { return _mm256_cmp_ps(x, y, _CMP_GT_OQ); }
+  static inline Mask eq(V x, V y) { return _mm256_cmp_ps(x, y, _CMP_EQ_OQ); }
+  static inline Mask isnan(V x)   { return _mm256_cmp_ps(x, x, _CMP_UNORD_Q); }
+  static inline V select(Mask m, V x, V y) { return _mm256_blendv_ps(y, x, m); } // m ? x : y
+
+  // x * 2^n for integral n in [-252, 254], the factor is split in two to avoid overflowing the exponent
+  static inline V ldexp(V x, V n) {
+    __m256i ni = _mm256_cvtps_epi32(n);
+    __m256i half = _mm256_srai_epi32(ni, 1);
+    V f1 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(half, _mm256_set1_epi32(127)), 23));
+    V f2 = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_sub_epi32(ni, half), _mm256_set1_epi32(127)), 23));
+    return _mm256_mul_ps(_mm256_mul_ps(x, f1), f2);
+  }
+
+  // x = m * 2^e with m in [0.5, 1) for positive finite x
+  static inline V frexp(V x, V& e) {
+    // scale denormals into the normal range first
+    Mask denormal = lt(x, set1(1.17549435e-38f));
+    x = select(denormal, mul(x, set1(8388608.f)), x);
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126));
+    e = sub(_mm256_cvtepi32_ps(exponent), select(denormal, set1(23.f), set1(0.f)));
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000));
+    return _mm256_castsi256_ps(bits);
+  }
+};
+#endif
+
+#if defined(__AVX512F__)
+template <>
+struct Simd<16> {
+  typedef __m512 V;
+  typedef __mmask16 Mask;
+
+  static inline V set1(float x) { return _mm512_set1_ps(x); }
+  static inline V add(V x, V y) { return _mm512_add_ps(x, y); }
+  static inline V sub(V x, V y) { return _mm512_sub_ps(x, y); }
+  static inline V mul(V x, V y) { return _mm512_mul_ps(x, y); }
+  static inline V div(V x, V y) { return _mm512_div_ps(x, y); }
+  static inline V fma(V x, V y, V z) { return _mm512_fmadd_ps(x, y, z); } // x * y + z
+  // masked variants, the unmasked ones trigger -Wmaybe-uninitialized in GCC
+  static inline V max(V x, V y) { return _mm512_mask_max_ps(x, 0xFFFF, x, y); }
+  static inline V min(V x, V y) { return _mm512_mask_min_ps(x, 0xFFFF, x, y); }
+  static inline V round(V x) { return _mm512_mask_roundscale_ps(x, 0xFFFF, x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline V abs(V x) { return _mm512_abs_ps(x); }
+  static inline V copysign(V x, V sign) {
+    V a = abs(x);
+    return _mm512_mask_sub_ps(a, lt(sign, set1(0.f)), set1(0.f), a);
+  }
+
+  static inline Mask lt(V x, V y) { return _mm512_cmp_ps_mask(x, y, _CMP_LT_OQ); }
+  static inline Mask gt(V x, V y) { return _mm512_cmp_ps_mask(x, y, _CMP_GT_OQ); }
+  static inline Mask eq(V x, V y) { return _mm512_cmp_ps_mask(x, y, _CMP_EQ_OQ); }
+  static inline Mask isnan(V x)   { return _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q); }
+  static inline V select(Mask m, V x, V y) { return _mm512_mask_blend_ps(m, y, x); } // m ? x : y
+
+  // scalef handles the whole exponent range including denormal results
+  static inline V ldexp(V x, V n) { return _mm512_mask_scalef_ps(x, 0xFFFF, x, n); }
+
+  // x = m * 2^e with m in [0.5, 1) for positive finite x, getexp/getmant normalize denormals
+  static inline V frexp(V x, V& e) {
+    e = add(_mm512_mask_getexp_ps(x, 0xFFFF, x), set1(1.f));
+    return _mm512_mask_getmant_ps(x, 0xFFFF, x, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_src);
+  }
+};
+#endif
+
+template <int W, class V = typename Simd<W>::V>
+inline V exp(V x) {
+  typedef Simd<W> S;
+  const float hi = 88.7228394f;   // expf(hi) is the largest finite float
+  const float lo = -87.3365479f;  // expf(lo) is the smallest normal float
+
+  V xc = S::min(S::max(x, S::set1(lo)), S::set1(hi));
+  V n = S::round(S::mul(xc, S::set1(1.44269504088896341f)));  // x / ln(2)
+  // r = x - n * ln(2) in two steps, the first constant is exact in a few bits
+  V r = S::fma(n, S::set1(-0.693359375f), xc);
+  r = S::fma(n, S::set1(2.12194440e-4f), r);
+
+  V p = S::set1(1.9875691500E-4f);
+  p = S::fma(p, r, S::set1(1.3981999507E-3f));
+  p = S::fma(p, r, S::set1(8.3334519073E-3f));
+  p = S::fma(p, r, S::set1(4.1665795894E-2f));
+  p = S::fma(p, r, S::set1(1.6666665459E-1f));
+  p = S::fma(p, r, S::set1(5.0000001201E-1f));
+  p = S::fma(p, S::mul(r, r), S::add(r, S::set1(1.f)));
+
+  V y = S::ldexp(p, n);
+  y = S::select(S::lt(x, S::set1(lo)), S::set1(0.f), y);
+  y = S::select(S::gt(x, S::set1(hi)), S::set1(std::numeric_limits<float>::infinity()), y);
+  return S::select(S::isnan(x), x, y);
+}
+
+template <int W, class V = typename Simd<W>::V>
+inline V log(V x) {
+  typedef Simd<W> S;
+  V e;
+  V m = S::frexp(x, e);
+
+  // move m into [sqrt(0.5), sqrt(2))
+  auto below = S::lt(m, S::set1(0.707106781186547524f));
+  e = S::select(below, S::sub(e, S::set1(1.f)), e);
+  m = S::sub(S::select(below, S::add(m, m), m), S::set1(1.f));
+
+  V z = S::mul(m, m);
+  V p = S::set1(7.0376836292E-2f);
+  p = S::fma(p, m, S::set1(-1.1514610310E-1f));
+  p = S::fma(p, m, S::set1(1.1676998740E-1f));
+  p = S::fma(p, m, S::set1(-1.2420140846E-1f));
+  p = S::fma(p, m, S::set1(1.4249322787E-1f));
+  p = S::fma(p, m, S::set1(-1.6668057665E-1f));
+  p = S::fma(p, m, S::set1(2.0000714765E-1f));
+  p = S::fma(p, m, S::set1(-2.4999993993E-1f));
+  p = S::fma(p, m, S::set1(3.3333331174E-1f));
+  V y = S::mul(S::mul(p, m), z);
+  y = S::fma(e, S::set1(-2.12194440e-4f), y);
+  y = S::fma(z, S::set1(-0.5f), y);
+  y = S::add(m, y);
+  y = S::fma(e, S::set1(0.693359375f), y);
+
+  const float inf = std::numeric_limits<float>::infinity();
+  y = S::select(S::eq(x, S::set1(inf)), x, y);
+  y = S::select(S::eq(x, S::set1(0.f)), S::set1(-inf), y);
+  y = S::select(S::lt(x, S::set1(0.f)), S::set1(std::numeric_limits<float>::quiet_NaN()), y);
+  return S::select(S::isnan(x), x, y);
+}
+
+template <int W, class V = typename Simd<W>::V>
+inline V tanh(V x) {
+  typedef Simd<W> S;
+  V a = S::abs(x);
+
+  // odd polynomial for small |x|
+  V z = S::mul(x, x);
+  V p = S::set1(-5.70498872745E-3f);
+  p = S::fma(p, z, S::set1(2.06390887954E-2f));
+  p = S::fma(p, z, S::set1(-5.37397155531E-2f));
+  p = S::fma(p, z, S::set1(1.33314422036E-1f));
+  p = S::fma(p, z, S::set1(-3.33332819422E-1f));
+  V inner = S::fma(S::mul(p, z), x, x);
+
+  // 1 - 2 / (exp(2|x|) + 1), goes to 1 without overflow
+  V outer = S::sub(S::set1(1.f), S::div(S::set1(2.f), S::add(exp<W>(S::add(a, a)), S::set1(1.f))));
+  outer = S::copysign(outer, x);
+
+  return S::select(S::lt(a, S::set1(0.625f)), inner, outer);
+}
+
+template <int W, class V = typename Simd<W>::V>
+inline V sigmoid(V x) {
+  typedef Simd<W> S;
+  // exp(-x) overflows to inf for very negative x which results in 0 instead of NaN
+  return S::div(S::set1(1.f), S::add(S::set1(1.f), exp<W>(S::sub(S::set1(0.f), x))));
+}
+
+template <int W, class V = typename Simd<W>::V>
+inline V erf(V x) {
+  typedef Simd<W> S;
+  V a = S::min(S::abs(x), S::set1(4.f)); // erf(4) rounds to 1
+
+  // |x| < 1.5: x * P(x^2)
+  V z = S::mul(a, a);
+  V p = S::set1(6.198345160e-07f);
+  p = S::fma(p, z, S::set1(-1.132422055e-05f));
+  p = S::fma(p, z, S::set1(1.130898744e-04f));
+  p = S::fma(p, z, S::set1(-8.454757337e-04f));
+  p = S::fma(p, z, S::set1(5.216972133e-03f));
+  p = S::fma(p, z, S::set1(-2.686321201e-02f));
+  p = S::fma(p, z, S::set1(1.128372973e-01f));
+  p = S::fma(p, z, S::set1(-3.761263416e-01f));
+  p = S::fma(p, z, S::set1(1.128379167e+00f));
+  V inner = S::mul(a, p);
+
+  // |x| >= 1.5: 1 - erfc(x) with erfc(x) = exp(-x^2) / x * Q(1 / x^2)
+  V t = S::div(S::set1(1.f), z);
+  V q = S::set1(-1.118391181e+00f);
+  q = S::fma(q, t, S::set1(2.553855504e+00f));
+  q = S::fma(q, t, S::set1(-2.633118706e+00f));
+  q = S::fma(q, t, S::set1(1.692630723e+00f));
+  q = S::fma(q, t, S::set1(-8.344139070e-01f));
+  q = S::fma(q, t, S::set1(4.063981578e-01f));
+  q = S::fma(q, t, S::set1(-2.813710927e-01f));
+  q = S::fma(q, t, S::set1(5.641762550e-01f));
+  // exp(-x^2) with the rounding error of x^2 added back as exp(-hi - lo) ~ exp(-hi) * (1 - lo)
+  V zlo = S::fma(a, a, S::sub(S::set1(0.f), z));
+  V ez = exp<W>(S::sub(S::set1(0.f), z));
+  ez = S::fma(S::sub(S::set1(0.f), ez), zlo, ez);
+  V outer = S::sub(S::set1(1.f), S::div(S::mul(ez, q), a));
+
+  V y = S::select(S::lt(a, S::set1(1.5f)), inner, outer);
+  y = S::copysign(y, x);
+  return S::select(S::isnan(x), x, y);
+}
+
+}  // namespace vmath
+}  // namespace functional
+}  // namespace marian
@@ -0,0 +1,204 @@
+#include "graph/checkpoint_planner.h"
+
+#include <algorithm>
+
+namespace marian {
+
+// same alignment as the workspace TensorAllocator
+static size_t alignedBytes(const Shape& shape, Type type) {
+  const size_t alignment = 256;
+  size_t bytes = requiredBytes(shape, type);
+  return ((bytes + alignment - 1) / alignment) * alignment;
+}
+
+// Rough cost model: matrix products count multiply-adds, everything else one operation per element.
+static double approximateFlops(Expr node) {
+  double elements = (double)node->shape().elements();
+  auto type = node->type();
+  if((type == "dot" || type == "bdot" || type == "bdot_legacy" || type == "affine" || type == "affineWithRelu")
+     && node->children().size() >= 2) {
+    const auto& outShape = node->shape();
+    const auto& aShape = node->child(0)->shape();
+    if(outShape.size() >= 2 && aShape.size() >= 2) {
+      // A is either [M, K] or [K, M], the output has M rows
+      int k = aShape[-2] == outShape[-2] ? aShape[-1] : aShape[-2];
+      return 2.0 * elements * k;
+    }
+  }
+  return elements;
+}
+
+CheckpointPlanner::CheckpointPlanner(const std::list<Expr>& nodesForward,
+                                     const std::unordered_set<Expr>& topNodes) {
+  nodes_.assign(nodesForward.begin(), nodesForward.end());
+  for(size_t i = 0; i < nodes_.size(); ++i)
+    index_[nodes_[i].get()] = i;
+
+  children_.resize(nodes_.size());
+  bytes_.resize(nodes_.size(), 0);
+  flops_.resize(nodes_.size(), 0);
+  trainable_.resize(nodes_.size(), false);
+  top_.resize(nodes_.size(), false);
+
+  for(size_t i = 0; i < nodes_.size(); ++i) {
+    auto& node = nodes_[i];
+    for(auto& child : node->children()) {
+      auto it = index_.find(child.get());
+      if(it != index_.end())
+        children_[i].push_back(it->second);
+    }
+    // parameters and memoized nodes live outside of the workspace
+    if(node->type() != "param" && !node->memoize())
+      bytes_[i] = alignedBytes(node->shape(), node->value_type());
+    flops_[i] = approximateFlops(node);
+    trainable_[i] = node->trainable();
+    top_[i] = topNodes.count(node) > 0;
+  }
+
+  // Collect segments the same way ExpressionGraph::forwardNext() creates subtapes: starting from the
+  // last trainable checkpoint, every node that is not a checkpoint itself belongs to the segment of
+  // the first checkpoint that reaches it. The segments of the top nodes are never recomputed.
+  auto isCheckpoint = [&](size_t i) { return top_[i] || nodes_[i]->isCheckpoint(); };
+
+  std::vector<bool> visited(nodes_.size(), false);
+  std::vector<size_t> stack;
+  for(size_t c = nodes_.size(); c-- > 0;) {
+    if(!isCheckpoint(c) || !trainable_[c])
+      continue;
+
+    CheckpointSegment segment;
+    segment.checkpoint = nodes_[c];
+    stack.assign(children_[c].begin(), children_[c].end());
+    while(!stack.empty()) {
+      size_t i = stack.back();
+      stack.pop_back();
+      if(visited[i] || isCheckpoint(i))
+        continue;
+      visited[i] = true;
+      segment.nodes.push_back(i);
+      segment.bytes += bytes_[i];
+      segment.flops += flops_[i];
+      stack.insert(stack.end(), children_[i].begin(), children_[i].end());
+    }
+
+    if(top_[c] || segment.nodes.empty())
+      continue;
+
+    std::sort(segment.nodes.begin(), segment.nodes.end());
+    segments_.push_back(std::move(segment));
+  }
+}
+
+// Replays ExpressionGraph::forward() and backward(): all values are allocated in forward order and
+// recomputed segments are freed once their checkpoint has been computed. Backward allocates the
+// gradients of the children of each trainable node, recomputes its segment and then releases the node.
+// Non-trainable nodes are released together with their last parent.
+size_t CheckpointPlanner::simulate(const std::vector<CheckpointSegment>& segments) const {
+  std::unordered_map<size_t, const CheckpointSegment*> recomputeAt;
+  for(const auto& segment : segments)
+    if(segment.recompute)
+      recomputeAt[index_.at(segment.checkpoint.get())] = &segment;
+
+  std::vector<bool> valLive(nodes_.size(), false);
+  std::vector<bool> gradLive(nodes_.size(), false);
+  std::vector<size_t> parents(nodes_.size(), 0);
+  for(const auto& children : children_)
+    for(auto child : children)
+      parents[child]++;
+
+  size_t live = 0, peak = 0;
+  auto allocVal = [&](size_t i) { if(!valLive[i]) { valLive[i] = true; live += bytes_[i]; } };
+  auto freeVal  = [&](size_t i) { if(valLive[i]) { valLive[i] = false; live -= bytes_[i]; } };
+
+  for(size_t i = 0; i < nodes_.size(); ++i) {
+    allocVal(i);
+    peak = std::max(peak, live);
+    auto it = recomputeAt.find(i);
+    if(it != recomputeAt.end())
+      for(auto j : it->second->nodes)
+        freeVal(j);
+  }
+
+  for(size_t i = 0; i < nodes_.size(); ++i) {
+    if(top_[i] && trainable_[i] && !gradLive[i]) {
+      gradLive[i] = true;
+      live += bytes_[i];
+    }
+  }
+
+  for(size_t i = nodes_.size(); i-- > 0;) {
+    if(!trainable_[i])
+      continue;
+
+    auto it = recomputeAt.find(i);
+    if(it != recomputeAt.end())
+      for(auto j : it->second->nodes)
+        allocVal(j);
+
+    for(auto child : children_[i]) {
+      if(trainable_[child] && !gradLive[child]) {
+        gradLive[child] = true;
+        live += bytes_[child];
+      }
+    }
+    peak = std::max(peak, live);
+
+    for(auto child : children_[i])
+      if(--parents[child] == 0 && !trainable_[child])
+        freeVal(child);
+
+    freeVal(i);
+    if(gradLive[i]) {
+      gradLive[i] = false;
+      live -= bytes_[i];
+    }
+  }
+
+  return peak;
+}
+
+CheckpointPlan CheckpointPlanner::finalize(std::vector<CheckpointSegment>&& segments) const {
+  CheckpointPlan plan;
+  plan.peakBytes = simulate(segments);
+  for(auto f : flops_)
+    plan.flops += f;
+  for(const auto& segment : segments)
+    if(segment.recompute)
+      plan.recomputeFlops += segment.flops;
+  plan.segments = std::move(segments);
+  return plan;
+}
+
+CheckpointPlan CheckpointPlanner::estimate() const {
+  auto segments = segments_;
+  for(auto& segment : segments)
+    segment.recompute = false;
+  return finalize(std::move(segments));
+}
+
+CheckpointPlan CheckpointPlanner::plan(size_t budget) const {
+  auto segments = segments_;
+  if(budget == 0)
+    return finalize(std::move(segments));
+
+  for(auto& segment : segments)
+    segment.recompute = false;
+
+  // recompute the segments that save the most memory per FLOP first until the peak fits the budget
+  std::vector<size_t> order(segments.size());
+  for(size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return segments[a].bytes * std::max(segments[b].flops, 1.0) > segments[b].bytes * std::max(segments[a].flops, 1.0);
+  });
+
+  for(auto i : order) {
+    if(simulate(segments) <= budget)
+      break;
+    segments[i].recompute = true;
+  }
+
+  return finalize(std::move(segments));
+}
+
+}  // namespace marian
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common/definitions.h"
+#include "tensors/tensor.h"
+#include "graph/chainable.h"
+
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace marian {
+
+/**
+ * A gradient-checkpointing segment: all nodes that are freed after the forward pass and recomputed
+ * from the preceding checkpoints when the backward pass reaches the checkpoint that closes the segment.
+ */
+struct CheckpointSegment {
+  Expr checkpoint;           // node closing the segment, e.g. the output of a transformer layer
+  std::vector<size_t> nodes; // indices of the nodes in the segment (forward order)
+  size_t bytes{0};           // workspace memory of the values in the segment
+  double flops{0};           // approximate cost of recomputing the segment
+  bool recompute{true};      // free and recompute (true) or keep the values (false)
+};
+
+/**
+ * Result of a checkpoint planning pass or memory estimate for a graph.
+ */
+struct CheckpointPlan {
+  std::vector<CheckpointSegment> segments;
+  size_t peakBytes{0};      // estimated peak workspace memory for forward and backward pass
+  double flops{0};          // approximate cost of one forward pass
+  double recomputeFlops{0}; // approximate cost of the recomputation during the backward pass
+
+  size_t numRecomputed() const {
+    size_t n = 0;
+    for(const auto& segment : segments)
+      n += segment.recompute;
+    return n;
+  }
+};
+
+/**
+ * Analytic memory model of the workspace used by ExpressionGraph::forward() and backward().
+ * Walks the forward tape once and replays the allocations and deallocations of node values and
+ * gradients without touching any device memory. Parameters and memoized nodes are not part of the
+ * workspace and are ignored. Scratch memory that operators request from the graph allocator is
+ * not known here, hence the estimate is a lower bound.
+ *
+ * The planner picks for each manually marked checkpoint (see checkpoint(Expr)) whether the segment
+ * before it is recomputed. Segments are kept as long as the peak fits into the budget, segments
+ * that free the most memory per recomputed FLOP are recomputed first.
+ */
+class CheckpointPlanner {
+public:
+  CheckpointPlanner(const std::list<Expr>& nodesForward, const std::unordered_set<Expr>& topNodes);
+
+  // Memory estimate without any recomputation, i.e. without gradient checkpointing.
+  CheckpointPlan estimate() const;
+
+  // Plan the recomputation for a budget in bytes; 0 recomputes all segments which corresponds
+  // to gradient checkpointing with manually set checkpoints only.
+  CheckpointPlan plan(size_t budget) const;
+
+private:
+  size_t simulate(const std::vector<CheckpointSegment>& segments) const;
+  CheckpointPlan finalize(std::vector<CheckpointSegment>&& segments) const;
+
+  std::vector<Expr> nodes_;                   // forward order
+  std::unordered_map<Chainable<Tensor>*, size_t> index_;
+  std::vector<std::vector<size_t>> children_; // children within the tape
+  std::vector<size_t> bytes_;                 // workspace bytes for the value (and gradient) of each node
+  std::vector<double> flops_;
+  std::vector<bool> trainable_;
+  std::vector<bool> top_;
+
+  std::vector<CheckpointSegment> segments_;
+};
+
+}  // namespace marian
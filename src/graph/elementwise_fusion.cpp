@@ -0,0 +1,150 @@
+#include "graph/elementwise_fusion.h"
+
+#include <algorithm>
+
+namespace marian {
+
+static bool isElementwise(Expr node) {
+  static const std::unordered_set<std::string> types = {
+      "+", "-", "*", "/", "max", "min", "logaddexp",
+      "scalar_add", "scalar_mult", "clip", "sigmoid", "tanh", "ReLU", "PReLU", "swish",
+      "log", "exp", "sin", "cos", "tan", "sqrt", "square", "negate", "abs"};
+
+  if(node->value_type() != Type::float32 || node->memoize() || node->marked_for_debug())
+    return false;
+  if(node->children().empty() || !types.count(node->type()))
+    return false;
+  // broadcasting operands would need index arithmetic across tiles
+  for(auto& child : node->children())
+    if(child->shape() != node->shape() || child->value_type() != node->value_type())
+      return false;
+  return true;
+}
+
+FusionStats ElementwiseFusion::fuse(const std::list<Expr>& forwardTape) {
+  clear();
+
+  std::unordered_map<Chainable<Tensor>*, size_t> index;
+  std::vector<bool> elementwise;
+  size_t i = 0;
+  for(auto& node : forwardTape) {
+    index[node.get()] = i++;
+    elementwise.push_back(isElementwise(node));
+  }
+
+  // the consumer of each node and how often it references it, nodes with several consumers are shared
+  std::unordered_map<Chainable<Tensor>*, std::pair<Chainable<Tensor>*, long>> consumers;
+  std::unordered_set<Chainable<Tensor>*> shared;
+  for(auto& node : forwardTape) {
+    for(auto& child : node->children()) {
+      auto it = consumers.find(child.get());
+      if(it == consumers.end())
+        consumers[child.get()] = {node.get(), 1};
+      else if(it->second.first == node.get())
+        it->second.second++;
+      else
+        shared.insert(child.get());
+    }
+  }
+
+  // An intermediate is only referenced by the tape and its consumer, otherwise someone might look
+  // at its value later, e.g. decoder states that are kept between steps.
+  std::unordered_set<Chainable<Tensor>*> intermediates;
+  for(auto& node : forwardTape) {
+    if(!elementwise[index[node.get()]] || shared.count(node.get()) || node->val())
+      continue;
+    auto it = consumers.find(node.get());
+    if(it == consumers.end())
+      continue;
+    auto consumer = index.find(it->second.first);
+    if(consumer != index.end() && elementwise[consumer->second] && (long)references(node.get()) == 1 + it->second.second)
+      intermediates.insert(node.get());
+  }
+
+  FusionStats stats;
+  std::vector<Expr> stack;
+  for(auto it = forwardTape.rbegin(); it != forwardTape.rend(); ++it) {
+    auto& tail = *it;
+    if(!elementwise[index[tail.get()]] || intermediates.count(tail.get()) || tail->val())
+      continue;
+
+    std::vector<Expr> group;
+    stack.assign(tail->children().begin(), tail->children().end());
+    while(!stack.empty()) {
+      auto node = stack.back();
+      stack.pop_back();
+      if(fused_.count(node.get()) || !intermediates.count(node.get()))
+        continue;
+      fused_.insert(node.get());
+      group.push_back(node);
+      stack.insert(stack.end(), node->children().begin(), node->children().end());
+    }
+
+    if(group.empty())
+      continue;
+
+    std::sort(group.begin(), group.end(), [&](const Expr& a, const Expr& b) {
+      return index[a.get()] < index[b.get()];
+    });
+    stats.chains++;
+    stats.nodes += group.size();
+    group.push_back(tail);
+    groups_[tail.get()] = std::move(group);
+  }
+
+  return stats;
+}
+
+std::vector<Expr> ElementwiseFusion::forward(Expr tail, Ptr<TensorAllocator> allocator) {
+  auto it = groups_.find(tail.get());
+  ABORT_IF(it == groups_.end(), "Node {} {} is not the last node of a fused group", tail->getId(), tail->type());
+  std::vector<Expr> group = std::move(it->second);
+  groups_.erase(it);
+
+  // values of inputs from outside the group, restored after execution
+  std::vector<std::pair<Expr, Tensor>> inputs;
+  for(auto& node : group) {
+    for(auto& child : node->children()) {
+      if(fused_.count(child.get()))
+        continue;
+      bool seen = false;
+      for(auto& input : inputs)
+        seen = seen || input.first == child;
+      if(!seen) {
+        ABORT_IF(!child->val(), "De-allocated child {} {} of fused {} {}", child->getId(), child->type(), tail->getId(), tail->type());
+        inputs.push_back({child, child->val()});
+      }
+    }
+  }
+
+  std::vector<Tensor> scratch(group.size() - 1);
+  for(auto& tile : scratch)
+    allocator->allocate(tile, Shape({1, (int)TILE}), tail->value_type());
+
+  Tensor out = tail->val();
+  size_t size = out->shape().elements();
+  for(size_t offset = 0; offset < size; offset += TILE) {
+    size_t n = std::min(TILE, size - offset);
+    for(auto& input : inputs)
+      input.first->val() = input.second->subtensor(offset, n);
+    for(size_t j = 0; j < scratch.size(); ++j)
+      group[j]->val() = scratch[j]->subtensor(0, n);
+    tail->val() = out->subtensor(offset, n);
+
+    for(auto& node : group)
+      node->forward();
+  }
+
+  for(auto& input : inputs)
+    input.first->val() = input.second;
+  for(size_t j = 0; j < scratch.size(); ++j) {
+    group[j]->val() = nullptr;
+    fused_.erase(group[j].get());
+    allocator->free(scratch[j]);
+  }
+  tail->val() = out;
+
+  return group;
+}
+
+}  // namespace marian
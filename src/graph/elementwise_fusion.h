@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common/definitions.h"
+#include "tensors/tensor.h"
+#include "tensors/tensor_allocator.h"
+#include "graph/chainable.h"
+
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace marian {
+
+/**
+ * Number of fused groups and of nodes that no longer materialize their value.
+ */
+struct FusionStats {
+  size_t chains{0}; // number of fused groups, each is executed by its last node
+  size_t nodes{0};  // number of intermediate nodes that are computed in tiles only
+
+  FusionStats& operator+=(const FusionStats& other) {
+    chains += other.chains;
+    nodes  += other.nodes;
+    return *this;
+  }
+};
+
+/**
+ * Inference-only fusion of element-wise operations on the CPU.
+ *
+ * Sequences like `relu(x * a + b)` create a full-sized intermediate tensor for every operation, each
+ * of which is written to and read back from main memory. fuse() finds groups of same-shape
+ * element-wise nodes (no broadcasting) whose intermediate results are consumed by exactly one other
+ * node of the group and by nobody outside of the graph. forward() then executes the group tile by
+ * tile: inputs and output are temporarily replaced by views on the current tile, intermediates are
+ * written into small scratch tiles that stay in cache, and every node runs its own functional kernel.
+ * The intermediate nodes are never allocated in the workspace.
+ */
+class ElementwiseFusion {
+public:
+  static const size_t TILE = 4096; // elements per tile, a multiple of the vector width
+
+  // Find the fused groups in the forward tape, replaces the groups of a previous tape.
+  FusionStats fuse(const std::list<Expr>& forwardTape);
+
+  // True for intermediate nodes that are computed by the last node of their group.
+  bool isFused(Chainable<Tensor>* node) const { return fused_.count(node) > 0; }
+
+  // True for the last node of a fused group.
+  bool isFusedTail(Chainable<Tensor>* node) const { return groups_.count(node) > 0; }
+
+  // Execute the group that ends with the given node, which has to be allocated already.
+  // Returns the nodes of the group in execution order and forgets the group.
+  std::vector<Expr> forward(Expr tail, Ptr<TensorAllocator> allocator);
+
+  void clear() {
+    groups_.clear();
+    fused_.clear();
+  }
+
+private:
+  std::unordered_map<Chainable<Tensor>*, std::vector<Expr>> groups_; // last node -> nodes in tape order
+  std::unordered_set<Chainable<Tensor>*> fused_;
+};
+
+}  // namespace marian
@@ -1,4 +1,5 @@
 #include "graph/expression_graph.h"
+#include "graph/profiler.h"
 #include "tensors/tensor_operators.h"
 
 #include <sstream>
@@ -78,6 +79,17 @@ void ExpressionGraph::forwardNext() {
     for(auto top : topNodes_)
       top->markCheckpoint();
 
+    CheckpointPlan plan;
+    if(checkpointingBudget_ > 0) {
+      plan = CheckpointPlanner(nodesForward_, topNodes_).plan(checkpointingBudget_);
+      LOG(debug,
+          "[memory] Recomputing {}/{} checkpoint segments, estimated peak {:.1f} MB, {:.1f}% extra FLOPs",
+          plan.numRecomputed(),
+          plan.segments.size(),
+          plan.peakBytes / (1024.f * 1024.f),
+          plan.flops > 0 ? 100.0 * plan.recomputeFlops / plan.flops : 0.0);
+    }
+
     auto it = nodesBackward_.rbegin();
     while(it != nodesBackward_.rend()) {
       auto v = *it;
@@ -96,22 +108,80 @@ void ExpressionGraph::forwardNext() {
         top->getSubtape()->clear();
       }
     }
+
+    // Segments that fit into the budget are kept, same as the segment below the top
+    for(auto& segment : plan.segments) {
+      if(!segment.recompute && segment.checkpoint->getSubtape()) {
+        for(auto& node : *segment.checkpoint->getSubtape())
+          node->markCheckpoint();
+        segment.checkpoint->getSubtape()->clear();
+      }
+    }
+  }
+
+  if(inferenceOnly_ && fuseElementwise_ && backend_->getDeviceId().type == DeviceType::cpu) {
+    auto stats = fusion_.fuse(nodesForward_);
+    if(stats.chains > 0)
+      LOG(debug, "[graph] Fused {} element-wise nodes into {} chains", stats.nodes, stats.chains);
+    fusionStats_ += stats;
   }
 
   forward(nodesForward_, /*finalPass=*/!checkpointing_); // if checkPointing, this is not final
 }
 
+CheckpointPlan ExpressionGraph::estimateMemory() {
+  CheckpointPlanner planner(nodesForward_, topNodes_);
+  return checkpointing_ ? planner.plan(checkpointingBudget_) : planner.estimate();
+}
+
+size_t ExpressionGraph::memoryInUse() {
+  auto allocator = tensors_->getTensorAllocator()->allocator();
+  return allocator->size() - allocator->available();
+}
+
+AllocatorStats ExpressionGraph::memoryStats() {
+  return tensors_->getAllocator()->stats();
+}
+
 void ExpressionGraph::forward(std::list<Expr>& forwardTape, bool finalPass) {
+  auto profiler = GraphProfiler::get();
   while(!forwardTape.empty()) {
     auto v = forwardTape.front();
 
+    // computed in tiles together with the last node of its fused group
+    if(fusion_.isFused(v.get())) {
+      forwardTape.pop_front();
+      continue;
+    }
+
+    size_t inUseBefore = 0;
+    GraphProfiler::Clock::time_point start;
+    if(profiler) {
+      inUseBefore = memoryInUse();
+      start = GraphProfiler::Clock::now();
+    }
+
     v->allocate();
     v->init();
 
-    for(auto& child : v->children())
-      ABORT_IF(!child->val(), "De-allocated child {} {} of {} {}", child->getId(), child->type(), v->getId(), v->type());
+    if(fusion_.isFusedTail(v.get())) {
+      auto group = fusion_.forward(v, tensors_->getTensorAllocator());
+      if(inferenceOnly_)
+        for(auto& node : group)
+          node->children().clear();
+    } else {
+      for(auto& child : v->children())
+        ABORT_IF(!child->val(), "De-allocated child {} {} of {} {}", child->getId(), child->type(), v->getId(), v->type());
+
+      v->forward();
+    }
 
-    v->forward();
+    if(profiler) {
+      backend_->synchronize();
+      size_t inUse = memoryInUse();
+      profiler->record(v, /*backward=*/false, backend_->getDeviceId().no, start, GraphProfiler::Clock::now(),
+                       inUse, inUse > inUseBefore ? inUse - inUseBefore : 0);
+    }
 
     if(v->trainable() && throwNaN_) {
       bool isNaN = false, isInf = false;
@@ -191,6 +261,7 @@ void ExpressionGraph::backward(bool reset, float clipValue) {
 
   tensors_->clearShorttermMemory();
 
+  auto profiler = GraphProfiler::get();
   bool firstNaN = true;
   while(!nodesBackward_.empty()) {
     auto v = nodesBackward_.back();  // return the last element
@@ -224,8 +295,19 @@ void ExpressionGraph::backward(bool reset, float clipValue) {
       Element(_1 = clip(_1, clipValue), v->grad());
     }
 
-    if(v->trainable())
-      v->backward();
+    if(v->trainable()) {
+      if(profiler) {
+        size_t inUseBefore = memoryInUse();
+        auto start = GraphProfiler::Clock::now();
+        v->backward();
+        backend_->synchronize();
+        size_t inUse = memoryInUse();
+        profiler->record(v, /*backward=*/true, backend_->getDeviceId().no, start, GraphProfiler::Clock::now(),
+                         inUse, inUse > inUseBefore ? inUse - inUseBefore : 0);
+      } else {
+        v->backward();
+      }
+    }
 
     if(throwNaN_ && firstNaN) {
       for(auto&& child : v->children()) {
@@ -7,9 +7,12 @@
 #include "tensors/tensor_allocator.h"
 
 #include "graph/chainable.h"
+#include "graph/checkpoint_planner.h"
+#include "graph/elementwise_fusion.h"
 #include "graph/node_initializers.h"
 #include "graph/node_operators.h"
 #include "graph/parameters.h"
+#include "graph/profiler.h"
 
 #include <map>
 #include <unordered_set>
@@ -44,13 +47,17 @@ public:
       : tensors_(New<TensorAllocator>(backend)),
         cache_(New<TensorAllocator>(backend)),
         shortterm_(New<WeakMemory>()),
-        longterm_(New<Memory>()) {}
+        longterm_(New<Memory>()) {
+    tensors_->allocator()->trackTags(GraphMemoryStats::enabled());
+  }
 
   Tensors(Ptr<Backend> backend, Ptr<Device> device)
       : tensors_(New<TensorAllocator>(backend, device)),
         cache_(New<TensorAllocator>(backend)),
         shortterm_(New<WeakMemory>()),
-        longterm_(New<Memory>()) {}
+        longterm_(New<Memory>()) {
+    tensors_->allocator()->trackTags(GraphMemoryStats::enabled());
+  }
 
   void reserve(size_t bytes) { tensors_->reserve(bytes); }
 
@@ -60,16 +67,28 @@ public:
 
   void allocateForward(Expr node) {
     if(!node->val()) {
-      if(node->memoize())
+      if(node->memoize()) {
         cache_->allocate(node->val(), node->shape(), node->value_type());
-      else
+      } else {
+        tag(node, /*gradient=*/false);
         tensors_->allocate(node->val(), node->shape(), node->value_type());
+        tag(nullptr, false);
+      }
     }
   }
 
   void allocateBackward(Expr node) {
-    if(!node->grad())
+    if(!node->grad()) {
+      tag(node, /*gradient=*/true);
       tensors_->allocate(node->grad(), node->shape(), node->value_type());
+      tag(nullptr, false);
+    }
+  }
+
+  // attributes the following workspace allocations to the node, or to none (--memory-stats)
+  void tag(Expr node, bool gradient) {
+    if(GraphMemoryStats::enabled())
+      tensors_->allocator()->setTag(node ? GraphMemoryStats::tagOf(node, gradient) : "");
   }
 
   void free(const Tensor& tensor) { tensors_->free(tensor); }
@@ -150,6 +169,11 @@ private:
   bool inferenceOnly_{false};               // a flag holds whether the graph is used for inference only
 
   bool checkpointing_{false};               // use gradient checkpointing if true
+  size_t checkpointingBudget_{0};           // memory budget in bytes for automatic checkpoint selection, 0 recomputes all checkpoints
+
+  bool fuseElementwise_{false};             // fuse chains of element-wise operations during inference on CPU
+  ElementwiseFusion fusion_;                // fused groups of the current forward tape
+  FusionStats fusionStats_;                 // accumulated number of fused groups and nodes
 
   bool reloaded_{false};                    // a flag holds whether the graph is reloaded: reloaded is true if the graph loads parameters by load() function.
 
@@ -179,6 +203,9 @@ public:
 
   /** Destructor. Clear everything related to the graph except memoized nodes. */
   virtual ~ExpressionGraph() {
+    // the workspace may be shared with other graphs, see reuseWorkspace()
+    if(GraphMemoryStats::enabled() && tensors_ && tensors_.use_count() == 1)
+      GraphMemoryStats::log("workspace " + std::string(backend_->getDeviceId()), memoryStats());
     clear();
     for(auto kvParams : paramsByElementType_)
       kvParams.second->clear();
@@ -222,6 +249,28 @@ public:
   /** Check whether the graph uses gradient checkpointing or not */
   bool isCheckpointing() { return checkpointing_; }
 
+  /**
+   * Set the workspace memory budget in bytes for gradient checkpointing. With a budget, segments
+   * between checkpoints are only recomputed if the activations would not fit otherwise,
+   * see CheckpointPlanner. 0 (default) recomputes all segments.
+   */
+  void setCheckpointingBudget(size_t bytes) { checkpointingBudget_ = bytes; }
+
+  /**
+   * Estimate the peak workspace memory of forward() and backward() for the current graph without
+   * executing it. Takes gradient checkpointing and its budget into account.
+   */
+  CheckpointPlan estimateMemory();
+
+  /**
+   * Set whether chains of element-wise operations are fused and executed tile by tile, see ElementwiseFusion.
+   * Only used for inference on the CPU, ignored otherwise.
+   */
+  void setElementwiseFusion(bool fuse) { fuseElementwise_ = fuse; }
+
+  /** Number of fused groups and nodes since the graph was created */
+  const FusionStats& getFusionStats() const { return fusionStats_; }
+
   /**
    * Set namespace (std::string) for the graph.
    * Each graph has its own unique namespace, which is used to form the name of a parameter object.
@@ -292,6 +341,18 @@ public:
    */
   void checkNaN(Tensor t, bool& isNaN, bool& isInf);
 
+  /**
+   * Number of bytes currently in use in the graph's tensor allocator, used by the profiler.
+   */
+  size_t memoryInUse();
+
+  /**
+   * Usage statistics of the graph's tensor allocator (the workspace): peak and current use, growth,
+   * fragmentation and allocation counts. With --memory-stats the bytes at the peak are also
+   * attributed to node types and name prefixes.
+   */
+  AllocatorStats memoryStats();
+
   /**
    * Perform the forward pass on the nodes of the graph.
    * The forward pass refers to the calculation process.
@@ -724,6 +785,7 @@ public:
     nodesBackward_.clear();
 
     topNodes_.clear();
+    fusion_.clear();
 
     tensors_->clear();
   }
@@ -751,6 +813,10 @@ public:
       // otherwise keep the loaded type. This is used when e.g. loading a float32 model as a float16 model as both
       // have type class TypeClass::float_type.
       auto loadElementType = isSameTypeClass(item.type, defaultElementType_) ? defaultElementType_ : item.type;
+      // bfloat16 matrices are kept as they are for inference, where matrix products convert them on the fly,
+      // but are converted to the default float type for training.
+      if(isBFloat(item.type) && !inferenceOnly_ && isFloat(defaultElementType_))
+        loadElementType = defaultElementType_;
       param(pName, item.shape, inits::fromItem(item), loadElementType, /*fixed=*/false);
     }
     if(markReloaded)
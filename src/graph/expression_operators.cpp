@@ -493,7 +493,10 @@ Expr dot(Expr a, Expr b, bool transA, bool transB, float scale) {
   // Currently only true when command line options
   // --optimize --cpu-thread=N with N > 0 are set.
   if(device == DeviceType::cpu) {
-    if(isFloat(aElementType) && isFloat(bElementType)) {
+    if(isFloat(aElementType) && isBFloat(bElementType)) {
+      // bfloat16 weights are converted block-wise to float32 inside the product
+      return Expression<DotNodeOp>(a, b, transA, transB, scale);
+    } else if(isFloat(aElementType) && isFloat(bElementType)) {
       if(b->memoize() && (a->graph()->getBackend()->getGemmType() == GemmType::FbFp16Packed ||
         a->graph()->getBackend()->getGemmType() == GemmType::FbInt8Packed)) {
 #if USE_FBGEMM
@@ -594,7 +597,10 @@ Expr affine(Expr a, Expr b, Expr bias, bool transA, bool transB, float scale) {
   Type bElementType = b->value_type();
 
   if(device == DeviceType::cpu) {
-    if(isFloat(aElementType) && isFloat(bElementType)) {
+    if(isFloat(aElementType) && isBFloat(bElementType)) {
+      // bfloat16 weights are converted block-wise to float32 inside the product
+      return affineDefault(a, b, bias, transA, transB, scale);
+    } else if(isFloat(aElementType) && isFloat(bElementType)) {
       if(a->graph()->getBackend()->isOptimized()) {
         if(b->memoize() && (a->graph()->getBackend()->getGemmType() == GemmType::FbFp16Packed ||
           a->graph()->getBackend()->getGemmType() == GemmType::FbInt8Packed)) {
@@ -667,7 +673,7 @@ Expr affine(Expr a, Expr b, Expr bias, bool transA, bool transB, float scale) {
     }
   } else {
     // Default GEMM
-    ABORT_IF(!isFloat(aElementType) || !isFloat(bElementType),
+    ABORT_IF(!isFloat(aElementType) || !isFloat(bElementType) || isBFloat(bElementType),
              "GPU-based GEMM only supports float types, you have A: {} and B: {}",
              aElementType, bElementType);
     return affineDefault(a, b, bias, transA, transB, scale);
@@ -857,6 +863,13 @@ Expr rmsNorm(Expr x,
   return Expression<RMSNormalizationOp>(nodes, eps);
 }
 
+Expr fusedAttention(Expr q, Expr k, Expr v, Expr mask, int dimHeads, float scale) {
+  std::vector<Expr> nodes = {q, k, v};
+  if(mask)
+    nodes.push_back(mask);
+  return Expression<FusedAttentionNodeOp>(nodes, dimHeads, scale);
+}
+
 Expr highway(Expr y, Expr x, Expr t) {
   std::vector<Expr> nodes = {y, x, t};
   return Expression<HighwayNodeOp>(nodes);
@@ -935,6 +935,19 @@ Expr layerNorm(Expr x, Expr gamma, Expr beta = nullptr, float eps = 1e-9);
  */
 Expr rmsNorm(Expr x, Expr gamma, Expr beta = nullptr, float eps = 1e-9);
 
+/**
+ * Multi-head scaled dot-product attention with the heads side-by-side in the last dimension:
+ * per head, softmax(scale * q * k^T + mask) * v. Computed in tiles with an online softmax, hence
+ * neither the heads are transposed nor the attention weights materialized. Inference on CPU only.
+ * @param q queries [-4: beam depth, -3: batch size, -2: max q length, -1: model dim]
+ * @param k keys [-4: beam depth or 1, -3: batch size, -2: max kv length, -1: model dim]
+ * @param v values, same shape as the keys
+ * @param mask additive mask [-4: batch size (times beam depth) or 1, -3: 1, -2: max q length or 1, -1: max kv length], may be nullptr
+ * @return [-4: beam depth, -3: batch size, -2: max q length, -1: model dim]
+ * @see FusedAttentionNodeOp
+ */
+Expr fusedAttention(Expr q, Expr k, Expr v, Expr mask, int dimHeads, float scale);
+
 /**
  * Highway transformation.
  * Computes the highway tranform on @p y and @p x as gated by @p t:
@@ -79,6 +79,17 @@ public:
   }
 };
 
+// Result type of a matrix product. A bfloat16 matrix B is a storage format for weights only,
+// the product is computed and returned in the type of the remaining operands.
+static inline Type productType(const std::vector<Expr>& nodes) {
+  if(nodes.size() > 1 && isBFloat(nodes[1]->value_type())) {
+    std::vector<Expr> others(nodes);
+    others.erase(others.begin() + 1);
+    return NaryNodeOp::commonType(others);
+  }
+  return NaryNodeOp::commonType(nodes);
+}
+
 class DotNodeOp : public NaryNodeOp {
 private:
   friend class SerializationHelpers;
@@ -88,7 +99,7 @@ private:
 
 public:
   DotNodeOp(Expr a, Expr b, bool transA, bool transB, float scalar)
-      : NaryNodeOp({a, b}, newShape(a, b, transA, transB)),
+      : NaryNodeOp({a, b}, newShape(a, b, transA, transB), productType({a, b})),
         transA_(transA),
         transB_(transB),
         scalar_(scalar) {}
@@ -249,7 +260,7 @@ public:
                bool transA,
                bool transB,
                float scalar)
-      : NaryNodeOp(nodes, newShape(nodes[0], nodes[1], transA, transB)),
+      : NaryNodeOp(nodes, newShape(nodes[0], nodes[1], transA, transB), productType(nodes)),
         transA_(transA),
         transB_(transB),
         scalar_(scalar) {}
@@ -1659,6 +1670,63 @@ private:
   float eps_;
 };
 
+/**
+ * Multi-head attention softmax(scale * q * k^T + mask) * v in one operation, see fusedAttention().
+ * Only the forward step is implemented, on the CPU, for inference.
+ */
+struct FusedAttentionNodeOp : public NaryNodeOp {
+  FusedAttentionNodeOp(const std::vector<Expr>& nodes, int dimHeads, float scale)
+      : NaryNodeOp(nodes, nodes[0]->shape()), dimHeads_(dimHeads), scale_(scale) {
+    const auto& q = child(0)->shape();
+    const auto& k = child(1)->shape();
+    const auto& v = child(2)->shape();
+    ABORT_IF(q.size() != 4 || k.size() != 4 || k != v,
+             "Fused attention expects 4D queries and keys/values of the same shape, got {}, {} and {}", q, k, v);
+    ABORT_IF(q[-1] != k[-1] || q[-1] % dimHeads != 0,
+             "Model dimension {} of fused attention does not match keys {} or {} heads", q[-1], k[-1], dimHeads);
+    ABORT_IF(q[-3] != k[-3] || (k[-4] != 1 && k[-4] != q[-4]),
+             "Batch dimensions of queries {} and keys {} do not match", q, k);
+  }
+
+  NodeOps forwardOps() override {
+    return {NodeOp(FusedAttention(val_,
+                                  child(0)->val(),
+                                  child(1)->val(),
+                                  child(2)->val(),
+                                  children_.size() == 4 ? child(3)->val() : nullptr,
+                                  dimHeads_,
+                                  scale_))};
+  }
+
+  NodeOps backwardOps() override {
+    ABORT("Fused attention is only implemented for inference");
+  }
+
+  const std::string type() override { return "fused_attention"; }
+
+  virtual size_t hash() override {
+    size_t seed = NaryNodeOp::hash();
+    util::hash_combine(seed, dimHeads_);
+    util::hash_combine(seed, scale_);
+    return seed;
+  }
+
+  virtual bool equal(Expr node) override {
+    if(!NaryNodeOp::equal(node))
+      return false;
+    auto cnode = std::dynamic_pointer_cast<FusedAttentionNodeOp>(node);
+    if(!cnode)
+      return false;
+    if(dimHeads_ != cnode->dimHeads_ || scale_ != cnode->scale_)
+      return false;
+    return true;
+  }
+
+private:
+  int dimHeads_;
+  float scale_;
+};
+
 
 struct HighwayNodeOp : public NaryNodeOp {
   HighwayNodeOp(const std::vector<Expr>& nodes) : NaryNodeOp(nodes) {}
@@ -112,6 +112,22 @@ public:
 
   virtual void set_zero_adjoint() { grads()->set(0.f); }
 
+  // Point all parameter values to the memory of 'other' and release our own copy.
+  // Both objects need to hold the same set of parameters and live in the same address space,
+  // e.g. the parameters of CPU workers inside one process. Gradients remain separate.
+  virtual void shareValsWith(Ptr<Parameters> other) {
+    ABORT_IF(params_.size() != other->params_.size(),
+             "Cannot share values between parameter objects of different sizes ({} != {})",
+             params_.size(), other->params_.size());
+    for(auto p : params_) {
+      auto q = other->get(p->name());
+      ABORT_IF(!q || q->shape() != p->shape() || q->value_type() != p->value_type(),
+               "Parameter '{}' does not match its counterpart in shared parameter object", p->name());
+      p->val() = q->val();
+    }
+    vals_ = other->vals_; // frees our own memory once no tensor refers to it any more
+  }
+
   virtual Tensor vals() { return vals_->asTensor(acceptedElementType_); }
 
   virtual Tensor grads() { return grads_->asTensor(acceptedElementType_); }
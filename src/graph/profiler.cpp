@@ -0,0 +1,219 @@
+#include "graph/profiler.h"
+#include "graph/node.h"
+#include "common/logging.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace marian {
+
+GraphProfiler* GraphProfiler::instance_ = nullptr;
+bool GraphMemoryStats::enabled_ = false;
+size_t GraphMemoryStats::topN_ = 20;
+
+namespace {
+
+std::string escapeJson(const std::string& s) {
+  std::string out;
+  for(char c : s) {
+    if(c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+double toMB(size_t bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+std::string toString(const Shape& shape) {
+  std::stringstream ss;
+  ss << "[";
+  for(int i = 0; i < (int)shape.size(); ++i)
+    ss << (i > 0 ? "x" : "") << shape[i];
+  ss << "]";
+  return ss.str();
+}
+
+}  // namespace
+
+void GraphProfiler::enable(const std::string& traceFile, size_t topN) {
+  if(instance_)
+    return;
+  // never deleted, finish() runs at exit while the loggers still exist
+  instance_ = new GraphProfiler(traceFile, topN);
+  std::atexit([]() { instance_->finish(); });
+  LOG(info, "[profiler] Timing every operator{}", traceFile.empty() ? "" : ", trace is written to " + traceFile);
+}
+
+GraphProfiler::GraphProfiler(const std::string& traceFile, size_t topN)
+    : traceFile_(traceFile), topN_(topN), origin_(Clock::now()) {}
+
+std::string GraphProfiler::prefixOf(const Expr& node) {
+  const std::string* name = node->name() != "none" ? &node->name() : nullptr;
+  for(size_t i = 0; !name && i < node->children().size(); ++i)
+    if(node->children()[i]->name() != "none")
+      name = &node->children()[i]->name();
+  if(!name)
+    return "(unnamed)";
+  auto pos = name->rfind('_');
+  return pos == std::string::npos || pos == 0 ? *name : name->substr(0, pos);
+}
+
+void GraphProfiler::record(const Expr& node,
+                           bool backward,
+                           size_t deviceId,
+                           Clock::time_point start,
+                           Clock::time_point end,
+                           size_t inUse,
+                           size_t allocated) {
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::string shape = toString(node->shape());
+  std::string prefix = prefixOf(node);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if(finished_)
+    return;
+
+  auto& op = byOperator_[std::string(backward ? "backward " : "forward  ") + node->type() + " " + shape];
+  op.seconds += seconds;
+  op.calls++;
+  op.bytes += allocated;
+
+  auto& pre = byPrefix_[prefix];
+  pre.seconds += seconds;
+  pre.calls++;
+  pre.bytes += allocated;
+
+  if(!traceFile_.empty() && events_.size() < maxEvents_) {
+    std::stringstream args;
+    args << "\"shape\": \"" << shape << "\", \"name\": \"" << escapeJson(node->name())
+         << "\", \"prefix\": \"" << escapeJson(prefix) << "\", \"bytes\": " << allocated;
+    events_.push_back({node->type(),
+                       args.str(),
+                       backward,
+                       deviceId,
+                       std::chrono::duration<double, std::micro>(start - origin_).count(),
+                       std::chrono::duration<double, std::micro>(end - start).count(),
+                       inUse});
+    if(events_.size() == maxEvents_)
+      LOG(warn, "[profiler] Trace is limited to {} events, later ones are only summarized", maxEvents_);
+  }
+}
+
+void GraphProfiler::logTable(const std::string& title, const std::map<std::string, Stats>& stats, double total) const {
+  std::vector<std::pair<std::string, Stats>> sorted(stats.begin(), stats.end());
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Stats>& a, const std::pair<std::string, Stats>& b) {
+    return a.second.seconds > b.second.seconds;
+  });
+  if(sorted.size() > topN_)
+    sorted.resize(topN_);
+
+  LOG(info, "[profiler] Top {} by {}:", sorted.size(), title);
+  LOG(info, "[profiler] {:>10} {:>6} {:>9} {:>10} {:>10}  {}", "total ms", "%", "calls", "mean us", "MB alloc", title);
+  for(const auto& entry : sorted) {
+    const auto& s = entry.second;
+    LOG(info, "[profiler] {:10.2f} {:6.2f} {:9d} {:10.2f} {:10.1f}  {}",
+        s.seconds * 1e3,
+        total > 0 ? 100.0 * s.seconds / total : 0.0,
+        s.calls,
+        s.seconds * 1e6 / s.calls,
+        s.bytes / (1024.0 * 1024.0),
+        entry.first);
+  }
+}
+
+void GraphProfiler::finish() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if(finished_)
+    return;
+  finished_ = true;
+
+  double total = 0;
+  for(const auto& op : byOperator_)
+    total += op.second.seconds;
+  LOG(info, "[profiler] {:.3f}s in {} operator types", total, byOperator_.size());
+  logTable("operator", byOperator_, total);
+  logTable("name prefix", byPrefix_, total);
+
+  if(!traceFile_.empty())
+    writeTrace();
+}
+
+void GraphProfiler::writeTrace() const {
+  std::ofstream out(traceFile_);
+  if(!out) {
+    LOG(warn, "[profiler] Could not write trace to {}", traceFile_);
+    return;
+  }
+
+  // timestamps in microseconds with fixed precision, the default precision of 6 significant digits
+  // merges events after the first second
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\": [\n";
+  for(size_t i = 0; i < events_.size(); ++i) {
+    const auto& e = events_[i];
+    out << (i > 0 ? ",\n" : "")
+        << "{\"name\": \"" << escapeJson(e.name) << "\", \"cat\": \"" << (e.backward ? "backward" : "forward")
+        << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << e.deviceId
+        << ", \"ts\": " << e.startUs << ", \"dur\": " << e.durationUs
+        << ", \"args\": {" << e.args << "}},\n"
+        << "{\"name\": \"memory in use\", \"ph\": \"C\", \"pid\": 0, \"tid\": " << e.deviceId
+        << ", \"ts\": " << e.startUs + e.durationUs
+        << ", \"args\": {\"device " << e.deviceId << " MB\": " << e.inUse / (1024.0 * 1024.0) << "}}";
+  }
+  out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  LOG(info, "[profiler] Wrote {} events to {}", events_.size(), traceFile_);
+}
+
+void GraphMemoryStats::enable(size_t topN) {
+  enabled_ = true;
+  topN_ = topN;
+  LOG(info, "[memory] Collecting memory statistics of the graph workspaces");
+}
+
+std::string GraphMemoryStats::tagOf(const Expr& node, bool gradient) {
+  return node->type() + (gradient ? " (grad)" : "") + "\t" + GraphProfiler::prefixOf(node);
+}
+
+void GraphMemoryStats::log(const std::string& title, const AllocatorStats& stats) {
+  LOG(info, "[memory] {}: peak {:.1f} MB of {:.1f} MB reserved, {:.1f} MB in use, {:.1f} MB free in {} gaps, "
+      "largest gap {:.1f} MB, fragmentation {:.1f}%",
+      title, toMB(stats.peak), toMB(stats.reserved), toMB(stats.inUse), toMB(stats.free), stats.gaps,
+      toMB(stats.largestGap), 100.0 * stats.fragmentation());
+  LOG(info, "[memory] {}: {} allocations in {} steps, at most {} per step, grown {} times by {:.1f} MB, {} failed allocations",
+      title, stats.allocations, stats.steps, stats.maxStepAllocations, stats.grows, toMB(stats.grownBytes), stats.failures);
+  if(stats.grows > 0)
+    LOG(info, "[memory] {}: a workspace of at least {} MB avoids growing", title, (stats.peak >> 20) + 1);
+
+  if(stats.peakByTag.empty())
+    return;
+
+  // the tag is "type<tab>prefix"
+  std::map<std::string, size_t> byType, byPrefix;
+  for(const auto& tag : stats.peakByTag) {
+    auto tab = tag.first.find('\t');
+    byType[tab == std::string::npos ? "(other)" : tag.first.substr(0, tab)] += tag.second;
+    byPrefix[tab == std::string::npos ? "(other)" : tag.first.substr(tab + 1)] += tag.second;
+  }
+
+  auto logTable = [&](const std::string& name, const std::map<std::string, size_t>& bytes) {
+    std::vector<std::pair<std::string, size_t>> sorted(bytes.begin(), bytes.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
+      return a.second > b.second;
+    });
+    if(sorted.size() > topN_)
+      sorted.resize(topN_);
+    LOG(info, "[memory] {}: top {} by {} at the peak:", title, sorted.size(), name);
+    for(const auto& entry : sorted)
+      LOG(info, "[memory] {:10.1f} MB {:6.2f}%  {}", toMB(entry.second), 100.0 * entry.second / std::max(stats.peak, (size_t)1), entry.first);
+  };
+  logTable("node type", byType);
+  logTable("name prefix", byPrefix);
+}
+
+}  // namespace marian
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "common/shape.h"
+#include "common/types.h"
+#include "graph/chainable.h"
+#include "tensors/allocator.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace marian {
+
+// Opt-in per-operator profiler for ExpressionGraph (--profile). When enabled, every Node::forward()
+// and Node::backward() of every graph is timed and aggregated by operator type and shape, and by
+// name prefix. The prefix is the node's name, or the name of its first named child such as a
+// parameter, without the last '_'-separated part, e.g. 'decoder_l3_self' for 'decoder_l3_self_Wq'.
+//
+// At exit a table of the top operators and prefixes is logged and, if a file name was given, all
+// events are written as Chrome trace events (chrome://tracing or https://ui.perfetto.dev) together
+// with a counter of the graph's allocator memory in use. When disabled, GraphProfiler::get() returns
+// nullptr and the graph does not record anything.
+class GraphProfiler {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Creates the global profiler, the summary lists the topN most expensive entries
+  static void enable(const std::string& traceFile, size_t topN);
+  static GraphProfiler* get() { return instance_; }
+
+  // One timed Node::forward() (backward = false) or Node::backward(). inUse is the number of bytes
+  // used in the graph's allocator afterwards, allocated those newly allocated for the node.
+  void record(const Expr& node,
+              bool backward,
+              size_t deviceId,
+              Clock::time_point start,
+              Clock::time_point end,
+              size_t inUse,
+              size_t allocated);
+
+  // Logs the summary and writes the trace file
+  void finish();
+
+  // The node's name prefix as described above
+  static std::string prefixOf(const Expr& node);
+
+private:
+  GraphProfiler(const std::string& traceFile, size_t topN);
+
+  struct Stats {
+    double seconds{0};
+    size_t calls{0};
+    size_t bytes{0};
+  };
+
+  struct Event {
+    std::string name;
+    std::string args;
+    bool backward;
+    size_t deviceId;
+    double startUs;
+    double durationUs;
+    size_t inUse;
+  };
+
+  void logTable(const std::string& title, const std::map<std::string, Stats>& stats, double total) const;
+  void writeTrace() const;
+
+  static GraphProfiler* instance_;
+
+  // events beyond this are not kept for the trace, the summary still counts them
+  const size_t maxEvents_{2000000};
+
+  std::string traceFile_;
+  size_t topN_;
+  Clock::time_point origin_;
+
+  std::map<std::string, Stats> byOperator_;  // "forward/backward type shape"
+  std::map<std::string, Stats> byPrefix_;
+  std::vector<Event> events_;
+  bool finished_{false};
+  std::mutex mutex_;
+};
+
+// Memory statistics of the graph workspaces (--memory-stats). When enabled, every graph attributes
+// the allocations of its workspace to node types and name prefixes, and logs the statistics of its
+// allocator (see AllocatorStats) with the attribution at the peak when it is destroyed. The
+// statistics without attribution are always available from ExpressionGraph::memoryStats().
+class GraphMemoryStats {
+public:
+  static void enable(size_t topN);
+  static bool enabled() { return enabled_; }
+
+  // Allocator tag of a node's value or gradient: "type<tab>prefix"
+  static std::string tagOf(const Expr& node, bool gradient);
+
+  static void log(const std::string& title, const AllocatorStats& stats);
+
+private:
+  static bool enabled_;
+  static size_t topN_;
+};
+
+}  // namespace marian
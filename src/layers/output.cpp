@@ -2,6 +2,7 @@
 #include "common/timer.h"
 #include "data/factored_vocab.h"
 #include "layers/loss.h"
+#include "tensors/cpu/intgemm_interface.h"
 
 namespace marian {
 namespace mlp {
@@ -78,11 +79,16 @@ Logits Output::applyAsLogits(Expr input) /*override final*/ {
 
     Expr ret;
 
-    if (b) {
+    if (b && W->value_type() != Type::int8) {
       // original shortlist. W always has 1 for beam & batch
       ABORT_UNLESS(!shortlist_->isDynamic(), "affineShortlist. Bias not supported with LSH/dynamic shortlist"); // todo rename ABORT_UNLESS to ASSERT
       ret = affine(x, W, b, transA, transB);
     }
+    else if (W->value_type() == Type::int8) {
+      // short-listed rows of the pre-quantized output embeddings, see lazyConstruct()
+      ABORT_IF(transA || !transB, "affineShortlist. Int8 output embeddings require transA==0 and transB==1");
+      ret = cpu::integer::dotInt8(x, W, b, /*scale=*/1.f);
+    }
     else if (shortlist_->isDynamic()) {
       // LSH produces W entry for each beam and batch => need bdot()
       ABORT_IF(!(!transA && transB), "affineShortlist. Only tested with transA==0 and transB==1");
@@ -98,6 +104,11 @@ Logits Output::applyAsLogits(Expr input) /*override final*/ {
   };
 
   if(shortlist_) {
+    // int8 product with short-listed rows of output embeddings that are quantized once per model
+    if(options_->get<bool>("int8-activations", false) && graph_->isInference()
+       && graph_->getDeviceId().type == DeviceType::cpu && !factoredVocab_
+       && !shortlist_->isDynamic() && !isLegacyUntransposedW && isFloat(Wt_->value_type()))
+      shortlist_->setQuantizedWeights(cpu::integer::quantizeRowsInt8(Wt_));
     shortlist_->filter(input, Wt_, isLegacyUntransposedW, b_, lemmaEt_);
   }
 
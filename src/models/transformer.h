@@ -12,6 +12,7 @@
 #include "models/states.h"
 #include "models/transformer_factory.h"
 #include "rnn/constructors.h"
+#include "tensors/cpu/intgemm_interface.h"
 #define _USE_MATH_DEFINES  // enables math constants. We need M_PI_2
 #include <math.h>
 
@@ -249,7 +250,10 @@ public:
 
     // multiplicative attention with flattened softmax
     float scale = 1.0f / std::sqrt((float)dk); // scaling to avoid extreme values due to matrix multiplication
-    auto z = bdot_legacy(q, k, false, true, scale); // [-4: beam depth * batch size, -3: num heads, -2: max tgt length, -1: max src length]
+    // both products with on-line int8 quantization of the activations
+    bool int8 = inference_ && opt<bool>("int8-activations", false) && graph_->getDeviceId().type == DeviceType::cpu;
+    auto z = int8 ? cpu::integer::bdotInt8(q, k, false, true, scale)
+                  : bdot_legacy(q, k, false, true, scale); // [-4: beam depth * batch size, -3: num heads, -2: max tgt length, -1: max src length]
 
     // mask out garbage beyond end of sequences
     z = z + mask;
@@ -264,7 +268,8 @@ public:
     weights = dropout(weights, inference_ ? 0 : opt<float>("transformer-dropout-attention"));
 
     // apply attention weights to values
-    auto output = bdot_legacy(weights, v);   // [-4: beam depth * batch size, -3: num heads, -2: max tgt length, -1: split vector dim]
+    auto output = int8 ? cpu::integer::bdotInt8(weights, v, false, false, 1.f)
+                       : bdot_legacy(weights, v);   // [-4: beam depth * batch size, -3: num heads, -2: max tgt length, -1: split vector dim]
 
     return output;
   }
@@ -283,7 +288,12 @@ public:
     auto Wq = graph_->param(prefix + "_Wq", {dimModel, dimModel}, inits::glorotUniform(true, true, depthScaling_ ? 1.f / sqrtf((float)depth_) : 1.f));
     auto bq = graph_->param(prefix + "_bq", {       1, dimModel}, inits::zeros());
     auto qh = affine(q, Wq, bq);
-    qh = SplitHeads(qh, dimHeads); // [-4: beam depth * batch size, -3: num heads, -2: max length, -1: split vector dim]
+
+    // the fused CPU kernel works on joined heads and does not produce attention weights
+    bool fused = inference_ && opt<bool>("fused-attention", false) && !saveAttentionWeights
+                 && graph_->getDeviceId().type == DeviceType::cpu;
+    if(!fused)
+      qh = SplitHeads(qh, dimHeads); // [-4: beam depth * batch size, -3: num heads, -2: max length, -1: split vector dim]
 
     Expr kh;
     // Caching transformation of the encoder that should not be created again.
@@ -300,7 +310,8 @@ public:
       auto bk = graph_->param(prefix + "_bk", {1,        dimModel}, inits::zeros());
 
       kh = affine(keys, Wk, bk);     // [-4: beam depth, -3: batch size, -2: max length, -1: vector dim]
-      kh = SplitHeads(kh, dimHeads); // [-4: batch size, -3: num heads, -2: max length, -1: split vector dim]
+      if(!fused)
+        kh = SplitHeads(kh, dimHeads); // [-4: batch size, -3: num heads, -2: max length, -1: split vector dim]
       if (cache) cache_result.first->second = kh;
     }
 
@@ -315,17 +326,22 @@ public:
       auto bv = graph_->param(prefix + "_bv", {1,        dimModel}, inits::zeros());
 
       vh = affine(values, Wv, bv); // [-4: batch size, -3: num heads, -2: max length, -1: split vector dim]
-      vh = SplitHeads(vh, dimHeads);
+      if(!fused)
+        vh = SplitHeads(vh, dimHeads);
       if (cache) cache_result.first->second = vh;
     }
 
     int dimBeam = q->shape()[-4];
 
-    // apply multi-head attention to downscaled inputs
-    auto output
-        = Attention(prefix, qh, kh, vh, mask, saveAttentionWeights, dimBeam); // [-4: beam depth * batch size, -3: num heads, -2: max length, -1: split vector dim]
-
-    output = JoinHeads(output, dimBeam); // [-4: beam depth, -3: batch size, -2: max length, -1: vector dim]
+    Expr output;
+    if(fused) {
+      float scale = 1.0f / std::sqrt((float)(dimModel / dimHeads));
+      output = fusedAttention(qh, kh, vh, mask, dimHeads, scale); // [-4: beam depth, -3: batch size, -2: max length, -1: vector dim]
+    } else {
+      // apply multi-head attention to downscaled inputs
+      output = Attention(prefix, qh, kh, vh, mask, saveAttentionWeights, dimBeam); // [-4: beam depth * batch size, -3: num heads, -2: max length, -1: split vector dim]
+      output = JoinHeads(output, dimBeam); // [-4: beam depth, -3: batch size, -2: max length, -1: vector dim]
+    }
 
     int dimAtt = output->shape()[-1];
 
@@ -677,6 +693,7 @@ private:
         "dim", dimTrgVoc,
         "vocab", opt<std::vector<std::string>>("vocabs")[batchIndex_], // for factored outputs
         "output-omit-bias", opt<bool>("output-omit-bias", false),
+        "int8-activations", opt<bool>("int8-activations", false),
         "output-approx-knn", opt<std::vector<int>>("output-approx-knn", {}),
         "lemma-dim-emb", opt<int>("lemma-dim-emb", 0), // for factored outputs
         "lemma-dependency", opt<std::string>("lemma-dependency", ""), // for factored outputs
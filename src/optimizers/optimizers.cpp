@@ -3,6 +3,7 @@
 #include "common/io.h"
 #include "tensors/tensor_operators.h"
 #include <array>
+#include <cmath>
 
 namespace marian {
 
@@ -397,38 +398,141 @@ void Adam::updateImpl(Tensor params, Tensor grads, size_t actualMBSize) {
   denom1_ = (beta1 * denom1_) + (1 - beta1); // momentum smoothing
   denom2_ = (beta2 * denom2_) + (1 - beta2); // RMS normalization
 
-  // numerators. Divide by T to convert ce-sum gradient to avg gradient.
-  using namespace functional;
-#if 0 // why the division by T or T^2 here? It's T=1 without mb-ref anyway and we have the adjustment above, also converges a lot(!) slower with T != 1
-  Element(_1 = ((float)beta1 * _1) + float((1 - beta1) / T    ) *  _2,       mt_, grads); // momentum smoothing. At steady state: =smoothed avg gradient
-  Element(_1 = ((float)beta2 * _1) + float((1 - beta2) / T / T) * (_2 * _2), vt_, grads); // RMS normalization.  At steady state: =mean square of the avg gradients
-#else
-  Element(_1 = ((float)beta1 * _1) + float((1 - beta1)) *  _2,       mt_, grads); // momentum smoothing. At steady state: =smoothed avg gradient
-  Element(_1 = ((float)beta2 * _1) + float((1 - beta2)) * (_2 * _2), vt_, grads); // RMS normalization.  At steady state: =mean square of the avg gradients
-#endif
-
   // make sure eps_ does not drop below minimum value, this is important
   // when training with mixed precision. Otherwise we divide by 0.
   // We multiply the minimum by 2 in order to step away from the abyss.
   eps_ = std::max(NumericLimits<float>(params->type()).min * 2.f, eps_);
 
-  // make sure eps_ does not drop below minimum value, this is important
-  // when training with mixed precision. Otherwise we divide by 0.
-  // We multiply the minimum by 2 in order to step away from the abyss.
-  eps_ = std::max(NumericLimits<float>(params->type()).min * 2.f, eps_);
+  updates_++;
 
-  // apply Adam normalization
   float etaf = (float)eta, denom1f = (float)denom1_, denom2f = (float)denom2_, decayf = (float)decay; // (get casts out of Element expression for readability)
+  if(!sparseRows_.empty() && params->getBackend()->getDeviceId().type == DeviceType::cpu && params->type() == Type::float32) {
+    updateLazy(params, grads, etaf, denom1f, denom2f, decayf);
+  } else {
+    if(!sparseRows_.empty())
+      LOG_ONCE(warn, "[optimizers] Lazy row-wise updates are only implemented for float32 parameters on the CPU, using dense updates");
+    updateDense(params, grads, 0, params->size(), etaf, denom1f, denom2f, decayf);
+  }
+}
+
+void Adam::updateDense(Tensor params, Tensor grads, size_t begin, size_t end, float etaf, float denom1f, float denom2f, float decayf) {
+  if(begin >= end)
+    return;
+
+  // operate on views if only a part of the shard is updated
+  Tensor mt = mt_, vt = vt_;
+  if(begin != 0 || end != params->size()) {
+    params = params->subtensor(begin, end - begin);
+    grads  = grads->subtensor(begin, end - begin);
+    mt     = mt_->subtensor(begin, end - begin);
+    vt     = vt_->subtensor(begin, end - begin);
+  }
+
+  // numerators. Gradients are not divided by the mini-batch size here, see the learning-rate adjustment in updateImpl().
+  using namespace functional;
+  Element(_1 = (beta1_ * _1) + (1.f - beta1_) *  _2,       mt, grads); // momentum smoothing. At steady state: =smoothed avg gradient
+  Element(_1 = (beta2_ * _1) + (1.f - beta2_) * (_2 * _2), vt, grads); // RMS normalization.  At steady state: =mean square of the avg gradients
+
+  // apply Adam normalization
   Element(_1 -= etaf                               // learning-rate: x_t = x_{t-1} - \eta * (...)
                 * ((  (     _2 / denom1f)          // momentum-smoothed per-sample gradient: m_{t-1}
                     / (sqrt(_3 / denom2f) + eps_)) // normalize by RMS: \sqrt(v_{t-1})
                    + (decayf * _1)),                 // weight-decay: w * x_{t-1}
           params,  // =_1
-          mt_,     // =_2
-          vt_      // =_3
+          mt,      // =_2
+          vt       // =_3
           );
 }
 
+// Lazy Adam for row-sparse gradients, e.g. embeddings where only the rows of words in the batch
+// receive a gradient. Rows without gradient are skipped. When a row is updated again after d skipped
+// updates, its moments are first decayed by beta^d and weight decay is applied d times, so the moments
+// match what dense Adam would have computed. Only the parameter movement during skipped updates,
+// which dense Adam would have caused from the decaying momentum, is dropped.
+void Adam::updateLazy(Tensor params, Tensor grads, float etaf, float denom1f, float denom2f, float decayf) {
+  int64_t size = (int64_t)params->size();
+  if(lastRowUpdates_.size() != sparseRows_.size()) {
+    size_t totalRows = 0;
+    for(const auto& matrix : sparseRows_)
+      totalRows += matrix.rows;
+    ABORT_IF(!rowLag_.empty() && rowLag_.size() != totalRows,
+             "adam_row_lag has {} rows, but the row-sparse matrices have {} rows",
+             rowLag_.size(),
+             totalRows);
+
+    lastRowUpdates_.resize(sparseRows_.size());
+    size_t firstRow = 0; // of the current matrix among the rows of all matrices
+    for(size_t k = 0; k < sparseRows_.size(); ++k) {
+      const auto& matrix = sparseRows_[k];
+      lastRowUpdates_[k].assign(matrix.rows, updates_ - 1); // all rows up-to-date
+      // unless loaded from a checkpoint that recorded the updates these rows had missed
+      if(!rowLag_.empty())
+        for(size_t r = 0; r < matrix.rows; ++r)
+          lastRowUpdates_[k][r] -= (size_t)rowLag_[firstRow + r];
+      firstRow += matrix.rows;
+    }
+    rowLag_.clear();
+  }
+
+  float* x = params->data<float>();
+  float* g = grads->data<float>();
+  float* m = mt_->data<float>();
+  float* v = vt_->data<float>();
+
+  size_t skipped = 0, total = 0;
+  int64_t denseBegin = 0; // start of the current dense region between matrices
+  for(size_t k = 0; k < sparseRows_.size(); ++k) {
+    const auto& matrix = sparseRows_[k];
+    int64_t matrixBegin = std::max((int64_t)0, matrix.offset);
+    int64_t matrixEnd   = std::min(size, matrix.offset + (int64_t)(matrix.rows * matrix.cols));
+    if(matrixBegin >= matrixEnd)
+      continue;
+
+    updateDense(params, grads, (size_t)denseBegin, (size_t)matrixBegin, etaf, denom1f, denom2f, decayf);
+    denseBegin = matrixEnd;
+
+    for(size_t r = 0; r < matrix.rows; ++r) {
+      // clip the row to the shard, matrices can start or end in a neighboring shard
+      int64_t rowBegin = std::max(matrixBegin, matrix.offset + (int64_t)(r * matrix.cols));
+      int64_t rowEnd   = std::min(matrixEnd,   matrix.offset + (int64_t)((r + 1) * matrix.cols));
+      if(rowBegin >= rowEnd)
+        continue;
+      total++;
+
+      bool touched = false;
+      for(int64_t i = rowBegin; i < rowEnd && !touched; ++i)
+        touched = g[i] != 0.f;
+      if(!touched) {
+        skipped++;
+        continue;
+      }
+
+      // catch up on the updates this row has missed
+      size_t missed = updates_ - lastRowUpdates_[k][r] - 1;
+      lastRowUpdates_[k][r] = updates_;
+      if(missed > 0) {
+        float decay1 = std::pow(beta1_, (float)missed);
+        float decay2 = std::pow(beta2_, (float)missed);
+        float shrink = std::pow(1.f - etaf * decayf, (float)missed);
+        for(int64_t i = rowBegin; i < rowEnd; ++i) {
+          m[i] *= decay1;
+          v[i] *= decay2;
+          x[i] *= shrink;
+        }
+      }
+
+      for(int64_t i = rowBegin; i < rowEnd; ++i) {
+        m[i] = beta1_ * m[i] + (1.f - beta1_) * g[i];
+        v[i] = beta2_ * v[i] + (1.f - beta2_) * g[i] * g[i];
+        x[i] -= etaf * ((m[i] / denom1f) / (std::sqrt(v[i] / denom2f) + eps_) + decayf * x[i]);
+      }
+    }
+  }
+  updateDense(params, grads, (size_t)denseBegin, (size_t)size, etaf, denom1f, denom2f, decayf);
+
+  LOG(debug, "[optimizers] Lazy Adam skipped {} of {} embedding rows", skipped, total);
+}
+
 void Adam::load(std::vector<io::Item>& items,
                 const std::vector<Ptr<OptimizerBase>>& opts,
                 const std::vector<Ptr<Backend>>& backends,
@@ -441,7 +545,9 @@ void Adam::load(std::vector<io::Item>& items,
 
   io::Item iMt;
   io::Item iVt;
+  io::Item iLag;
   std::array<double, 2> vDenoms;
+  double updates = 0;
 
   for(auto item : items) {
     // extract data into vectors
@@ -453,6 +559,11 @@ void Adam::load(std::vector<io::Item>& items,
       ABORT_IF(item.size() != 2 * sizeof(double), "adam_denoms should have 2 entries not {} bytes", item.size());
       std::copy((double*)item.data(), ((double*)item.data()) + 2, vDenoms.begin());
       // Back compat note: Old files lacked "adam_denoms". For those, vDenoms will remain 0, which reproduces the old behavior.
+    } else if(item.name == "adam_updates") {
+      ABORT_IF(item.size() != sizeof(double), "adam_updates should have 1 entry not {} bytes", item.size());
+      updates = *(double*)item.data();
+    } else if(item.name == "adam_row_lag") {
+      iLag = std::move(item);
     }
   }
 
@@ -475,6 +586,8 @@ void Adam::load(std::vector<io::Item>& items,
       // denominators need to be set in all shards, hijack this scatter
       opt->denom1_ = vDenoms[0];
       opt->denom2_ = vDenoms[1];
+      opt->updates_ = (size_t)updates;
+      opt->lastRowUpdates_.clear();
 
       if(!opt->mt_ || !opt->vt_) { // lazily allocate
         if(!opt->alloc_)
@@ -493,6 +606,20 @@ void Adam::load(std::vector<io::Item>& items,
       auto opt = std::dynamic_pointer_cast<Adam>(opts[localDeviceIndex]);
       opt->vt_->set(begin, end, iVt.type);
     });
+
+  // lazy updates: missed updates per row, absent in checkpoints saved without lazy updates
+  // One value per row of the row-sparse matrices, which every shard knows about. Each shard hence
+  // receives all of them, the number of rows is checked against the matrices at the first lazy update.
+  if(!iLag.bytes.empty()) {
+    ABORT_IF(iLag.type != Type::float32 || iLag.shape.size() != 1
+             || iLag.size() != iLag.shape.elements() * sizeof(float),
+             "adam_row_lag should have shape [rows] and type float32, not {} of type {}",
+             iLag.shape,
+             iLag.type);
+    const float* lag = (const float*)iLag.data();
+    for(auto opt : opts)
+      std::dynamic_pointer_cast<Adam>(opt)->rowLag_.assign(lag, lag + iLag.shape.elements());
+  }
 }
 
 void Adam::save(std::vector<io::Item>& items,
@@ -525,6 +652,39 @@ void Adam::save(std::vector<io::Item>& items,
 
   std::vector<double> vDenoms{denom1_, denom2_};
   items.emplace_back(io::fromVector(vDenoms, "adam_denoms"));
+
+  // lazy updates: for each row of the row-sparse matrices, the number of updates that row has missed
+  // so far. The lazy path runs on the CPU only, where all shards live in this process, hence the
+  // rows are collected from the local shards. A row that spans two shards is taken from the shard
+  // that holds its first element.
+  bool lazy = false;
+  for(auto opt : opts)
+    lazy |= !std::dynamic_pointer_cast<Adam>(opt)->lastRowUpdates_.empty();
+  if(lazy) {
+    std::vector<float> rowLag;
+    for(auto base : opts) {
+      auto opt = std::dynamic_pointer_cast<Adam>(base);
+      if(opt->lastRowUpdates_.empty())
+        continue;
+      int64_t size = (int64_t)opt->mt_->size();
+      size_t firstRow = 0;
+      for(size_t k = 0; k < opt->sparseRows_.size(); ++k) {
+        const auto& matrix = opt->sparseRows_[k];
+        rowLag.resize(std::max(rowLag.size(), firstRow + matrix.rows), 0.f);
+        for(size_t r = 0; r < matrix.rows; ++r) {
+          int64_t rowBegin = matrix.offset + (int64_t)(r * matrix.cols);
+          if(rowBegin >= 0 && rowBegin < size)
+            rowLag[firstRow + r] = (float)(opt->updates_ - opt->lastRowUpdates_[k][r]);
+        }
+        firstRow += matrix.rows;
+      }
+    }
+    auto lag = io::fromVector(rowLag, "adam_row_lag");
+    lag.shape = Shape({(int)rowLag.size()});
+    items.emplace_back(std::move(lag));
+  }
+
+  items.emplace_back(io::fromVector(std::vector<double>{(double)updates_}, "adam_updates"));
 }
 
 void Adam::resetStats() {
@@ -536,6 +696,9 @@ void Adam::resetStats() {
 
   denom1_ = 0; // @BUGBUG: or 1 or refMBWords if so specified. Fix once we have proper parameterization for that.
   denom2_ = 0;
+
+  lastRowUpdates_.clear(); // moments are zero, nothing to catch up on
+  rowLag_.clear();
 }
 
 Ptr<OptimizerBase> Optimizer(Ptr<Options> options) {
@@ -14,6 +14,17 @@
 
 namespace marian {
 
+/**
+ * Row-major matrix parameter (e.g. an embedding) that lies within an optimizer shard.
+ * 'offset' is the position of its first element relative to the start of the shard and
+ * can be negative if the matrix starts in a previous shard.
+ */
+struct SparseRows {
+  int64_t offset;
+  size_t rows;
+  size_t cols;
+};
+
 /**
  * Base class for optimizers.
  */
@@ -115,6 +126,10 @@ public:
   // Usually we will call this twice, to swap in and to swap out.
   void swapWithSmoothed(Tensor params);
 
+  // Declare matrices in the shard whose gradients are expected to be row-sparse. Optimizers that
+  // support it update these row by row and skip rows without gradient, others ignore this.
+  void setSparseRows(const std::vector<SparseRows>& sparseRows) { sparseRows_ = sparseRows; }
+
   // return stateful optimizer shards, for base that's only averaged parameters
   virtual std::vector<Tensor> getShards() { 
     if(avg_)
@@ -146,6 +161,8 @@ protected:
 
   Tensor pm_;
   Tensor gd_;
+
+  std::vector<SparseRows> sparseRows_; // row-sparse matrices within this shard, see setSparseRows()
 };
 
 /**
@@ -246,6 +263,11 @@ private:
   void updateImpl(Tensor params, Tensor grads, size_t actualMBSize) override;
   void resetStats() override;
 
+  // dense update of the elements [begin, end) of the shard
+  void updateDense(Tensor params, Tensor grads, size_t begin, size_t end, float eta, float denom1, float denom2, float decay);
+  // lazy row-wise update of the rows in sparseRows_, dense update of everything in-between
+  void updateLazy(Tensor params, Tensor grads, float eta, float denom1, float denom2, float decay);
+
   // Adam parameters:
   // [beta1, beta2, eps, w, refMBWords]
   virtual void setParams(const std::vector<float>& params) override {
@@ -275,6 +297,13 @@ private:
   Ptr<TensorAllocator> alloc_;
   Tensor mt_;
   Tensor vt_;
+
+  // lazy updates: number of updates so far and, per row in sparseRows_, the update that last touched it
+  size_t updates_{0};
+  std::vector<std::vector<size_t>> lastRowUpdates_;
+  // per row of all matrices in sparseRows_, the updates it had missed when the checkpoint was saved.
+  // Restored into lastRowUpdates_ at the first lazy update after loading.
+  std::vector<float> rowLag_;
 };
 
 Ptr<OptimizerBase> Optimizer(Ptr<Options> options);
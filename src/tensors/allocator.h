@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
+#include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -78,6 +81,31 @@ public:
   Gap rest(size_t offset) const { return Gap(data_ + offset, size_ - offset); }
 };
 
+// Usage statistics of an Allocator. A step ends with clear(), e.g. when a graph is cleared for the
+// next batch. Fragmentation is the part of the free memory that is not in the largest gap, i.e.
+// that a single allocation of all free memory could not use.
+struct AllocatorStats {
+  size_t reserved{0};       // bytes of the underlying device memory
+  size_t inUse{0};          // bytes currently allocated
+  size_t peak{0};           // high-water mark of inUse since the allocator was created
+  size_t free{0};           // bytes in gaps
+  size_t largestGap{0};
+  size_t gaps{0};
+  size_t grows{0};          // re-allocations because the reserved memory was exhausted
+  size_t grownBytes{0};
+  size_t failures{0};       // allocations that threw because of throwAtReallocation()
+  size_t allocations{0};
+  size_t steps{0};
+  size_t stepAllocations{0};     // allocations in the current step
+  size_t maxStepAllocations{0};  // most allocations in a single step
+  size_t stepPeak{0};            // high-water mark of inUse in the current step
+
+  // bytes at the peak by the tag given to Allocator::setTag(), if tracking was enabled
+  std::map<std::string, size_t> peakByTag;
+
+  double fragmentation() const { return free > 0 ? 1.0 - (double)largestGap / free : 0.0; }
+};
+
 class Allocator {
 private:
   Ptr<Device> device_;
@@ -90,8 +118,28 @@ private:
   std::set<Gap> gaps_;
   std::unordered_map<uint8_t*, MemoryPiece::PtrType> allocated_;
 
+  AllocatorStats stats_;
+
+  // attribution of allocated bytes to tags, only if enabled with trackTags()
+  bool trackTags_{false};
+  std::string tag_;
+  std::unordered_map<uint8_t*, std::string> tags_;
+  std::map<std::string, size_t> bytesByTag_;
+
+  void updatePeak() {
+    size_t inUse = device_->size() - available_;
+    stats_.stepPeak = std::max(stats_.stepPeak, inUse);
+    if(inUse > stats_.peak) {
+      stats_.peak = inUse;
+      if(trackTags_)
+        stats_.peakByTag = bytesByTag_;
+    }
+  }
+
   void grow(size_t add) {
     add = alignedSize(add);
+    stats_.grows++;
+    stats_.grownBytes += add;
     uint8_t* oldData = device_->data();
     size_t oldSize = device_->size();
 
@@ -107,19 +155,38 @@ private:
 
     std::unordered_map<uint8_t*, MemoryPiece::PtrType> oldAllocated;
     allocated_.swap(oldAllocated);
+    std::unordered_map<uint8_t*, std::string> oldTags;
+    tags_.swap(oldTags);
     for(auto it : oldAllocated) {
       uint8_t* newPtr = device_->data() + std::distance(oldData, it.first);
       allocated_[newPtr] = oldAllocated[it.first];
       allocated_[newPtr]->setPtr(newPtr);
+      auto tag = oldTags.find(it.first);
+      if(tag != oldTags.end())
+        tags_[newPtr] = std::move(tag->second);
     }
   }
 
+  void untag(uint8_t* ptr, size_t bytes) {
+    auto it = tags_.find(ptr);
+    if(it == tags_.end())
+      return;
+    auto count = bytesByTag_.find(it->second);
+    if(count != bytesByTag_.end()) {
+      count->second -= std::min(count->second, bytes);
+      if(count->second == 0)
+        bytesByTag_.erase(count);
+    }
+    tags_.erase(it);
+  }
+
   Gap getGap(size_t size) {
     size = alignedSize(size);
     auto it = std::lower_bound(gaps_.begin(), gaps_.end(), Gap(nullptr, size));
 
     if(throw_ && it == gaps_.end()) {
       //ABORT("Trying to allocate {}, but only {} available.", available_, size);
+      stats_.failures++;
       throw AllocationException(available_, size);
     }
 
@@ -210,6 +277,15 @@ public:
     auto ptr = gap.data();
     auto mp = MemoryPiece::New(ptr, bytes);
     allocated_[ptr] = mp;
+
+    stats_.allocations++;
+    stats_.stepAllocations++;
+    stats_.maxStepAllocations = std::max(stats_.maxStepAllocations, stats_.stepAllocations);
+    if(trackTags_) {
+      tags_[ptr] = tag_;
+      bytesByTag_[tag_] += bytes;
+    }
+    updatePeak();
     return mp;
   }
 
@@ -225,6 +301,8 @@ public:
     if(it != allocated_.end()) {
       allocated_.erase(ptr);
       insertGap(Gap(ptr, bytes), true);
+      if(trackTags_)
+        untag(ptr, bytes);
       return true;
     }
     return false;
@@ -243,6 +321,12 @@ public:
     gaps_.clear();
     allocated_.clear();
     insertGap({device_->data(), device_->size()}, false);
+
+    tags_.clear();
+    bytesByTag_.clear();
+    stats_.steps++;
+    stats_.stepAllocations = 0;
+    stats_.stepPeak = 0;
   }
 
   MemoryPiece::PtrType memory() {
@@ -254,5 +338,30 @@ public:
   size_t available() { return available_; }
 
   DeviceId getDeviceId() { return device_->getDeviceId(); }
+
+  AllocatorStats stats() const {
+    AllocatorStats stats = stats_;
+    stats.reserved = device_->size();
+    stats.inUse = device_->size() - available_;
+    stats.free = available_;
+    stats.largestGap = gaps_.empty() ? 0 : gaps_.rbegin()->size();  // gaps are ordered by size
+    stats.gaps = gaps_.size();
+    return stats;
+  }
+
+  // Attributes the bytes of subsequent allocations to the tag given with setTag(), until it changes.
+  // The bytes per tag at the peak are then part of stats().
+  void trackTags(bool track) {
+    trackTags_ = track;
+    if(!track) {
+      tags_.clear();
+      bytesByTag_.clear();
+    }
+  }
+
+  void setTag(const std::string& tag) { tag_ = tag; }
+
+  // Bytes currently allocated by tag
+  const std::map<std::string, size_t>& bytesByTag() const { return bytesByTag_; }
 };
 }  // namespace marian
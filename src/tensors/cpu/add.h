@@ -10,6 +10,7 @@
 #include "functional/tensor.h"
 #include "functional/tmp.h"
 #include "tensors/tensor.h"
+#include "tensors/cpu/element.h"
 
 namespace marian {
 
@@ -31,15 +32,20 @@ void gAggregateGeneric(Functor functor, float aggInit, AggFunctor aggFunctor,
   for(int i = 0; i < N; ++i)
     len[i] = full[i] / out.shape()[i];
 
-  functional::Array<int, N> dims;
-  for(int index = 0; index < outLength; ++index) {
-    if(same) {
-      out[index] = aggFunctor(out[index], functional::apply(functor, ins, index) * scale);
-    } else {
-      out.shape().dims(index, dims);
-      out[index] = aggFunctor(out[index], functional::loops(functor, aggInit, aggFunctor, ins, len, dims) * scale);
+  // every output element is reduced by exactly one thread
+  size_t grain = std::max(ELEMENT_GRAIN * outLength / std::max(full.elements(), 1), (size_t)1);
+  parallelFor(outLength, grain, [&](size_t begin, size_t end) {
+    auto localIns = ins;
+    functional::Array<int, N> dims;
+    for(int index = (int)begin; index < (int)end; ++index) {
+      if(same) {
+        out[index] = aggFunctor(out[index], functional::apply(functor, localIns, index) * scale);
+      } else {
+        out.shape().dims(index, dims);
+        out[index] = aggFunctor(out[index], functional::loops(functor, aggInit, aggFunctor, localIns, len, dims) * scale);
+      }
     }
-  }
+  });
 }
 
 template <size_t K, class Functor, class AggFunctor>
@@ -49,22 +55,30 @@ void gAggregateEqual(Functor functor, AggFunctor aggFunctor,
                float scale,
                bool broadcast) {
   int length = out.shape().elements();
-  functional::Array<int, functional::Shape::size()> dims;
 
-  for(int index = 0; index < length; ++index) {
-    functional::Array<int, K> indices;
-    indices.fill(index);
+  parallelFor(length, ELEMENT_GRAIN, [&](size_t begin, size_t end) {
+    auto localIns = ins;
+    functional::Array<int, functional::Shape::size()> dims;
+    for(int index = (int)begin; index < (int)end; ++index) {
+      functional::Array<int, K> indices;
+      indices.fill(index);
 
-    if(broadcast) {
-      out.shape().dims(index, dims);
-      for(size_t i = 0; i < K; ++i)
-        indices[i] = ins[i].shape().bindex(dims);
-    }
+      if(broadcast) {
+        out.shape().dims(index, dims);
+        for(size_t i = 0; i < K; ++i)
+          indices[i] = localIns[i].shape().bindex(dims);
+      }
 
-    out[index] = aggFunctor(out[index], functional::apply(functor, ins, indices) * scale);
-  }
+      out[index] = aggFunctor(out[index], functional::apply(functor, localIns, indices) * scale);
+    }
+  });
 }
 
+// Rows longer than twice this many columns are reduced in fixed chunks of columns in parallel,
+// the chunks of a row are then combined in order. The chunking does not depend on the number of
+// threads, hence neither does the result.
+const int AGGREGATE_CHUNK = 1 << 14;
+
 template <size_t K, class Functor, class AggFunctor>
 void gAggregateReduce(Functor functor, float aggInit, AggFunctor aggFunctor,
                 const functional::Shape full,
@@ -78,21 +92,51 @@ void gAggregateReduce(Functor functor, float aggInit, AggFunctor aggFunctor,
   for(size_t i = 0; i < K; ++i)
     same = same && ins[i].shape().elements() == full.elements();
 
-  for(int j = 0; j < rows; ++j) {
+  int chunks = cols >= 2 * AGGREGATE_CHUNK ? (cols + AGGREGATE_CHUNK - 1) / AGGREGATE_CHUNK : 1;
+  int chunkCols = (cols + chunks - 1) / chunks;
+
+  // reduces columns [begin, end) of row j
+  auto reduce = [&](functional::Array<functional::Tensor<float>, K>& localIns, int j, int begin, int end) {
     float colSum = aggInit;
     if(same) {
-      for(int id = 0; id < cols; ++id)
-        colSum = aggFunctor(colSum, functional::apply(functor, ins, j * cols + id));
+      for(int id = begin; id < end; ++id)
+        colSum = aggFunctor(colSum, functional::apply(functor, localIns, j * cols + id));
     } else {
       functional::Array<int, functional::Shape::size()> dims;
-      for(int id = 0; id < cols; ++id) {
+      for(int id = begin; id < end; ++id) {
         full.dims(j * cols + id, dims);
         functional::Array<int, K> indices;
         for(size_t i = 0; i < K; ++i)
-          indices[i] = ins[i].shape().bindex(dims);
-        colSum = aggFunctor(colSum, functional::apply(functor, ins, indices));
+          indices[i] = localIns[i].shape().bindex(dims);
+        colSum = aggFunctor(colSum, functional::apply(functor, localIns, indices));
       }
     }
+    return colSum;
+  };
+
+  if(chunks == 1) {
+    size_t grain = std::max(ELEMENT_GRAIN / std::max(cols, 1), (size_t)1);
+    parallelFor(rows, grain, [&](size_t begin, size_t end) {
+      auto localIns = ins;
+      for(int j = (int)begin; j < (int)end; ++j)
+        out[j] = aggFunctor(out[j], reduce(localIns, j, 0, cols) * scale);
+    });
+    return;
+  }
+
+  std::vector<float> partials((size_t)rows * chunks);
+  parallelFor(partials.size(), 1, [&](size_t begin, size_t end) {
+    auto localIns = ins;
+    for(size_t item = begin; item < end; ++item) {
+      int j = (int)(item / chunks);
+      int c = (int)(item % chunks);
+      partials[item] = reduce(localIns, j, c * chunkCols, std::min(cols, (c + 1) * chunkCols));
+    }
+  });
+  for(int j = 0; j < rows; ++j) {
+    float colSum = aggInit;
+    for(int c = 0; c < chunks; ++c)
+      colSum = aggFunctor(colSum, partials[(size_t)j * chunks + c]);
     out[j] = aggFunctor(out[j], colSum * scale);
   }
 }
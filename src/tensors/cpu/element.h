@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tensors/tensor.h"
+#include "tensors/cpu/parallel.h"
 
 namespace marian {
 namespace cpu {
@@ -61,42 +62,137 @@ struct E<F::Shape::size()> {
   }
 };
 
+// minimum number of floats per thread when splitting element-wise operations
+const size_t ELEMENT_GRAIN = 1 << 14;
+
 template <typename ElementType, class Functor, class... Tensors>
 void element(const Functor& functor, marian::Tensor out, Tensors... tensors) {
 
   // Number of input tensors + 1 (output tensor)
   constexpr size_t argNum = sizeof...(tensors) + 1;
+  constexpr size_t N = F::Shape::size();
+
+  F::Array<F::Tensor<ElementType>, argNum> gTensors = {out, tensors...};
+
+  // With multiple threads, the outer dimensions are flattened into rows which are distributed
+  // across threads. Each row then starts the inner-most loop at its own broadcasted indices.
+  const auto& shape = gTensors[0].shape();
+  int cols = shape[N - 1];
+  size_t rows = cols > 0 ? shape.elements() / cols : 0;
+  if(getIntraOpThreads() > 1 && rows > 1) {
+    size_t width = sizeof(ElementType) / sizeof(float);
+    size_t grain = std::max(ELEMENT_GRAIN / (width * cols), (size_t)1);
+    parallelFor(rows, grain, [&](size_t begin, size_t end) {
+      auto localTensors = gTensors;
+      F::Array<int, N> dims;
+      F::Array<int, argNum> indices;
+      for(size_t row = begin; row < end; ++row) {
+        shape.dims((int)row * cols, dims);
+        for(size_t k = 0; k < argNum; ++k)
+          indices[k] = localTensors[k].shape().bindex(dims);
+        E<N - 1>::element(functor, localTensors, indices);
+      }
+    });
+    return;
+  }
+
   // create and initialize indices to 0, one index per tensor
   F::Array<int, argNum> indices;
   indices.fill(0);
 
   // call elementwise operation going from outer-most dimension
   // to inner-most element.
-  F::Array<F::Tensor<ElementType>, argNum> gTensors = {out, tensors...};
   E<0>::element(functor, gTensors, indices);
 }
 
-// Dispatch elementwise functions with float element type based on number of 
-// elements. If dividable by 8 and AVX2 is available (TODO: check this?) use
-// AVX2 specific intrinsics. Similar for 4 and AVX. TODO: Add AVX512 support.
+// Element-wise operation on flat arrays of the same length, indices [begin, end) count ElementType
+// items. Used when no broadcasting is required and all tensors are contiguous blocks of equal size.
+template <typename ElementType, size_t argNum, class Functor>
+void elementFlat(const Functor& functor, const F::Array<float*, argNum>& ptrs, size_t begin, size_t end) {
+  F::Array<F::Tensor<ElementType>, argNum> views;
+  for(size_t k = 0; k < argNum; ++k)
+    views[k] = F::Tensor<ElementType>((ElementType*)ptrs[k] + begin, F::Shape(marian::Shape({(int)(end - begin)})));
+  for(int i = 0; i < (int)(end - begin); ++i)
+    views[0].data()[i] = F::apply(functor, views, i);
+}
+
+// Runs ElementType vectors on the aligned bulk of the arrays and floats on the unaligned head and
+// the tail, the bulk is split across threads. Returns false if the arrays are not equally aligned.
+template <typename ElementType, size_t argNum, class Functor>
+bool elementFlatVectorized(const Functor& functor, const F::Array<float*, argNum>& ptrs, size_t size) {
+  constexpr size_t width = sizeof(ElementType) / sizeof(float);
+  size_t misalignment = (size_t)ptrs[0] % sizeof(ElementType);
+  for(size_t k = 1; k < argNum; ++k)
+    if((size_t)ptrs[k] % sizeof(ElementType) != misalignment)
+      return false;
+
+  size_t head = std::min(misalignment ? (sizeof(ElementType) - misalignment) / sizeof(float) : 0, size);
+  elementFlat<float>(functor, ptrs, 0, head);
+
+  F::Array<float*, argNum> bulk;
+  for(size_t k = 0; k < argNum; ++k)
+    bulk[k] = ptrs[k] + head;
+  size_t vectors = (size - head) / width;
+  parallelFor(vectors, ELEMENT_GRAIN / width, [&](size_t begin, size_t end) {
+    elementFlat<ElementType>(functor, bulk, begin, end);
+  });
+
+  elementFlat<float>(functor, ptrs, head + vectors * width, size);
+  return true;
+}
+
+// Dispatch elementwise functions with float element type. If no broadcasting is required,
+// the tensors are processed as flat arrays with the widest available vector type and a
+// scalar remainder. Otherwise use AVX-512, AVX or SSE intrinsics if the last dimension of
+// all tensors is divisible by 16, 8 or 4 respectively.
 template <class Functor, class... Tensors>
 void elementFloat(const Functor& functor, marian::Tensor out, Tensors... tensors) {
 #ifndef __CUDACC__
   std::vector<marian::Tensor> ts({out, tensors...});
+  bool same = true;
+  bool div16 = true;
   bool div8 = true;
   bool div4 = true;
 
   for(auto t : ts) {
+    if(t->shape() != out->shape())
+      same = false;
+    if(t->shape()[-1] % 16 != 0)
+      div16 = false;
     if(t->shape()[-1] % 8 != 0)
       div8 = false;
-    if(t->shape()[-1] % 4 != 0) {
+    if(t->shape()[-1] % 4 != 0)
       div4 = false;
-      break;
-    }
+  }
+
+  if(same) {
+    constexpr size_t argNum = sizeof...(tensors) + 1;
+    F::Array<float*, argNum> ptrs = {out->data<float>(), tensors->template data<float>()...};
+    size_t size = out->shape().elements();
+#ifdef __AVX512F__
+    if(elementFlatVectorized<float32x16>(functor, ptrs, size))
+      return;
+#endif
+#ifdef __AVX__
+    if(elementFlatVectorized<float32x8>(functor, ptrs, size))
+      return;
+#endif
+    if(elementFlatVectorized<float32x4>(functor, ptrs, size))
+      return;
+    parallelFor(size, ELEMENT_GRAIN, [&](size_t begin, size_t end) {
+      elementFlat<float>(functor, ptrs, begin, end);
+    });
+    return;
+  }
+
+  if(div16) {
+#ifdef __AVX512F__
+    element<float32x16>(functor, out, tensors...);
+    return;
+#endif
   }
 
   if(div8) {
-    // std::cerr << "8: " << functor.to_string() << std::endl;
 #ifdef __AVX__
     element<float32x8>(functor, out, tensors...);
     return;
@@ -104,12 +200,10 @@ void elementFloat(const Functor& functor, marian::Tensor out, Tensors... tensors
   }
 
   if(div4) {
-    // std::cerr << "4: " << functor.to_string() << std::endl;
     element<float32x4>(functor, out, tensors...);
     return;
   }
 #endif
-  // std::cerr << "1: " << functor.to_string() << std::endl;
   element<float>(functor, out, tensors...);
 }
 
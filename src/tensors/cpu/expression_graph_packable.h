@@ -251,6 +251,13 @@ public:
 #else
         ABORT("Packed type {} only supported when compiled with -DCOMPILE_CPU=on", gemmElementType);
 #endif
+      } else if (gemmElementType == Type::bfloat16 &&
+      (pName.find("_W") == pName.length() - 3 || pName.find("_W") == pName.length() - 2)) {
+        // bfloat16 is not packed, the matrix is only stored with half the bits and converted during the product
+        io::Item item;
+        val->get(item, pName);
+        item.convert(Type::bfloat16);
+        ioItems.emplace_back(std::move(item));
       } else {
         ABORT_IF(saveElementType != Type::float32, "We currently do not know how to save matrices as {}", saveElementType);
         io::Item item;
@@ -1,5 +1,8 @@
 #include "integer_common.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace marian {
 namespace cpu {
 namespace integer {
@@ -37,6 +40,68 @@ void AddBias(marian::Tensor C, const marian::Tensor Bias) {
   }
 }
 
+void QuantizeRowsInt8(const float* input, int rows, int cols, bool transposed, int8_t* output, float* quantMults) {
+  auto at = [&](int i, int j) { return transposed ? input[(size_t)j * rows + i] : input[(size_t)i * cols + j]; };
+  for(int i = 0; i < rows; ++i) {
+    float maxAbs = 0.f;
+    for(int j = 0; j < cols; ++j)
+      maxAbs = std::max(maxAbs, std::abs(at(i, j)));
+    float quantMult = maxAbs > 0.f ? 127.f / maxAbs : 0.f;
+    int8_t* row = output + (size_t)i * cols;
+    for(int j = 0; j < cols; ++j)
+      row[j] = (int8_t)std::max(-127.f, std::min(127.f, std::round(at(i, j) * quantMult)));
+    quantMults[i] = maxAbs / 127.f;
+  }
+}
+
+static inline int32_t dotInt8(const int8_t* a, const int8_t* b, int k) {
+  int p = 0;
+  int32_t sum = 0;
+#if defined(__AVX512BW__)
+  __m512i acc = _mm512_setzero_si512();
+  for(; p + 32 <= k; p += 32) {
+    __m512i ai = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(a + p)));
+    __m512i bi = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(b + p)));
+    acc = _mm512_add_epi32(acc, _mm512_madd_epi16(ai, bi)); // pairs of int16 products summed to int32
+  }
+  alignas(64) int32_t part[16];
+  _mm512_store_si512((__m512i*)part, acc);
+  for(int i = 0; i < 16; ++i)
+    sum += part[i];
+#elif defined(__AVX2__)
+  __m256i acc = _mm256_setzero_si256();
+  for(; p + 16 <= k; p += 16) {
+    __m256i ai = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + p)));
+    __m256i bi = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + p)));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(ai, bi));
+  }
+  alignas(32) int32_t part[8];
+  _mm256_store_si256((__m256i*)part, acc);
+  for(int i = 0; i < 8; ++i)
+    sum += part[i];
+#endif
+  for(; p < k; ++p)
+    sum += (int32_t)a[p] * b[p];
+  return sum;
+}
+
+void MultiplyInt8(const int8_t* A, const float* aQuantMults,
+                  const int8_t* B, const float* bQuantMults,
+                  int m, int n, int k,
+                  float scale, const float* bias,
+                  float* C, int ldc) {
+  for(int i = 0; i < m; ++i) {
+    const int8_t* aRow = A + (size_t)i * k;
+    float* cRow = C + (size_t)i * ldc;
+    float aMult = scale * aQuantMults[i];
+    for(int j = 0; j < n; ++j) {
+      cRow[j] = aMult * bQuantMults[j] * (float)dotInt8(aRow, B + (size_t)j * k, k);
+      if(bias)
+        cRow[j] += bias[j];
+    }
+  }
+}
+
 //template void prepareAndTranspose<intgemm8>;//(io::Item& item, const char * input);
 //template void prepareAndTranspose<intgemm16>(io::Item&, const char *);
 
@@ -182,6 +182,20 @@ static inline float computeQuantMult(marian::Tensor val) {
 // This operates on floats after processing so doesn't care about int8_t vs int16_t.
 void AddBias(marian::Tensor C, const marian::Tensor Bias);
 
+// Symmetric int8 quantization of every row of a rows x cols matrix for the int8 products below that
+// quantize both operands on-line. If transposed is set, the input is stored as cols x rows and the
+// rows of the quantized output are its columns. quantMults[i] maps row i back to floats, i.e. it is
+// the inverse of the usual intgemm quantization multiplier.
+void QuantizeRowsInt8(const float* input, int rows, int cols, bool transposed, int8_t* output, float* quantMults);
+
+// C[i, j] = scale * aQuantMults[i] * bQuantMults[j] * dot(A[i, :], B[j, :]) (+ bias[j]) for row-quantized
+// A (m x k) and B (n x k) with int32 accumulation, rows of C are ldc apart. Single-threaded.
+void MultiplyInt8(const int8_t* A, const float* aQuantMults,
+                  const int8_t* B, const float* bQuantMults,
+                  int m, int n, int k,
+                  float scale, const float* bias,
+                  float* C, int ldc);
+
 // For loading architecture agnostic models. We do PrepareAndTranpose, because we already transposed
 // in our binary format. Then we copy the quantizationMultiplier information at the end
 template<Type vtype>
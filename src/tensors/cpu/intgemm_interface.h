@@ -127,6 +127,134 @@ static inline Expr affineOrDot(Expr a, Expr bQuant, Expr bias, bool transA, bool
   }
 }
 
+/*
+ * Int8 products for operands that are not parameters prepared by intgemm, i.e. activation x activation
+ * products like the attention QK^T and attention x V as well as the short-listed output layer.
+ * Operands are quantized symmetrically per row (of op(A) and of the transpose of op(B)) and multiplied
+ * with int32 accumulation, there are no shape restrictions like intgemm's multiples of 8/64.
+ */
+
+// Row-wise int8 quantization of a float matrix [rows, cols]. The result is an int8 tensor of shape
+// [rows, cols + 4] that holds the rows x cols quantized values followed by one float multiplier per
+// row. The node is memoized for parameters, so output embeddings are quantized once, not per batch.
+static inline Expr quantizeRowsInt8(Expr a) {
+  static auto nodeOp = [](Expr out, const std::vector<Expr>& children) {
+    Tensor in = children[0]->val();
+    int8_t* values = out->val()->data<int8_t>();
+    QuantizeRowsInt8(in->data(), rows(in), cols(in), /*transposed=*/false,
+                     values, reinterpret_cast<float*>(values + in->shape().elements()));
+  };
+  static const size_t nodeOpHash = (size_t)&nodeOp;
+  int cols = a->shape()[-1];
+  return lambda({a}, {a->shape().elements() / cols, cols + (int)sizeof(float)}, Type::int8, nodeOp, nodeOpHash);
+}
+
+// Selects rows of a matrix quantized by quantizeRowsInt8() together with their multipliers, e.g. the
+// short-listed output embeddings. indices is a vector of row indices.
+static inline Expr selectRowsInt8(Expr aQuant, Expr indices) {
+  int cols = aQuant->shape()[-1] - (int)sizeof(float);
+  int rows = (int)indices->shape().elements();
+  auto nodeOp = [cols, rows](Expr out, const std::vector<Expr>& children) {
+    const int8_t* in = children[0]->val()->data<int8_t>();
+    const float* inMults = reinterpret_cast<const float*>(in + (size_t)children[0]->shape()[-2] * cols);
+    const IndexType* idx = children[1]->val()->data<IndexType>();
+    int8_t* values = out->val()->data<int8_t>();
+    float* mults = reinterpret_cast<float*>(values + (size_t)rows * cols);
+    for(int i = 0; i < rows; ++i) {
+      std::copy(in + (size_t)idx[i] * cols, in + (size_t)(idx[i] + 1) * cols, values + (size_t)i * cols);
+      mults[i] = inMults[idx[i]];
+    }
+  };
+  return lambda({aQuant, indices}, {rows, cols + (int)sizeof(float)}, Type::int8, nodeOp);
+}
+
+// scale * a * bQuant^T (+ bias) for float activations a [..., k] and a matrix bQuant [n, k] from
+// quantizeRowsInt8() or selectRowsInt8(). The rows of a are quantized on-line. Inference only.
+static inline Expr dotInt8(Expr a, Expr bQuant, Expr bias, float scale) {
+  int k = a->shape()[-1];
+  int n = bQuant->shape()[-2];
+  ABORT_IF(bQuant->value_type() != Type::int8 || bQuant->shape()[-1] != k + (int)sizeof(float),
+           "Expected a row-quantized int8 matrix with {} columns, got {} {}", k, bQuant->value_type(), bQuant->shape());
+  Shape outShape = a->shape();
+  outShape.set(-1, n);
+
+  auto nodeOp = [k, n, scale](Expr out, const std::vector<Expr>& children) {
+    Tensor a = children[0]->val();
+    int m = rows(a);
+    std::vector<int8_t> aQuant((size_t)m * k);
+    std::vector<float> aMults(m);
+    QuantizeRowsInt8(a->data(), m, k, /*transposed=*/false, aQuant.data(), aMults.data());
+
+    const int8_t* b = children[1]->val()->data<int8_t>();
+    const float* bMults = reinterpret_cast<const float*>(b + (size_t)n * k);
+    const float* bias = children.size() > 2 ? children[2]->val()->data() : nullptr;
+    float* c = out->val()->data();
+    // the output layer has few rows and many columns, split the columns
+    parallelFor(n, std::max((size_t)1, ELEMENT_GRAIN / ((size_t)m * k)), [&](size_t begin, size_t end) {
+      MultiplyInt8(aQuant.data(), aMults.data(),
+                   b + begin * k, bMults + begin,
+                   m, (int)(end - begin), k,
+                   scale, bias ? bias + begin : nullptr,
+                   c + begin, n);
+    });
+  };
+
+  std::vector<Expr> children = {a, bQuant};
+  if(bias)
+    children.push_back(bias);
+  return lambda(children, outShape, Type::float32, nodeOp); // inference-only Lambda node
+}
+
+// Int8 version of bdot_legacy(a, b, transA, transB, scale) for two float activations, e.g. the
+// attention products. Both operands are quantized on-line, batch entries of b are broadcast
+// over a like in ProdBatchedLegacy. Inference only.
+static inline Expr bdotInt8(Expr a, Expr b, bool transA, bool transB, float scale) {
+  Shape shapeA = a->shape(), shapeB = b->shape();
+  int m = transA ? shapeA[-1] : shapeA[-2];
+  int k = transA ? shapeA[-2] : shapeA[-1];
+  int n = transB ? shapeB[-2] : shapeB[-1];
+  ABORT_IF((transB ? shapeB[-1] : shapeB[-2]) != k,
+           "Batched matrix product requires inner dimensions to match in {}{} * {}{}", std::string(shapeA), transA, std::string(shapeB), transB);
+  Shape outShape = shapeA;
+  outShape.set(-2, m);
+  outShape.set(-1, n);
+
+  auto nodeOp = [m, n, k, transA, transB, scale](Expr out, const std::vector<Expr>& children) {
+    Tensor a = children[0]->val();
+    Tensor b = children[1]->val();
+    size_t batchA = a->shape().elements() / ((size_t)m * k);
+    size_t batchB = b->shape().elements() / ((size_t)n * k);
+    size_t batchC = out->val()->shape().elements() / ((size_t)m * n);
+
+    // row j of the quantized b is column j of op(b)
+    std::vector<int8_t> aQuant(batchA * m * k), bQuant(batchB * n * k);
+    std::vector<float> aMults(batchA * m), bMults(batchB * n);
+    size_t grain = std::max((size_t)1, ELEMENT_GRAIN / ((size_t)std::max(m, n) * k));
+    parallelFor(batchA + batchB, grain, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i) {
+        if(i < batchA)
+          QuantizeRowsInt8(a->data() + i * m * k, m, k, transA, aQuant.data() + i * m * k, aMults.data() + i * m);
+        else
+          QuantizeRowsInt8(b->data() + (i - batchA) * n * k, n, k, !transB, bQuant.data() + (i - batchA) * n * k, bMults.data() + (i - batchA) * n);
+      }
+    });
+
+    float* c = out->val()->data();
+    grain = std::max((size_t)1, ELEMENT_GRAIN / ((size_t)m * n * k));
+    parallelFor(batchC, grain, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i) {
+        size_t ia = i % batchA, ib = i % batchB;
+        MultiplyInt8(aQuant.data() + ia * m * k, aMults.data() + ia * m,
+                     bQuant.data() + ib * n * k, bMults.data() + ib * n,
+                     m, n, k, scale, /*bias=*/nullptr,
+                     c + i * m * n, n);
+      }
+    });
+  };
+
+  return lambda({a, b}, outShape, Type::float32, nodeOp); // inference-only Lambda node
+}
+
 }  // namespace integer
 }  // namespace cpu
 }  // namespace marian
@@ -0,0 +1,240 @@
+#include "tensors/cpu/native_gemm.h"
+#include "tensors/cpu/parallel.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace marian {
+namespace cpu {
+
+namespace {
+
+const int MR = 6;    // rows of c computed by one micro-kernel call
+const int NR = 16;   // columns of c computed by one micro-kernel call
+const int KC = 256;  // depth of the packed panels, an MR x KC panel of a stays in L1
+const int MC = 120;  // maximum rows of a packed per block (multiple of MR), stays in L2
+const int NC = 3072; // columns of b packed at once, KC x NC stays in L3
+
+inline float at(const float* x, int ld, bool trans, int row, int col) {
+  return trans ? x[(size_t)col * ld + row] : x[(size_t)row * ld + col];
+}
+
+// Packs rows [i0, i0 + mc) and depth [p0, p0 + kc) of op(a) into panels of MR interleaved rows, padded with zeros.
+void packA(const float* a, int lda, bool transA, int i0, int mc, int p0, int kc, float* out) {
+  for(int ir = 0; ir < mc; ir += MR) {
+    int mr = std::min(MR, mc - ir);
+    for(int p = 0; p < kc; ++p) {
+      for(int r = 0; r < mr; ++r)
+        out[r] = at(a, lda, transA, i0 + ir + r, p0 + p);
+      for(int r = mr; r < MR; ++r)
+        out[r] = 0.f;
+      out += MR;
+    }
+  }
+}
+
+// Packs depth [p0, p0 + kc) and columns [j0, j0 + nc) of op(b) into panels of NR columns, padded with zeros.
+void packB(const float* b, int ldb, bool transB, int p0, int kc, int j0, int nc, float* out) {
+  for(int jr = 0; jr < nc; jr += NR) {
+    int nr = std::min(NR, nc - jr);
+    for(int p = 0; p < kc; ++p) {
+      for(int col = 0; col < nr; ++col)
+        out[col] = at(b, ldb, transB, p0 + p, j0 + jr + col);
+      for(int col = nr; col < NR; ++col)
+        out[col] = 0.f;
+      out += NR;
+    }
+  }
+}
+
+// c[0:mr, 0:nr] += alpha * a * b for a packed MR x kc panel a and a packed kc x NR panel b.
+void microKernel(int kc, const float* a, const float* b, float* c, int ldc, int mr, int nr, float alpha) {
+  alignas(64) float acc[MR * NR];
+#if defined(__AVX512F__)
+  __m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps(), c2 = _mm512_setzero_ps();
+  __m512 c3 = _mm512_setzero_ps(), c4 = _mm512_setzero_ps(), c5 = _mm512_setzero_ps();
+  for(int p = 0; p < kc; ++p, a += MR, b += NR) {
+    __m512 bv = _mm512_loadu_ps(b);
+    c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), bv, c0);
+    c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), bv, c1);
+    c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), bv, c2);
+    c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), bv, c3);
+    c4 = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), bv, c4);
+    c5 = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), bv, c5);
+  }
+  _mm512_store_ps(acc + 0 * NR, c0);
+  _mm512_store_ps(acc + 1 * NR, c1);
+  _mm512_store_ps(acc + 2 * NR, c2);
+  _mm512_store_ps(acc + 3 * NR, c3);
+  _mm512_store_ps(acc + 4 * NR, c4);
+  _mm512_store_ps(acc + 5 * NR, c5);
+#elif defined(__AVX2__) && defined(__FMA__)
+  __m256 cv[2 * MR];
+  for(int r = 0; r < 2 * MR; ++r)
+    cv[r] = _mm256_setzero_ps();
+  for(int p = 0; p < kc; ++p, a += MR, b += NR) {
+    __m256 b0 = _mm256_loadu_ps(b);
+    __m256 b1 = _mm256_loadu_ps(b + 8);
+    for(int r = 0; r < MR; ++r) {
+      __m256 av = _mm256_set1_ps(a[r]);
+      cv[2 * r]     = _mm256_fmadd_ps(av, b0, cv[2 * r]);
+      cv[2 * r + 1] = _mm256_fmadd_ps(av, b1, cv[2 * r + 1]);
+    }
+  }
+  for(int r = 0; r < MR; ++r) {
+    _mm256_store_ps(acc + r * NR, cv[2 * r]);
+    _mm256_store_ps(acc + r * NR + 8, cv[2 * r + 1]);
+  }
+#else
+  std::fill(acc, acc + MR * NR, 0.f);
+  for(int p = 0; p < kc; ++p, a += MR, b += NR)
+    for(int r = 0; r < MR; ++r)
+      for(int col = 0; col < NR; ++col)
+        acc[r * NR + col] += a[r] * b[col];
+#endif
+  for(int r = 0; r < mr; ++r)
+    for(int col = 0; col < nr; ++col)
+      c[(size_t)r * ldc + col] += alpha * acc[r * NR + col];
+}
+
+// BLAS semantics: beta == 0 overwrites c, even if it contains NaNs.
+void scaleRow(float* row, int n, float beta) {
+  if(beta == 0.f)
+    std::fill(row, row + n, 0.f);
+  else if(beta != 1.f)
+    for(int j = 0; j < n; ++j)
+      row[j] *= beta;
+}
+
+inline float dot(const float* x, const float* y, int k) {
+  int p = 0;
+  float sum = 0.f;
+#if defined(__AVX512F__)
+  __m512 s = _mm512_setzero_ps();
+  for(; p + 16 <= k; p += 16)
+    s = _mm512_fmadd_ps(_mm512_loadu_ps(x + p), _mm512_loadu_ps(y + p), s);
+  alignas(64) float part[16];
+  _mm512_store_ps(part, s);
+  for(int i = 0; i < 16; ++i)
+    sum += part[i];
+#elif defined(__AVX2__) && defined(__FMA__)
+  __m256 s = _mm256_setzero_ps();
+  for(; p + 8 <= k; p += 8)
+    s = _mm256_fmadd_ps(_mm256_loadu_ps(x + p), _mm256_loadu_ps(y + p), s);
+  alignas(32) float part[8];
+  _mm256_store_ps(part, s);
+  for(int i = 0; i < 8; ++i)
+    sum += part[i];
+#endif
+  for(; p < k; ++p)
+    sum += x[p] * y[p];
+  return sum;
+}
+
+}  // namespace
+
+void smallSgemm(bool transA,
+                bool transB,
+                int m,
+                int n,
+                int k,
+                float alpha,
+                const float* a,
+                int lda,
+                const float* b,
+                int ldb,
+                float beta,
+                float* c,
+                int ldc) {
+  for(int i = 0; i < m; ++i) {
+    float* row = c + (size_t)i * ldc;
+    scaleRow(row, n, beta);
+    if(!transB) {        // rows of b are contiguous, accumulate scaled rows of b
+      for(int p = 0; p < k; ++p) {
+        float av = alpha * at(a, lda, transA, i, p);
+        const float* bRow = b + (size_t)p * ldb;
+        for(int j = 0; j < n; ++j)
+          row[j] += av * bRow[j];
+      }
+    } else if(!transA) { // rows of a and columns of op(b) are contiguous, dot products
+      const float* aRow = a + (size_t)i * lda;
+      for(int j = 0; j < n; ++j)
+        row[j] += alpha * dot(aRow, b + (size_t)j * ldb, k);
+    } else {
+      for(int j = 0; j < n; ++j) {
+        const float* bRow = b + (size_t)j * ldb;
+        float sum = 0.f;
+        for(int p = 0; p < k; ++p)
+          sum += a[(size_t)p * lda + i] * bRow[p];
+        row[j] += alpha * sum;
+      }
+    }
+  }
+}
+
+void nativeSgemm(bool transA,
+                 bool transB,
+                 int m,
+                 int n,
+                 int k,
+                 float alpha,
+                 const float* a,
+                 int lda,
+                 const float* b,
+                 int ldb,
+                 float beta,
+                 float* c,
+                 int ldc) {
+  if(m <= 0 || n <= 0)
+    return;
+
+  if(isSmallGemm(m, n, k) || k <= 0 || alpha == 0.f) {
+    smallSgemm(transA, transB, m, n, alpha == 0.f ? 0 : k, alpha, a, lda, b, ldb, beta, c, ldc);
+    return;
+  }
+
+  for(int i = 0; i < m; ++i)
+    scaleRow(c + (size_t)i * ldc, n, beta);
+
+  // at least one block of rows per thread, but not more rows than fit into L2
+  int threads = (int)getIntraOpThreads();
+  int mc = (m + threads - 1) / threads;
+  mc = std::min(MC, std::max(MR, (mc + MR - 1) / MR * MR));
+  size_t blocks = (m + mc - 1) / mc;
+
+  std::vector<float> packedB((size_t)KC * ((std::min(n, NC) + NR - 1) / NR * NR));
+  for(int j0 = 0; j0 < n; j0 += NC) {
+    int nc = std::min(NC, n - j0);
+    for(int p0 = 0; p0 < k; p0 += KC) {
+      int kc = std::min(KC, k - p0);
+      packB(b, ldb, transB, p0, kc, j0, nc, packedB.data());
+
+      parallelFor(blocks, 1, [&](size_t begin, size_t end) {
+        thread_local std::vector<float> packedA;
+        packedA.resize((size_t)MC * KC);
+        for(size_t block = begin; block < end; ++block) {
+          int i0 = (int)block * mc;
+          int rows = std::min(mc, m - i0);
+          packA(a, lda, transA, i0, rows, p0, kc, packedA.data());
+          for(int jr = 0; jr < nc; jr += NR)
+            for(int ir = 0; ir < rows; ir += MR)
+              microKernel(kc,
+                          packedA.data() + (size_t)ir * kc,
+                          packedB.data() + (size_t)jr * kc,
+                          c + (size_t)(i0 + ir) * ldc + j0 + jr,
+                          ldc,
+                          std::min(MR, rows - ir),
+                          std::min(NR, nc - jr),
+                          alpha);
+        }
+      });
+    }
+  }
+}
+
+}  // namespace cpu
+}  // namespace marian
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+namespace marian {
+namespace cpu {
+
+// Built-in single precision GEMM for builds without a BLAS library, row-major with the same
+// arguments as cblas_sgemm: c = alpha * op(a) * op(b) + beta * c where op(a) is m x k and op(b) is k x n.
+// The product is cache-blocked, packs both operands into panels for an AVX-512, AVX2 or
+// portable micro-kernel and splits the rows of c over the intra-op threads.
+void nativeSgemm(bool transA,
+                 bool transB,
+                 int m,
+                 int n,
+                 int k,
+                 float alpha,
+                 const float* a,
+                 int lda,
+                 const float* b,
+                 int ldb,
+                 float beta,
+                 float* c,
+                 int ldc);
+
+// Products up to this many multiply-adds are cheaper without packing, e.g. the [1 x dk] x [dk x t]
+// attention products of a single decoding step.
+const size_t SMALL_GEMM_FLOPS = 1 << 16;
+
+inline bool isSmallGemm(int m, int n, int k) {
+  return (size_t)m * n * k <= SMALL_GEMM_FLOPS;
+}
+
+// Unpacked GEMM for small matrices with the same arguments as nativeSgemm(), single-threaded since
+// it is meant to be called for every product of a batch.
+void smallSgemm(bool transA,
+                bool transB,
+                int m,
+                int n,
+                int k,
+                float alpha,
+                const float* a,
+                int lda,
+                const float* b,
+                int ldb,
+                float beta,
+                float* c,
+                int ldc);
+
+}  // namespace cpu
+}  // namespace marian
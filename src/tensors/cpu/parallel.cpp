@@ -0,0 +1,102 @@
+#include "tensors/cpu/parallel.h"
+#include "3rd_party/threadpool.h"
+#include "common/logging.h"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <memory>
+#include <vector>
+
+#if MKL_FOUND
+#include <mkl.h>
+#endif
+
+namespace marian {
+namespace cpu {
+
+static size_t intraOpThreads = 1;
+static std::unique_ptr<ThreadPool> intraOpPool;  // intraOpThreads - 1 helpers, the caller does the rest
+static thread_local bool inParallelFor = false;
+
+void setIntraOpThreads(size_t threads) {
+  ABORT_IF(threads == 0, "Number of intra-op threads has to be at least 1");
+  if(threads == intraOpThreads)
+    return;
+  intraOpPool.reset(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+  intraOpThreads = threads;
+  LOG(info, "[cpu] Using {} threads per CPU operator", threads);
+}
+
+size_t getIntraOpThreads() {
+  return intraOpThreads;
+}
+
+void setDeterministic(bool value) {
+  if(!value)
+    return;
+#if MKL_FOUND && defined(MKL_CBWR_STRICT)
+  // only takes effect before the first MKL call, i.e. when the options are parsed, and cannot be undone
+  int status = mkl_cbwr_set(MKL_CBWR_AUTO | MKL_CBWR_STRICT);
+  if(status != MKL_CBWR_SUCCESS)
+    LOG(warn, "[cpu] Could not change MKL's numerical reproducibility mode, error {}", status);
+  else
+    LOG(info, "[cpu] Deterministic mode: MKL uses its reproducible code path");
+#else
+  LOG(info, "[cpu] Deterministic mode has no effect without MKL, CPU reductions use a fixed order anyway");
+#endif
+}
+
+void parallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+  grain = std::max(grain, (size_t)1);
+  size_t chunks = std::min(intraOpThreads, (size + grain - 1) / grain);
+  if(chunks <= 1 || !intraOpPool || inParallelFor) {
+    fn(0, size);
+    return;
+  }
+
+  size_t chunkSize = (size + chunks - 1) / chunks;
+  // an ABORT in a helper throws if it would throw on the calling thread, e.g. in marian-server.
+  // Errors are returned instead of thrown, the pool would turn an exception into an ABORT.
+  bool throwOnAbort = getThrowExceptionOnAbortInThisThread();
+  std::vector<std::future<std::exception_ptr>> futures;
+  for(size_t begin = chunkSize; begin < size; begin += chunkSize) {
+    size_t end = std::min(begin + chunkSize, size);
+    futures.emplace_back(intraOpPool->enqueue([&fn, begin, end, throwOnAbort]() -> std::exception_ptr {
+      inParallelFor = true;
+      try {
+        if(throwOnAbort) {
+          ScopedThrowExceptionOnAbort scoped;
+          fn(begin, end);
+        } else {
+          fn(begin, end);
+        }
+      } catch(...) {
+        return std::current_exception();
+      }
+      return nullptr;
+    }));
+  }
+
+  // the helpers reference 'fn', so wait for them even if the first chunk fails
+  std::exception_ptr error;
+  inParallelFor = true;
+  try {
+    fn(0, chunkSize);
+  } catch(...) {
+    error = std::current_exception();
+  }
+  inParallelFor = false;
+
+  // rethrow the first error, a failed chunk leaves the output incomplete
+  for(auto& future : futures) {
+    auto helperError = future.get();
+    if(helperError && !error)
+      error = helperError;
+  }
+  if(error)
+    std::rethrow_exception(error);
+}
+
+}  // namespace cpu
+}  // namespace marian
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace marian {
+namespace cpu {
+
+// Number of threads that a single CPU operator may use (--cpu-intra-op-threads). Each CPU worker
+// (--cpu-threads) shares the same intra-op thread pool. 1 (default) runs everything on the calling thread.
+void setIntraOpThreads(size_t threads);
+size_t getIntraOpThreads();
+
+// Deterministic mode (--deterministic). The reductions of the CPU operators use fixed blocks and
+// a fixed combination order regardless of this flag, so their results never depend on the number
+// of threads. The flag only pins MKL to a reproducible code path (conditional numerical
+// reproducibility), which costs a few percent in GEMM throughput; other builds are unaffected.
+void setDeterministic(bool deterministic);
+
+// Splits the range [0, size) into at most getIntraOpThreads() contiguous chunks of at least 'grain'
+// items and calls fn(begin, end) for each chunk. The calling thread processes the first chunk and
+// waits for the others. Calls from inside a chunk run serially, hence nesting is safe.
+void parallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+}  // namespace cpu
+}  // namespace marian
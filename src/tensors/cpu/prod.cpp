@@ -17,12 +17,77 @@
 
 #include "integer_common.h"
 #include "prod_blas.h"
+#include "tensors/cpu/native_gemm.h"
+#include "tensors/cpu/parallel.h"
+
+#include <algorithm>
+#include <vector>
 
 
 namespace marian {
 
 namespace cpu {
 
+// Matrix product with a bfloat16 matrix B (usually a weight matrix) and float32 matrices A and C.
+// B is converted block-wise along the inner dimension into a small float32 buffer, so only a slice
+// of B is ever held in float32 and the product is accumulated in float32 in C.
+static void ProdBFloat16(marian::Tensor C,
+                         const marian::Tensor& A,
+                         const marian::Tensor& B,
+                         bool transA,
+                         bool transB,
+                         float beta,
+                         float alpha,
+                         int m,
+                         int n,
+                         int k,
+                         int lda,
+                         int ldb,
+                         int ldc) {
+  ABORT_IF(A->type() != Type::float32 || C->type() != Type::float32,
+           "Matrix product with {} matrix B requires {} matrices A and C, got A: {} and C: {}",
+           B->type(), Type::float32, A->type(), C->type());
+
+  const int blockK = 256; // 256 rows/columns of B, keeps the float32 slice in L2 for typical widths
+  thread_local std::vector<float> buffer;
+
+  const bfloat16* b = B->data<bfloat16>();
+  float* a = A->data<float>();
+  for(int k0 = 0; k0 < k; k0 += blockK) {
+    int kb = std::min(blockK, k - k0);
+    buffer.resize((size_t)kb * n);
+
+    int ldbBlock;
+    if(!transB) { // B is k x n, rows [k0, k0 + kb) are contiguous
+      for(int i = 0; i < kb; ++i)
+        for(int j = 0; j < n; ++j)
+          buffer[(size_t)i * n + j] = b[(size_t)(k0 + i) * ldb + j];
+      ldbBlock = n;
+    } else {      // B is n x k, take columns [k0, k0 + kb) of every row
+      for(int j = 0; j < n; ++j)
+        for(int i = 0; i < kb; ++i)
+          buffer[(size_t)j * kb + i] = b[(size_t)j * ldb + k0 + i];
+      ldbBlock = kb;
+    }
+
+    // matching slice of op(A), the leading dimension stays the same
+    float* aBlock = transA ? a + (size_t)k0 * lda : a + k0;
+    sgemm(transA,
+          transB,
+          m,
+          n,
+          kb,
+          alpha,
+          aBlock,
+          lda,
+          buffer.data(),
+          ldbBlock,
+          k0 == 0 ? beta : 1.f, // accumulate all but the first block
+          C->data(),
+          ldc);
+  }
+}
+
 void Prod(marian::Tensor C,
           const marian::Tensor& A,
           const marian::Tensor& B,
@@ -30,7 +95,6 @@ void Prod(marian::Tensor C,
           bool transB,
           float beta,
           float scalar) {
-#if BLAS_FOUND
   float alpha = scalar;
 
   int m = A->shape().elements() / A->shape()[-1];
@@ -50,6 +114,11 @@ void Prod(marian::Tensor C,
   if(transB)
     ldc = B->shape().elements() / B->shape()[-1];
 
+  if(B->type() == Type::bfloat16) {
+    ProdBFloat16(C, A, B, transA, transB, beta, alpha, m, n, k, lda, ldb, ldc);
+    return;
+  }
+
   sgemm(transA,
         transB,
         m,
@@ -63,10 +132,6 @@ void Prod(marian::Tensor C,
         beta,
         C->data(),
         ldc);
-#else
-  C; A; B; transA; transB; beta; scalar;
-  ABORT("You need to compile with MKL in order to use the CPU version");
-#endif
 }
 
 // dummy implementation, computeType doesn't do anything on CPU
@@ -90,7 +155,10 @@ void ProdBatched(marian::Tensor C,
                  bool transB,
                  float beta,
                  float scalar) {
-#if BLAS_FOUND
+  // bfloat16 weights (e.g. the LSH-shortlisted output layer) are only supported by Prod()
+  ABORT_IF(A->type() != Type::float32 || B->type() != Type::float32,
+           "Batched matrix product requires {} matrices, got A: {} and B: {}",
+           Type::float32, A->type(), B->type());
   float alpha = scalar;
 
   // determine meta-shape of bdot operation. Essentially treat the last two dimensions as single elements
@@ -145,6 +213,26 @@ void ProdBatched(marian::Tensor C,
   functional::Shape bShapeMetaF = bShapeMeta;
   functional::Shape cShapeMetaF = cShapeMeta;
 
+  // Many tiny products, e.g. attention over a single decoding step: computing each one directly
+  // is cheaper than a BLAS call per product
+  if(isSmallGemm(m, n, k)) {
+    size_t grain = std::max(SMALL_GEMM_FLOPS / std::max((size_t)m * n * k, (size_t)1), (size_t)1);
+    parallelFor(batchC, grain, [&](size_t begin, size_t end) {
+      functional::Array<int, functional::Shape::size()> dims;
+      for(size_t i = begin; i < end; ++i) {
+        cShapeMetaF.dims((int)i, dims);
+        auto aIndex = aShapeMetaF.bindex(dims);
+        auto bIndex = bShapeMetaF.bindex(dims);
+        smallSgemm(transA, transB, m, n, k, alpha,
+                   A->data() + aIndex * strideA, lda,
+                   B->data() + bIndex * strideB, ldb,
+                   beta,
+                   C->data() + i * strideC, ldc);
+      }
+    });
+    return;
+  }
+
 #if MKL_FOUND
   CBLAS_TRANSPOSE transA_forarr = CblasNoTrans;
   CBLAS_TRANSPOSE transB_forarr = CblasNoTrans;
@@ -231,10 +319,6 @@ void ProdBatched(marian::Tensor C,
           ldc);
   }
 #endif
-#else
-  C; A; B; transA; transB; beta; scalar;
-  ABORT("You need to compile with MKL in order to use the CPU version");
-#endif
 }
 
 
@@ -246,7 +330,10 @@ void ProdBatchedLegacy(marian::Tensor C,
                        bool transB,
                        float beta,
                        float scalar) {
-#if BLAS_FOUND
+  // see ProdBatched()
+  ABORT_IF(A->type() != Type::float32 || B->type() != Type::float32,
+           "Batched matrix product requires {} matrices, got A: {} and B: {}",
+           Type::float32, A->type(), B->type());
   float alpha = scalar;
 
   size_t batchA = A->shape().elements() / (A->shape()[-1] * A->shape()[-2]);
@@ -274,6 +361,20 @@ void ProdBatchedLegacy(marian::Tensor C,
   auto strideC = n * m;
 
   auto batchC = std::max(batchA, batchB);
+
+  if(isSmallGemm((int)m, (int)n, (int)k)) {
+    size_t grain = std::max(SMALL_GEMM_FLOPS / std::max(m * n * k, (size_t)1), (size_t)1);
+    parallelFor(batchC, grain, [&](size_t begin, size_t end) {
+      for(size_t i = begin; i < end; ++i)
+        smallSgemm(transA, transB, (int)m, (int)n, (int)k, alpha,
+                   A->data() + (i % batchA) * strideA, (int)lda,
+                   B->data() + (i % batchB) * strideB, (int)ldb,
+                   beta,
+                   C->data() + i * strideC, (int)ldc);
+    });
+    return;
+  }
+
 #if MKL_FOUND
   CBLAS_TRANSPOSE transA_forarr = CblasNoTrans;
   CBLAS_TRANSPOSE transB_forarr = CblasNoTrans;
@@ -350,10 +451,6 @@ void ProdBatchedLegacy(marian::Tensor C,
           (int)ldc);
   }
 #endif
-#else
-  C; A; B; transA; transB; beta; scalar;
-  ABORT("You need to compile with MKL in order to use the CPU version");
-#endif
 }
 
 void ProdWithBias(marian::Tensor C,
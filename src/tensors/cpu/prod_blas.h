@@ -6,6 +6,8 @@
 #endif
 #endif
 
+#include "tensors/cpu/native_gemm.h"
+
 inline void sgemm(bool transA,
                   bool transB,
                   int rows_a,
@@ -35,7 +37,6 @@ inline void sgemm(bool transA,
               c,
               ldc);
 #else
-    transA; transB; rows_a; rows_b; width; alpha; a; lda; b; ldb; beta; c; ldc; // make compiler happy
-    ABORT("Marian must be compiled with a BLAS library");
+  marian::cpu::nativeSgemm(transA, transB, rows_a, rows_b, width, alpha, a, lda, b, ldb, beta, c, ldc);
 #endif
 }
@@ -5,6 +5,8 @@
 
 #include "tensors/tensor_operators.h"
 #include "tensors/cpu/backend.h"
+#include "tensors/cpu/native_gemm.h"
+#include "tensors/cpu/transpose.h"
 #include "tensors/allocator.h"
 
 #include "functional/approx.h"
@@ -16,6 +18,9 @@
 #include <mkl.h>
 #endif
 
+#include <cstring>
+#include <limits>
+
 namespace marian {
 
 namespace cpu {
@@ -55,6 +60,8 @@ void CopyCastFrom(Tensor out, const T* in, int length) {
     CopyCastTo<add>(out->data<float>(), in, length);
   } else if(out->type() == Type::float16) {
     CopyCastTo<add>(out->data<float16>(), in, length);
+  } else if(out->type() == Type::bfloat16) {
+    CopyCastTo<add>(out->data<bfloat16>(), in, length);
   } else {
     ABORT("CopyCastTo to type {} not implemented", out->type());
   }
@@ -66,6 +73,8 @@ void CopyCast(Tensor out, const Tensor in) {
     CopyCastFrom</*add=*/false>(out, in->data<float>(), (int)in->size());
   } else if(in->type() == Type::float16) {
     CopyCastFrom</*add=*/false>(out, in->data<float16>(), (int)in->size());
+  } else if(in->type() == Type::bfloat16) {
+    CopyCastFrom</*add=*/false>(out, in->data<bfloat16>(), (int)in->size());
   } else if(in->type() == Type::uint32) {
     CopyCastFrom</*add=*/false>(out, in->data<uint32_t>(), (int)in->size());
   } else {
@@ -79,6 +88,8 @@ void AddCast(Tensor out, const Tensor in) {
     CopyCastFrom</*add=*/true>(out, in->data<float>(), (int)in->size());
   } else if(in->type() == Type::float16) {
     CopyCastFrom</*add=*/true>(out, in->data<float16>(), (int)in->size());
+  } else if(in->type() == Type::bfloat16) {
+    CopyCastFrom</*add=*/true>(out, in->data<bfloat16>(), (int)in->size());
   } else if(in->type() == Type::uint32) {
     CopyCastFrom</*add=*/true>(out, in->data<uint32_t>(), (int)in->size());
   } else {
@@ -214,101 +225,6 @@ void Deconcatenate(std::vector<Tensor>& outputs, const Tensor in, int ax) {
     SplitCont(outputs, in, ax);
 }
 
-template <bool add>
-void Transpose0213(Tensor out, Tensor in) {
-  int cols = in->shape()[-1];
-  int rows = in->shape().elements() / in->shape()[-1];
-
-  int r1 = in->shape()[-2];
-  int r2 = in->shape()[-3];
-  int rest = rows / (r1 * r2);
-
-  for(int k = 0; k < rest; ++k) {
-    int shift = k * r1 * r2;
-    for(int j = 0; j < r1 * r2; ++j) {
-      int src = j + shift;
-      int dst = j / r1 + (j % r1) * r2 + shift;
-
-      const float* inRow = in->data() + src * cols;
-      float* outRow = out->data() + dst * cols;
-
-      if(!add) {
-        // mostly for fast forward computation
-        std::copy(inRow, inRow + cols, outRow);
-      } else {
-        for(int i = 0; i < cols; ++i) {
-          outRow[i] += inRow[i];
-        }
-      }
-    }
-  }
-}
-
-// This function is called only when MKL is available.
-#if MKL_FOUND
-// Given a 4D array, transpose (swap) the initial 3 dimensions while keeping the last dimension.
-// e.g. 1234 --> 2134, 1234 --> 3214 (4 is always kept).
-// This is an optimized version for swapping first 3 dimensions
-// assuming the last dimension is large enough to get benefits from vectorized copy.
-//
-// @param out output tensor
-// @param in input tensor
-// @param vAxis target (transposed) axes of each given axes
-template <bool add>
-void TransposeFirst3In4(Tensor out, Tensor in, const std::vector<int>& vAxis) {
-  ABORT_IF(vAxis.size() != 4, "This function handles only 4D arrays.");
-  int innermost = in->shape()[-1];
-
-  int l1 = in->shape()[vAxis[0]];
-  int l2 = in->shape()[vAxis[1]];
-  int l3 = in->shape()[vAxis[2]];
-
-  // find the mapping between the transposed output dimensional indices (oi, oj, ok)
-  // and original input dimensional indices (i, j, k)
-#pragma omp parallel for
-  for(int k = 0; k < l1; ++k) {
-    int shift = k * l2 * l3;
-    for(int j = 0; j < l2; ++j) {
-      for(int i = 0; i < l3; ++i) {
-        int oi, oj, ok;
-        if(vAxis[0] == 0) {
-          if(vAxis[1] == 1) {
-            oi = i; oj = j; ok = k;
-          } else {
-            oi = j; oj = i; ok = k;
-          }
-        } else if(vAxis[0] == 1) {
-          if(vAxis[1] == 0) {
-            oi = i; oj = k; ok = j;
-          } else {
-            oi = j; oj = k; ok = i;
-          }
-        } else {
-          if(vAxis[1] == 0) {
-            oi = k; oj = i; ok = j;
-          } else {
-            oi = k; oj = j; ok = i;
-          }
-        }
-        int src = ok * in->shape()[1] * in->shape()[2] + oj * in->shape()[2] + oi;
-        int dst = l3 * j + shift + i;
-
-        const float* inRow = in->data() + src * innermost;
-        float* outRow = out->data() + dst * innermost;
-
-        if(!add) {
-          mkl_somatcopy('R', 'N', 1, innermost, 1.0f, inRow, innermost, outRow, innermost);
-        } else {
-          for(int ii = 0; ii < innermost; ++ii) {
-            outRow[ii] += inRow[ii];
-          }
-        }
-      }
-    }
-  }
-}
-#endif  // MKL_FOUND
-
 inline void transpose4x4_SSE(const float* A,
                              float* B,
                              const int lda,
@@ -352,60 +268,21 @@ void Transpose10(Tensor out, const Tensor in) {
   }
 }
 
-// @TODO: optimize this, currently it's quite horrible
-template <bool add>
-void TransposeGeneric(Tensor out, Tensor in, const std::vector<int>& vAxis) {
-  functional::Array<int, functional::Shape::size()> permute;
-  int diff = int(functional::Shape::size() - vAxis.size());
-  for(int i = 0; i < permute.size(); ++i)
-    if(i < diff)
-      permute[i] = i;
-    else
-      permute[i] = vAxis[i - diff] + diff;
-
-  int length = out->shape().elements();
-
-  constexpr size_t N = functional::Shape::size();
-  functional::Array<int, N> oDims;
-  functional::Array<int, N> pDims;
-  functional::Tensor<float> gOut = out;
-  functional::Tensor<float> gIn = in;
-
-  for(int index = 0; index < length; ++index) {
-    gOut.shape().dims(index, oDims);
-    for(size_t i = 0; i < N; ++i)
-      pDims[permute[i]] = oDims[i];
-
-    // @TODO: where does this change come from?
-    int inIndex = gIn.shape().index(pDims);
-
-    // @TODO: use internal conversion instead of raw indices
-    if(add)
-      gOut.data()[index] += gIn.data()[inIndex];
-    else
-      gOut.data()[index] = gIn.data()[inIndex];
-  }
+// The shape of `in` left-padded with unit axes to the length of the permutation, so that e.g. a
+// 2-D tensor can be transposed with {0, 1, 3, 2}
+static std::vector<int> permutedShape(Tensor in, const std::vector<int>& vAxis) {
+  std::vector<int> shape(in->shape().begin(), in->shape().end());
+  if(vAxis.size() > shape.size())
+    shape.insert(shape.begin(), vAxis.size() - shape.size(), 1);
+  return shape;
 }
 
 void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
-  if(vAxis == std::vector<int>({0, 2, 1, 3}))
-    Transpose0213<false>(out, in);
-#if MKL_FOUND
-  else if(vAxis.size() == 4 && vAxis[3] == 3)
-    TransposeFirst3In4<false>(out, in, vAxis);
-#endif  // MKL_FOUND
-  else if(vAxis == std::vector<int>({1, 0}) && in->shape()[-1] % 16 == 0
-          && in->shape()[-2] % 16 == 0)
-    Transpose10(out, in);
-  else
-    TransposeGeneric<false>(out, in, vAxis);
+  permute(in->data(), permutedShape(in, vAxis), out->data(), vAxis, /*add=*/false);
 }
 
 void TransposeNDGrad(Tensor out, Tensor in, const std::vector<int>& vAxis) {
-  if(vAxis == std::vector<int>({0, 2, 1, 3}))
-    Transpose0213<true>(out, in);
-  else
-    TransposeGeneric<true>(out, in, vAxis);
+  permute(in->data(), permutedShape(in, vAxis), out->data(), vAxis, /*add=*/true);
 }
 
 template <typename ElementType>
@@ -453,6 +330,12 @@ void Softmax(Tensor out, Tensor in) {
   matchOrAbort<float>(out->type());
   matchOrAbort<float>(in->type());
 
+#ifdef __AVX512F__
+  if(out->shape()[-1] % 16 == 0) {
+    Softmax<float32x16>(out, in);
+    return;
+  }
+#endif
 #ifdef __AVX__
   if(out->shape()[-1] % 8 == 0) {
     Softmax<float32x8>(out, in);
@@ -509,6 +392,12 @@ void LogSoftmax(Tensor out, Tensor in) {
   matchOrAbort<float>(out->type());
   matchOrAbort<float>(in->type());
 
+#ifdef __AVX512F__
+  if(out->shape()[-1] % 16 == 0) {
+    LogSoftmax<float32x16>(out, in);
+    return;
+  }
+#endif
 #ifdef __AVX__
   if(out->shape()[-1] % 8 == 0) {
     LogSoftmax<float32x8>(out, in);
@@ -577,26 +466,24 @@ void CopyRows(Tensor out_,
 
   matchOrAbort<IndexType>(indices->type());
 
-  size_t cols = in_->shape()[-1];
-  size_t rows = indices->size();
-
-  // note: may also be applied to IndexType; works by luck. Fix with fp16
-  float* out = out_->data();
-  const float* in = in_->data();
-
-#pragma omp parallel for
-  for(size_t j = 0; j < rows; ++j) {
-    size_t dst = j;
+  ABORT_IF(out_->type() != in_->type(), "CopyRows: types of input {} and output {} differ", in_->type(), out_->type());
 
-    // @TODO: consider moving type checking to this function
-    // instead of matchOrAbort above
-    size_t src = (size_t)indices->data<IndexType>()[j];
+  // rows are copied as bytes, hence this works for any element type, e.g. bfloat16 weights
+  size_t rowBytes = in_->shape()[-1] * sizeOf(in_->type());
+  size_t rows = indices->size();
 
-    float* rowOut = out + dst * cols;
-    const float* rowIn = in + src * cols;
+  char* out = out_->data<char>();
+  const char* in = in_->data<char>();
+  const IndexType* idx = indices->data<IndexType>();
 
-    std::copy(rowIn, rowIn + cols, rowOut);
-  }
+  size_t grain = std::max(ELEMENT_GRAIN * sizeof(float) / std::max(rowBytes, (size_t)1), (size_t)1);
+  parallelFor(rows, grain, [&](size_t begin, size_t end) {
+    for(size_t j = begin; j < end; ++j) {
+      size_t dst = j;
+      size_t src = (size_t)idx[j];
+      std::memcpy(out + dst * rowBytes, in + src * rowBytes, rowBytes);
+    }
+  });
 }
 
 void PasteRows(Tensor out_,
@@ -604,24 +491,31 @@ void PasteRows(Tensor out_,
                const Tensor indices) {
 
   matchOrAbort<IndexType>(indices->type());
+  matchOrAbort<float>(out_->type());
+  matchOrAbort<float>(in_->type());
 
   size_t cols = in_->shape()[-1];
   size_t rows = indices->size();
 
   float* out = out_->data();
   const float* in = in_->data();
+  const IndexType* idx = indices->data<IndexType>();
 
-  for(size_t j = 0; j < rows; ++j) {
-    size_t dst = indices->data<IndexType>()[j];  // not a permutation - may alias, unlike PasteCols
-    size_t src = j;
+  // indices may repeat, hence the threads split the columns and each one visits all rows
+  size_t grain = std::max(ELEMENT_GRAIN / std::max(rows, (size_t)1), (size_t)64);
+  parallelFor(cols, grain, [&](size_t begin, size_t end) {
+    for(size_t j = 0; j < rows; ++j) {
+      size_t dst = idx[j];  // not a permutation - may alias, unlike PasteCols
+      size_t src = j;
 
-    float* rowOut = out + dst * cols;
-    const float* rowIn = in + src * cols;
+      float* rowOut = out + dst * cols;
+      const float* rowIn = in + src * cols;
 
-    for(size_t i = 0; i < cols; ++i) {
-      rowOut[i] += rowIn[i];
+      for(size_t i = begin; i < end; ++i) {
+        rowOut[i] += rowIn[i];
+      }
     }
-  }
+  });
 }
 
 void CopyCols(Tensor out_,
@@ -674,40 +568,32 @@ void PasteCols(Tensor out_,
   }
 }
 
-#if 0 // this version seems to actually be buggy, but also not used in decoding?
-// Optimized version of Select for axis=2
-// @TODO: make this generally fast without this special version
-void SelectAxis2(Tensor out,
-             const Tensor in,
-             const Tensor indices) {
-
-  std::cerr << indices->debug() << std::endl;
-
-  matchOrAbort<IndexType>(indices->type());
-
-  functional::Shape outShape = out->shape();
-  functional::Shape inShape = in->shape();
-
-  auto idxData = indices->data<IndexType>();
-  auto odata = out->data();
-  const auto idata = in->data();
-
-  int size = outShape[3];
-
-  for(int k = 0; k < outShape[0]; ++k) {
-    for(int j = 0; j < outShape[1]; ++j) {
-      int outOffset = k * j * outShape[2] * size + j * outShape[2] * size;
-      int inOffset = k * j * inShape[2] * size + j * inShape[2] * size;
-      for(int i = 0; i < outShape[2]; ++i) {
-        auto idx = idxData[i];
-        int outIndex = outOffset +   i * size;
-        int inIndex  = inOffset  + idx * size;
-        std::copy(idata + inIndex, idata + inIndex + size, odata + outIndex);
-      }
-    }
+// Select() and Insert() work on [outer, axis, inner] blocks of 'out' and 'in', which only differ in
+// the size of 'axis'. If the indices do not vary within the inner dimensions, which is the case for
+// beam reordering and batch subselection of [beam, time, batch, dim] states, every index moves a
+// contiguous block of 'inner' values. Returns false if there is no such block structure.
+static bool indexBlocks(const functional::Shape& shape,
+                        const functional::Shape& idxShape,
+                        int axis,
+                        size_t& outer,
+                        size_t& inner,
+                        bool& direct) {
+  outer = 1;
+  inner = 1;
+  direct = true; // the indices are not broadcast, hence block i uses index i
+  for(int i = 0; i < (int)functional::Shape::size(); ++i) {
+    if(i < axis)
+      outer *= shape[i];
+    else if(i > axis)
+      inner *= shape[i];
+
+    if(i > axis && idxShape[i] != 1)
+      return false;
+    if(i <= axis && idxShape[i] != shape[i])
+      direct = false;
   }
+  return true;
 }
-#endif
 
 void Select(Tensor out,
             const Tensor in,
@@ -715,8 +601,8 @@ void Select(Tensor out,
             int axis) {
 
   matchOrAbort<IndexType>(indices->type());
+  ABORT_IF(out->type() != in->type(), "Select: types of input {} and output {} differ", in->type(), out->type());
 
-  // @TODO: make this efficient
   functional::Shape outShape = out->shape();
   functional::Shape inShape  = in->shape();
   functional::Shape idxShape = indices->shape();
@@ -725,17 +611,41 @@ void Select(Tensor out,
   functional::Array<int, functional::Shape::size()> dims;
   int axisCPU = (int)(axis + functional::Shape::size() - out->shape().size());
 
-#if 0 // buggy but not really used?
-  if(axisCPU == 2 && outShape == idxShape) // specialization for axis==2 when there is no broadcasting, @TODO to be removed once we have a faster implementation below
-    return SelectAxis2(out, in, indices);
-#endif
+  // values are only moved, hence they are copied as bytes and any element type works, e.g. the
+  // short-listed rows of bfloat16 output weights
+  size_t bytes = sizeOf(in->type());
+  const char* src = in->data<char>();
+  char* dst = out->data<char>();
+
+  size_t outer, inner;
+  bool direct;
+  if(indexBlocks(outShape, idxShape, axisCPU, outer, inner, direct)) {
+    size_t axisOut = outShape[axisCPU], axisIn = inShape[axisCPU];
+    const IndexType* idx = indices->data<IndexType>();
+
+    size_t grain = std::max(ELEMENT_GRAIN / std::max(inner, (size_t)1), (size_t)1);
+    parallelFor(outer * axisOut, grain, [&](size_t begin, size_t end) {
+      functional::Array<int, functional::Shape::size()> blockDims;
+      for(size_t block = begin; block < end; ++block) {
+        size_t k = block;
+        if(!direct) {
+          outShape.dims((int)(block * inner), blockDims);
+          k = idxShape.bindex(blockDims);
+        }
+        const char* from = src + ((block / axisOut) * axisIn + idx[k]) * inner * bytes;
+        std::memcpy(dst + block * inner * bytes, from, inner * bytes);
+      }
+    });
+    return;
+  }
 
+  // general case, the indices vary within the inner dimensions
   for(int index = 0; index < length; ++index) {
     outShape.dims(index, dims);                                // compute dimension-based indices from global index;
     int idxIndex = idxShape.bindex(dims);                      // return global index for indices based on dimension-specific indices from out, take broadcasting into account;
     dims[axisCPU] = (int)indices->data<IndexType>()[idxIndex]; // substitute index of out-tensor with corresponding axis-local position from in-tensor;
     int inIndex = inShape.index(dims);                         // compute global index from dimension-specific indices, no broadcasting as out and in match in all dimensions apart from axis
-    out->data()[index] = in->data()[inIndex];                  // assign corresponding values.
+    std::memcpy(dst + index * bytes, src + inIndex * bytes, bytes); // assign corresponding values.
   }
 }
 
@@ -746,8 +656,10 @@ void Insert(Tensor out,
             int axis) {
 
   matchOrAbort<IndexType>(indices->type());
+  ABORT_IF(out->type() != in->type(), "Insert: types of input {} and output {} differ", in->type(), out->type());
+  if(add) // only copies work on other element types, see Select()
+    matchOrAbort<float>(out->type());
 
-  // @TODO: make this efficient
   functional::Shape outShape = out->shape();
   functional::Shape inShape  = in->shape();
   functional::Shape idxShape = indices->shape();
@@ -756,6 +668,40 @@ void Insert(Tensor out,
   functional::Array<int, functional::Shape::size()> dims;
   int axisCPU = (int)(axis + functional::Shape::size() - out->shape().size());
 
+  size_t bytes = sizeOf(in->type());
+
+  size_t outer, inner;
+  bool direct;
+  if(indexBlocks(inShape, idxShape, axisCPU, outer, inner, direct)) {
+    size_t axisOut = outShape[axisCPU], axisIn = inShape[axisCPU];
+    const IndexType* idx = indices->data<IndexType>();
+    const char* src = in->data<char>();
+    char* dst = out->data<char>();
+
+    // indices may repeat along the axis, hence the threads split the outer dimensions only
+    size_t grain = std::max(ELEMENT_GRAIN / std::max(axisIn * inner, (size_t)1), (size_t)1);
+    parallelFor(outer, grain, [&](size_t begin, size_t end) {
+      functional::Array<int, functional::Shape::size()> blockDims;
+      for(size_t block = begin * axisIn; block < end * axisIn; ++block) {
+        size_t k = block;
+        if(!direct) {
+          inShape.dims((int)(block * inner), blockDims);
+          k = idxShape.bindex(blockDims);
+        }
+        const char* from = src + block * inner * bytes;
+        char* to = dst + ((block / axisIn) * axisOut + idx[k]) * inner * bytes;
+        if(add) {
+          for(size_t i = 0; i < inner; ++i)
+            ((float*)to)[i] += ((const float*)from)[i];
+        } else {
+          std::memcpy(to, from, inner * bytes);
+        }
+      }
+    });
+    return;
+  }
+
+  // general case, the indices vary within the inner dimensions
   for(int index = 0; index < length; ++index) {
     inShape.dims(index, dims);
     int idxIndex = idxShape.bindex(dims); // broadcast index into indices tensor
@@ -764,55 +710,195 @@ void Insert(Tensor out,
     if(add)
       out->data()[outIndex] += in->data()[index];
     else
-      out->data()[outIndex] = in->data()[index];
+      std::memcpy(out->data<char>() + outIndex * bytes, in->data<char>() + index * bytes, bytes);
   }
 }
 
 template void Insert<true>(Tensor out, const Tensor in, const Tensor indices, int axis);
 template void Insert<false>(Tensor out, const Tensor in, const Tensor indices, int axis);
 
-void GRUFastForward(Tensor out_, std::vector<Tensor> inputs, bool final) {
+// Multi-head attention over q [beam, batch, time q, model] and k, v [beam or 1, batch, time k, model]
+// with heads side-by-side in the model dimension. Each (sequence, head) pair processes tiles of
+// queries against tiles of keys and keeps a running maximum and sum per query (online softmax),
+// hence the attention weights only ever exist for one tile.
+void FusedAttention(Tensor out,
+                    const Tensor q,
+                    const Tensor k,
+                    const Tensor v,
+                    const Tensor mask,
+                    int dimHeads,
+                    float scale) {
+  const int queryTile = 16;
+  const int keyTile   = 64;
+
+  int dimBeam  = q->shape()[-4];
+  int dimBatch = q->shape()[-3];
+  int dimQuery = q->shape()[-2];
+  int dimModel = q->shape()[-1];
+  int beamKV   = k->shape()[-4];
+  int dimKeys  = k->shape()[-2];
+  int dimDepth = dimModel / dimHeads;
+
+  // mask: [1 or (beam *) batch, 1, 1 or time q, 1 or time k], a single key position is broadcast like
+  // the step mask of decoder self-attention, which attends to all cached positions
+  int maskBatch = mask ? mask->shape()[-4] : 1;
+  int maskQuery = mask ? mask->shape()[-2] : 1;
+  int maskKeys  = mask ? mask->shape()[-1] : 1;
+  ABORT_IF(mask && ((maskKeys != dimKeys && maskKeys != 1) || mask->shape()[-3] != 1),
+           "Attention mask {} does not match keys {}", mask->shape(), k->shape());
+
+  const float* qData = q->data();
+  const float* kData = k->data();
+  const float* vData = v->data();
+  const float* maskData = mask ? mask->data() : nullptr;
+  float* outData = out->data();
+
+  size_t pairs = (size_t)dimBeam * dimBatch * dimHeads;
+  size_t work = (size_t)dimQuery * dimKeys * dimDepth;
+  size_t grain = std::max(SMALL_GEMM_FLOPS / std::max(work, (size_t)1), (size_t)1);
+  parallelFor(pairs, grain, [&](size_t begin, size_t end) {
+    std::vector<float> scores(queryTile * keyTile), acc(queryTile * dimDepth);
+    std::vector<float> rowMax(queryTile), rowSum(queryTile);
+
+    for(size_t pair = begin; pair < end; ++pair) {
+      int head = (int)(pair % dimHeads);
+      size_t seq = pair / dimHeads; // beam * dimBatch + batch
+      size_t seqKV = beamKV == 1 ? seq % dimBatch : seq;
+
+      const float* qBase = qData + seq * dimQuery * dimModel + head * dimDepth;
+      const float* kBase = kData + seqKV * dimKeys * dimModel + head * dimDepth;
+      const float* vBase = vData + seqKV * dimKeys * dimModel + head * dimDepth;
+      float* outBase = outData + seq * dimQuery * dimModel + head * dimDepth;
+      const float* maskBase = maskData ? maskData + (seq % maskBatch) * maskQuery * maskKeys : nullptr;
+
+      for(int t0 = 0; t0 < dimQuery; t0 += queryTile) {
+        int rows = std::min(queryTile, dimQuery - t0);
+        std::fill(rowMax.begin(), rowMax.end(), -std::numeric_limits<float>::infinity());
+        std::fill(rowSum.begin(), rowSum.end(), 0.f);
+        std::fill(acc.begin(), acc.end(), 0.f);
+
+        for(int j0 = 0; j0 < dimKeys; j0 += keyTile) {
+          int cols = std::min(keyTile, dimKeys - j0);
+          // scores = scale * q * k^T for the tile
+          smallSgemm(false, true, rows, cols, dimDepth, scale,
+                     qBase + (size_t)t0 * dimModel, dimModel,
+                     kBase + (size_t)j0 * dimModel, dimModel,
+                     0.f, scores.data(), cols);
+
+          for(int r = 0; r < rows; ++r) {
+            float* row = scores.data() + r * cols;
+            if(maskBase) {
+              const float* maskRow = maskBase + (maskQuery == 1 ? 0 : t0 + r) * maskKeys;
+              if(maskKeys == 1) {
+                for(int j = 0; j < cols; ++j)
+                  row[j] += maskRow[0];
+              } else {
+                for(int j = 0; j < cols; ++j)
+                  row[j] += maskRow[j0 + j];
+              }
+            }
+            float newMax = rowMax[r];
+            for(int j = 0; j < cols; ++j)
+              newMax = std::max(newMax, row[j]);
+
+            // rescale what was accumulated with the previous maximum
+            float correction = std::exp(rowMax[r] - newMax);
+            float sum = rowSum[r] * correction;
+            float* accRow = acc.data() + r * dimDepth;
+            for(int d = 0; d < dimDepth; ++d)
+              accRow[d] *= correction;
+
+            for(int j = 0; j < cols; ++j) {
+              row[j] = std::exp(row[j] - newMax);
+              sum += row[j];
+            }
+            rowMax[r] = newMax;
+            rowSum[r] = sum;
+          }
+
+          // acc += softmax numerators * v for the tile
+          smallSgemm(false, false, rows, dimDepth, cols, 1.f,
+                     scores.data(), cols,
+                     vBase + (size_t)j0 * dimModel, dimModel,
+                     1.f, acc.data(), dimDepth);
+        }
+
+        for(int r = 0; r < rows; ++r) {
+          float* outRow = outBase + (size_t)(t0 + r) * dimModel;
+          const float* accRow = acc.data() + r * dimDepth;
+          float norm = 1.f / rowSum[r];
+          for(int d = 0; d < dimDepth; ++d)
+            outRow[d] = accRow[d] * norm;
+        }
+      }
+    }
+  });
+}
+
+template <typename FType>
+void GRUFastForwardTyped(Tensor out_, const std::vector<Tensor>& inputs, bool final) {
   int rows = out_->shape().elements() / out_->shape().back();
-  int cols = out_->shape().back();
 
-  float* out = out_->data();
+  int fVecSize = sizeof(FType) / sizeof(float);
+  int cols = out_->shape().back() / fVecSize;
 
-  const float* state = inputs[0]->data();
-  const float* xW = inputs[1]->data();
-  const float* sU = inputs[2]->data();
-  const float* b = inputs[3]->data();
+  FType* out = out_->data<FType>();
+
+  const FType* state = inputs[0]->data<FType>();
+  const FType* xW = inputs[1]->data<FType>();
+  const FType* sU = inputs[2]->data<FType>();
+  const FType* b = inputs[3]->data<FType>();
   const float* mask = inputs.size() > 4 ? inputs[4]->data() : nullptr;
 
+  using fop = functional::Ops<FType>;
+
 #pragma omp parallel for
   for(int j = 0; j < rows; ++j) {
     float m = !mask || mask[j];
-    float* rowOut = out + j * cols;
-    const float* rowState = state + j * cols;
+    FType* rowOut = out + j * cols;
+    const FType* rowState = state + j * cols;
 
-    const float* xWrow = xW + j * cols * 3;
-    const float* sUrow = sU + j * cols * 3;
+    const FType* xWrow = xW + j * cols * 3;
+    const FType* sUrow = sU + j * cols * 3;
 
-#pragma omp simd
     for(int i = 0; i < cols; ++i) {
-      float r = functional::Ops<float>::sigmoid(xWrow[i] + sUrow[i] + b[i]);
+      FType r = fop::sigmoid(fop::add(fop::add(xWrow[i], sUrow[i]), b[i]));
 
       int k = i + cols;
 
-      float z = functional::Ops<float>::sigmoid(xWrow[k] + sUrow[k] + b[k]);
+      FType z = fop::sigmoid(fop::add(fop::add(xWrow[k], sUrow[k]), b[k]));
 
       int l = i + 2 * cols;
-      float h;
+      FType h;
       if(final)
-        h = std::tanh(xWrow[l] + (sUrow[l] + b[l]) * r);
+        h = fop::tanh(fop::add(xWrow[l], fop::mul(fop::add(sUrow[l], b[l]), r)));
       else
-        h = std::tanh(xWrow[l] + sUrow[l] * r + b[l]);
+        h = fop::tanh(fop::add(fop::add(xWrow[l], fop::mul(sUrow[l], r)), b[l]));
 
-      float o = (1.0f - z) * h + z * rowState[i];
-      rowOut[i] = m * o + (1 - m) * rowState[i];
+      FType o = fop::add(fop::mul(fop::sub(1.f, z), h), fop::mul(z, rowState[i]));
+      rowOut[i] = fop::add(fop::mul(m, o), fop::mul(1.f - m, rowState[i]));
     }
   }
 }
 
+void GRUFastForward(Tensor out, std::vector<Tensor> inputs, bool final) {
+  int cols = out->shape()[-1];
+#ifdef __AVX512F__
+  if(cols % 16 == 0)
+    GRUFastForwardTyped<float32x16>(out, inputs, final);
+  else
+#endif
+#ifdef __AVX__
+  if(cols % 8 == 0)
+    GRUFastForwardTyped<float32x8>(out, inputs, final);
+  else
+#endif
+  if(cols % 4 == 0)
+    GRUFastForwardTyped<float32x4>(out, inputs, final);
+  else
+    GRUFastForwardTyped<float>(out, inputs, final);
+}
+
 void GRUFastBackward(Ptr<Allocator> /*allocator*/,
                      std::vector<Tensor> outputs,
                      std::vector<Tensor> inputs,
@@ -906,41 +992,87 @@ void GRUFastBackward(Ptr<Allocator> /*allocator*/,
   }
 }
 
+// the columns of a row are split into chunks of this size for the cross-entropy reductions
+const size_t CROSS_ENTROPY_CHUNK = 2048;
+
+// Per-row maximum, sum of exp(x - max) and sum of x. Each fixed chunk of columns is reduced first
+// and the chunks of a row are then combined in order, hence the results do not depend on the
+// number of threads. Rows and chunks are split over the threads.
+static void CrossEntropyRowStats(const float* in,
+                                 size_t rows,
+                                 size_t cols,
+                                 std::vector<float>& rowMax,
+                                 std::vector<float>& rowSumExp,
+                                 std::vector<float>& rowSum) {
+  size_t chunks = (cols + CROSS_ENTROPY_CHUNK - 1) / CROSS_ENTROPY_CHUNK;
+  std::vector<float> partials(rows * chunks * 3);
+
+  size_t grain = std::max(ELEMENT_GRAIN / CROSS_ENTROPY_CHUNK, (size_t)1);
+  parallelFor(rows * chunks, grain, [&](size_t begin, size_t end) {
+    for(size_t item = begin; item < end; ++item) {
+      size_t offset = (item % chunks) * CROSS_ENTROPY_CHUNK;
+      size_t n = std::min(CROSS_ENTROPY_CHUNK, cols - offset);
+      const float* sp = in + (item / chunks) * cols + offset;
+
+      float max = sp[0];
+      #pragma omp simd reduction(max : max)
+      for(size_t i = 1; i < n; ++i) {
+        max = std::max(max, sp[i]);
+      }
+
+      float sumexp = 0.f, sum = 0.f;
+      #pragma omp simd reduction(+ : sumexp, sum)
+      for(size_t i = 0; i < n; ++i) {
+        sumexp += std::exp(sp[i] - max);
+        sum += sp[i];
+      }
+
+      partials[3 * item + 0] = max;
+      partials[3 * item + 1] = sumexp;
+      partials[3 * item + 2] = sum;
+    }
+  });
+
+  rowMax.resize(rows);
+  rowSumExp.resize(rows);
+  rowSum.resize(rows);
+  for(size_t j = 0; j < rows; ++j) {
+    const float* p = partials.data() + 3 * j * chunks;
+    float max = p[0];
+    for(size_t c = 1; c < chunks; ++c)
+      max = std::max(max, p[3 * c]);
+    float sumexp = 0.f, sum = 0.f;
+    for(size_t c = 0; c < chunks; ++c) {
+      sumexp += p[3 * c + 1] * std::exp(p[3 * c] - max);
+      sum += p[3 * c + 2];
+    }
+    rowMax[j] = max;
+    rowSumExp[j] = sumexp;
+    rowSum[j] = sum;
+  }
+}
+
 void CrossEntropyPick(Tensor out, Tensor in, Tensor labelIndices, float labelSmoothingAlpha = 0.f) {
   matchOrAbort<IndexType>(labelIndices->type());
 
   // Shape& outShape = out_->shape();
   Shape& inShape = in->shape();
 
-  int rows = inShape.elements() / inShape.back();
-  int cols = inShape.back();
-
-  #pragma omp parallel for
-  for(int j = 0; j < rows; ++j) {
-    const float* sp = in->data() + j * cols;
-    float max = sp[0];
-    #pragma omp simd reduction(max : max)
-    for(int i = 1; i < cols; ++i) {
-      max = std::max(max, sp[i]);
-    }
+  size_t rows = inShape.elements() / inShape.back();
+  size_t cols = inShape.back();
 
-    float sumexp = 0.f;
-    #pragma omp simd reduction(+ : sumexp)
-    for(int i = 0; i < cols; ++i) {
-      sumexp += std::exp(sp[i] - max);
-    }
+  std::vector<float> rowMax, rowSumExp, rowSum;
+  CrossEntropyRowStats(in->data(), rows, cols, rowMax, rowSumExp, rowSum);
 
-    float mean = 0.f;
-    #pragma omp simd reduction(+ : mean)
-    for(int i = 0; i < cols; ++i) {
-      mean += sp[i] - max;
-    }
-    mean /= (float)cols;
+  for(size_t j = 0; j < rows; ++j) {
+    const float* sp = in->data() + j * cols;
+    float max = rowMax[j];
+    float mean = rowSum[j] / (float)cols - max; // mean of x - max
 
     // Groundtruth label index
     IndexType i = labelIndices->data<IndexType>()[j];
     // This appears to be safe i.e. that i >= 0 && i < cols is known
-    float logsumexp = std::log(sumexp);
+    float logsumexp = std::log(rowSumExp[j]);
     float ce = logsumexp - sp[i] + max; // -log(p_i) = - logsoftmax(x_i - max) = - (x_i - max) - log(sum_j exp(x_j - max))
     float ls = logsumexp - mean; 
     out->data()[j] = (1.f - labelSmoothingAlpha) * ce + labelSmoothingAlpha * ls;
@@ -956,43 +1088,80 @@ void CrossEntropyPickBackward(Tensor out,
   matchOrAbort<IndexType>(labelIndices->type());
   Shape& outShape = out->shape();
 
-  int rows = outShape.elements() / outShape.back();
-  int cols = outShape.back();
-
-#pragma omp parallel for
-  for(int j = 0; j < rows; ++j) {
-    const float* sp = in->data() + j * cols;
-    float* so = out->data() + j * cols;
-
-    float max = sp[0];
-    for(int i = 1; i < cols; ++i) {
-      max = std::max(max, sp[i]);
+  size_t rows = outShape.elements() / outShape.back();
+  size_t cols = outShape.back();
+
+  std::vector<float> rowMax, rowSumExp, rowSum;
+  CrossEntropyRowStats(in->data(), rows, cols, rowMax, rowSumExp, rowSum);
+
+  size_t chunks = (cols + CROSS_ENTROPY_CHUNK - 1) / CROSS_ENTROPY_CHUNK;
+  size_t grain = std::max(ELEMENT_GRAIN / CROSS_ENTROPY_CHUNK, (size_t)1);
+  parallelFor(rows * chunks, grain, [&](size_t begin, size_t end) {
+    for(size_t item = begin; item < end; ++item) {
+      size_t j = item / chunks;
+      size_t offset = (item % chunks) * CROSS_ENTROPY_CHUNK;
+      size_t n = std::min(CROSS_ENTROPY_CHUNK, cols - offset);
+      const float* sp = in->data() + j * cols;
+      float* so = out->data() + j * cols;
+
+      float max = rowMax[j];
+      float sumexp = rowSumExp[j];
+      float a = adj->data()[j];
+      size_t label = (size_t)labelIndices->data<IndexType>()[j];
+
+      // cross-entropy
+      for(size_t i = offset; i < offset + n; ++i) {
+        float sub = (float)(i == label); // delta, true if label index and column index match
+        float dce = std::exp(sp[i] - max) / sumexp - sub
+                  + labelSmoothingAlpha * (sub - 1.f / (float)cols);
+        so[i] += a * dce;
+      }
     }
+  });
+}
 
-    float sumexp = 0.f;
-    for(int i = 0; i < cols; ++i) {
-      sumexp += std::exp(sp[i] - max);
+// Sums per-row contributions to the gradients of column-wise parameters such as gamma and beta in
+// two phases: fixed blocks of rows accumulate into their own partial row, then the partial rows are
+// combined pairwise in a fixed tree. Neither depends on the number of threads, nor does the result.
+// blockFn(begin, end, partial) handles rows [begin, end) and adds its contributions to partial[0:width].
+template <class BlockFn>
+std::vector<float> reduceRowBlocks(size_t rows, size_t width, const BlockFn& blockFn) {
+  const size_t maxBlocks = 256;
+  size_t blockRows = std::max((size_t)32, (rows + maxBlocks - 1) / maxBlocks);
+  size_t blocks = std::max((rows + blockRows - 1) / blockRows, (size_t)1);
+
+  std::vector<float> partials(blocks * width, 0.f);
+  parallelFor(blocks, 1, [&](size_t begin, size_t end) {
+    for(size_t block = begin; block < end; ++block)
+      blockFn(block * blockRows, std::min(rows, (block + 1) * blockRows), partials.data() + block * width);
+  });
+
+  size_t grain = std::max(ELEMENT_GRAIN / blocks, (size_t)64);
+  parallelFor(width, grain, [&](size_t begin, size_t end) {
+    for(size_t stride = 1; stride < blocks; stride *= 2) {
+      for(size_t block = 0; block + stride < blocks; block += 2 * stride) {
+        float* dst = partials.data() + block * width;
+        const float* src = dst + stride * width;
+        for(size_t i = begin; i < end; ++i)
+          dst[i] += src[i];
+      }
     }
+  });
 
-    // cross-entropy
-    for(int i = 0; i < cols; ++i) {
-      float sub = (float)(i == (int)labelIndices->data<IndexType>()[j]); // delta, true if label index and column index match
-      float dce = std::exp(sp[i] - max) / sumexp - sub 
-                + labelSmoothingAlpha * (sub - 1.f / (float)cols);
-      so[i] += adj->data()[j] * dce;
-    }
-  }
+  partials.resize(width);
+  return partials;
 }
 
 float L2Norm(Tensor in, Ptr<Allocator> /*not used*/) {
-  float sum = 0.f;
   size_t size = in->size();
   const float* data = in->data();
-  #pragma omp parallel for simd reduction(+ : sum)
-  for(size_t i = 0; i < size; ++i) {
-    sum += data[i] * data[i];
-  }
-  return std::sqrt(sum);
+  auto sum = reduceRowBlocks(size, 1, [&](size_t begin, size_t end, float* partial) {
+    float blockSum = 0.f;
+    for(size_t i = begin; i < end; ++i)
+      blockSum += data[i] * data[i];
+    partial[0] = blockSum;
+  });
+  return std::sqrt(sum[0]);
 }
 
 void Att(Tensor out_, Tensor va_, Tensor context_, Tensor state_) {
@@ -1046,30 +1215,40 @@ void AttBack(Tensor gVa_,
   size_t k = context_->shape()[-1];
   size_t n = context_->shape()[-2];
 
-  #pragma omp parallel for reduction(+ : gState[:n * k], gVa[:k])
-  for(size_t j = 0; j < m; ++j) {
-    float* gcRow = gContext + j * k;
-    float* gsRow = gState + (j % n) * k;
-
-    const float* cRow = context + j * k;
-    const float* sRow = state + (j % n) * k;
-
-    float adj_j = adj[j];
-
-    #pragma omp simd
-    for(size_t i = 0; i < k; ++i) {
-      float z = cRow[i] + sRow[i];
-
-      float t = std::tanh(z);
-      float r = va[i] * (1.f - t * t);
-
-      float r_adj_j = r * adj_j;
-      gcRow[i] += r_adj_j;
-      gsRow[i] += r_adj_j;
-
-      gVa[i] += t * adj_j;
+  // Row j of the context belongs to row j % n of the state. Each state row is handled by one thread
+  // and keeps its own contribution to gVa, which are summed in row order afterwards.
+  std::vector<float> gVaRows(n * k, 0.f);
+  parallelFor(n, 1, [&](size_t begin, size_t end) {
+    for(size_t r = begin; r < end; ++r) {
+      float* gsRow = gState + r * k;
+      const float* sRow = state + r * k;
+      float* gVaRow = gVaRows.data() + r * k;
+      for(size_t j = r; j < m; j += n) {
+        float* gcRow = gContext + j * k;
+        const float* cRow = context + j * k;
+
+        float adj_j = adj[j];
+
+        for(size_t i = 0; i < k; ++i) {
+          float z = cRow[i] + sRow[i];
+
+          float t = std::tanh(z);
+          float r_adj_j = va[i] * (1.f - t * t) * adj_j;
+          gcRow[i] += r_adj_j;
+          gsRow[i] += r_adj_j;
+
+          gVaRow[i] += t * adj_j;
+        }
+      }
     }
-  }
+  });
+
+  size_t grain = std::max(ELEMENT_GRAIN / std::max(n, (size_t)1), (size_t)64);
+  parallelFor(k, grain, [&](size_t begin, size_t end) {
+    for(size_t r = 0; r < n; ++r)
+      for(size_t i = begin; i < end; ++i)
+        gVa[i] += gVaRows[r * k + i];
+  });
 }
 
 MARIAN_FFAST_MATH_BEGIN
@@ -1152,77 +1331,53 @@ void LayerNormalization(Tensor out_,
   }
 }
 
+// gradParam[stride * i] += value[i] for a column-wise (stride 1) or scalar (stride 0) parameter
+inline void accumulateParamGrad(float* gradParam, int stride, const float* value, size_t cols) {
+  if(stride) {
+    for(size_t i = 0; i < cols; ++i)
+      gradParam[i] += value[i];
+  } else {
+    float sum = 0.f;
+    for(size_t i = 0; i < cols; ++i)
+      sum += value[i];
+    gradParam[0] += sum;
+  }
+}
+
 MARIAN_FFAST_MATH_BEGIN
-void LayerNormalizationGrad(Tensor gradX_,
-                            Tensor gradGamma_,
-                            Tensor gradBeta_,
-                            Tensor adj_,
-                            Tensor y_,
-                            Tensor x_,
-                            Tensor gamma_,
-                            Tensor beta_,
-                            float eps) {
+template <bool hasBeta>
+void LayerNormalizationGradImpl(Tensor gradX_,
+                                Tensor gradGamma_,
+                                Tensor gradBeta_,
+                                Tensor adj_,
+                                Tensor y_,
+                                Tensor x_,
+                                Tensor gamma_,
+                                Tensor beta_,
+                                float eps) {
   float* gradX = gradX_->data();
   float* gradGamma = gradGamma_->data();
-  float* gradBeta = gradBeta_ ? gradBeta_->data() : nullptr;
-  float* adj = adj_->data();
-  float* y = y_->data();
-  float* x = x_->data();
-  float* gamma = gamma_->data();
-  float* beta = beta_ ? beta_->data() : nullptr;
+  float* gradBeta = hasBeta ? gradBeta_->data() : nullptr;
+  const float* adj = adj_->data();
+  const float* y = y_->data();
+  const float* x = x_->data();
+  const float* gamma = gamma_->data();
+  const float* beta = hasBeta ? beta_->data() : nullptr;
   // @TODO: The CPU implementation supports scalar gamma and beta. This is a left-over,
   //        we should enable that in the GPU version as well.
   const int gammaStride = gamma_->shape().back() > 1;  // broadcasting for alpha and beta. 0 means it's a scalar
-  const int betaStride = beta_ && beta_->shape().back() > 1;
+  const int betaStride = hasBeta && beta_->shape().back() > 1;
 
   size_t rows = y_->shape().elements() / y_->shape()[-1];
   size_t cols = y_->shape()[-1];
 
-  if(beta) {
-    #pragma omp parallel for reduction(+ : gradGamma[:cols], gradBeta[:cols])
-    for(size_t j = 0; j < rows; ++j) {
-      const float* xRow = x + j * cols;
-      const float* yRow = y + j * cols;
-      const float* adjRow = adj + j * cols;
-      float* gradXRow = gradX + j * cols;
-
-      float sum_x = 0.f;
-      float sum_adj = 0.f;
-      float sum_adj_x = 0.f;
-      float sum_sqr = 0.f;
-
-      #pragma omp simd reduction(+ : sum_x, sum_adj_x, sum_adj)
-      for(size_t i = 0; i < cols; ++i) {
-        sum_x += xRow[i];
-        sum_adj_x += adjRow[i] * (yRow[i] - (beta ? beta[betaStride * i] : 0.f)) / gamma[gammaStride * i];
-        sum_adj += adjRow[i];
-      }
+  // the partial row holds the contributions to gamma followed by those to beta
+  size_t gammaWidth = gammaStride ? cols : 1;
+  size_t betaWidth = hasBeta ? (betaStride ? cols : 1) : 0;
 
-      float mean = sum_x / cols;
-      #pragma omp simd reduction(+ : sum_sqr)
-      for(size_t i = 0; i < cols; ++i) {
-        float ex = xRow[i] - mean;
-        sum_sqr += ex * ex;
-      }
-
-      float sigma = std::sqrt(sum_sqr / cols + eps);
-      #pragma omp simd
-      for(size_t i = 0; i < cols; ++i) {
-        float grad_x = 0.f;
-        float x_hat = (yRow[i] - beta[betaStride * i]) / gamma[gammaStride * i];
-        grad_x += cols * adjRow[i];
-        grad_x -= sum_adj;
-        grad_x -= sum_adj_x * x_hat;
-        grad_x /= cols * sigma;
-
-        gradXRow[i] += gamma[gammaStride * i] * grad_x;
-        gradGamma[gammaStride * i] += adjRow[i] * x_hat;
-        gradBeta[betaStride * i] += adjRow[i];
-      }
-    }
-  } else { // @TODO: this code duplication is really ugly, but required for omp to work correctly?
-    #pragma omp parallel for reduction(+ : gradGamma[:cols])
-    for(size_t j = 0; j < rows; ++j) {
+  auto sums = reduceRowBlocks(rows, gammaWidth + betaWidth, [&](size_t begin, size_t end, float* partial) {
+    std::vector<float> xHat(cols), adjXHat(cols);
+    for(size_t j = begin; j < end; ++j) {
       const float* xRow = x + j * cols;
       const float* yRow = y + j * cols;
       const float* adjRow = adj + j * cols;
@@ -1235,8 +1390,10 @@ void LayerNormalizationGrad(Tensor gradX_,
 
       #pragma omp simd reduction(+ : sum_x, sum_adj_x, sum_adj)
       for(size_t i = 0; i < cols; ++i) {
+        xHat[i] = (yRow[i] - (hasBeta ? beta[betaStride * i] : 0.f)) / gamma[gammaStride * i];
+        adjXHat[i] = adjRow[i] * xHat[i];
         sum_x += xRow[i];
-        sum_adj_x += adjRow[i] * yRow[i] / gamma[gammaStride * i];
+        sum_adj_x += adjXHat[i];
         sum_adj += adjRow[i];
       }
 
@@ -1251,20 +1408,41 @@ void LayerNormalizationGrad(Tensor gradX_,
       #pragma omp simd
       for(size_t i = 0; i < cols; ++i) {
         float grad_x = 0.f;
-        float x_hat = yRow[i] / gamma[gammaStride * i];
         grad_x += cols * adjRow[i];
         grad_x -= sum_adj;
-        grad_x -= sum_adj_x * x_hat;
+        grad_x -= sum_adj_x * xHat[i];
         grad_x /= cols * sigma;
-
         gradXRow[i] += gamma[gammaStride * i] * grad_x;
-        gradGamma[gammaStride * i] += adjRow[i] * x_hat;
       }
+
+      accumulateParamGrad(partial, gammaStride, adjXHat.data(), cols);
+      if(hasBeta)
+        accumulateParamGrad(partial + gammaWidth, betaStride, adjRow, cols);
     }
-  }
+  });
+
+  for(size_t i = 0; i < gammaWidth; ++i)
+    gradGamma[i] += sums[i];
+  for(size_t i = 0; i < betaWidth; ++i)
+    gradBeta[i] += sums[gammaWidth + i];
 }
 MARIAN_FFAST_MATH_END
 
+void LayerNormalizationGrad(Tensor gradX,
+                            Tensor gradGamma,
+                            Tensor gradBeta,
+                            Tensor adj,
+                            Tensor y,
+                            Tensor x,
+                            Tensor gamma,
+                            Tensor beta,
+                            float eps) {
+  if(beta)
+    LayerNormalizationGradImpl<true>(gradX, gradGamma, gradBeta, adj, y, x, gamma, beta, eps);
+  else
+    LayerNormalizationGradImpl<false>(gradX, gradGamma, gradBeta, adj, y, x, gamma, beta, eps);
+}
+
 MARIAN_FFAST_MATH_BEGIN
 template <int alphaStride, int betaStride, bool hasBeta>
 void RMSNormalizationImpl(float* out,
@@ -1336,34 +1514,39 @@ void RMSNormalization(Tensor out,
 }
 
 MARIAN_FFAST_MATH_BEGIN
-void RMSNormalizationGrad(Tensor gradX_,
-                          Tensor gradGamma_,
-                          Tensor gradBeta_,
-                          Tensor adj_,
-                          Tensor y_,
-                          Tensor x_,
-                          Tensor gamma_,
-                          Tensor beta_,
-                          float eps) {
+template <bool hasBeta>
+void RMSNormalizationGradImpl(Tensor gradX_,
+                              Tensor gradGamma_,
+                              Tensor gradBeta_,
+                              Tensor adj_,
+                              Tensor y_,
+                              Tensor x_,
+                              Tensor gamma_,
+                              Tensor beta_,
+                              float eps) {
   float* gradX = gradX_->data();
   float* gradGamma = gradGamma_->data();
-  float* gradBeta = gradBeta_ ? gradBeta_->data() : nullptr;
-  float* adj = adj_->data();
-  float* x = x_->data();
-  float* y = y_->data();
-  float* gamma = gamma_->data();
-  float* beta = beta_ ? beta_->data() : nullptr;
+  float* gradBeta = hasBeta ? gradBeta_->data() : nullptr;
+  const float* adj = adj_->data();
+  const float* x = x_->data();
+  const float* y = y_->data();
+  const float* gamma = gamma_->data();
+  const float* beta = hasBeta ? beta_->data() : nullptr;
   // @TODO: The CPU implementation supports scalar gamma and beta. This is a left-over,
   //        we should enable that in the GPU version as well.
   const int gammaStride = gamma_->shape().back() > 1;  // broadcasting for alpha and beta. 0 means it's a scalar
-  const int betaStride = beta_ && beta_->shape().back() > 1;
+  const int betaStride = hasBeta && beta_->shape().back() > 1;
 
   size_t rows = y_->shape().elements() / y_->shape()[-1];
   size_t cols = y_->shape()[-1];
 
-  if(beta) {
-    #pragma omp parallel for reduction(+ : gradGamma[:cols], gradBeta[:cols])
-    for(size_t j = 0; j < rows; ++j) {
+  // the partial row holds the contributions to gamma followed by those to beta
+  size_t gammaWidth = gammaStride ? cols : 1;
+  size_t betaWidth = hasBeta ? (betaStride ? cols : 1) : 0;
+
+  auto sums = reduceRowBlocks(rows, gammaWidth + betaWidth, [&](size_t begin, size_t end, float* partial) {
+    std::vector<float> rmsNorm(cols), adjRmsNorm(cols);
+    for(size_t j = begin; j < end; ++j) {
       const float* xRow = x + j * cols;
       const float* yRow = y + j * cols;
       const float* adjRow = adj + j * cols;
@@ -1374,54 +1557,48 @@ void RMSNormalizationGrad(Tensor gradX_,
 
       #pragma omp simd reduction(+ : sum_adj_r, sum_sqr)
       for(size_t i = 0; i < cols; ++i) {
-        sum_adj_r += adjRow[i] * (yRow[i] - beta[betaStride * i]) / gamma[gammaStride * i];
+        rmsNorm[i] = (yRow[i] - (hasBeta ? beta[betaStride * i] : 0.f)) / gamma[gammaStride * i];
+        adjRmsNorm[i] = adjRow[i] * rmsNorm[i];
+        sum_adj_r += adjRmsNorm[i];
         sum_sqr   += xRow[i] * xRow[i];
       }
 
       float rms = std::sqrt(sum_sqr / cols + eps);
       #pragma omp simd
       for(size_t i = 0; i < cols; ++i) {
-        float rmsNorm  = (yRow[i] - beta[betaStride * i]) / gamma[gammaStride * i];
-        float gradNorm = cols * adjRow[i] - rmsNorm * sum_adj_r;
-        gradNorm      /= cols * rms; 
-
-        gradXRow[i]                += gamma[gammaStride * i] * gradNorm;
-        gradGamma[gammaStride * i] += adjRow[i] * rmsNorm;
-        gradBeta[betaStride * i]   += adjRow[i];
-      }
-    }
-  } else {
-    #pragma omp parallel for reduction(+ : gradGamma[:cols])
-    for(size_t j = 0; j < rows; ++j) {
-      const float* xRow = x + j * cols;
-      const float* yRow = y + j * cols;
-      const float* adjRow = adj + j * cols;
-      float* gradXRow = gradX + j * cols;
-
-      float sum_adj_r = 0.f;
-      float sum_sqr = 0.f;
-
-      #pragma omp simd reduction(+ : sum_adj_r, sum_sqr)
-      for(size_t i = 0; i < cols; ++i) {
-        sum_adj_r += yRow[i] / gamma[gammaStride * i];
-        sum_sqr += xRow[i] * xRow[i];
+        float gradNorm = cols * adjRow[i] - rmsNorm[i] * sum_adj_r;
+        gradNorm      /= cols * rms;
+        gradXRow[i]   += gamma[gammaStride * i] * gradNorm;
       }
 
-      float rms = std::sqrt(sum_sqr / cols + eps);
-      #pragma omp simd
-      for(size_t i = 0; i < cols; ++i) {
-        float rmsNorm  = yRow[i] / gamma[gammaStride * i];
-        float gradNorm = cols * adjRow[i] - rmsNorm * sum_adj_r;
-        gradNorm      /= cols * rms; 
-
-        gradXRow[i]                += gamma[gammaStride * i] * gradNorm;
-        gradGamma[gammaStride * i] += adjRow[i] * rmsNorm;
-      }
+      accumulateParamGrad(partial, gammaStride, adjRmsNorm.data(), cols);
+      if(hasBeta)
+        accumulateParamGrad(partial + gammaWidth, betaStride, adjRow, cols);
     }
-  }
+  });
+
+  for(size_t i = 0; i < gammaWidth; ++i)
+    gradGamma[i] += sums[i];
+  for(size_t i = 0; i < betaWidth; ++i)
+    gradBeta[i] += sums[gammaWidth + i];
 }
 MARIAN_FFAST_MATH_END
 
+void RMSNormalizationGrad(Tensor gradX,
+                          Tensor gradGamma,
+                          Tensor gradBeta,
+                          Tensor adj,
+                          Tensor y,
+                          Tensor x,
+                          Tensor gamma,
+                          Tensor beta,
+                          float eps) {
+  if(beta)
+    RMSNormalizationGradImpl<true>(gradX, gradGamma, gradBeta, adj, y, x, gamma, beta, eps);
+  else
+    RMSNormalizationGradImpl<false>(gradX, gradGamma, gradBeta, adj, y, x, gamma, beta, eps);
+}
+
 void Shift(Tensor out_,
            Tensor in_,
            marian::Shape shift,
@@ -1521,6 +1698,11 @@ void LSTMCellForwardTyped(Tensor out_, const std::vector<Tensor>& inputs) {
 
 void LSTMCellForward(Tensor out, std::vector<Tensor> inputs) {
   int cols = out->shape()[-1];
+#ifdef __AVX512F__
+  if(cols % 16 == 0)
+    LSTMCellForwardTyped<float32x16>(out, inputs);
+  else
+#endif
 #ifdef __AVX__
   if(cols % 8 == 0)
     LSTMCellForwardTyped<float32x8>(out, inputs);
@@ -1565,6 +1747,11 @@ void LSTMOutputForwardTyped(Tensor out_, const std::vector<Tensor>& inputs) {
 void LSTMOutputForward(Tensor out, std::vector<Tensor> inputs) {
   int cols = out->shape()[-1];
 
+#ifdef __AVX512F__
+  if(cols % 16 == 0)
+    LSTMOutputForwardTyped<float32x16>(out, inputs);
+  else
+#endif
 #ifdef __AVX__
   if(cols % 8 == 0)
     LSTMOutputForwardTyped<float32x8>(out, inputs);
@@ -0,0 +1,207 @@
+#include "tensors/cpu/transpose.h"
+#include "tensors/cpu/parallel.h"
+#include "common/logging.h"
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+namespace marian {
+namespace cpu {
+
+namespace {
+
+const int TILE = 32;              // 2D transposes work on TILE x TILE blocks, 8 KB for input and output stay in L1
+const size_t GRAIN = 1 << 14;     // minimum number of elements per thread
+
+struct Axis {
+  size_t size;
+  size_t inStride;
+  size_t outStride;
+};
+
+// in and out offsets of the index-th combination of the given axes, the last axis runs fastest
+inline void offsets(const std::vector<Axis>& axes, size_t index, size_t& inOffset, size_t& outOffset) {
+  inOffset = outOffset = 0;
+  for(int i = (int)axes.size() - 1; i >= 0; --i) {
+    size_t k = index % axes[i].size;
+    index /= axes[i].size;
+    inOffset += k * axes[i].inStride;
+    outOffset += k * axes[i].outStride;
+  }
+}
+
+// out[c * ldOut + r] (+)= in[r * ldIn + c] for r in [r0, r1) and c in [c0, c1)
+inline void transposeScalar(const float* in, size_t ldIn, float* out, size_t ldOut, int r0, int r1, int c0, int c1, bool add) {
+  for(int c = c0; c < c1; ++c) {
+    float* outRow = out + c * ldOut;
+    if(add)
+      for(int r = r0; r < r1; ++r)
+        outRow[r] += in[r * ldIn + c];
+    else
+      for(int r = r0; r < r1; ++r)
+        outRow[r] = in[r * ldIn + c];
+  }
+}
+
+#ifdef __AVX__
+template <bool add>
+inline void transpose8x8(const float* in, size_t ldIn, float* out, size_t ldOut) {
+  __m256 r0 = _mm256_loadu_ps(in + 0 * ldIn);
+  __m256 r1 = _mm256_loadu_ps(in + 1 * ldIn);
+  __m256 r2 = _mm256_loadu_ps(in + 2 * ldIn);
+  __m256 r3 = _mm256_loadu_ps(in + 3 * ldIn);
+  __m256 r4 = _mm256_loadu_ps(in + 4 * ldIn);
+  __m256 r5 = _mm256_loadu_ps(in + 5 * ldIn);
+  __m256 r6 = _mm256_loadu_ps(in + 6 * ldIn);
+  __m256 r7 = _mm256_loadu_ps(in + 7 * ldIn);
+
+  // interleave pairs of rows, then pairs of pairs within each 128-bit lane, then swap lanes
+  __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+  __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+  __m256 o[8] = {_mm256_permute2f128_ps(s0, s4, 0x20),
+                 _mm256_permute2f128_ps(s1, s5, 0x20),
+                 _mm256_permute2f128_ps(s2, s6, 0x20),
+                 _mm256_permute2f128_ps(s3, s7, 0x20),
+                 _mm256_permute2f128_ps(s0, s4, 0x31),
+                 _mm256_permute2f128_ps(s1, s5, 0x31),
+                 _mm256_permute2f128_ps(s2, s6, 0x31),
+                 _mm256_permute2f128_ps(s3, s7, 0x31)};
+
+  for(int i = 0; i < 8; ++i) {
+    float* outRow = out + i * ldOut;
+    _mm256_storeu_ps(outRow, add ? _mm256_add_ps(_mm256_loadu_ps(outRow), o[i]) : o[i]);
+  }
+}
+#endif
+
+// Transposes a rows x cols block, out[c * ldOut + r] (+)= in[r * ldIn + c]
+void transposeTile(const float* in, size_t ldIn, float* out, size_t ldOut, int rows, int cols, bool add) {
+  int r = 0;
+#ifdef __AVX__
+  for(; r + 8 <= rows; r += 8) {
+    int c = 0;
+    for(; c + 8 <= cols; c += 8) {
+      if(add)
+        transpose8x8<true>(in + r * ldIn + c, ldIn, out + c * ldOut + r, ldOut);
+      else
+        transpose8x8<false>(in + r * ldIn + c, ldIn, out + c * ldOut + r, ldOut);
+    }
+    transposeScalar(in, ldIn, out, ldOut, r, r + 8, c, cols, add);
+  }
+#endif
+  transposeScalar(in, ldIn, out, ldOut, r, rows, 0, cols, add);
+}
+
+}  // namespace
+
+void permute(const float* in, const std::vector<int>& shape, float* out, const std::vector<int>& perm, bool add) {
+  int rank = (int)shape.size();
+  ABORT_IF((int)perm.size() != rank, "Permutation {} does not match the rank of the tensor", perm.size());
+
+  std::vector<size_t> inStrides(rank);
+  size_t total = 1;
+  for(int i = rank - 1; i >= 0; --i) {
+    inStrides[i] = total;
+    total *= shape[i];
+  }
+  if(total == 0)
+    return;
+
+  // output axes from outer to inner without unit axes, neighbours in both tensors are merged
+  std::vector<Axis> axes;
+  for(int i = 0; i < rank; ++i) {
+    int a = perm[i];
+    if(shape[a] == 1)
+      continue;
+    if(!axes.empty() && axes.back().inStride == inStrides[a] * shape[a]) {
+      axes.back().size *= shape[a];
+      axes.back().inStride = inStrides[a];
+    } else {
+      axes.push_back({(size_t)shape[a], inStrides[a], 0});
+    }
+  }
+  size_t stride = 1;
+  for(int i = (int)axes.size() - 1; i >= 0; --i) {
+    axes[i].outStride = stride;
+    stride *= axes[i].size;
+  }
+
+  if(axes.empty() || axes.back().inStride == 1) {
+    // the innermost axis stays innermost, copy contiguous rows
+    size_t cols = axes.empty() ? 1 : axes.back().size;
+    std::vector<Axis> outer(axes.begin(), axes.end() - (axes.empty() ? 0 : 1));
+    size_t grain = std::max(GRAIN / cols, (size_t)1);
+    parallelFor(total / cols, grain, [&](size_t begin, size_t end) {
+      for(size_t row = begin; row < end; ++row) {
+        size_t inOffset, outOffset;
+        offsets(outer, row, inOffset, outOffset);
+        const float* inRow = in + inOffset;
+        float* outRow = out + outOffset;
+        if(add)
+          for(size_t i = 0; i < cols; ++i)
+            outRow[i] += inRow[i];
+        else
+          std::copy(inRow, inRow + cols, outRow);
+      }
+    });
+    return;
+  }
+
+  // The innermost input axis moves outwards: transpose the plane of the innermost output axis
+  // (rows, strided in the input) and the innermost input axis (columns, strided in the output).
+  Axis rowAxis = axes.back();
+  Axis colAxis = {1, 1, 1};
+  std::vector<Axis> outer;
+  for(size_t i = 0; i + 1 < axes.size(); ++i) {
+    if(axes[i].inStride == 1)
+      colAxis = axes[i];
+    else
+      outer.push_back(axes[i]);
+  }
+
+  size_t rowTiles = (rowAxis.size + TILE - 1) / TILE;
+  size_t colTiles = (colAxis.size + TILE - 1) / TILE;
+  size_t outerSize = total / (rowAxis.size * colAxis.size);
+  size_t grain = std::max(GRAIN / (TILE * TILE), (size_t)1);
+  parallelFor(outerSize * rowTiles * colTiles, grain, [&](size_t begin, size_t end) {
+    for(size_t unit = begin; unit < end; ++unit) {
+      size_t colTile = unit % colTiles;
+      size_t rowTile = (unit / colTiles) % rowTiles;
+      size_t inOffset, outOffset;
+      offsets(outer, unit / (colTiles * rowTiles), inOffset, outOffset);
+
+      size_t r0 = rowTile * TILE, c0 = colTile * TILE;
+      int rows = (int)std::min((size_t)TILE, rowAxis.size - r0);
+      int cols = (int)std::min((size_t)TILE, colAxis.size - c0);
+      transposeTile(in + inOffset + r0 * rowAxis.inStride + c0,
+                    rowAxis.inStride,
+                    out + outOffset + c0 * colAxis.outStride + r0,
+                    colAxis.outStride,
+                    rows,
+                    cols,
+                    add);
+    }
+  });
+}
+
+}  // namespace cpu
+}  // namespace marian
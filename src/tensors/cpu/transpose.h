@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+namespace marian {
+namespace cpu {
+
+// Permutes the axes of a row-major tensor: axis i of out is axis perm[i] of in, which has the
+// dimensions given by shape. With add the permuted values are added to out instead.
+//
+// Unit axes are dropped and axes that stay neighbours are merged first. If the innermost axis
+// stays innermost, contiguous rows are copied. Otherwise the innermost input and output axes are
+// transposed in cache-sized tiles with an 8x8 AVX micro-kernel. Rows or tiles are split over the
+// intra-op threads.
+void permute(const float* in, const std::vector<int>& shape, float* out, const std::vector<int>& perm, bool add);
+
+}  // namespace cpu
+}  // namespace marian
@@ -28,6 +28,7 @@ template void copy<char>(Ptr<Backend>, const char*, const char*, char*);
 template void copy<float16>(Ptr<Backend>, const float16*, const float16*, float16*);
 template void copy<float>(Ptr<Backend>, const float*, const float*, float*);
 template void copy<double>(Ptr<Backend>, const double*, const double*, double*);
+template void copy<bfloat16>(Ptr<Backend>, const bfloat16*, const bfloat16*, bfloat16*);
 // clang-format on
 
 template <typename T>
@@ -82,6 +83,7 @@ template void fill<uint64_t>(Ptr<Backend>, uint64_t*, uint64_t*, uint64_t);
 
 template void fill<float>(Ptr<Backend>, float*, float*, float);
 template void fill<double>(Ptr<Backend>, double*, double*, double);
+template void fill<bfloat16>(Ptr<Backend>, bfloat16*, bfloat16*, bfloat16);
 
 void setSparse(Ptr<Backend> backend,
                const std::vector<size_t>& keys,
@@ -148,6 +150,7 @@ template void swap_ranges<uint64_t>(Ptr<Backend>, uint64_t*, uint64_t*, uint64_t
 
 template void swap_ranges<float>(Ptr<Backend>, float*, float*, float*);
 template void swap_ranges<double>(Ptr<Backend>, double*, double*, double*);
+template void swap_ranges<bfloat16>(Ptr<Backend>, bfloat16*, bfloat16*, bfloat16*);
 // clang-format on
 
 }  // namespace gpu
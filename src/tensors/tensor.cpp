@@ -103,6 +103,7 @@ std::string TensorBase::debug(int precision, int dispCols) {
 template std::string TensorBase::debug<float16>(int, int);
 template std::string TensorBase::debug<float  >(int, int);
 template std::string TensorBase::debug<double >(int, int);
+template std::string TensorBase::debug<bfloat16>(int, int);
 
 template std::string TensorBase::debug<uint8_t >(int, int);
 template std::string TensorBase::debug<uint16_t>(int, int);
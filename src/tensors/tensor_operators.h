@@ -322,6 +322,29 @@ static inline void Insert(Tensor out, const Tensor in, const Tensor indices, int
 
 DISPATCH7(TopK, marian::Tensor, marian::Tensor, Ptr<Allocator>, const marian::Tensor, int, int, bool);
 
+namespace cpu {
+void FusedAttention(marian::Tensor out,
+                    const marian::Tensor q,
+                    const marian::Tensor k,
+                    const marian::Tensor v,
+                    const marian::Tensor mask,
+                    int dimHeads,
+                    float scale);
+}
+
+// CPU only, see FusedAttentionNodeOp
+static inline void FusedAttention(marian::Tensor out,
+                                  const marian::Tensor q,
+                                  const marian::Tensor k,
+                                  const marian::Tensor v,
+                                  const marian::Tensor mask,
+                                  int dimHeads,
+                                  float scale) {
+  ABORT_IF(out->getBackend()->getDeviceId().type != DeviceType::cpu,
+           "Fused attention is only implemented for the CPU");
+  cpu::FusedAttention(out, q, k, v, mask, dimHeads, scale);
+}
+
 DISPATCH2(LSTMCellForward, marian::Tensor, std::vector<marian::Tensor>)
 DISPATCH2(LSTMOutputForward, marian::Tensor, std::vector<marian::Tensor>);
 // clang-format on
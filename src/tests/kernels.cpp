@@ -0,0 +1,386 @@
+// Microbenchmarks of the CPU kernels at transformer shapes. Each kernel is called directly on
+// tensors, without a graph, and reported as one JSON line with its time, the achieved GB/s and
+// GFLOP/s and their fraction of the machine peak. With --baseline, the results are compared to a
+// previous run and kernels that got slower than --tolerance are reported, e.g.
+//
+//   ./test_kernels --threads 4 --pin-threads -o before.jsonl
+//   ... rebuild ...
+//   ./test_kernels --threads 4 --pin-threads --baseline before.jsonl
+
+#include "marian.h"
+
+#include "common/cli_wrapper.h"
+#include "tensors/cpu/parallel.h"
+#include "tensors/tensor_allocator.h"
+#include "tensors/tensor_operators.h"
+#if COMPILE_CPU
+#include "tensors/cpu/integer_common.h"
+#endif
+#if USE_FBGEMM
+#include "tensors/cpu/fbgemm/packed_gemm.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace marian;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Kernel {
+  std::string name;
+  std::string shape;
+  double bytes;  // read and written per call
+  double flops;  // 0 for kernels that are not compute-bound
+  std::function<void()> run;
+};
+
+// Random tensors on the CPU backend
+class Workspace {
+public:
+  Workspace(size_t seed) : backend_(BackendByDeviceId(CPU0, seed)), allocator_(New<TensorAllocator>(backend_)), rng_(seed) {}
+
+  Tensor tensor(Shape shape, Type type = Type::float32) {
+    Tensor t;
+    allocator_->allocate(t, shape, type);
+    if(type == Type::float32) {
+      std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+      std::vector<float> values(shape.elements());
+      for(auto& v : values)
+        v = uniform(rng_);
+      t->set(values);
+    }
+    return t;
+  }
+
+  Tensor indices(Shape shape, size_t range) {
+    Tensor t;
+    allocator_->allocate(t, shape, Type::uint32);
+    std::uniform_int_distribution<IndexType> uniform(0, (IndexType)range - 1);
+    std::vector<IndexType> values(shape.elements());
+    for(auto& v : values)
+      v = uniform(rng_);
+    t->set(values);
+    return t;
+  }
+
+  Ptr<Allocator> allocator() { return allocator_->allocator(); }
+
+private:
+  Ptr<Backend> backend_;
+  Ptr<TensorAllocator> allocator_;
+  std::mt19937 rng_;
+};
+
+std::string str(const Shape& shape) {
+  std::stringstream ss;
+  for(int i = 0; i < (int)shape.size(); ++i)
+    ss << (i > 0 ? "x" : "") << shape[i];
+  return ss.str();
+}
+
+// Kernels at the shapes of a transformer with the given dimensions. 'rows' is the number of target
+// positions in a call (beam x batch when decoding, batch x length when training), 'length' the
+// source length attended to and 'queries' the target positions per sentence.
+std::vector<Kernel> createKernels(Workspace& ws, int dim, int ffn, int heads, int vocab, int rows, int length, int queries, const std::string& fbgemmType) {
+  std::vector<Kernel> kernels;
+  int sentences = rows / queries;
+  int dimHead = dim / heads;
+  const double F = sizeof(float);
+
+  {
+    Shape shape = {sentences, heads, queries, length};
+    auto in = ws.tensor(shape), out = ws.tensor(shape);
+    double n = (double)shape.elements();
+    kernels.push_back({"Softmax", str(shape), 2 * n * F, 0, [=]() { Softmax(out, in); }});
+  }
+  {
+    Shape shape = {rows, vocab};
+    auto in = ws.tensor(shape), out = ws.tensor(shape);
+    double n = (double)shape.elements();
+    kernels.push_back({"LogSoftmax", str(shape), 2 * n * F, 0, [=]() { LogSoftmax(out, in); }});
+  }
+  {
+    Shape shape = {rows, dim};
+    auto in = ws.tensor(shape), out = ws.tensor(shape);
+    auto gamma = ws.tensor({1, dim}), beta = ws.tensor({1, dim});
+    double n = (double)shape.elements();
+    kernels.push_back({"LayerNormalization", str(shape), 2 * n * F, 0, [=]() { LayerNormalization(out, in, gamma, beta, 1e-9f); }});
+  }
+  {
+    // splitting the heads
+    Shape shape = {sentences, queries, heads, dimHead};
+    auto in = ws.tensor(shape), out = ws.tensor({sentences, heads, queries, dimHead});
+    double n = (double)shape.elements();
+    kernels.push_back({"TransposeND", str(shape) + " 0213", 2 * n * F, 0, [=]() { TransposeND(out, in, {0, 2, 1, 3}); }});
+  }
+  {
+    // reordering hypotheses in beam search
+    auto in = ws.tensor({rows, dim}), out = ws.tensor({rows, dim});
+    auto idx = ws.indices({rows, 1}, rows);
+    double n = (double)rows * dim;
+    kernels.push_back({"Select", str(in->shape()) + " axis 0", 2 * n * F, 0, [=]() { Select(out, in, idx, 0); }});
+  }
+  {
+    // embedding lookup
+    auto in = ws.tensor({vocab, dim}), out = ws.tensor({rows, dim});
+    auto idx = ws.indices({rows}, vocab);
+    double n = (double)rows * dim;
+    kernels.push_back({"CopyRows", str(in->shape()) + " rows " + std::to_string(rows), 2 * n * F, 0, [=]() { CopyRows(out, in, idx); }});
+  }
+  {
+    // feed-forward layer and output layer with tied embeddings
+    auto a = ws.tensor({rows, dim}), w1 = ws.tensor({dim, ffn}), h = ws.tensor({rows, ffn});
+    kernels.push_back({"Prod", str(a->shape()) + " * " + str(w1->shape()),
+                       ((double)rows * dim + (double)dim * ffn + (double)rows * ffn) * F,
+                       2.0 * rows * dim * ffn,
+                       [=]() { Prod(h, a, w1, false, false, 0.f, 1.f); }});
+    auto emb = ws.tensor({vocab, dim}), logits = ws.tensor({rows, vocab});
+    kernels.push_back({"Prod", str(a->shape()) + " * " + str(emb->shape()) + "^T",
+                       ((double)rows * dim + (double)dim * vocab + (double)rows * vocab) * F,
+                       2.0 * rows * dim * vocab,
+                       [=]() { Prod(logits, a, emb, false, true, 0.f, 1.f); }});
+  }
+  {
+    // attention scores Q * K^T per head
+    int batch = sentences * heads;
+    auto q = ws.tensor({batch, queries, dimHead}), k = ws.tensor({batch, length, dimHead});
+    auto out = ws.tensor({batch, queries, length});
+    Ptr<Allocator> allocator = ws.allocator();
+    kernels.push_back({"ProdBatched", str(q->shape()) + " * " + str(k->shape()) + "^T",
+                       ((double)q->size() + k->size() + out->size()) * F,
+                       2.0 * batch * queries * length * dimHead,
+                       [=]() { ProdBatched(out, allocator, q, k, false, true, 0.f, 1.f); }});
+  }
+#if COMPILE_CPU
+  {
+    // the work of cpu::integer::affineOrDot: quantize A, then multiply with the prepared B and add the bias
+    typedef cpu::integer::intgemm_<Type::intgemm8> Int8;
+    auto a = ws.tensor({rows, dim}), b = ws.tensor({dim, ffn}), bias = ws.tensor({1, ffn}), out = ws.tensor({rows, ffn});
+    auto aQuant = ws.tensor({rows, dim}, Type::int8), bQuant = ws.tensor({dim, ffn}, Type::int8);
+    float bQuantMult = cpu::integer::computeQuantMult<Type::intgemm8>(b);
+    Int8::width::PrepareB(b->data(), bQuant->data<int8_t>(), bQuantMult, dim, ffn);
+    kernels.push_back({"intgemm8 affineOrDot", str(a->shape()) + " * " + str(b->shape()),
+                       (double)rows * dim * (F + 2) + (double)dim * ffn + (double)rows * ffn * F,
+                       2.0 * rows * dim * ffn,
+                       [=]() {
+                         float aQuantMult = cpu::integer::computeQuantMult<Type::intgemm8>(a);
+                         Int8::width::PrepareA(a->data(), aQuant->data<int8_t>(), aQuantMult, rows, dim);
+                         Int8::width::Multiply(aQuant->data<int8_t>(), bQuant->data<int8_t>(), rows, dim, ffn,
+                                               intgemm::callbacks::UnquantizeAndAddBiasAndWrite(1.f / (aQuantMult * bQuantMult), bias->data(), out->data()));
+                       }});
+  }
+#endif
+#if USE_FBGEMM
+  {
+    Type packType = typeFromString(fbgemmType);
+    auto a = ws.tensor({rows, dim}), b = ws.tensor({dim, ffn}), out = ws.tensor({rows, ffn});
+    int nrow, ncol;
+    uint64_t packSize;
+    cpu::variant::fbgemmPacked8PackInfo(b->shape(), packType, false, nrow, ncol, packSize);
+    auto packed = ws.tensor({1, (int)packSize}, packType);
+    cpu::variant::fbgemmPacked8Pack(packed, b->data(), packType, false, nrow, ncol, packSize);
+    kernels.push_back({"fbgemmPacked8Gemm " + fbgemmType, str(a->shape()) + " * " + str(b->shape()),
+                       (double)rows * dim * F + (double)packSize + (double)rows * ffn * F,
+                       2.0 * rows * dim * ffn,
+                       [=]() { cpu::variant::fbgemmPacked8Gemm(packType, out, a, packed, rows, ffn, dim); }});
+  }
+#else
+  fbgemmType;
+#endif
+  if(queries == 1) {
+    // n-best of beam x vocab scores per sentence
+    int beam = rows / sentences;
+    auto in = ws.tensor({sentences, beam * vocab});
+    auto values = ws.tensor({sentences, beam}), idx = ws.tensor({sentences, beam}, Type::uint32);
+    Ptr<Allocator> allocator = ws.allocator();
+    kernels.push_back({"TopK", str(in->shape()) + " k " + std::to_string(beam),
+                       (double)in->size() * F, 0,
+                       [=]() { TopK(values, idx, allocator, in, beam, 1, true); }});
+  }
+  return kernels;
+}
+
+// Pins the calling thread to core 'first' and the intra-op helper threads to the following cores.
+// All chunks wait for each other, so each runs on its own thread.
+void pinThreads(size_t first) {
+#ifdef __linux__
+  size_t threads = cpu::getIntraOpThreads();
+  std::atomic<size_t> arrived{0};
+  cpu::parallelFor(threads, 1, [&](size_t begin, size_t /*end*/) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((int)(first + begin), &set);
+    int status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(status != 0)
+      LOG(warn, "Could not pin a thread to core {}, error {}", first + begin, status);
+    arrived++;
+    while(arrived < threads)
+      std::this_thread::yield();
+  });
+#else
+  first;
+  LOG(warn, "Pinning threads is only supported on Linux");
+#endif
+}
+
+// Read and write bandwidth of a large parallel copy, the best of a few runs
+double measureBandwidth() {
+  const size_t bytes = 256 * 1024 * 1024;
+  std::vector<char> src(bytes, 1), dst(bytes);
+  double best = 0;
+  for(int i = 0; i < 5; ++i) {
+    auto start = Clock::now();
+    cpu::parallelFor(bytes, 1 << 20, [&](size_t begin, size_t end) {
+      std::memcpy(dst.data() + begin, src.data() + begin, end - begin);
+    });
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    best = std::max(best, 2.0 * bytes / seconds / 1e9);
+  }
+  return best;
+}
+
+// Median times of a previous run keyed by kernel, shape and threads
+std::map<std::string, double> loadBaseline(const std::string& path) {
+  std::map<std::string, double> baseline;
+  std::ifstream in(path);
+  ABORT_IF(!in, "Could not read baseline {}", path);
+  std::string line;
+  while(std::getline(in, line)) {
+    if(line.empty())
+      continue;
+    auto result = YAML::Load(line);  // JSON is a subset of YAML
+    baseline[result["kernel"].as<std::string>() + " " + result["shape"].as<std::string>() + " "
+             + result["threads"].as<std::string>()] = result["median-us"].as<double>();
+  }
+  return baseline;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  createLoggers();
+
+  auto options = New<Options>();
+  {
+    YAML::Node config;
+    auto cli = New<cli::CLIWrapper>(config, "Microbenchmarks of the CPU kernels at transformer shapes", "Allowed options");
+    cli->add<std::vector<std::string>>("--kernels", "Only run kernels whose name contains one of these strings");
+    cli->add<std::vector<std::string>>("--models", "Model sizes: base, big", {"base", "big"});
+    cli->add<std::vector<std::string>>("--cases",
+        "Shapes of decoding (8 sentences x beam 4, one step) and training (32 x 32 words)", {"decode", "train"});
+    cli->add<size_t>("--threads", "Intra-op threads per kernel", 1);
+    cli->add<bool>("--pin-threads", "Pin the threads to consecutive cores starting at --first-core");
+    cli->add<size_t>("--first-core", "First core to pin to", 0);
+    cli->add<size_t>("--warmup", "Untimed calls per kernel", 3);
+    cli->add<size_t>("--repeats", "Timed calls per kernel, the median is reported", 20);
+    cli->add<float>("--peak-gbps", "Memory bandwidth of the machine in GB/s, 0 measures a large copy", 0);
+    cli->add<float>("--peak-gflops", "Peak float32 GFLOP/s of the machine, 0 omits the compute fraction", 0);
+    cli->add<std::string>("--fbgemm-type", "Packed type for fbgemmPacked8Gemm: packed8avx2, packed8avx512", "packed8avx2");
+    cli->add<std::string>("--baseline", "JSON lines of a previous run to compare with");
+    cli->add<float>("--tolerance", "Report kernels that are slower than the baseline by more than this fraction", 0.1f);
+    cli->add<std::string>("--output,-o", "Write the JSON lines to this file", "stdout");
+    cli->add<size_t>("--seed", "Seed for the random inputs", 1234);
+    cli->parse(argc, argv);
+    options->merge(config);
+  }
+
+  size_t threads = options->get<size_t>("threads");
+  cpu::setIntraOpThreads(threads);
+  if(options->get<bool>("pin-threads"))
+    pinThreads(options->get<size_t>("first-core"));
+
+  double peakGbps = options->get<float>("peak-gbps");
+  if(peakGbps <= 0) {
+    peakGbps = measureBandwidth();
+    LOG(info, "Measured memory bandwidth: {:.1f} GB/s", peakGbps);
+  }
+  double peakGflops = options->get<float>("peak-gflops");
+
+  std::map<std::string, double> baseline;
+  if(!options->get<std::string>("baseline").empty())
+    baseline = loadBaseline(options->get<std::string>("baseline"));
+
+  std::ofstream file;
+  auto outputPath = options->get<std::string>("output");
+  if(outputPath != "stdout")
+    file.open(outputPath);
+  std::ostream& out = outputPath != "stdout" ? file : std::cout;
+  ABORT_IF(!out, "Could not open {}", outputPath);
+
+  auto filters = options->get<std::vector<std::string>>("kernels");
+  size_t warmup = options->get<size_t>("warmup");
+  size_t repeats = std::max(options->get<size_t>("repeats"), (size_t)1);
+  size_t regressions = 0;
+
+  for(const auto& model : options->get<std::vector<std::string>>("models")) {
+    ABORT_IF(model != "base" && model != "big", "Unknown model size '{}'", model);
+    int dim = model == "base" ? 512 : 1024, heads = model == "base" ? 8 : 16;
+    for(const auto& benchCase : options->get<std::vector<std::string>>("cases")) {
+      ABORT_IF(benchCase != "decode" && benchCase != "train", "Unknown case '{}'", benchCase);
+      bool decode = benchCase == "decode";
+
+      Workspace ws(options->get<size_t>("seed"));
+      auto kernels = createKernels(ws, dim, 4 * dim, heads, /*vocab=*/32000,
+                                   /*rows=*/decode ? 8 * 4 : 32 * 32, /*length=*/32, /*queries=*/decode ? 1 : 32,
+                                   options->get<std::string>("fbgemm-type"));
+
+      for(const auto& kernel : kernels) {
+        bool selected = filters.empty();
+        for(const auto& filter : filters)
+          selected |= kernel.name.find(filter) != std::string::npos;
+        if(!selected)
+          continue;
+
+        for(size_t i = 0; i < warmup; ++i)
+          kernel.run();
+        std::vector<double> times;
+        for(size_t i = 0; i < repeats; ++i) {
+          auto start = Clock::now();
+          kernel.run();
+          times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        double gbps = kernel.bytes / median / 1e3;
+        double gflops = kernel.flops / median / 1e3;
+
+        out << "{\"kernel\": \"" << kernel.name << "\", \"model\": \"" << model << "\", \"case\": \"" << benchCase
+            << "\", \"shape\": \"" << kernel.shape << "\", \"threads\": " << threads << ", \"repeats\": " << repeats
+            << ", \"min-us\": " << times.front() << ", \"median-us\": " << median
+            << ", \"gbps\": " << gbps << ", \"bandwidth-fraction\": " << gbps / peakGbps;
+        if(kernel.flops > 0) {
+          out << ", \"gflops\": " << gflops;
+          if(peakGflops > 0)
+            out << ", \"compute-fraction\": " << gflops / peakGflops;
+        }
+        out << "}" << std::endl;
+
+        auto it = baseline.find(kernel.name + " " + kernel.shape + " " + std::to_string(threads));
+        if(it != baseline.end() && median > it->second * (1 + options->get<float>("tolerance"))) {
+          LOG(warn, "Regression: {} {} takes {:.1f} us, {:.1f} us in the baseline", kernel.name, kernel.shape, median, it->second);
+          regressions++;
+        }
+      }
+    }
+  }
+
+  if(!baseline.empty())
+    LOG(info, "{} regression(s) against the baseline", regressions);
+  return regressions > 0 ? 1 : 0;
+}
@@ -1,11 +1,74 @@
 #include "catch.hpp"
 #include "common/binary.h"
 #include "common/file_stream.h"
+#include "common/io.h"
 
+#include "3rd_party/cnpy/cnpy.h"
 #include "3rd_party/mio/mio.hpp"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
 using namespace marian;
 
+namespace {
+
+template <typename T>
+void put(std::vector<char>& out, T value) {
+  const char* bytes = (const char*)&value;
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Rewrites the local headers of a .npz file like zip64 writers do, e.g. numpy for large arrays:
+// the sizes in the header are 0xFFFFFFFF and the actual sizes follow in a zip64 extra field
+void rewriteAsZip64(const std::string& fileName) {
+  std::vector<char> zip;
+  {
+    std::ifstream in(fileName, std::ios::binary);
+    zip.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  std::vector<char> out;
+  size_t pos = 0;
+  while(pos + 30 <= zip.size() && zip[pos + 2] == 0x03 && zip[pos + 3] == 0x04) {
+    uint32_t size;
+    uint16_t nameLen, extraLen;
+    std::memcpy(&size, &zip[pos + 18], sizeof(size));
+    std::memcpy(&nameLen, &zip[pos + 26], sizeof(nameLen));
+    std::memcpy(&extraLen, &zip[pos + 28], sizeof(extraLen));
+    size_t headerLen = 30 + nameLen + extraLen;
+
+    std::vector<char> header(zip.begin() + pos, zip.begin() + pos + headerLen);
+    uint32_t unknown = 0xFFFFFFFF;
+    uint16_t zip64ExtraLen = (uint16_t)(extraLen + 20);
+    std::memcpy(&header[18], &unknown, sizeof(unknown)); // compressed size
+    std::memcpy(&header[22], &unknown, sizeof(unknown)); // uncompressed size
+    std::memcpy(&header[28], &zip64ExtraLen, sizeof(zip64ExtraLen));
+    out.insert(out.end(), header.begin(), header.end());
+    put<uint16_t>(out, 0x0001); // zip64 extended information
+    put<uint16_t>(out, 16);
+    put<uint64_t>(out, size);
+    put<uint64_t>(out, size);
+
+    out.insert(out.end(), zip.begin() + pos + headerLen, zip.begin() + pos + headerLen + size);
+    pos += headerLen + size;
+  }
+  out.insert(out.end(), zip.begin() + pos, zip.end()); // central directory, not read by cnpy
+
+  std::ofstream(fileName, std::ios::binary).write(out.data(), out.size());
+}
+
+std::vector<io::Item> checkpointItems(float value, const std::string& config) {
+  std::vector<io::Item> items = {io::fromVector(std::vector<float>(6, value), "Wemb"),
+                                 io::fromVector(std::vector<float>({value, -value}), "b")};
+  io::addMetaToItems(config, "special:model.yml", items);
+  return items;
+}
+
+}  // namespace
+
 TEST_CASE("a few operations on binary files", "[binary]") {
 
   SECTION("Save two items to temporary binary file and then load and map") {
@@ -59,3 +122,66 @@ TEST_CASE("a few operations on binary files", "[binary]") {
     }
   }
 }
+
+TEST_CASE("Checkpoints in different formats can be averaged", "[binary]") {
+  std::vector<std::string> paths = {"binary_tests.avg1.npz", "binary_tests.avg2.npz", "binary_tests.avg3.bin"};
+  io::saveItems(paths[0], checkpointItems(1.f, "first"));
+  io::saveItems(paths[1], checkpointItems(2.f, "second"));
+  io::saveItems(paths[2], checkpointItems(4.f, "last"));
+  rewriteAsZip64(paths[1]);
+
+  // every item is found and read on its own, also after a zip64 local header
+  std::vector<std::string> names = {"Wemb", "b", "special:model.yml"};
+  CHECK(cnpy::npz_names(paths[1]) == names);
+  for(const auto& path : paths) {
+    io::ItemReader reader(path);
+    CHECK(reader.names() == names);
+    auto b = reader.get("b");
+    CHECK(b.shape == Shape({1, 2}));
+    CHECK(((const float*)b.data())[0] == ((const float*)reader.get("Wemb").data())[0]);
+  }
+
+  auto averaged = io::averageCheckpoints(paths, {0.25, 0.25, 0.5}, /*threads=*/2);
+  REQUIRE(averaged.size() == 3);
+  CHECK(averaged[0].name == "Wemb");
+  CHECK(averaged[0].shape == Shape({1, 6}));
+  CHECK(averaged[0].type == Type::float32);
+  for(int i = 0; i < 6; ++i)
+    CHECK(((const float*)averaged[0].data())[i] == 2.75f);
+  CHECK(((const float*)averaged[1].data())[1] == -2.75f);
+  CHECK(std::string(averaged[2].data()) == "last"); // taken from the last checkpoint
+
+  // written item by item, the same items as averaged in memory
+  std::string saved = "binary_tests.avg.bin";
+  io::saveAveragedCheckpoints(saved, paths, {0.25, 0.25, 0.5}, /*threads=*/1);
+  auto items = io::loadItems(saved);
+  REQUIRE(items.size() == averaged.size());
+  for(size_t i = 0; i < items.size(); ++i) {
+    CHECK(items[i].name == averaged[i].name);
+    CHECK(items[i].shape == averaged[i].shape);
+    CHECK(items[i].type == averaged[i].type);
+    CHECK(std::equal(items[i].data(), items[i].data() + items[i].size(), averaged[i].data()));
+  }
+  std::remove(saved.c_str());
+
+  for(const auto& path : paths)
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Averaging float64 items keeps double precision", "[binary]") {
+  std::vector<std::string> paths = {"binary_tests.avg1.bin", "binary_tests.avg2.bin"};
+  double tiny = 1e-12; // lost in float32
+  io::saveItems(paths[0], {io::fromVector(std::vector<double>{1.0, 1.0 + 2 * tiny}, "x")});
+  io::saveItems(paths[1], {io::fromVector(std::vector<double>{1.0 + 2 * tiny, 1.0}, "x")});
+
+  auto averaged = io::averageCheckpoints(paths, {0.5, 0.5}, /*threads=*/1);
+  REQUIRE(averaged.size() == 1);
+  CHECK(averaged[0].type == Type::float64);
+  const double* x = (const double*)averaged[0].data();
+  CHECK(x[0] == Approx(1.0 + tiny).epsilon(1e-15));
+  CHECK(x[0] != 1.0);
+  CHECK(x[0] == x[1]);
+
+  for(const auto& path : paths)
+    std::remove(path.c_str());
+}
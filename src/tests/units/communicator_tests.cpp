@@ -0,0 +1,193 @@
+#include "catch.hpp"
+#include "graph/expression_graph.h"
+#include "graph/expression_operators.h"
+#include "training/communicator.h"
+#include "training/gradient_compression.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace marian;
+
+namespace {
+
+// Two processes that send identical messages, so an all-reduce returns twice what was sent
+struct MirroredMPI : public IMPIWrapper {
+  size_t myMPIRank() const override { return 0; }
+  size_t numMPIProcesses() const override { return 2; }
+  void barrier(MPI_Comm) const override {}
+  void bCast(void*, size_t, MPI_Datatype, size_t, MPI_Comm) const override {}
+  void sSend(void*, size_t, MPI_Datatype, size_t, int, MPI_Comm) const override { ABORT("Not implemented"); }
+  void recv(void*, size_t, MPI_Datatype, size_t, int, MPI_Comm, MPI_Status*) const override { ABORT("Not implemented"); }
+  void allReduce(const void*, void*, size_t, MPI_Datatype, MPI_Op, MPI_Comm) const override { ABORT("Not implemented"); }
+  void allGather(const void* sendbuf, size_t count, MPI_Datatype datatype, void* recvbuf, MPI_Comm) const override {
+    ABORT_IF(datatype != MPI_BYTE, "Only bytes are gathered");
+    std::memcpy(recvbuf, sendbuf, count);
+    std::memcpy((char*)recvbuf + count, sendbuf, count);
+  }
+  void finalize() override {}
+};
+
+// What one process sent in a compressed all-reduce of 'gradient'
+std::vector<float> sent(GradientCompressorBase& compressor, std::vector<float> gradient) {
+  compressor.allReduce(gradient.data(), gradient.size(), /*shardIndex=*/0, New<MirroredMPI>());
+  for(auto& g : gradient)
+    g /= 2.f;
+  return gradient;
+}
+
+// decodeAdd(encode(in)) into zeros
+std::vector<float> roundTrip(const GradientCompressorBase& compressor, const std::vector<float>& in) {
+  std::vector<char> message(compressor.messageBytes(in.size()));
+  compressor.encode(in.data(), in.size(), message.data());
+  std::vector<float> out(in.size(), 0.f);
+  compressor.decodeAdd(message.data(), in.size(), out.data(), 1.f);
+  return out;
+}
+
+// Two local CPU workers, each with its own batch, as in SyncGraphGroup
+struct Workers {
+  std::vector<Ptr<ExpressionGraph>> graphs;
+  std::vector<Ptr<OptimizerBase>> optimizers;
+  Ptr<ICommunicator> comm;
+
+  Workers(bool sharedParams) {
+    auto options = New<Options>();
+    options->set("optimizer", "adam");
+    options->set("learn-rate", 0.01f);
+
+    for(size_t i = 0; i < 2; ++i) {
+      auto graph = New<ExpressionGraph>();
+      graph->setDevice({i, DeviceType::cpu});
+      graph->reserveWorkspaceMB(4);
+      graphs.push_back(graph);
+      optimizers.push_back(Optimizer(options));
+    }
+    comm = New<DefaultCommunicator>(graphs, ShardingMode::global, nullptr);
+
+    // allocate the parameters
+    for(size_t i = 0; i < 2; ++i) {
+      build(i);
+      graphs[i]->forward();
+    }
+    if(sharedParams)
+      graphs[1]->params()->shareValsWith(graphs[0]->params());
+  }
+
+  Expr build(size_t i) {
+    auto graph = graphs[i];
+    graph->clear();
+    std::vector<float> vW(8), vX(8);
+    for(size_t k = 0; k < 8; ++k) {
+      vW[k] = 0.1f * (float)k - 0.4f;
+      vX[k] = 0.5f * (float)((k + 3 * i) % 5) - 1.f; // different data per worker
+    }
+    auto W = graph->param("W", {2, 4}, inits::fromVector(vW));
+    auto x = graph->constant({2, 4}, inits::fromVector(vX));
+    return sum(sum(tanh(W * x) * W, /*axis=*/-1), /*axis=*/0);
+  }
+
+  void step() {
+    for(size_t i = 0; i < 2; ++i) {
+      build(i);
+      graphs[i]->forward();
+      graphs[i]->backward();
+    }
+    comm->scatterReduceAndResetGrads();
+    comm->foreach([&](size_t i, size_t begin, size_t end) {
+      auto params = graphs[i]->params();
+      optimizers[i]->update(params->vals()->subtensor(begin, end - begin),
+                            params->grads()->subtensor(begin, end - begin),
+                            /*mbSize=*/1);
+      return true;
+    });
+    comm->allGatherParams();
+  }
+
+  std::vector<float> values(size_t i) {
+    std::vector<float> v;
+    graphs[i]->params()->get("W")->val()->get(v);
+    return v;
+  }
+};
+
+}  // namespace
+
+TEST_CASE("Workers sharing parameter values update them like workers with own copies", "[communicator]") {
+  Workers own(/*sharedParams=*/false), shared(/*sharedParams=*/true);
+  CHECK(shared.graphs[1]->params()->vals()->data() == shared.graphs[0]->params()->vals()->data());
+  CHECK(own.graphs[1]->params()->vals()->data() != own.graphs[0]->params()->vals()->data());
+
+  auto initial = own.values(0);
+  for(int step = 0; step < 3; ++step) {
+    own.step();
+    shared.step();
+    CHECK(own.values(0) == own.values(1));
+    CHECK(shared.values(0) == own.values(0));
+    CHECK(shared.values(1) == own.values(1));
+  }
+  CHECK(own.values(0) != initial);
+}
+
+TEST_CASE("Compressed gradients keep what was not sent for the next step", "[communicator]") {
+  std::vector<float> g = {0.5f, -3.f, 0.25f, 1.5f, -0.125f, 2.f, -1.f, 0.75f};
+  std::vector<float> zeros(g.size(), 0.f);
+
+  SECTION("top-k") {
+    TopKGradientCompressor compressor(New<Options>(), /*ratio=*/0.25f);
+
+    // the two entries with the largest magnitude are sent as they are, the residual holds the rest
+    auto decoded = roundTrip(compressor, g);
+    CHECK(decoded == std::vector<float>({0.f, -3.f, 0.f, 0.f, 0.f, 2.f, 0.f, 0.f}));
+
+    // without new gradients, the residual is sent over the next steps until all of g got through
+    std::vector<float> total(g.size(), 0.f);
+    auto first = sent(compressor, g);
+    CHECK(first == decoded);
+    for(size_t step = 0; step < 4; ++step) {
+      auto message = step == 0 ? first : sent(compressor, zeros);
+      for(size_t i = 0; i < g.size(); ++i)
+        total[i] += message[i];
+    }
+    CHECK(total == g);
+    CHECK(sent(compressor, zeros) == zeros);
+  }
+
+  SECTION("skipped step") {
+    TopKGradientCompressor compressor(New<Options>(), /*ratio=*/0.25f), reference(New<Options>(), /*ratio=*/0.25f);
+    sent(compressor, g);
+    sent(reference, g);
+
+    // cost scaling skips a step with NaN or Inf in the gradient, which must not end up in the residual
+    std::vector<float> overflow = g;
+    overflow[3] = std::numeric_limits<float>::infinity();
+    overflow[6] = std::numeric_limits<float>::quiet_NaN();
+    auto skipped = sent(compressor, overflow);
+    CHECK(std::isinf(skipped[3]));
+
+    for(size_t step = 0; step < 4; ++step)
+      CHECK(sent(compressor, zeros) == sent(reference, zeros));
+  }
+
+  SECTION("8-bit") {
+    QuantizedGradientCompressor compressor(New<Options>(), /*bucketSize=*/4);
+
+    // the residual is at most half a quantization step of the entry's bucket
+    auto decoded = roundTrip(compressor, g);
+    for(size_t i = 0; i < g.size(); ++i) {
+      float step = (i < 4 ? 3.f : 2.f) / 127.f;
+      CHECK(std::abs(g[i] - decoded[i]) <= 0.5f * step + 1e-7f);
+    }
+
+    // the next step sends the new gradient plus what was left over from the first one
+    std::vector<float> g2 = {1.f, 0.5f, -0.25f, 0.f, 0.125f, -2.f, 1.f, 0.f};
+    auto first = sent(compressor, g);
+    CHECK(first == decoded);
+    auto second = sent(compressor, g2);
+    std::vector<float> carried(g.size());
+    for(size_t i = 0; i < g.size(); ++i)
+      carried[i] = (g[i] - decoded[i]) + g2[i];
+    CHECK(second == roundTrip(compressor, carried));
+  }
+}
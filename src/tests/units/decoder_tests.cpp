@@ -0,0 +1,160 @@
+#include "catch.hpp"
+#include "common/config_parser.h"
+#include "data/shortlist.h"
+#include "models/encoder_decoder.h"
+#include "models/model_factory.h"
+#include "tensors/cpu/expression_graph_packable.h"
+
+using namespace marian;
+
+namespace {
+
+const int dimVocab = 24;
+
+// Options of a small transformer as marian-decoder would see them, 'args' are added to the command line
+Ptr<Options> transformerOptions(const std::vector<std::string>& args = {}) {
+  std::vector<std::string> cmdLine = {"marian-decoder",
+                                      "--type", "transformer",
+                                      "--dim-emb", "16",
+                                      "--transformer-heads", "2",
+                                      "--transformer-dim-ffn", "32",
+                                      "--enc-depth", "1",
+                                      "--dec-depth", "2",
+                                      "--dim-vocabs", std::to_string(dimVocab), std::to_string(dimVocab),
+                                      "--models", "model.npz",
+                                      "--vocabs", "vocab.src.yml", "vocab.trg.yml",
+                                      "--ignore-model-config",
+                                      "--seed", "1234"};
+  cmdLine.insert(cmdLine.end(), args.begin(), args.end());
+
+  std::vector<char*> argv;
+  for(auto& arg : cmdLine)
+    argv.push_back(&arg[0]);
+  auto options = ConfigParser(cli::mode::translation).parseOptions((int)argv.size(), argv.data(), /*validate=*/false);
+  options->set("inference", true);
+  return options;
+}
+
+Ptr<ExpressionGraph> inferenceGraph() {
+  auto graph = New<ExpressionGraph>(/*inference=*/true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(32);
+  return graph;
+}
+
+// Two source sentences of different length, the second one is padded
+Ptr<data::CorpusBatch> sourceBatch() {
+  auto sb = New<data::SubBatch>(/*size=*/2, /*width=*/5, nullptr);
+  std::vector<size_t> lengths = {5, 3};
+  for(size_t j = 0; j < 5; ++j) {
+    for(size_t b = 0; b < 2; ++b) {
+      size_t i = j * 2 + b; // time-major
+      sb->data()[i] = Word::fromWordIndex(j < lengths[b] ? (3 + 5 * b + 7 * j) % dimVocab : 0);
+      sb->mask()[i] = j < lengths[b] ? 1.f : 0.f;
+    }
+  }
+  sb->setWords(8);
+  return New<data::CorpusBatch>(std::vector<Ptr<data::SubBatch>>({sb}));
+}
+
+// Decodes a fixed number of steps with beam size 1 and returns the logits of every step
+// [step][batch * vocab]. The words that are fed back come from 'words', hence different models can be
+// compared step by step.
+std::vector<std::vector<float>> decode(Ptr<ExpressionGraph> graph,
+                                       Ptr<IEncoderDecoder> model,
+                                       const std::vector<Words>& words) {
+  graph->clear();
+  auto state = model->startState(graph, sourceBatch());
+
+  std::vector<std::vector<float>> logits;
+  std::vector<IndexType> hypIndices, batchIndices = {0, 1};
+  Words prevWords;
+  for(const auto& stepWords : words) {
+    state = model->step(graph, state, hypIndices, prevWords, batchIndices, /*beamSize=*/1);
+    auto out = state->getLogProbs().getLogits();
+    graph->forward();
+
+    logits.push_back({});
+    out->val()->get(logits.back());
+    hypIndices = {0, 1};
+    prevWords = stepWords;
+  }
+  return logits;
+}
+
+// Target words that are fed back into the decoder, the same for all models
+const std::vector<Words> targetWords = {
+    {Word::fromWordIndex(4), Word::fromWordIndex(9)},
+    {Word::fromWordIndex(7), Word::fromWordIndex(2)},
+    {Word::fromWordIndex(11), Word::fromWordIndex(5)},
+    {Word::fromWordIndex(3), Word::fromWordIndex(3)}};
+
+Ptr<IEncoderDecoder> createModel(Ptr<Options> options) {
+  auto model = models::createModelFromOptions(options, models::usage::raw);
+  return std::dynamic_pointer_cast<IEncoderDecoder>(model);
+}
+
+}  // namespace
+
+TEST_CASE("Decoding with a short list and bfloat16 weights", "[decoder]") {
+  auto options = transformerOptions();
+
+  // float32 model with random weights and its logits over the full vocabulary
+  auto graph = inferenceGraph();
+  auto model = createModel(options);
+  auto full = decode(graph, model, targetWords);
+  std::vector<io::Item> items;
+  graph->save(items);
+
+  // as written by marian-conv --gemm-type bfloat16, all matrices with names ending in _W* are bfloat16
+  auto packable = New<ExpressionGraphPackable>();
+  packable->setDevice({0, DeviceType::cpu});
+  packable->reserveWorkspaceMB(32);
+  packable->load(items);
+  packable->forward();
+  auto converted = packable->pack(Type::bfloat16, Type::float32);
+  for(const auto& item : converted)
+    if(item.name == "decoder_ff_logit_out_Wt")
+      CHECK(item.type == Type::bfloat16);
+
+  std::unordered_set<WordIndex> shortlistSet = {0, 1, 2, 3, 4, 5, 7, 9, 11, 17, 20};
+  std::vector<WordIndex> shortlist(shortlistSet.begin(), shortlistSet.end());
+  std::sort(shortlist.begin(), shortlist.end());
+  auto bf16Graph = inferenceGraph();
+  auto bf16Model = createModel(options);
+  bf16Model->load(bf16Graph, converted);
+  bf16Model->setShortlistGenerator(New<data::FakeShortlistGenerator>(shortlistSet));
+  auto shortlisted = decode(bf16Graph, bf16Model, targetWords);
+
+  // the short-listed rows of the bfloat16 output layer are selected without converting them
+  CHECK(bf16Graph->get("decoder_ff_logit_out_Wt")->value_type() == Type::bfloat16);
+  int k = (int)shortlist.size();
+  for(size_t t = 0; t < full.size(); ++t) {
+    REQUIRE(shortlisted[t].size() == (size_t)(2 * k));
+    for(size_t b = 0; b < 2; ++b)
+      for(int i = 0; i < k; ++i)
+        CHECK(shortlisted[t][b * k + i] == Approx(full[t][b * dimVocab + shortlist[i]]).margin(0.05f));
+  }
+}
+
+TEST_CASE("Decoding with fused attention matches unfused attention", "[decoder]") {
+  auto options = transformerOptions();
+  auto graph = inferenceGraph();
+  auto model = createModel(options);
+  auto expected = decode(graph, model, targetWords);
+  std::vector<io::Item> items;
+  graph->save(items);
+
+  // the self-attention of every step after the first attends to the cached keys of the earlier steps
+  auto fusedGraph = inferenceGraph();
+  auto fusedModel = createModel(transformerOptions({"--fused-attention"}));
+  fusedModel->load(fusedGraph, items);
+  auto fused = decode(fusedGraph, fusedModel, targetWords);
+
+  REQUIRE(fused.size() == expected.size());
+  for(size_t t = 0; t < fused.size(); ++t) {
+    REQUIRE(fused[t].size() == expected[t].size());
+    for(size_t i = 0; i < fused[t].size(); ++i)
+      CHECK(fused[t][i] == Approx(expected[t][i]).epsilon(0.0001f).margin(0.0001f));
+  }
+}
@@ -121,3 +121,178 @@ TEST_CASE("Expression graph can be initialized with constant values (cpu)",
     REQUIRE(values == v);
   }
 }
+
+TEST_CASE("Element-wise chains are fused during inference (cpu)", "[graph]") {
+  Shape shape({64, 1001}); // several tiles and a remainder
+
+  auto run = [&](bool fuse, std::vector<float>& out, std::vector<float>& kept) {
+    auto graph = New<ExpressionGraph>(/*inference=*/true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->setElementwiseFusion(fuse);
+    graph->reserveWorkspaceMB(16);
+
+    std::vector<float> vA(shape.elements()), vB(shape.elements());
+    for(size_t i = 0; i < vA.size(); ++i) {
+      vA[i] = (i % 13) * 0.1f - 0.6f;
+      vB[i] = (i % 7) * 0.2f + 0.1f;
+    }
+    auto a = graph->constant(shape, inits::fromVector(vA));
+    auto b = graph->constant(shape, inits::fromVector(vB));
+
+    // all intermediates are only referenced by their consumer
+    auto y = relu(exp(a) * b + a) * 0.5f;
+    // the value of `k` is looked at, hence it must not be fused
+    auto k = a * b;
+    auto z = k - a;
+    graph->forward();
+
+    y->val()->get(out);
+    k->val()->get(kept);
+    std::vector<float> vZ;
+    z->val()->get(vZ);
+    for(size_t i = 0; i < vZ.size(); ++i)
+      CHECK(vZ[i] == Approx(vA[i] * vB[i] - vA[i]).margin(1e-6f)); // the reference may be contracted to an fma
+
+    return graph->getFusionStats();
+  };
+
+  std::vector<float> fusedOut, fusedKept, out, kept;
+  auto fused = run(true, fusedOut, fusedKept);
+  auto plain = run(false, out, kept);
+
+  CHECK(fused.chains == 1);
+  CHECK(fused.nodes == 4);
+  CHECK(plain.nodes == 0);
+  CHECK(fusedOut == out);
+  CHECK(fusedKept == kept);
+}
+
+TEST_CASE("Allocator statistics track peak, growth and fragmentation (cpu)", "[graph]") {
+  Allocator allocator({0, DeviceType::cpu}, /*bytes=*/4096, /*step=*/4096, /*alignment=*/256);
+  allocator.trackTags(true);
+
+  allocator.setTag("a");
+  auto a = allocator.alloc(1024);
+  allocator.setTag("b");
+  auto b = allocator.alloc(1000);  // aligned to 1024
+  auto c = allocator.alloc(1024);
+  allocator.free(b);
+
+  auto stats = allocator.stats();
+  CHECK(stats.reserved == 4096);
+  CHECK(stats.inUse == 2048);
+  CHECK(stats.peak == 3072);
+  CHECK(stats.allocations == 3);
+  CHECK(stats.grows == 0);
+  // the freed block and the end of the memory are not adjacent
+  CHECK(stats.gaps == 2);
+  CHECK(stats.largestGap == 1024);
+  CHECK(stats.fragmentation() == Approx(0.5));
+  CHECK(stats.peakByTag == std::map<std::string, size_t>({{"a", 1024}, {"b", 2048}}));
+
+  allocator.alloc(2048);
+  stats = allocator.stats();
+  CHECK(stats.grows == 1);
+  CHECK(stats.reserved == 8192);
+  CHECK(stats.peak == 4096);
+
+  allocator.clear();
+  allocator.alloc(256);
+  stats = allocator.stats();
+  CHECK(stats.steps == 2);  // reserve() clears as well
+  CHECK(stats.stepAllocations == 1);
+  CHECK(stats.maxStepAllocations == 4);
+  CHECK(stats.stepPeak == 256);
+  CHECK(stats.peak == 4096);
+}
+
+TEST_CASE("Allocator tags follow the memory when it grows (cpu)", "[graph]") {
+  Allocator allocator({0, DeviceType::cpu}, /*bytes=*/2048, /*step=*/2048, /*alignment=*/256);
+  allocator.trackTags(true);
+
+  allocator.setTag("a");
+  auto a = allocator.alloc(1024);
+  allocator.setTag("b");
+  auto b = allocator.alloc(1024);
+  allocator.setTag("c");
+  auto c = allocator.alloc(1024);  // grows and moves a and b
+  CHECK(allocator.stats().grows == 1);
+
+  allocator.free(a);
+  allocator.free(b);
+  CHECK(allocator.bytesByTag() == std::map<std::string, size_t>({{"c", 1024}}));
+
+  // a new peak is attributed by the current bytes
+  allocator.setTag("d");
+  auto d = allocator.alloc(3072);
+  auto stats = allocator.stats();
+  CHECK(stats.peak == 4096);
+  CHECK(stats.peakByTag == std::map<std::string, size_t>({{"c", 1024}, {"d", 3072}}));
+
+  allocator.free(c);
+  allocator.free(d);
+  CHECK(allocator.bytesByTag().empty());
+}
+
+TEST_CASE("Checkpoint planner recomputes the cheapest segments that meet the budget (cpu)", "[graph]") {
+  // Three layers of 1x64 float32 values, i.e. 256 bytes each. The segment before h2 holds
+  // three values, the one before h1 only one at a similar cost.
+  auto build = [](bool checkpointing, size_t budget) {
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(4);
+    graph->setCheckpointing(checkpointing);
+    graph->setCheckpointingBudget(budget);
+
+    auto x  = checkpoint(graph->constant({1, 64}, inits::ones()));
+    auto W1 = graph->param("W1", {64, 64}, inits::glorotUniform());
+    auto h1 = checkpoint(tanh(dot(x, W1)));
+    auto W2 = graph->param("W2", {64, 64}, inits::glorotUniform());
+    auto h2 = checkpoint(tanh(dot(h1, W2) * 2.f + 1.f));
+    auto W3 = graph->param("W3", {64, 64}, inits::glorotUniform());
+    sum(tanh(dot(h2, W3)), /*axis=*/-1);
+    return graph->estimateMemory();
+  };
+
+  const double matmul = 2.0 * 64 * 64; // multiply-adds of a 1x64 times 64x64 product
+  const double params = 3 * 64 * 64;   // parameters count one operation per element
+  const double flops  = params + 3 * matmul + 6 * 64 + 1; // six 1x64 element-wise nodes and the sum
+  const double h1Segment = matmul;          // dot, parameters are not recomputed
+  const double h2Segment = matmul + 2 * 64; // dot, *2, +1
+
+  auto none = build(/*checkpointing=*/false, 0);
+  REQUIRE(none.segments.size() == 2);
+  CHECK(none.numRecomputed() == 0);
+  // all 10 values after the forward pass plus the gradients of the sum and the tanh below it
+  CHECK(none.peakBytes == 12 * 256);
+  CHECK(none.flops == flops);
+  CHECK(none.recomputeFlops == 0);
+
+  // segments are listed from the top, the one before h2 frees more memory per FLOP
+  auto all = build(/*checkpointing=*/true, /*budget=*/0);
+  REQUIRE(all.segments.size() == 2);
+  CHECK(all.segments[0].nodes.size() == 3);
+  CHECK(all.segments[0].bytes == 3 * 256);
+  CHECK(all.segments[0].flops == h2Segment);
+  CHECK(all.segments[1].bytes == 256);
+  CHECK(all.segments[1].flops == h1Segment);
+  CHECK(all.numRecomputed() == 2);
+  CHECK(all.peakBytes == 8 * 256);
+  CHECK(all.flops == flops);
+  CHECK(all.recomputeFlops == h1Segment + h2Segment);
+
+  auto one = build(/*checkpointing=*/true, /*budget=*/10 * 256);
+  CHECK(one.segments[0].recompute);
+  CHECK(!one.segments[1].recompute);
+  CHECK(one.peakBytes == 9 * 256);
+  CHECK(one.recomputeFlops == h2Segment);
+
+  auto both = build(/*checkpointing=*/true, /*budget=*/9 * 256 - 1);
+  CHECK(both.numRecomputed() == 2);
+  CHECK(both.peakBytes == 8 * 256);
+
+  auto fits = build(/*checkpointing=*/true, /*budget=*/12 * 256);
+  CHECK(fits.numRecomputed() == 0);
+  CHECK(fits.peakBytes == none.peakBytes);
+  CHECK(fits.recomputeFlops == 0);
+}
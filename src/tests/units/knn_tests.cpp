@@ -0,0 +1,115 @@
+#include "catch.hpp"
+#include "embedder/knn.h"
+#include "embedder/vector_collector.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <random>
+
+using namespace marian;
+
+namespace {
+
+std::vector<float> randomVectors(size_t rows, size_t dim, std::mt19937& rng) {
+  std::normal_distribution<float> normal;
+  std::vector<float> data(rows * dim);
+  for(auto& x : data)
+    x = normal(rng);
+  return data;
+}
+
+}  // namespace
+
+TEST_CASE("Nearest neighbour search and margin mining", "[knn]") {
+  std::mt19937 rng(42);
+  size_t rows = 1000, dim = 32, k = 5;
+  auto base = New<knn::Embeddings>(randomVectors(rows, dim, rng), dim);
+  knn::Embeddings queries(randomVectors(300, dim, rng), dim);
+
+  std::vector<float> scores;
+  std::vector<int64_t> ids;
+  knn::Index exact(base, /*nlist=*/0);
+  exact.search(queries, k, 0, scores, ids);
+
+  SECTION("exact search returns the best rows in order") {
+    for(size_t q = 0; q < queries.rows(); ++q) {
+      std::vector<std::pair<float, int64_t>> all;
+      for(size_t r = 0; r < rows; ++r) {
+        float s = 0;
+        for(size_t j = 0; j < dim; ++j)
+          s += queries.row(q)[j] * base->row(r)[j];
+        all.push_back({s, (int64_t)r});
+      }
+      std::partial_sort(all.begin(), all.begin() + k, all.end(), std::greater<std::pair<float, int64_t>>());
+      for(size_t j = 0; j < k; ++j) {
+        CHECK(ids[q * k + j] == all[j].second);
+        CHECK(scores[q * k + j] == Approx(all[j].first).epsilon(1e-4));
+      }
+    }
+  }
+
+  SECTION("an inverted file index that visits every list is exact") {
+    knn::Index ivf(base, /*nlist=*/16, /*iterations=*/5);
+    std::vector<float> ivfScores;
+    std::vector<int64_t> ivfIds;
+    ivf.search(queries, k, /*nprobe=*/16, ivfScores, ivfIds);
+    CHECK(ivfIds == ids);
+
+    // visiting fewer lists finds most of the true neighbours
+    ivf.search(queries, k, /*nprobe=*/4, ivfScores, ivfIds);
+    size_t found = 0;
+    for(size_t q = 0; q < queries.rows(); ++q)
+      for(size_t j = 0; j < k; ++j)
+        found += std::count(ids.begin() + q * k, ids.begin() + (q + 1) * k, ivfIds[q * k + j]);
+    CHECK(found > queries.rows() * k / 2);
+  }
+
+  SECTION("margin mining recovers translations") {
+    // targets are a permutation of noisy copies of the sources
+    std::vector<size_t> permutation(rows);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::shuffle(permutation.begin(), permutation.end(), rng);
+    std::normal_distribution<float> noise(0.f, 0.02f);
+    std::vector<float> targetData(rows * dim);
+    for(size_t i = 0; i < rows; ++i)
+      for(size_t j = 0; j < dim; ++j)
+        targetData[permutation[i] * dim + j] = base->row(i)[j] + noise(rng);
+    auto targets = New<knn::Embeddings>(std::move(targetData), dim);
+
+    knn::Index sourceIndex(base, 0), targetIndex(targets, 0);
+    auto candidates = knn::mineMargin(*base, *targets, sourceIndex, targetIndex, k, 0);
+    for(size_t i = 0; i < rows; ++i) {
+      CHECK(candidates[i].target == (int64_t)permutation[i]);
+      CHECK(candidates[i].margin > 1.f);
+    }
+  }
+}
+
+TEST_CASE("Embeddings are written as npy and read back", "[knn]") {
+  std::string file = "knn_tests.npy";
+  std::vector<std::vector<float>> vectors = {{3, 4, 0}, {0, -2, 0}, {1, 1, 1}};
+
+  for(auto type : {"float32", "float16", "int8"}) {
+    auto options = New<Options>();
+    options->set("output", file);
+    options->set("embedding-format", "npy");
+    options->set("embedding-type", type);
+    {
+      VectorCollector collector(options);
+      // out of order as from several threads
+      collector.Write(2, vectors[2]);
+      collector.Write(0, vectors[0]);
+      collector.Write(1, vectors[1]);
+    }
+
+    knn::Embeddings embeddings(file);
+    REQUIRE(embeddings.rows() == 3);
+    REQUIRE(embeddings.dim() == 3);
+    CHECK(embeddings.row(0)[0] == Approx(0.6f).epsilon(0.01));
+    CHECK(embeddings.row(0)[1] == Approx(0.8f).epsilon(0.01));
+    CHECK(embeddings.row(1)[1] == Approx(-1.f).epsilon(0.01));
+    CHECK(embeddings.row(2)[2] == Approx(0.57735f).epsilon(0.01));
+  }
+  std::remove(file.c_str());
+}
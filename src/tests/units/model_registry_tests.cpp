@@ -0,0 +1,108 @@
+#include "catch.hpp"
+#include "translator/model_registry.h"
+
+#include <fstream>
+#include <future>
+
+using namespace marian;
+
+namespace {
+
+// Stands in for a TranslateService: checks its model file like one and, like TranslateService::run,
+// translates in a ThreadPool
+class EchoService {
+public:
+  EchoService(Ptr<Options> options) : prefix_(options->get<std::string>("echo-prefix", "")) {
+    auto models = options->get<std::vector<std::string>>("models");
+    ABORT_IF(!std::ifstream(models[0]), "Model file {} does not exist", models[0]);
+  }
+
+  std::string run(const std::string& input) {
+    ThreadPool threadPool(2, 2);
+    return threadPool.enqueue([this, input]() { return prefix_ + input; }).get();
+  }
+
+private:
+  std::string prefix_;
+};
+
+typedef ModelRegistry<EchoService> Registry;
+
+struct Loaded {
+  std::string error;
+  Ptr<const Registry::Model> model;
+};
+
+// Waits for the result of a background load
+Loaded waitFor(std::promise<Loaded>& promise) {
+  return promise.get_future().get();
+}
+
+Registry::LoadCallback done(std::promise<Loaded>& promise) {
+  return [&promise](const std::string& error, Ptr<const Registry::Model> model) {
+    promise.set_value({error, model});
+  };
+}
+
+}  // namespace
+
+TEST_CASE("Model registry loads, translates with and replaces models in the background", "[model_registry]") {
+  std::string modelFile = "model_registry_tests.bin";
+  std::ofstream(modelFile) << "model";
+
+  // as with --model-admin, loads are requested while the default model is serving
+  auto options = New<Options>();
+  options->set("models", std::vector<std::string>({modelFile}));
+  options->set("model-admin", true);
+  options->set("model-warmup", "warm-up");
+  options->set("ignore-model-config", true);
+  options->set("echo-prefix", "default:");
+
+  Registry registry(options);
+  REQUIRE(registry.get(""));
+  CHECK(registry.get("")->service->run("a") == "default:a");
+
+  YAML::Node source;
+  source["models"].push_back(modelFile);
+  source["echo-prefix"] = "en-de:";
+
+  std::promise<Loaded> first;
+  registry.load("en-de", source, done(first));
+  auto loaded = waitFor(first);
+  CHECK(loaded.error.empty());
+  REQUIRE(loaded.model);
+  CHECK(loaded.model->generation == 1);
+  CHECK(registry.get("en-de")->service->run("b") == "en-de:b");
+
+  // a model that fails to load is reported and neither replaces a model nor ends the process
+  YAML::Node missing;
+  missing["models"].push_back("model_registry_tests.missing.bin");
+  std::promise<Loaded> failed;
+  registry.load("en-de", missing, done(failed));
+  loaded = waitFor(failed);
+  CHECK(loaded.error.find("does not exist") != std::string::npos);
+  CHECK(!loaded.model);
+  CHECK(registry.get("en-de")->generation == 1);
+
+  std::promise<Loaded> invalid;
+  registry.load("en de", source, done(invalid));
+  CHECK(!waitFor(invalid).error.empty());
+  CHECK(!getThrowExceptionOnAbort());
+
+  // requests keep the model they started with
+  auto running = registry.get("en-de");
+  std::promise<Loaded> second;
+  std::string error;
+  REQUIRE(registry.reload("en-de", done(second), error));
+  loaded = waitFor(second);
+  CHECK(loaded.error.empty());
+  CHECK(registry.get("en-de")->generation == 2);
+  CHECK(running->generation == 1);
+  CHECK(running->service->run("c") == "en-de:c");
+
+  CHECK(!registry.reload("fr-en", done(second), error));
+  CHECK(!registry.unload(Registry::DEFAULT, error));
+  CHECK(registry.unload("en-de", error));
+  CHECK(!registry.get("en-de"));
+  CHECK(registry.list().size() == 1);
+}
@@ -5,6 +5,10 @@
 #include "catch.hpp"
 #include "graph/expression_graph.h"
 #include "graph/expression_operators.h"
+#include "tensors/cpu/native_gemm.h"
+#include "tensors/cpu/intgemm_interface.h"
+#include "tensors/cpu/parallel.h"
+#include "rnn/attention.h"
 
 #ifdef CUDA_FOUND
 #include "tensors/gpu/backend.h"
@@ -235,6 +239,44 @@ void tests(DeviceType device, Type floatType = Type::float32) {
     CHECK(!t6->trainable());
   }
 
+  SECTION("transposing tensors with partial tiles") {
+    graph->clear();
+    values.clear();
+
+    std::vector<int> dims = {3, 19, 5, 37};
+    std::vector<T> vA(3 * 19 * 5 * 37);
+    for(size_t i = 0; i < vA.size(); ++i)
+      vA[i] = (T)(i % 251);
+
+    auto a = graph->constant({3, 19, 5, 37}, inits::fromVector(vA));
+    std::vector<std::vector<int>> perms = {{0, 2, 1, 3}, {0, 1, 3, 2}, {3, 1, 0, 2}, {2, 3, 0, 1}};
+    std::vector<Expr> ts;
+    for(auto& perm : perms)
+      ts.push_back(transpose(a, perm));
+
+    graph->forward();
+
+    for(size_t p = 0; p < perms.size(); ++p) {
+      auto& perm = perms[p];
+      std::vector<T> expected(vA.size());
+      std::vector<int> idx(4);
+      for(idx[0] = 0; idx[0] < dims[0]; ++idx[0])
+        for(idx[1] = 0; idx[1] < dims[1]; ++idx[1])
+          for(idx[2] = 0; idx[2] < dims[2]; ++idx[2])
+            for(idx[3] = 0; idx[3] < dims[3]; ++idx[3]) {
+              int in = ((idx[0] * dims[1] + idx[1]) * dims[2] + idx[2]) * dims[3] + idx[3];
+              int out = 0;
+              for(int i = 0; i < 4; ++i)
+                out = out * dims[perm[i]] + idx[perm[i]];
+              expected[out] = vA[in];
+            }
+
+      ts[p]->val()->get(values);
+      CHECK(ts[p]->shape() == Shape({dims[perm[0]], dims[perm[1]], dims[perm[2]], dims[perm[3]]}));
+      CHECK(values == expected);
+    }
+  }
+
   SECTION("softmax and logsoftmax") {
     graph->clear();
     values.clear();
@@ -615,6 +657,60 @@ void tests(DeviceType device, Type floatType = Type::float32) {
     CHECK(values2 == values);
   }
 
+  // bfloat16 is a storage type for weight matrices on the CPU, products are computed in float32
+  if(device == DeviceType::cpu && floatType == Type::float32) {
+    SECTION("dot product and affine with bfloat16 weights") {
+      graph->clear();
+      values.clear();
+
+      CHECK((float)bfloat16(1.f + 1.f / 256.f) == 1.f);               // tie, rounds to even
+      CHECK((float)bfloat16(1.f + 3.f / 256.f) == 1.f + 4.f / 256.f); // tie, rounds to even
+      CHECK((float)bfloat16(-3.f) == -3.f);
+      CHECK(std::isnan((float)bfloat16(NAN)));
+
+      // inner dimension larger than one block of the bfloat16 product, small integers are exact in bfloat16
+      int rows = 4, k = 600, cols = 3;
+      std::vector<float> vA(rows * k), vB(k * cols), vBt(cols * k);
+      for(int i = 0; i < rows * k; ++i)
+        vA[i] = (float)(i % 5) - 2.f;
+      for(int i = 0; i < k; ++i) {
+        for(int j = 0; j < cols; ++j) {
+          vB[i * cols + j] = (float)((i + 2 * j) % 7) - 3.f;
+          vBt[j * k + i]   = vB[i * cols + j];
+        }
+      }
+
+      auto A     = graph->param("A", {rows, k}, inits::fromVector(vA));
+      auto B     = graph->param("B", {k, cols}, inits::fromVector(vB));
+      auto Bbf   = graph->param("Bbf", {k, cols}, inits::fromVector(vB), Type::bfloat16);
+      auto Btbf  = graph->param("Btbf", {cols, k}, inits::fromVector(vBt), Type::bfloat16);
+      auto bias  = graph->param("bias", {1, cols}, inits::fromValue(2));
+
+      auto C     = dot(A, B);
+      auto Cbf   = dot(A, Bbf);
+      auto Ctbf  = dot(A, Btbf, /*transA=*/false, /*transB=*/true);
+      auto aff   = affine(A, B, bias);
+      auto affbf = affine(A, Bbf, bias);
+
+      graph->forward();
+
+      CHECK(Bbf->value_type() == Type::bfloat16);
+      CHECK(Cbf->value_type() == Type::float32);
+      CHECK(Cbf->shape() == Shape({rows, cols}));
+
+      C->val()->get(values);
+      Cbf->val()->get(values2);
+      CHECK(values == values2);
+
+      Ctbf->val()->get(values2);
+      CHECK(values == values2);
+
+      aff->val()->get(values);
+      affbf->val()->get(values2);
+      CHECK(values == values2);
+    }
+  }
+
   SECTION("bdot") {
     graph->clear();
     values.clear();
@@ -1118,6 +1214,473 @@ TEST_CASE("Expression graph supports basic math operations (cpu)", "[operator]")
 }
 #endif
 
+#ifdef BLAS_FOUND
+TEST_CASE("Element-wise operators and reductions on cpu with remainders and intra-op threads", "[operator]") {
+  auto floatApprox = [](float x, float y) -> bool { return x == Approx(y).epsilon(0.0001f).margin(0.0001f); };
+
+  // computes element-wise expressions without (flat) and with broadcasting and a reduction
+  auto run = [&](size_t threads, Shape shape, std::vector<std::vector<float>>& results) {
+    cpu::setIntraOpThreads(threads);
+
+    auto graph = New<ExpressionGraph>();
+    graph->setInference(true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(16);
+
+    std::vector<float> vA(shape.elements()), vB(shape.elements()), vC(shape[-1]);
+    for(size_t i = 0; i < vA.size(); ++i) {
+      vA[i] = (i % 13) * 0.1f - 0.6f;
+      vB[i] = (i % 7) * 0.2f + 0.1f;
+    }
+    for(size_t i = 0; i < vC.size(); ++i)
+      vC[i] = i * 0.01f;
+
+    auto a = graph->constant(shape, inits::fromVector(vA));
+    auto b = graph->constant(shape, inits::fromVector(vB));
+    auto c = graph->constant({1, shape[-1]}, inits::fromVector(vC));
+
+    auto flat  = exp(a) * b + a;
+    auto bcast = a * c + log(b);
+    auto rsum  = sum(flat, -1);
+    graph->forward();
+
+    results.resize(3);
+    flat->val()->get(results[0]);
+    bcast->val()->get(results[1]);
+    rsum->val()->get(results[2]);
+
+    // reference values
+    for(size_t i = 0; i < vA.size(); ++i) {
+      CHECK(floatApprox(results[0][i], std::exp(vA[i]) * vB[i] + vA[i]));
+      CHECK(floatApprox(results[1][i], vA[i] * vC[i % shape[-1]] + std::log(vB[i])));
+    }
+  };
+
+  for(Shape shape : {Shape({3, 37}), Shape({5, 16}), Shape({64, 1001})}) {
+    std::vector<std::vector<float>> serial, parallel;
+    run(1, shape, serial);
+    run(3, shape, parallel);
+    for(size_t i = 0; i < serial.size(); ++i)
+      CHECK(serial[i] == parallel[i]);
+  }
+
+  cpu::setIntraOpThreads(1);
+}
+
+TEST_CASE("Errors in any chunk of a parallel loop reach the caller", "[operator]") {
+  cpu::setIntraOpThreads(3);
+
+  // the caller processes the first chunk, the helper threads the others
+  for(size_t failing : {0, 5, 9}) {
+    std::vector<int> done(10, 0);
+    auto run = [&]() {
+      cpu::parallelFor(10, 1, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+          if(i == failing)
+            throw std::runtime_error("chunk failed");
+          done[i] = 1;
+        }
+      });
+    };
+    CHECK_THROWS_WITH(run(), "chunk failed");
+  }
+
+  // ABORT in a helper thread throws like it does on the calling thread
+  {
+    ScopedThrowExceptionOnAbort throwOnAbort;
+    CHECK_THROWS(cpu::parallelFor(10, 1, [](size_t begin, size_t) { ABORT_IF(begin > 0, "helper failed"); }));
+  }
+
+  cpu::setIntraOpThreads(1);
+}
+
+TEST_CASE("Gather and scatter of contiguous blocks on cpu", "[operator]") {
+  // beam reordering layout [beam, time, batch, dim] with an odd dimension
+  Shape shape({3, 2, 4, 33});
+  std::vector<float> vA(shape.elements());
+  for(size_t i = 0; i < vA.size(); ++i)
+    vA[i] = (float)i;
+
+  for(size_t threads : {1, 3}) {
+    cpu::setIntraOpThreads(threads);
+
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(16);
+
+    auto a = graph->param("a", shape, inits::fromVector(vA));
+    auto beams = index_select(a, 0, std::vector<IndexType>({2, 0, 0}));      // repeated index, sums in backward
+    auto batch = index_select(a, -2, std::vector<IndexType>({3, 1}));
+    auto idx = graph->constant({3, 2, 2, 1}, inits::fromVector(std::vector<IndexType>{
+                                   0, 3,  1, 1,
+                                   2, 2,  3, 0,
+                                   1, 0,  0, 0}), Type::uint32);
+    auto batched = gather(a, -2, idx);                             // indices broadcast over dim
+    auto cost = sum(sum(sum(sum(beams, -1), -2), -3), -4)
+              + sum(sum(sum(sum(batch, -1), -2), -3), -4)
+              + sum(sum(sum(sum(batched, -1), -2), -3), -4);
+
+    graph->forward();
+    graph->backward();
+
+    auto at = [&](int b, int t, int n, int d) { return vA[((b * 2 + t) * 4 + n) * 33 + d]; };
+
+    std::vector<float> values;
+    beams->val()->get(values);
+    std::vector<int> beamIdx = {2, 0, 0};
+    for(int b = 0; b < 3; ++b)
+      for(int t = 0; t < 2; ++t)
+        for(int n = 0; n < 4; ++n)
+          for(int d = 0; d < 33; ++d)
+            CHECK(values[((b * 2 + t) * 4 + n) * 33 + d] == at(beamIdx[b], t, n, d));
+
+    batch->val()->get(values);
+    std::vector<int> batchIdx = {3, 1};
+    for(int b = 0; b < 3; ++b)
+      for(int t = 0; t < 2; ++t)
+        for(int n = 0; n < 2; ++n)
+          for(int d = 0; d < 33; ++d)
+            CHECK(values[((b * 2 + t) * 2 + n) * 33 + d] == at(b, t, batchIdx[n], d));
+
+    batched->val()->get(values);
+    std::vector<IndexType> vIdx;
+    idx->val()->get(vIdx);
+    for(int b = 0; b < 3; ++b)
+      for(int t = 0; t < 2; ++t)
+        for(int n = 0; n < 2; ++n)
+          for(int d = 0; d < 33; ++d)
+            CHECK(values[((b * 2 + t) * 2 + n) * 33 + d] == at(b, t, vIdx[(b * 2 + t) * 2 + n], d));
+
+    // every element receives one gradient per time it was selected
+    std::vector<float> grad, expected(vA.size(), 0.f);
+    for(int b = 0; b < 3; ++b)
+      for(int t = 0; t < 2; ++t)
+        for(int n = 0; n < 4; ++n)
+          for(int d = 0; d < 33; ++d)
+            expected[((beamIdx[b] * 2 + t) * 4 + n) * 33 + d] += 1.f;
+    for(int b = 0; b < 3; ++b)
+      for(int t = 0; t < 2; ++t)
+        for(int n = 0; n < 2; ++n)
+          for(int d = 0; d < 33; ++d)
+            expected[((b * 2 + t) * 4 + batchIdx[n]) * 33 + d] += 1.f;
+    for(int b = 0; b < 3; ++b)
+      for(int t = 0; t < 2; ++t)
+        for(int n = 0; n < 2; ++n)
+          for(int d = 0; d < 33; ++d)
+            expected[((b * 2 + t) * 4 + vIdx[(b * 2 + t) * 2 + n]) * 33 + d] += 1.f;
+    a->grad()->get(grad);
+    CHECK(grad == expected);
+  }
+
+  cpu::setIntraOpThreads(1);
+}
+
+TEST_CASE("Transposing a matrix with a 4-D permutation on cpu", "[operator]") {
+  // as done for the LSH rotation matrix, the shape is padded with leading unit axes
+  auto graph = New<ExpressionGraph>();
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+
+  std::vector<float> vA(3 * 5);
+  for(size_t i = 0; i < vA.size(); ++i)
+    vA[i] = (float)i;
+  auto a = graph->constant({3, 5}, inits::fromVector(vA));
+  auto t = graph->constant({5, 3}, inits::fromValue(1.f));
+  graph->forward();
+
+  std::vector<float> values, expected(vA.size());
+  for(int i = 0; i < 3; ++i)
+    for(int j = 0; j < 5; ++j)
+      expected[j * 3 + i] = vA[i * 5 + j];
+
+  TransposeND(t->val(), a->val(), {0, 1, 3, 2});
+  t->val()->get(values);
+  CHECK(values == expected);
+
+  TransposeNDGrad(t->val(), a->val(), {0, 1, 3, 2});
+  t->val()->get(values);
+  for(auto& e : expected)
+    e *= 2;
+  CHECK(values == expected);
+}
+
+TEST_CASE("Gradients on cpu do not depend on the thread count", "[operator]") {
+  // enough rows for several row blocks and a vocabulary with several column chunks
+  const int rows = 300, cols = 37, vocab = 5000;
+  const int words = 5, batch = 60;
+  std::vector<float> vX(rows * cols), vW(rows * cols), vLogits(rows * vocab);
+  std::vector<IndexType> vLabels(rows);
+  for(size_t i = 0; i < vX.size(); ++i) {
+    vX[i] = std::sin(0.37f * i) * 3.f;
+    vW[i] = std::cos(0.11f * i);
+  }
+  for(size_t i = 0; i < vLogits.size(); ++i)
+    vLogits[i] = std::sin(0.013f * i) * 5.f;
+  for(int j = 0; j < rows; ++j)
+    vLabels[j] = (IndexType)((j * 7919) % vocab);
+
+  std::vector<std::vector<float>> results[3];
+  size_t run = 0;
+  for(size_t threads : {1, 4, 16}) {
+    cpu::setIntraOpThreads(threads);
+
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(64);
+
+    auto x = graph->param("x", {rows, cols}, inits::fromVector(vX));
+    auto xRms = graph->param("xRms", {rows, cols}, inits::fromVector(vX));
+    auto xRef = graph->param("xRef", {rows, cols}, inits::fromVector(vX));
+    auto w = graph->constant({rows, cols}, inits::fromVector(vW)); // non-uniform adjoints
+    auto gamma = graph->param("gamma", {1, cols}, inits::fromValue(1.5f));
+    auto beta = graph->param("beta", {1, cols}, inits::fromValue(0.5f));
+    auto gammaRms = graph->param("gammaRms", {1, cols}, inits::ones());
+    auto gammaRef = graph->param("gammaRef", {1, cols}, inits::ones());
+    auto logits = graph->param("logits", {rows, vocab}, inits::fromVector(vLogits));
+    auto va = graph->param("va", {cols, 1}, inits::fromValue(0.3f));
+    auto context = graph->param("context", {words, batch, cols}, inits::fromVector(std::vector<float>(vX.begin(), vX.begin() + words * batch * cols)));
+    auto state = graph->param("state", {1, batch, cols}, inits::fromVector(std::vector<float>(vW.begin(), vW.begin() + batch * cols)));
+    auto a = graph->param("a", {4, 50, cols}, inits::fromVector(std::vector<float>(vW.begin(), vW.begin() + 4 * 50 * cols)));
+    auto b = graph->param("b", {4, cols, 20}, inits::fromVector(std::vector<float>(vX.begin(), vX.begin() + 4 * cols * 20)));
+
+    auto ln = layerNorm(x, gamma, beta);
+    auto rms = rmsNorm(xRms, gammaRms, nullptr, 1e-5f);
+    auto rmsRef = gammaRef * (xRef / sqrt(mean(xRef * xRef, /*axis=*/-1) + 1e-5f));
+    auto ce = cross_entropy(logits, graph->indices(vLabels), /*labelSmoothing=*/0.1f);
+    auto att = rnn::attOps(va, context, state);
+    // the flattened logits are long enough to be summed in column chunks
+    auto cost = sum(flatten(ln * w)) + sum(flatten(rms * w)) + sum(flatten(rmsRef * w)) + sum(ce)
+              + sum(flatten(softmax(logits) * logits)) + sum(flatten(att * att))
+              + sum(flatten(bdot(a, b) * 0.1f));
+
+    graph->forward();
+    graph->backward();
+
+    std::vector<float> values, refValues;
+    for(auto node : {cost, ce, x, gamma, beta, xRms, gammaRms, logits, va, context, state, a, b}) {
+      if(node == cost || node == ce)
+        node->val()->get(values);
+      else
+        node->grad()->get(values);
+      results[run].push_back(values);
+      if(node != cost && node != ce)
+        results[run].push_back({L2Norm(node->grad(), graph->allocator())});
+    }
+
+    // the fused RMS normalization gradient matches the composed one
+    xRms->grad()->get(values);
+    xRef->grad()->get(refValues);
+    for(size_t i = 0; i < values.size(); ++i)
+      CHECK(values[i] == Approx(refValues[i]).margin(1e-4));
+    gammaRms->grad()->get(values);
+    gammaRef->grad()->get(refValues);
+    for(size_t i = 0; i < values.size(); ++i)
+      CHECK(values[i] == Approx(refValues[i]).epsilon(1e-3));
+    run++;
+  }
+
+  for(size_t i = 0; i < results[0].size(); ++i) {
+    CHECK(results[0][i] == results[1][i]);
+    CHECK(results[0][i] == results[2][i]);
+  }
+
+  cpu::setIntraOpThreads(1);
+}
+#endif
+
+TEST_CASE("Native CPU GEMM matches a reference product", "[operator]") {
+  auto floatApprox = [](float x, float y) -> bool { return x == Approx(y).epsilon(0.0001f).margin(0.0001f); };
+
+  // small shapes use the unpacked kernel, the large ones cover partial micro-kernel tiles and several k-blocks
+  std::vector<std::vector<int>> shapes = {{1, 7, 64}, {5, 50, 33}, {37, 45, 300}, {130, 19, 513}};
+  for(size_t threads : {1, 3}) {
+    cpu::setIntraOpThreads(threads);
+    for(auto& mnk : shapes) {
+      int m = mnk[0], n = mnk[1], k = mnk[2];
+      std::vector<float> a(m * k), b(k * n), c0(m * n);
+      for(size_t i = 0; i < a.size(); ++i)
+        a[i] = ((i * 7) % 19) * 0.1f - 0.9f;
+      for(size_t i = 0; i < b.size(); ++i)
+        b[i] = ((i * 5) % 11) * 0.2f - 1.f;
+      for(size_t i = 0; i < c0.size(); ++i)
+        c0[i] = (i % 3) * 0.5f;
+
+      for(bool transA : {false, true}) {
+        for(bool transB : {false, true}) {
+          for(float beta : {0.f, 1.f}) {
+            // a is stored as k x m and b as n x k when transposed, the values of op(a) and op(b) stay the same
+            std::vector<float> aStored(a.size()), bStored(b.size());
+            for(int i = 0; i < m; ++i)
+              for(int p = 0; p < k; ++p)
+                aStored[transA ? p * m + i : i * k + p] = a[i * k + p];
+            for(int p = 0; p < k; ++p)
+              for(int j = 0; j < n; ++j)
+                bStored[transB ? j * k + p : p * n + j] = b[p * n + j];
+
+            std::vector<float> c = c0;
+            cpu::nativeSgemm(transA, transB, m, n, k, 0.5f,
+                             aStored.data(), transA ? m : k,
+                             bStored.data(), transB ? k : n,
+                             beta, c.data(), n);
+
+            for(int i = 0; i < m; ++i) {
+              for(int j = 0; j < n; ++j) {
+                double sum = 0;
+                for(int p = 0; p < k; ++p)
+                  sum += (double)a[i * k + p] * b[p * n + j];
+                CHECK(floatApprox(c[i * n + j], (float)(0.5 * sum + beta * c0[i * n + j])));
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  cpu::setIntraOpThreads(1);
+}
+
+TEST_CASE("Fused attention matches softmax attention on cpu", "[operator]") {
+  auto floatApprox = [](float x, float y) -> bool { return x == Approx(y).epsilon(0.0001f).margin(0.0001f); };
+
+  // two beams share the keys and values of three sentences, more keys than one key tile
+  int dimBeam = 2, dimBatch = 3, dimQuery = 5, dimKeys = 70, dimHeads = 2, dimModel = 8;
+  int dimDepth = dimModel / dimHeads;
+  float scale = 1.f / std::sqrt((float)dimDepth);
+
+  std::vector<float> vQ(dimBeam * dimBatch * dimQuery * dimModel);
+  std::vector<float> vK(dimBatch * dimKeys * dimModel), vV(vK.size());
+  std::vector<float> vMask(dimBatch * dimKeys);
+  for(size_t i = 0; i < vQ.size(); ++i)
+    vQ[i] = ((i * 7) % 13) * 0.1f - 0.6f;
+  for(size_t i = 0; i < vK.size(); ++i) {
+    vK[i] = ((i * 5) % 17) * 0.1f - 0.8f;
+    vV[i] = ((i * 3) % 11) * 0.2f - 1.f;
+  }
+  // sentences of length 70, 41 and 3
+  std::vector<int> lengths = {70, 41, 3};
+  for(int b = 0; b < dimBatch; ++b)
+    for(int j = 0; j < dimKeys; ++j)
+      vMask[b * dimKeys + j] = j < lengths[b] ? 0.f : -99999999.f;
+
+  for(size_t threads : {1, 3}) {
+    cpu::setIntraOpThreads(threads);
+
+    auto graph = New<ExpressionGraph>(/*inference=*/true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(16);
+
+    auto q    = graph->constant({dimBeam, dimBatch, dimQuery, dimModel}, inits::fromVector(vQ));
+    auto k    = graph->constant({1, dimBatch, dimKeys, dimModel}, inits::fromVector(vK));
+    auto v    = graph->constant({1, dimBatch, dimKeys, dimModel}, inits::fromVector(vV));
+    auto mask = graph->constant({dimBatch, 1, 1, dimKeys}, inits::fromVector(vMask));
+    auto out  = fusedAttention(q, k, v, mask, dimHeads, scale);
+    CHECK(out->shape() == q->shape());
+
+    graph->forward();
+
+    std::vector<float> values;
+    out->val()->get(values);
+    for(int beam = 0; beam < dimBeam; ++beam) {
+      for(int b = 0; b < dimBatch; ++b) {
+        for(int h = 0; h < dimHeads; ++h) {
+          for(int t = 0; t < dimQuery; ++t) {
+            const float* qRow = vQ.data() + ((beam * dimBatch + b) * dimQuery + t) * dimModel + h * dimDepth;
+            std::vector<double> p(dimKeys);
+            double maxScore = -1e30, sum = 0;
+            for(int j = 0; j < dimKeys; ++j) {
+              const float* kRow = vK.data() + (b * dimKeys + j) * dimModel + h * dimDepth;
+              double score = 0;
+              for(int d = 0; d < dimDepth; ++d)
+                score += (double)qRow[d] * kRow[d];
+              p[j] = score * scale + vMask[b * dimKeys + j];
+              maxScore = std::max(maxScore, p[j]);
+            }
+            for(int j = 0; j < dimKeys; ++j)
+              sum += p[j] = std::exp(p[j] - maxScore);
+            for(int d = 0; d < dimDepth; ++d) {
+              double expected = 0;
+              for(int j = 0; j < dimKeys; ++j)
+                expected += p[j] / sum * vV[(b * dimKeys + j) * dimModel + h * dimDepth + d];
+              float actual = values[((beam * dimBatch + b) * dimQuery + t) * dimModel + h * dimDepth + d];
+              CHECK(floatApprox(actual, (float)expected));
+            }
+          }
+        }
+      }
+    }
+  }
+  cpu::setIntraOpThreads(1);
+}
+
+TEST_CASE("Int8 activation products on cpu", "[operator]") {
+  // int8 quantization keeps about two significant digits
+  auto int8Approx = [](float x, float y) -> bool { return x == Approx(y).margin(0.05f); };
+
+  std::vector<float> vA(4 * 3 * 5), vB(3 * 7 * 5), vW(9 * 5), vX(2 * 5);
+  for(size_t i = 0; i < vA.size(); ++i)
+    vA[i] = ((i * 7) % 13) * 0.1f - 0.6f;
+  for(size_t i = 0; i < vB.size(); ++i)
+    vB[i] = ((i * 5) % 11) * 0.2f - 1.f;
+  for(size_t i = 0; i < vW.size(); ++i)
+    vW[i] = ((i * 3) % 17) * 0.05f - 0.4f;
+  for(size_t i = 0; i < vX.size(); ++i)
+    vX[i] = ((i * 11) % 7) * 0.3f - 0.9f;
+  std::vector<IndexType> rows = {8, 2, 5};
+
+  for(size_t threads : {1, 3}) {
+    cpu::setIntraOpThreads(threads);
+
+    auto graph = New<ExpressionGraph>(/*inference=*/true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(16);
+
+    // [4 * 3, 5] x [3, 7, 5]^T broadcasts b over the first dimension like bdot_legacy
+    auto a = graph->constant({4, 3, 5}, inits::fromVector(vA));
+    auto b = graph->constant({3, 7, 5}, inits::fromVector(vB));
+    auto z = cpu::integer::bdotInt8(a, b, false, true, 0.5f);
+    auto bt = transpose(b, {0, 2, 1});
+    auto zt = cpu::integer::bdotInt8(a, bt, false, false, 0.5f);
+
+    // short-listed rows of a quantized weight matrix [9, 5]
+    auto W = graph->param("W", {9, 5}, inits::fromVector(vW));
+    auto idx = graph->indices(rows);
+    auto x = graph->constant({2, 5}, inits::fromVector(vX));
+    auto bias = graph->constant({1, 3}, inits::fromVector(std::vector<float>{0.1f, 0.2f, 0.3f}));
+    auto y = cpu::integer::dotInt8(x, cpu::integer::selectRowsInt8(cpu::integer::quantizeRowsInt8(W), idx), bias, 1.f);
+
+    CHECK(z->shape() == Shape({4, 3, 7}));
+    CHECK(y->shape() == Shape({2, 3}));
+    graph->forward();
+
+    std::vector<float> values, valuesT;
+    z->val()->get(values);
+    zt->val()->get(valuesT);
+    for(int batch = 0; batch < 4; ++batch) {
+      for(int i = 0; i < 3; ++i) {
+        for(int j = 0; j < 7; ++j) {
+          float expected = 0;
+          for(int p = 0; p < 5; ++p)
+            expected += vA[(batch * 3 + i) * 5 + p] * vB[((batch % 3) * 7 + j) * 5 + p];
+          CHECK(int8Approx(values[(batch * 3 + i) * 7 + j], 0.5f * expected));
+          CHECK(int8Approx(valuesT[(batch * 3 + i) * 7 + j], 0.5f * expected));
+        }
+      }
+    }
+
+    y->val()->get(values);
+    std::vector<float> vBias = {0.1f, 0.2f, 0.3f};
+    for(int i = 0; i < 2; ++i) {
+      for(int j = 0; j < 3; ++j) {
+        float expected = vBias[j];
+        for(int p = 0; p < 5; ++p)
+          expected += vX[i * 5 + p] * vW[rows[j] * 5 + p];
+        CHECK(int8Approx(values[i * 3 + j], expected));
+      }
+    }
+  }
+  cpu::setIntraOpThreads(1);
+}
+
 #ifdef BLAS_FOUND
 #ifdef CUDA_FOUND
 
@@ -0,0 +1,77 @@
+#include "catch.hpp"
+#include "translator/request_queue.h"
+
+#include <future>
+#include <vector>
+
+using namespace marian;
+
+namespace {
+
+Ptr<ServiceRequest> makeRequest(const std::string& input, size_t priority) {
+  auto request = New<ServiceRequest>();
+  request->input = input;
+  request->priority = priority;
+  return request;
+}
+
+}  // namespace
+
+TEST_CASE("Request queue schedules by priority and applies admission control", "[request_queue]") {
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::mutex mutex;
+  std::vector<std::string> processed, expired;
+
+  {
+    RequestQueue queue(
+        [&](Ptr<ServiceRequest> request) {
+          if(request->input == "block")
+            released.wait();
+          std::lock_guard<std::mutex> lock(mutex);
+          processed.push_back(request->input);
+        },
+        [&](Ptr<ServiceRequest> request) {
+          std::lock_guard<std::mutex> lock(mutex);
+          expired.push_back(request->input);
+        },
+        /*maxQueued=*/4);
+
+    std::string reason;
+    CHECK(queue.submit(makeRequest("block", 0), reason));
+    // wait until the worker has taken the blocking request
+    while(queue.metrics().running == 0)
+      std::this_thread::yield();
+
+    CHECK(queue.submit(makeRequest("low", 2), reason));
+    CHECK(queue.submit(makeRequest("high", 0), reason));
+    CHECK(queue.submit(makeRequest("medium", 1), reason));
+
+    auto late = makeRequest("late", 0);
+    late->deadline = ServiceRequest::Clock::now() + std::chrono::milliseconds(10);
+    CHECK(queue.submit(late, reason));
+
+    CHECK_FALSE(queue.submit(makeRequest("full", 0), reason));
+    CHECK(reason == "queue is full");
+
+    auto metrics = queue.metrics();
+    CHECK(metrics.queued[0] == 2);
+    CHECK(metrics.queued[1] == 1);
+    CHECK(metrics.queued[2] == 1);
+    CHECK(metrics.rejected == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release.set_value();
+    while(queue.metrics().completed + queue.metrics().expired < 5)
+      std::this_thread::yield();
+
+    metrics = queue.metrics();
+    CHECK(metrics.admitted == 5);
+    CHECK(metrics.completed == 4);
+    CHECK(metrics.expired == 1);
+    CHECK(metrics.queued.empty());
+  }
+
+  CHECK(processed == std::vector<std::string>({"block", "high", "medium", "low"}));
+  CHECK(expired == std::vector<std::string>({"late"}));
+}
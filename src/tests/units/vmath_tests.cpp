@@ -0,0 +1,218 @@
+#include "catch.hpp"
+#include "functional/functional.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+using marian::float32x4;
+using marian::float32x8;
+using marian::functional::Ops;
+#ifdef __AVX512F__
+using marian::float32x16;
+#endif
+
+namespace {
+
+// error of y in units in the last place of the correctly rounded reference
+double ulpError(float y, double ref) {
+  if(std::isnan(ref))
+    return std::isnan(y) ? 0 : std::numeric_limits<double>::infinity();
+  // references beyond the float range round to infinity
+  if(std::isinf((float)ref))
+    return y == (float)ref ? 0 : std::numeric_limits<double>::infinity();
+  double a = std::max(std::abs(ref), (double)std::numeric_limits<float>::min());
+  double ulp = std::ldexp(1.0, std::ilogb(a) - 23);
+  return std::abs((double)y - ref) / ulp;
+}
+
+float fromBits(uint32_t bits) {
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// Every step-th float of both signs plus special values, evaluated in batches of Width.
+template <int Width>
+double maxUlpError(const std::function<void(const float*, float*)>& f,
+                   const std::function<double(double)>& ref,
+                   const std::function<bool(float)>& checked,
+                   uint32_t step) {
+  std::vector<float> xs = {0.f, -0.f, 1.f, -1.f,
+                           std::numeric_limits<float>::min(),
+                           std::numeric_limits<float>::denorm_min(),
+                           std::numeric_limits<float>::max(),
+                           -std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::infinity(),
+                           -std::numeric_limits<float>::infinity()};
+  for(uint64_t bits = 0; bits < 0x7f800000u; bits += step) {
+    xs.push_back(fromBits((uint32_t)bits));
+    xs.push_back(-fromBits((uint32_t)bits));
+  }
+  while(xs.size() % Width != 0)
+    xs.push_back(0.f);
+
+  double maxErr = 0;
+  std::vector<float> ys(xs.size());
+  for(size_t i = 0; i < xs.size(); i += Width)
+    f(xs.data() + i, ys.data() + i);
+  for(size_t i = 0; i < xs.size(); ++i)
+    if(checked(xs[i]))
+      maxErr = std::max(maxErr, ulpError(ys[i], ref((double)xs[i])));
+  return maxErr;
+}
+
+bool all(float) { return true; }
+
+// exp and sigmoid flush denormal results to zero
+bool normalResult(float x) { return x > -87.3f; }
+
+double sigmoidRef(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+double logRef(double x) { return x < 0 ? std::numeric_limits<double>::quiet_NaN() : std::log(x); }
+
+}  // namespace
+
+#define APPLY4(op) [](const float* x, float* y) { float32x4 r = Ops<float32x4>::op(float32x4(_mm_loadu_ps(x))); _mm_storeu_ps(y, r); }
+#define APPLY8(op) [](const float* x, float* y) { float32x8 r = Ops<float32x8>::op(float32x8(_mm256_loadu_ps(x))); _mm256_storeu_ps(y, r); }
+#define APPLY16(op) [](const float* x, float* y) { float32x16 r = Ops<float32x16>::op(float32x16(_mm512_loadu_ps(x))); _mm512_storeu_ps(y, r); }
+
+TEST_CASE("Vectorized transcendental functions have bounded errors", "[vmath]") {
+  const uint32_t step = 4099; // about 500k samples per sign
+
+  SECTION("SSE4.1") {
+    // with FMA as in the other sections, as this test is only built with AVX2 and FMA
+    CHECK(maxUlpError<4>(APPLY4(exp), [](double x) { return std::exp(x); }, normalResult, step) <= 1.5);
+    CHECK(maxUlpError<4>(APPLY4(log), logRef, all, step) <= 1.0);
+    CHECK(maxUlpError<4>(APPLY4(tanh), [](double x) { return std::tanh(x); }, all, step) <= 1.5);
+    CHECK(maxUlpError<4>(APPLY4(sigmoid), sigmoidRef, normalResult, step) <= 3.5);
+    CHECK(maxUlpError<4>(APPLY4(erf), [](double x) { return std::erf(x); }, all, step) <= 3.5);
+  }
+
+  SECTION("AVX2") {
+    CHECK(maxUlpError<8>(APPLY8(exp), [](double x) { return std::exp(x); }, normalResult, step) <= 1.5);
+    CHECK(maxUlpError<8>(APPLY8(log), logRef, all, step) <= 1.0);
+    CHECK(maxUlpError<8>(APPLY8(tanh), [](double x) { return std::tanh(x); }, all, step) <= 1.5);
+    CHECK(maxUlpError<8>(APPLY8(sigmoid), sigmoidRef, normalResult, step) <= 3.5);
+    CHECK(maxUlpError<8>(APPLY8(erf), [](double x) { return std::erf(x); }, all, step) <= 3.5);
+  }
+
+#ifdef __AVX512F__
+  SECTION("AVX-512") {
+    CHECK(maxUlpError<16>(APPLY16(exp), [](double x) { return std::exp(x); }, normalResult, step) <= 1.5);
+    CHECK(maxUlpError<16>(APPLY16(log), logRef, all, step) <= 1.0);
+    CHECK(maxUlpError<16>(APPLY16(tanh), [](double x) { return std::tanh(x); }, all, step) <= 1.5);
+    CHECK(maxUlpError<16>(APPLY16(sigmoid), sigmoidRef, normalResult, step) <= 3.5);
+    CHECK(maxUlpError<16>(APPLY16(erf), [](double x) { return std::erf(x); }, all, step) <= 3.5);
+  }
+#endif
+
+  SECTION("special values") {
+    const float inf = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    alignas(32) float x[8] = {nan, inf, -inf, 0.f, -0.f, 100.f, -100.f, -1.f};
+    alignas(32) float y[8];
+
+    _mm256_store_ps(y, Ops<float32x8>::exp(float32x8(_mm256_load_ps(x))));
+    CHECK(std::isnan(y[0]));
+    CHECK(y[1] == inf);
+    CHECK(y[2] == 0.f);
+    CHECK(y[3] == 1.f);
+    CHECK(y[5] == inf);
+    CHECK(y[6] == 0.f);
+
+    _mm256_store_ps(y, Ops<float32x8>::log(float32x8(_mm256_load_ps(x))));
+    CHECK(std::isnan(y[0]));
+    CHECK(y[1] == inf);
+    CHECK(std::isnan(y[2]));
+    CHECK(y[3] == -inf);
+    CHECK(std::isnan(y[7]));
+
+    _mm256_store_ps(y, Ops<float32x8>::tanh(float32x8(_mm256_load_ps(x))));
+    CHECK(std::isnan(y[0]));
+    CHECK(y[1] == 1.f);
+    CHECK(y[2] == -1.f);
+    CHECK(y[5] == 1.f);
+    CHECK(y[6] == -1.f);
+
+    _mm256_store_ps(y, Ops<float32x8>::sigmoid(float32x8(_mm256_load_ps(x))));
+    CHECK(std::isnan(y[0]));
+    CHECK(y[1] == 1.f);
+    CHECK(y[2] == 0.f);
+    CHECK(y[3] == 0.5f);
+    CHECK(y[5] == 1.f);
+    CHECK(y[6] == 0.f);
+
+    // the 4-wide versions used by GRUFastForward, on {-0, 100, -100, -1}
+    _mm_store_ps(y, Ops<float32x4>::sigmoid(float32x4(_mm_load_ps(x + 4))));
+    CHECK(y[0] == 0.5f);
+    CHECK(y[1] == 1.f);
+    CHECK(y[2] == 0.f);
+    _mm_store_ps(y, Ops<float32x4>::tanh(float32x4(_mm_load_ps(x + 4))));
+    CHECK(y[0] == 0.f);
+    CHECK(y[1] == 1.f);
+    CHECK(y[2] == -1.f);
+
+    _mm256_store_ps(y, Ops<float32x8>::erf(float32x8(_mm256_load_ps(x))));
+    CHECK(std::isnan(y[0]));
+    CHECK(y[1] == 1.f);
+    CHECK(y[2] == -1.f);
+    CHECK(y[3] == 0.f);
+    CHECK(y[5] == 1.f);
+    CHECK(y[6] == -1.f);
+  }
+}
+
+// Throughput of the vectorized functions against the scalar C library, hidden by default,
+// run with: run_vmath_tests "[bench]"
+TEST_CASE("Vectorized transcendental functions throughput", "[.][bench]") {
+  const size_t size = 1 << 20;
+  const int repeats = 50;
+  std::vector<float> x(size), y(size);
+  for(size_t i = 0; i < size; ++i)
+    x[i] = -10.f + 20.f * (float)i / size;
+
+  auto time = [&](const char* name, const std::function<void()>& f) {
+    f(); // warm-up
+    auto start = std::chrono::steady_clock::now();
+    for(int r = 0; r < repeats; ++r)
+      f();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << (double)size * repeats / seconds.count() / 1e6 << " Mvalues/s" << std::endl;
+  };
+
+#define BENCH(op, scalar)                                                               \
+  time(#scalar " (scalar)", [&]() { for(size_t i = 0; i < size; ++i) y[i] = scalar(x[i]); });  \
+  time(#op " (AVX2)", [&]() {                                                            \
+    for(size_t i = 0; i < size; i += 8)                                                  \
+      _mm256_storeu_ps(&y[i], Ops<float32x8>::op(float32x8(_mm256_loadu_ps(&x[i]))));    \
+  });
+  BENCH(exp, expf)
+  BENCH(log, logf)
+  BENCH(tanh, tanhf)
+  BENCH(sigmoid, Ops<float>::sigmoid)
+  BENCH(erf, erff)
+#undef BENCH
+
+#ifdef __AVX512F__
+#define BENCH(op)                                                                        \
+  time(#op " (AVX-512)", [&]() {                                                         \
+    for(size_t i = 0; i < size; i += 16)                                                 \
+      _mm512_storeu_ps(&y[i], Ops<float32x16>::op(float32x16(_mm512_loadu_ps(&x[i]))));  \
+  });
+  BENCH(exp)
+  BENCH(log)
+  BENCH(tanh)
+  BENCH(sigmoid)
+  BENCH(erf)
+#undef BENCH
+#endif
+}
+
+#endif
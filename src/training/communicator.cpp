@@ -1,5 +1,6 @@
 #include "training/communicator.h"
 #include "common/utils.h"
+#include <cstring>
 
 #if defined(CUDA_FOUND) && defined(USE_NCCL)
 #include "training/communicator_nccl.h"
@@ -23,21 +24,28 @@ ShardingMode getShardingMode(Ptr<Options> options, Ptr<IMPIWrapper> mpi) {
 
 Ptr<ICommunicator> createCommunicator(
   const std::vector<Ptr<ExpressionGraph>>& graphs,
-  bool noNccl, ShardingMode shardingMode, Ptr<IMPIWrapper> mpi) {
+  bool noNccl, ShardingMode shardingMode, Ptr<IMPIWrapper> mpi,
+  Ptr<GradientCompressorBase> compressor) {
   mpi;
 #if defined(CUDA_FOUND) && defined(USE_NCCL)
   if(noNccl) {
     LOG(warn, "[comm] NCCL communicator overridden");
-    return New<DefaultCommunicator>(graphs, mpi);
+    return New<DefaultCommunicator>(graphs, shardingMode, mpi, compressor);
   }
 
   // if at least one of the devices is not a gpu, fall-back to default
   for(auto& graph : graphs) {
     if(graph->getBackend()->getDeviceId().type == DeviceType::cpu) {
-      return New<DefaultCommunicator>(graphs, mpi);
+      return New<DefaultCommunicator>(graphs, shardingMode, mpi, compressor);
     }
   }
 
+  // NCCL exchanges full gradients on the device, compression requires the host-side exchange
+  if(compressor && mpi && mpi->numMPIProcesses() > 1) {
+    LOG(warn, "[comm] Gradient compression requested, NCCL communicator overridden");
+    return New<DefaultCommunicator>(graphs, shardingMode, mpi, compressor);
+  }
+
   size_t d = graphs.size();
   if((d & (d - 1)) != 0) {
     LOG(warn,
@@ -50,8 +58,8 @@ Ptr<ICommunicator> createCommunicator(
   // the actual implementation is inside communicator.cu
   return New<NCCLCommunicator>(graphs, shardingMode, mpi);
 #else // no CUDA or no NCCL
-  noNccl; shardingMode; // (unused)
-  return New<DefaultCommunicator>(graphs, mpi);
+  noNccl; // (unused)
+  return New<DefaultCommunicator>(graphs, shardingMode, mpi, compressor);
 #endif
 }
 
@@ -190,6 +198,12 @@ public:
     }
   }
 
+  virtual void allGather(const void* sendbuf, size_t count, MPI_Datatype datatype, void* recvbuf, MPI_Comm comm) const override {
+    // MPI_Allgather interleaves the per-rank blocks, so we cannot simply cycle through chunks as above
+    ABORT_IF(count > (size_t)std::numeric_limits<int>::max(), "MPI_Allgather count {} exceeds MAX_INT", count);
+    HANDLE_MPI_ERROR(MPI_Allgather(sendbuf, (int)count, datatype, recvbuf, (int)count, datatype, comm));
+  }
+
   virtual void finalize() override {
     HANDLE_MPI_ERROR(MPI_Finalize());
   }
@@ -232,6 +246,20 @@ public:
     //        to only accept one parameter, and remove this error check can be removed.
     ABORT_IF(sendbuf != recvbuf, "FakeMPIWrapper::allReduce() only implemented for in-place operation"); // otherwise it's not a no-op, we must copy data
   }
+  virtual void allGather(const void* sendbuf, size_t count, MPI_Datatype datatype, void* recvbuf, MPI_Comm comm) const override {
+    comm;
+    // with a single process, gathering is a plain copy
+    // MPI_Datatype is a pointer in some MPI implementations, hence no switch
+    size_t datatypeSize = 0;
+    if(datatype == MPI_BYTE)                    datatypeSize = sizeof(char);
+    else if(datatype == MPI_INT)                datatypeSize = sizeof(int);
+    else if(datatype == MPI_FLOAT)              datatypeSize = sizeof(float);
+    else if(datatype == MPI_UNSIGNED_LONG)      datatypeSize = sizeof(unsigned long);
+    else if(datatype == MPI_UNSIGNED_LONG_LONG) datatypeSize = sizeof(unsigned long long);
+    else ABORT("FakeMPIWrapper::allGather(): unsupported data type");
+    if(sendbuf != recvbuf)
+      std::memcpy(recvbuf, sendbuf, count * datatypeSize);
+  }
 #pragma warning(pop)
   virtual void finalize() override { }
 };
@@ -5,6 +5,7 @@
 #include "functional/functional.h"
 #include "tensors/tensor_operators.h"
 #include "optimizers/optimizers.h"
+#include "training/gradient_compression.h"
 #include "3rd_party/threadpool.h"
 #if MPI_FOUND
 #ifdef __GNUC__
@@ -84,6 +85,8 @@ struct/*interface*/ IMPIWrapper {
   virtual void sSend(void* buf, size_t count, MPI_Datatype datatype, size_t destRank, int tag, MPI_Comm comm = MPI_COMM_WORLD) const = 0;
   virtual void recv(void* buf, size_t count, MPI_Datatype datatype, size_t sourceRank, int tag, MPI_Comm comm = MPI_COMM_WORLD, MPI_Status* status = MPI_STATUS_IGNORE) const = 0;
   virtual void allReduce(const void* sendbuf, void* recvbuf, size_t count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm = MPI_COMM_WORLD) const = 0;
+  // gathers 'count' elements from each process into recvbuf (size numMPIProcesses() * count), ordered by rank
+  virtual void allGather(const void* sendbuf, size_t count, MPI_Datatype datatype, void* recvbuf, MPI_Comm comm = MPI_COMM_WORLD) const = 0;
   virtual void finalize() = 0;
   static const size_t RECV_ANY_SOURCE = (size_t)MPI_ANY_SOURCE;
 
@@ -118,13 +121,51 @@ struct/*interface*/ IMPIWrapper {
 Ptr<IMPIWrapper> initMPI(bool multiThreaded);
 void finalizeMPI(Ptr<IMPIWrapper>&&);
 
-// DefaultCommunicator is used when we cannot use NCCLCommunicator, e.g. if it is not compiled in
+// DefaultCommunicator is used when we cannot use NCCLCommunicator, e.g. if it is not compiled in.
+// With multiple MPI processes, only local sharding is supported: gradient shards are reduced locally
+// and then summed across processes via MPI, optionally compressed with a GradientCompressor.
 class DefaultCommunicator : public ICommunicator {
 private:
   std::vector<Ptr<TensorAllocator>> paramsAllocs_;
   std::vector<Tensor> tmpTensors_;
   mutable ThreadPool threadPool_;
 
+  Ptr<IMPIWrapper> mpi_;                         // [not null if multi-process] for cross-process exchange
+  Ptr<GradientCompressorBase> compressor_;       // [may be null] compresses the cross-process gradient exchange
+  mutable std::vector<std::vector<float>> hostBuffers_; // [localDeviceIndex] staging buffers for non-CPU tensors
+
+  bool isMultiProcess() const { return mpi_ && mpi_->numMPIProcesses() > 1; }
+
+  // true if two graphs use the same parameter memory, see Parameters::shareValsWith()
+  static bool sharedVals(Ptr<ExpressionGraph> a, Ptr<ExpressionGraph> b) {
+    return a->params()->vals()->data() == b->params()->vals()->data();
+  }
+
+  // Sums a tensor across MPI processes, or broadcasts it from rank 0. MPI collectives have to be
+  // issued in the same order on all processes, so this must not be called from parallel threads.
+  void mpiExchange(Tensor t, size_t localDeviceIndex, bool broadcast, bool compress) const {
+    ABORT_IF(t->type() != Type::float32, "DefaultCommunicator only supports float32 tensors with multi-process MPI");
+
+    // CPU tensors can be handed to MPI directly, everything else goes through a host-side copy
+    bool onCpu = t->getBackend()->getDeviceId().type == DeviceType::cpu;
+    float* data = t->data<float>();
+    if(!onCpu) {
+      auto& buffer = hostBuffers_[localDeviceIndex];
+      t->get(buffer);
+      data = buffer.data();
+    }
+
+    if(broadcast)
+      mpi_->bCast(data, t->size(), MPI_FLOAT, /*rootRank=*/0);
+    else if(compress && compressor_)
+      compressor_->allReduce(data, t->size(), localDeviceIndex, mpi_);
+    else
+      mpi_->allReduce(data, data, t->size(), MPI_FLOAT, MPI_SUM);
+
+    if(!onCpu)
+      t->set(hostBuffers_[localDeviceIndex]);
+  }
+
   void lazyInit() {
     if(tmpTensors_.size() == 0) {
       int totalSize = (int)graphs_[0]->params()->vals()->size();
@@ -152,10 +193,17 @@ private:
   }
 
 public:
-  DefaultCommunicator(const std::vector<Ptr<ExpressionGraph>>& graphs, Ptr<IMPIWrapper> mpi)
+  DefaultCommunicator(const std::vector<Ptr<ExpressionGraph>>& graphs,
+                      ShardingMode shardingMode,
+                      Ptr<IMPIWrapper> mpi,
+                      Ptr<GradientCompressorBase> compressor = nullptr)
       : ICommunicator(graphs),
-        threadPool_(graphs.size(), graphs.size()) {
-    ABORT_IF(mpi && mpi->numMPIProcesses() != 1, "DefaultCommunicator does not support multi-process MPI");
+        threadPool_(graphs.size(), graphs.size()),
+        mpi_(mpi),
+        compressor_(compressor),
+        hostBuffers_(graphs.size()) {
+    ABORT_IF(isMultiProcess() && shardingMode != ShardingMode::local,
+             "DefaultCommunicator supports multi-process MPI only with --sharding local");
   }
 
   ~DefaultCommunicator() override {}
@@ -249,7 +297,16 @@ public:
       return true; // dummy success
     };
     
+    // sum local shards across processes, sequentially since MPI calls need to happen in the same order everywhere
+    auto crossProcessReduce = [this](size_t idx, size_t begin, size_t end) {
+      auto curGrad = graphs_[idx]->params()->grads()->subtensor(begin, end - begin);
+      mpiExchange(curGrad, idx, /*broadcast=*/false, /*compress=*/true);
+      return true; // dummy success
+    };
+
     foreach(scatter);
+    if(isMultiProcess())
+      foreach(crossProcessReduce, /*parallel=*/false);
     foreach(reset);
   }
 
@@ -263,7 +320,7 @@ public:
       auto curShard = getShard(graphs_[idx]);
       // Copy parameter shard to each graph
       for(auto graph : graphs_) {
-        if(graph != graphs_[idx]) {
+        if(graph != graphs_[idx] && !sharedVals(graph, graphs_[idx])) {
           auto subShard = getShard(graph);
           subShard->copyFrom(curShard);
         }
@@ -276,11 +333,21 @@ public:
   }
 
   void broadcastParams(bool average = false) const override {
-    ABORT_IF(average, "Parameter averaging not implemented in DefaultCommunicator::broadcastParams");
+    ABORT_IF(average && !isMultiProcess(), "Parameter averaging not implemented in DefaultCommunicator::broadcastParams");
+
+    // Synchronize first graph across processes
+    if(isMultiProcess()) {
+      auto vals = graphs_[0]->params()->vals();
+      mpiExchange(vals, 0, /*broadcast=*/!average, /*compress=*/false);
+      if(average) {
+        using namespace functional;
+        Element(_1 = _1 / (float)mpi_->numMPIProcesses(), vals);
+      }
+    }
 
     // Copy parameters from first graph
     auto copyFromFirst = [this](size_t idx, size_t /*begin*/, size_t /*end*/) {
-      if(idx != 0)
+      if(idx != 0 && !sharedVals(graphs_[idx], graphs_[0]))
         graphs_[idx]->params()->vals()->copyFrom(graphs_[0]->params()->vals());
       return true; // dummy success
     };
@@ -289,8 +356,21 @@ public:
   }
 
   virtual void broadcastShards(const std::vector<Ptr<OptimizerBase>>& opts, bool average = false) const override {
-    opts; average;
-    ABORT("DefaultCommunicator::broadcastShards not implemented");
+    if(!isMultiProcess())
+      return; // nothing to do, shards are independent
+
+    // if we are here we use local mode and shards are process-wise copies
+    for(size_t i = 0; i < opts.size(); ++i) {
+      for(auto shard : opts[i]->getShards()) {
+        if(shard) {
+          mpiExchange(shard, i, /*broadcast=*/!average, /*compress=*/false);
+          if(average) {
+            using namespace functional;
+            Element(_1 = _1 / (float)mpi_->numMPIProcesses(), shard);
+          }
+        }
+      }
+    }
   }
 
   void scatterState(const io::Item& data, const OptimizerBase::ScatterStateSetFunc& setFn) const override {
@@ -317,6 +397,7 @@ public:
 
 Ptr<ICommunicator> createCommunicator(
     const std::vector<Ptr<ExpressionGraph>>& graphs,
-    bool noNccl, ShardingMode shardingMode, Ptr<IMPIWrapper> mpi);
+    bool noNccl, ShardingMode shardingMode, Ptr<IMPIWrapper> mpi,
+    Ptr<GradientCompressorBase> compressor = nullptr);
 
 }  // namespace marian
@@ -0,0 +1,202 @@
+#include "training/gradient_compression.h"
+#include "training/communicator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace marian {
+
+GradientCompressorBase::~GradientCompressorBase() {
+  if(stats_.calls > 0)
+    logStats();
+}
+
+void GradientCompressorBase::allReduce(float* data, size_t size, size_t shardIndex, Ptr<IMPIWrapper> mpi) {
+  size_t numProcesses = mpi ? mpi->numMPIProcesses() : 1;
+  if(numProcesses == 1) // nothing to exchange, hence nothing to compress
+    return;
+  isMainProcess_ = mpi->isMainProcess();
+
+  timer::Timer timer;
+
+  // apply error feedback: add what was not transmitted previously. The new residual is only kept
+  // once the result is known to be finite, see below.
+  if(residuals_.size() <= shardIndex)
+    residuals_.resize(shardIndex + 1);
+  auto& residual = residuals_[shardIndex];
+  if(residual.size() != size)
+    residual.assign(size, 0.f);
+  nextResidual_.resize(size);
+  bool finite = true;
+  for(size_t i = 0; i < size; ++i) {
+    finite &= std::isfinite(data[i]);
+    nextResidual_[i] = residual[i] + data[i];
+  }
+
+  // compress and keep the part that did not make it into the message
+  size_t bytes = messageBytes(size);
+  sendBuffer_.resize(bytes);
+  encode(nextResidual_.data(), size, sendBuffer_.data());
+  decodeAdd(sendBuffer_.data(), size, nextResidual_.data(), -1.f);
+
+  stats_.compressSeconds += timer.elapsed();
+  timer.start();
+
+  // all messages have the same size, hence a single allGather does the exchange
+  recvBuffer_.resize(bytes * numProcesses);
+  mpi->allGather(sendBuffer_.data(), bytes, MPI_BYTE, recvBuffer_.data());
+
+  stats_.exchangeSeconds += timer.elapsed();
+  timer.start();
+
+  // sum all decoded messages into the output buffer
+  std::fill(data, data + size, 0.f);
+  for(size_t rank = 0; rank < numProcesses; ++rank)
+    decodeAdd(recvBuffer_.data() + rank * bytes, size, data, 1.f);
+
+  // A NaN or Inf in the summed gradient makes cost scaling or --check-gradient-nan skip the update,
+  // hence nothing of this step is applied and the residual stays as it was. Otherwise the NaN/Inf
+  // would remain in the residual and poison all later steps.
+  for(size_t i = 0; i < size && finite; ++i)
+    finite = std::isfinite(data[i]);
+  if(finite)
+    residual.swap(nextResidual_);
+  else
+    LOG(debug, "[comm] Non-finite gradient in compressed all-reduce of shard {}, residual not updated", shardIndex);
+
+  stats_.compressSeconds += timer.elapsed();
+  stats_.calls++;
+  stats_.rawBytes  += size * sizeof(float);
+  stats_.sentBytes += bytes;
+
+  LOG(debug, "[comm] Compressed all-reduce of shard {} with {} floats into {} bytes", shardIndex, size, bytes);
+  if(stats_.calls % LOG_FREQ == 0)
+    logStats();
+}
+
+void GradientCompressorBase::logStats() const {
+  if(!isMainProcess_)
+    return;
+  LOG(info,
+      "[comm] Gradient compression ({}): {:.1f}x smaller messages, {:.2f}s compressing, {:.2f}s exchanging over {} all-reduces",
+      name(),
+      stats_.ratio(),
+      stats_.compressSeconds,
+      stats_.exchangeSeconds,
+      stats_.calls);
+}
+
+TopKGradientCompressor::TopKGradientCompressor(Ptr<Options> options, float ratio)
+  : GradientCompressorBase(options, "top-k, ratio " + std::to_string(ratio)), ratio_(ratio) {
+  ABORT_IF(ratio_ <= 0.f || ratio_ > 1.f, "Top-k gradient compression ratio must be in (0, 1], got {}", ratio_);
+}
+
+size_t TopKGradientCompressor::topK(size_t size) const {
+  return std::max((size_t)1, std::min(size, (size_t)std::ceil(ratio_ * size)));
+}
+
+// message layout: k uint32_t indices followed by k float values
+size_t TopKGradientCompressor::messageBytes(size_t size) const {
+  return topK(size) * (sizeof(uint32_t) + sizeof(float));
+}
+
+void TopKGradientCompressor::encode(const float* in, size_t size, char* out) const {
+  ABORT_IF(size > (size_t)std::numeric_limits<uint32_t>::max(), "Gradient shard too large for top-k compression");
+  size_t k = topK(size);
+
+  indices_.resize(size);
+  for(size_t i = 0; i < size; ++i)
+    indices_[i] = (uint32_t)i;
+
+  // partial selection of the k entries with the largest magnitude
+  auto byMagnitude = [in](uint32_t a, uint32_t b) { return std::abs(in[a]) > std::abs(in[b]); };
+  if(k < size)
+    std::nth_element(indices_.begin(), indices_.begin() + k, indices_.end(), byMagnitude);
+  // sorted indices give a sequential access pattern when decoding
+  std::sort(indices_.begin(), indices_.begin() + k);
+
+  uint32_t* outIndices = (uint32_t*)out;
+  float*    outValues  = (float*)(out + k * sizeof(uint32_t));
+  for(size_t i = 0; i < k; ++i) {
+    outIndices[i] = indices_[i];
+    outValues[i]  = in[indices_[i]];
+  }
+}
+
+void TopKGradientCompressor::decodeAdd(const char* in, size_t size, float* out, float scale) const {
+  size_t k = topK(size);
+  const uint32_t* inIndices = (const uint32_t*)in;
+  const float*    inValues  = (const float*)(in + k * sizeof(uint32_t));
+  for(size_t i = 0; i < k; ++i)
+    out[inIndices[i]] += scale * inValues[i];
+}
+
+QuantizedGradientCompressor::QuantizedGradientCompressor(Ptr<Options> options, size_t bucketSize)
+  : GradientCompressorBase(options, "8-bit, bucket size " + std::to_string(bucketSize)), bucketSize_(bucketSize) {
+  ABORT_IF(bucketSize_ == 0, "Bucket size for 8-bit gradient compression must be larger than 0");
+}
+
+// message layout: one float scale per bucket followed by one int8_t per value
+size_t QuantizedGradientCompressor::messageBytes(size_t size) const {
+  size_t numBuckets = (size + bucketSize_ - 1) / bucketSize_;
+  return numBuckets * sizeof(float) + size * sizeof(int8_t);
+}
+
+void QuantizedGradientCompressor::encode(const float* in, size_t size, char* out) const {
+  size_t numBuckets = (size + bucketSize_ - 1) / bucketSize_;
+  float*  scales = (float*)out;
+  int8_t* values = (int8_t*)(out + numBuckets * sizeof(float));
+
+  for(size_t b = 0; b < numBuckets; ++b) {
+    size_t begin = b * bucketSize_;
+    size_t end   = std::min(begin + bucketSize_, size);
+
+    float maxAbs = 0.f;
+    for(size_t i = begin; i < end; ++i)
+      maxAbs = std::max(maxAbs, std::abs(in[i]));
+
+    float scale = maxAbs / 127.f;
+    scales[b] = scale;
+    float multiplier = scale > 0.f ? 1.f / scale : 0.f;
+    for(size_t i = begin; i < end; ++i)
+      values[i] = (int8_t)std::round(in[i] * multiplier);
+  }
+}
+
+void QuantizedGradientCompressor::decodeAdd(const char* in, size_t size, float* out, float scale) const {
+  size_t numBuckets = (size + bucketSize_ - 1) / bucketSize_;
+  const float*  scales = (const float*)in;
+  const int8_t* values = (const int8_t*)(in + numBuckets * sizeof(float));
+
+  for(size_t b = 0; b < numBuckets; ++b) {
+    size_t begin = b * bucketSize_;
+    size_t end   = std::min(begin + bucketSize_, size);
+    float bucketScale = scale * scales[b];
+    for(size_t i = begin; i < end; ++i)
+      out[i] += bucketScale * (float)values[i];
+  }
+}
+
+Ptr<GradientCompressorBase> GradientCompressor(Ptr<Options> options) {
+  auto params = options->get<std::vector<std::string>>("gradient-compression", {});
+  if(params.empty() || params[0] == "none")
+    return nullptr;
+
+  Ptr<GradientCompressorBase> compressor;
+  if(params[0] == "topk") {
+    float ratio = params.size() > 1 ? std::stof(params[1]) : 0.01f;
+    compressor = New<TopKGradientCompressor>(options, ratio);
+  } else if(params[0] == "8bit") {
+    size_t bucketSize = params.size() > 1 ? std::stoul(params[1]) : 512;
+    compressor = New<QuantizedGradientCompressor>(options, bucketSize);
+  } else {
+    ABORT("Unknown gradient compression type: {}", params[0]);
+  }
+
+  LOG_ONCE(info, "[comm] Compressing gradients exchanged between MPI processes: {}", compressor->name());
+  return compressor;
+}
+
+}  // namespace marian
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "common/definitions.h"
+#include "common/options.h"
+#include "common/timer.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace marian {
+
+struct/*interface*/ IMPIWrapper;
+
+/**
+ * Statistics collected by a gradient compressor over the course of training.
+ * Byte counts refer to the per-process payload, i.e. what a single process sends.
+ */
+struct GradientCompressionStats {
+  size_t calls{0};             // number of compressed all-reduces
+  size_t rawBytes{0};          // bytes an uncompressed fp32 exchange would have sent
+  size_t sentBytes{0};         // bytes actually sent
+  double compressSeconds{0};   // time spent in error feedback, encoding and decoding
+  double exchangeSeconds{0};   // time spent in the MPI exchange
+
+  float ratio() const { return sentBytes > 0 ? (float)rawBytes / (float)sentBytes : 0.f; }
+};
+
+/**
+ * Base class for gradient compression with error feedback for the gradient exchange
+ * between MPI processes. Each local gradient shard has its own residual accumulator
+ * which keeps the part of the gradient that was not transmitted in the previous steps
+ * and adds it back before the next compression.
+ * Messages have the same size on every process, so the exchange is a plain allGather of
+ * the compressed shards followed by local decoding and summation.
+ *
+ * Example:
+ *   auto compressor = GradientCompressor(options); // nullptr if compression is disabled
+ *   compressor->allReduce(shardData, shardSize, localDeviceIndex, mpi);
+ */
+class GradientCompressorBase {
+public:
+  GradientCompressorBase(Ptr<Options> options, const std::string& name)
+  : options_(options), name_(name) {}
+  virtual ~GradientCompressorBase();
+
+  // Sums the CPU-side float buffer 'data' of length 'size' across all MPI processes in-place.
+  // 'shardIndex' identifies the residual accumulator (one per local shard).
+  // Must be called by one thread at a time and in the same order on all processes.
+  void allReduce(float* data, size_t size, size_t shardIndex, Ptr<IMPIWrapper> mpi);
+
+  const GradientCompressionStats& stats() const { return stats_; }
+  void logStats() const;
+
+  const std::string& name() const { return name_; }
+
+  // size of a compressed message for 'size' floats
+  virtual size_t messageBytes(size_t size) const = 0;
+  // encode 'size' floats from 'in' into 'out' which has messageBytes(size) bytes
+  virtual void encode(const float* in, size_t size, char* out) const = 0;
+  // decode message 'in' and add it, scaled by 'scale', to 'out' which holds 'size' floats
+  virtual void decodeAdd(const char* in, size_t size, float* out, float scale) const = 0;
+
+protected:
+  Ptr<Options> options_;
+  std::string name_;
+
+  std::vector<std::vector<float>> residuals_; // [shardIndex] error-feedback residuals
+  std::vector<float> nextResidual_;           // residual after the current step, kept if the step is finite
+  std::vector<char> sendBuffer_;
+  std::vector<char> recvBuffer_;
+
+  GradientCompressionStats stats_;
+  bool isMainProcess_{true};
+
+  static const size_t LOG_FREQ = 1000; // log a summary every that many all-reduces
+};
+
+/**
+ * Top-k sparsification. Only the k = ratio * size entries with the largest magnitude
+ * are transmitted as (index, value) pairs, the rest is kept in the residual.
+ */
+class TopKGradientCompressor : public GradientCompressorBase {
+public:
+  TopKGradientCompressor(Ptr<Options> options, float ratio);
+
+  size_t messageBytes(size_t size) const override;
+  void encode(const float* in, size_t size, char* out) const override;
+  void decodeAdd(const char* in, size_t size, float* out, float scale) const override;
+
+private:
+  size_t topK(size_t size) const;
+
+  float ratio_;
+  mutable std::vector<uint32_t> indices_; // scratch space for selection
+};
+
+/**
+ * 8-bit quantization. The gradient is split into buckets, each bucket is transmitted as
+ * one float scale (max. absolute value) followed by one signed byte per entry.
+ */
+class QuantizedGradientCompressor : public GradientCompressorBase {
+public:
+  QuantizedGradientCompressor(Ptr<Options> options, size_t bucketSize);
+
+  size_t messageBytes(size_t size) const override;
+  void encode(const float* in, size_t size, char* out) const override;
+  void decodeAdd(const char* in, size_t size, float* out, float scale) const override;
+
+private:
+  size_t bucketSize_;
+};
+
+// Creates a compressor from --gradient-compression, returns nullptr if compression is disabled.
+Ptr<GradientCompressorBase> GradientCompressor(Ptr<Options> options);
+
+}  // namespace marian
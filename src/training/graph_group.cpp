@@ -57,7 +57,8 @@ GraphGroup::GraphGroup(Ptr<Options> options, Ptr<IMPIWrapper> mpi)
   comm_ = createCommunicator(graphs_,
                              /*noNccl=*/options_->get<bool>("no-nccl", false),
                              shardingMode_,
-                             /*mpi=*/mpi_);
+                             /*mpi=*/mpi_,
+                             /*compressor=*/GradientCompressor(options_));
 
   auto formattedDeviceType = utils::utf8ToUpper(devices_.front().typeAsString()) + "s";
   if (mpi_->numMPIProcesses() > 1)
@@ -76,6 +77,7 @@ void GraphGroup::initGraphsAndOpts() {
 
     graph->setDefaultElementType(parameterType);
     graph->setCheckpointing(options_->get<bool>("gradient-checkpointing"));
+    graph->setCheckpointingBudget(options_->get<size_t>("gradient-checkpointing-budget", 0) * 1024 * 1024);
 
     if(options_->get<bool>("check-nan")) // @TODO: add to other places
       graph->setThrowNaN(true);
@@ -501,51 +503,69 @@ Ptr<data::BatchStats> GraphGroup::collectStats(Ptr<ExpressionGraph> graph,
     if(inputTypes[i] == "class")
       localMaxes[i] = 1;
 
-  size_t maxBatch = 512;
-  bool fits = true;
-  while(fits) {
-    std::vector<size_t> lengths(numFiles, first);
+  // With --mini-batch-fit-analytic the memory of a fake batch is estimated from the graph instead of
+  // running forward and backward on it. The estimate misses scratch memory of some operators, hence the
+  // budget is reduced until the estimate for the longest fake batches agrees with a real pass.
+  bool analytic = options_->get<bool>("mini-batch-fit-analytic", false);
+  size_t budget = graph->getTensorAllocator()->size(Type::uint8);
+  auto fitsBatch = [&](Ptr<data::CorpusBatch> batch, bool estimate) {
+    auto loss = model->build(graph, batch);
+    return estimate ? graph->estimateMemory().peakBytes <= budget : graph->fits();
+  };
 
+  auto limitLengths = [&](size_t length) {
+    std::vector<size_t> lengths(numFiles, length);
     for(int j = 0; j < lengths.size(); ++j) // apply length restrictions
       lengths[j] = std::min(lengths[j], localMaxes[j]);
+    return lengths;
+  };
 
-    auto batch = data::CorpusBatch::fakeBatch(lengths, vocabs, maxBatch, options_);
-    auto loss = model->build(graph, batch);
-    fits = graph->fits();
+  size_t maxBatch = 512;
+  bool fits = true;
+  while(fits) {
+    auto batch = data::CorpusBatch::fakeBatch(limitLengths(first), vocabs, maxBatch, options_);
+    fits = fitsBatch(batch, analytic);
     if(fits)
       maxBatch *= 2;
   }
 
   // Do a binary search for maxmimum batch size that fits into given workspace memory
   // for a tested sentence length.
-  for(size_t i = step; i <= maxLength; i += step) {
+  auto searchBatchSize = [&](const std::vector<size_t>& lengths, size_t end, bool addStats) {
     size_t start = 1;
-    size_t end = maxBatch;
-
-    std::vector<size_t> lengths(numFiles, i);
-    for(int j = 0; j < lengths.size(); ++j)  // apply length restrictions
-      lengths[j] = std::min(lengths[j], localMaxes[j]);
-    fits = true;
-
     do {
       size_t current = (start + end) / 2;
       auto batch = data::CorpusBatch::fakeBatch(lengths, vocabs, current, options_);
-      auto loss = model->build(graph, batch);
-      fits = graph->fits();
+      bool fits = fitsBatch(batch, analytic);
 
       LOG(debug, "[batching] length: {} - size: {} - fits: {}", lengths[0], current, fits);
 
       if(fits) {
-        stats->add(batch, multiplier);
+        if(addStats)
+          stats->add(batch, multiplier);
         start = current + 1;
       } else {
         end = current - 1;
       }
     } while(end >= start);
+    return start;
+  };
 
-    maxBatch = start;
+  if(analytic) {
+    auto lengths = limitLengths(maxLength);
+    size_t workspace = budget;
+    for(int tries = 0; tries < 10; ++tries) {
+      size_t batchSize = searchBatchSize(lengths, maxBatch, /*addStats=*/false) - 1;
+      if(batchSize == 0 || fitsBatch(data::CorpusBatch::fakeBatch(lengths, vocabs, batchSize, options_), /*estimate=*/false))
+        break;
+      budget = (size_t)(0.9 * budget);
+    }
+    LOG(info, "[batching] Using {:.1f}% of the workspace for analytic memory estimates", 100.0 * budget / workspace);
   }
 
+  for(size_t i = step; i <= maxLength; i += step)
+    maxBatch = searchBatchSize(limitLengths(i), maxBatch, /*addStats=*/true);
+
   // set back to original value for aborting on NaN or Inf
   graph->setThrowNaN(throwNan);
 
@@ -6,7 +6,12 @@ namespace marian {
 
 SyncGraphGroup::SyncGraphGroup(Ptr<Options> options, Ptr<IMPIWrapper> mpi)
     : GraphGroup(options, mpi),
-      delay_{options_->get<double>("optimizer-delay")} {} // @TODO: rename delay_ to something else; delay means delayed updated, not accumulation
+      delay_{options_->get<double>("optimizer-delay")}, // @TODO: rename delay_ to something else; delay means delayed updated, not accumulation
+      sharedParams_{options_->get<bool>("cpu-shared-params", false)} {
+  if(sharedParams_)
+    for(auto device : devices_)
+      ABORT_IF(device.type != DeviceType::cpu, "--cpu-shared-params requires CPU training, found device {}", device.typeAsString());
+}
 
 void SyncGraphGroup::setScheduler(Ptr<Scheduler> scheduler) /*override*/ {
   validate();
@@ -32,7 +37,35 @@ void SyncGraphGroup::initialize(const Ptr<data::Batch>& exampleBatch) {
   // Copy weights from 0-th graph to all other graphs to have equal weights across devices.
   // This is used after weight initialization and after checkpoint restoration. 
   comm_->broadcastParams();
+
+  // All local CPU workers live in the same address space, so instead of keeping one parameter copy
+  // per worker, they can read the parameters of the first graph. Each optimizer shard then updates
+  // its slice of that single copy in-place and gathering the parameters becomes a no-op.
+  if(sharedParams_) {
+    for(size_t i = 1; i < graphs_.size(); ++i)
+      graphs_[i]->params()->shareValsWith(graphs_[0]->params());
+    LOG(info, "[training] {} local CPU workers share a single copy of the parameter values, gradients stay per worker", graphs_.size());
+  }
   
+  // Only the rows of words in the batch receive embedding gradients. Tell the optimizer shards
+  // where the embedding matrices are so they can skip the untouched rows.
+  if(options_->get<bool>("lazy-embedding-updates", false)) {
+    comm_->foreach([&](size_t i, size_t begin, size_t /*end*/) {
+      auto params = graphs_[i]->params();
+      std::vector<SparseRows> sparseRows;
+      for(auto p : *params) {
+        if(!utils::endsWith(p->name(), "Wemb") || p->shape().size() != 2)
+          continue;
+        int64_t offset = (int64_t)((p->val()->memory()->data() - params->vals()->memory()->data()) / sizeOf(p->value_type()));
+        sparseRows.push_back({offset - (int64_t)begin, (size_t)p->shape()[0], (size_t)p->shape()[1]});
+      }
+      optimizerShards_[i]->setSparseRows(sparseRows);
+      if(i == 0)
+        LOG(info, "[training] Using lazy row-wise optimizer updates for {} embedding matrices", sparseRows.size());
+      return true;
+    });
+  }
+
   // initialize model quantization
   if (options_->get<size_t>("quantize-bits") > 0) {
     for (int idx = 0; idx < graphs_.size(); idx++)
@@ -14,6 +14,8 @@ class SyncGraphGroup : public GraphGroup {
 
   // model quantizer
   std::vector<Ptr<ModelQuantizer>> quantizers_;
+
+  bool sharedParams_{false}; // if true, all local CPU workers use the parameter memory of the first graph
   
   // state for update()
   bool first_{ true };                           // gets interpreted and cleared by update()
@@ -400,19 +400,21 @@ float TranslationValidator::validate(const std::vector<Ptr<ExpressionGraph>>& gr
       auto histories = search->search(graph, batch);
 
       for(auto history : histories) {
-        std::stringstream best1;
-        std::stringstream bestn;
+        thread_local std::string best1, bestn;
         printer->print(history, best1, bestn);
-        collector->Write(
-            (long)history->getLineNum(), best1.str(), bestn.str(), options_->get<bool>("n-best"));
+        collector->Write((long)history->getLineNum(), best1, bestn, options_->get<bool>("n-best"));
       }
     };
 
     threadPool_.reserve(graphs.size());
-    TaskBarrier taskBarrier;
-    for(auto batch : *batchGenerator_)
-      taskBarrier.push_back(threadPool_.enqueue(task, batch));
-    // ~TaskBarrier waits until all are done
+    {
+      TaskBarrier taskBarrier;
+      for(auto batch : *batchGenerator_)
+        taskBarrier.push_back(threadPool_.enqueue(task, batch));
+      // ~TaskBarrier waits until all are done
+    }
+    // a finished task may still hold the collector, write all lines before the file is used
+    collector->close();
   }
 
   if(!quiet_)
@@ -536,22 +538,22 @@ float SacreBleuValidator::validate(const std::vector<Ptr<ExpressionGraph>>& grap
         const auto& words = std::get<0>(result);
         updateStats(stats, words, batch, no);
 
-        std::stringstream best1;
-        std::stringstream bestn;
+        thread_local std::string best1, bestn;
         printer->print(history, best1, bestn);
-        collector->Write((long)history->getLineNum(),
-                         best1.str(),
-                         bestn.str(),
-                         /*nbest=*/false);
+        collector->Write((long)history->getLineNum(), best1, bestn, /*nbest=*/false);
         no++;
       }
     };
 
     threadPool_.reserve(graphs.size());
-    TaskBarrier taskBarrier;
-    for(auto batch : *batchGenerator_)
-      taskBarrier.push_back(threadPool_.enqueue(task, batch));
-    // ~TaskBarrier waits until all are done
+    {
+      TaskBarrier taskBarrier;
+      for(auto batch : *batchGenerator_)
+        taskBarrier.push_back(threadPool_.enqueue(task, batch));
+      // ~TaskBarrier waits until all are done
+    }
+    // a finished task may still hold the collector, write all lines before the file is used
+    collector->close();
   }
 
   if(!quiet_)
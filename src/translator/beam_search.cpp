@@ -224,15 +224,17 @@ std::vector<float> BeamSearch::getAlignmentsForHypothesis( // -> P(s|t) for curr
 }
 
 // remove all beam entries that have reached EOS
-Beams BeamSearch::purgeBeams(const Beams& beams, /*in/out=*/std::vector<IndexType>& batchIdxMap) {
+Beams BeamSearch::purgeBeams(const Beams& beams, /*in/out=*/std::vector<IndexType>& batchIdxMap,
+                             const std::vector<bool>& dropped) {
   const auto trgEosId = trgVocab_->getEosId();
   Beams newBeams;
   size_t beamIdx = 0; // beam index
   for(auto beam : beams) {
     Beam newBeam; // a beam of surviving hyps
+    bool drop = !dropped.empty() && dropped[beamIdx];
     for(auto hyp : beam)
-      if(hyp->getWord() != trgEosId) // if this hyp is not finished,
-        newBeam.push_back(hyp);      // move over to beam of surviving hyps
+      if(hyp->getWord() != trgEosId && !drop) // if this hyp is not finished,
+        newBeam.push_back(hyp);               // move over to beam of surviving hyps
 
     if(PURGE_BATCH)
       if(newBeam.empty() && !beam.empty()) {      // previous beam had hyps, but all were finished in this step, newBeam will now stay empty
@@ -326,6 +328,9 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
   //    with History: vector [t] of array [maxBeamSize] of Hypothesis
   //    with Hypothesis: (last word, aggregate score, prev Hypothesis)
 
+  std::vector<bool> reported(origDimBatch, false); // whether finished_ has been called for a batch entry, or it was cancelled
+  std::vector<bool> dropped(origDimBatch, false);  // cancelled batch entries
+
   IndexType currentDimBatch = origDimBatch;
   auto prevBatchIdxMap = batchIdxMap; // [origBatchIdx -> currentBatchIdx] but shifted by one time step
   // main loop over output time steps
@@ -494,19 +499,32 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
 
     prevBatchIdxMap = batchIdxMap; // save current batchIdx map to be used in next step; we are then going to look one step back
 
+    // drop cancelled sentences, they are purged from the batch like finished ones
+    if(cancelled_)
+      for(int batchIdx = 0; batchIdx < origDimBatch; ++batchIdx)
+        if(!beams[batchIdx].empty() && !reported[batchIdx] && cancelled_(histories[batchIdx]->getLineNum()))
+          dropped[batchIdx] = reported[batchIdx] = true;
+
     // remove all hyps that end in EOS
     // The position of a hyp in the beam may change.
     // in/out = shifts the batch index map if a beam gets fully purged
-    const auto purgedNewBeams = purgeBeams(beams, /*in/out=*/batchIdxMap);
+    const auto purgedNewBeams = purgeBeams(beams, /*in/out=*/batchIdxMap, dropped);
 
     // add updated search space (beams) to our return value
     bool maxLengthReached = false;
     for(int batchIdx = 0; batchIdx < origDimBatch; ++batchIdx) {
       // if this batch entry has surviving hyps then add them to the traceback grid
-      if(!beams[batchIdx].empty()) { // if the beam is not empty expand the history object associated with the beam
+      if(!beams[batchIdx].empty() && !dropped[batchIdx]) { // if the beam is not empty expand the history object associated with the beam
         if (histories[batchIdx]->size() >= options_->get<float>("max-length-factor") * batch->front()->batchWidth())
           maxLengthReached = true;
-        histories[batchIdx]->add(beams[batchIdx], trgEosId, purgedNewBeams[batchIdx].empty() || maxLengthReached);
+        bool last = purgedNewBeams[batchIdx].empty() || maxLengthReached;
+        histories[batchIdx]->add(beams[batchIdx], trgEosId, last);
+        if(last && finished_) {
+          finished_(histories[batchIdx]);
+          reported[batchIdx] = true;
+        } else if(!last && partial_) {
+          partial_(histories[batchIdx]->getLineNum(), purgedNewBeams[batchIdx][0]->tracebackWords());
+        }
       }
     }
     if (maxLengthReached) // early exit if max length limit was reached
@@ -516,6 +534,12 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
     beams = purgedNewBeams;
   } // end of main loop over output time steps
 
+  // sentences that were still running when the length limit was reached
+  if(finished_)
+    for(int batchIdx = 0; batchIdx < origDimBatch; ++batchIdx)
+      if(!reported[batchIdx])
+        finished_(histories[batchIdx]);
+
   return histories; // [origDimBatch][t][N best hyps]
 }
 
@@ -16,6 +16,10 @@ private:
   const float INVALID_PATH_SCORE;
   const bool PURGE_BATCH = true; // @TODO: diagnostic, to-be-removed once confirmed there are no issues.
 
+  std::function<void(Ptr<History>)> finished_;
+  std::function<void(size_t, const Words&)> partial_;
+  std::function<bool(size_t)> cancelled_;
+
   static float chooseInvalidPathScore(Ptr<Options> options) {
     auto prec = options->get<std::vector<std::string>>("precision", {"float32"});
     auto computeType = typeFromString(prec[0]);
@@ -48,8 +52,25 @@ public:
       int origBatchIdx,
       int currentDimBatch) const;
 
-  // remove all beam entries that have reached EOS
-  Beams purgeBeams(const Beams& beams, /*in/out=*/std::vector<IndexType>& batchIdxMap);
+  // remove all beam entries that have reached EOS, and the whole beam of entries marked in dropped
+  Beams purgeBeams(const Beams& beams, /*in/out=*/std::vector<IndexType>& batchIdxMap,
+                   const std::vector<bool>& dropped = {});
+
+  // Hooks for streaming results, both are called from the searching thread. finished(history) is
+  // called as soon as a sentence of the batch is complete, which is usually before search() returns.
+  // partial(lineNum, words) is called after every output time step with the best unfinished prefix
+  // of each sentence that is still being translated; with beam sizes above 1 later prefixes may
+  // revise earlier ones.
+  typedef std::function<void(Ptr<History>)> FinishedCallback;
+  typedef std::function<void(size_t, const Words&)> PartialCallback;
+  void setFinishedCallback(const FinishedCallback& finished) { finished_ = finished; }
+  void setPartialCallback(const PartialCallback& partial) { partial_ = partial; }
+
+  // cancelled(lineNum) is checked for every unfinished sentence after each output time step. Cancelled
+  // sentences are dropped from the batch like finished ones, but their histories stay incomplete and
+  // are not passed to the finished callback. Callers must not print them.
+  typedef std::function<bool(size_t)> CancelledCallback;
+  void setCancelledCallback(const CancelledCallback& cancelled) { cancelled_ = cancelled; }
 
   // main decoding function
   Histories search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch);
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "common/io.h"
+#include "common/timer.h"
+#include "translator/translator.h"
+
+#include "3rd_party/threadpool.h"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace marian {
+
+// Named translation models of marian-server, each a Service (a TranslateService) with its own options,
+// vocabularies and shortlist. The model given on the command line is called 'default'. Others are
+// described by the file given with --model-registry, which maps names to either a YAML config file
+// or a map of options, e.g.
+//
+//   en-de: /models/en-de/config.yml
+//   de-en:
+//     models: [/models/de-en/model.bin]
+//     vocabs: [/models/de-en/vocab.spm, /models/de-en/vocab.spm]
+//
+// The options of a model are those of the server overwritten by the ones of its entry and then by
+// the configuration stored in its first model file, as on the command line.
+//
+// load() builds a model in the background, translates a warm-up sentence and only then replaces the
+// model of that name, so requests are never blocked by a load. Requests keep the model they started
+// with, hence a replaced or unloaded model is released once its last request is finished. Until then
+// both models are in memory; with --model-mmap binary models are mapped instead of read, which keeps
+// loading fast and lets the page cache share unchanged files.
+//
+// Errors of a load, e.g. a missing model file, are reported to its callback instead of terminating the
+// process: the loader thread throws on ABORT. Errors in the threads of the Service still abort.
+template <class Service>
+class ModelRegistry {
+public:
+  struct Model {
+    std::string name;
+    YAML::Node source;     // the entry the model was loaded from, null for the command line
+    size_t generation{0};  // counts the loads under this name
+    double seconds{0};     // loading and warm-up time
+    Ptr<Service> service;
+
+    ~Model() { LOG(info, "[models] Released model '{}' generation {}", name, generation); }
+  };
+
+  // Called by the loader thread with an error message or the new model
+  typedef std::function<void(const std::string&, Ptr<const Model>)> LoadCallback;
+
+  static const std::string DEFAULT;
+
+  ModelRegistry(Ptr<Options> options)
+      : options_(options), warmup_(options->get<std::string>("model-warmup", "")), loader_(1) {
+    install(create(DEFAULT, YAML::Node()));
+
+    auto registry = options->get<std::string>("model-registry", "");
+    if(!registry.empty()) {
+      auto entries = YAML::LoadFile(registry);
+      ABORT_IF(!entries.IsMap(), "Model registry {} does not map names to models", registry);
+      for(auto entry : entries)
+        install(create(checkName(entry.first.as<std::string>()), entry.second));
+    }
+  }
+
+  // The model with the given name, the default model for an empty name, or nullptr if unknown
+  Ptr<const Model> get(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = models_.find(name.empty() ? DEFAULT : name);
+    return it != models_.end() ? it->second : nullptr;
+  }
+
+  std::vector<Ptr<const Model>> list() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Ptr<const Model>> models;
+    for(const auto& model : models_)
+      models.push_back(model.second);
+    return models;
+  }
+
+  // Loads a model from a config file (or from an option map given as YAML) in the background and
+  // switches to it when it is ready. Loads are done one at a time.
+  void load(const std::string& name, const YAML::Node& source, const LoadCallback& done) {
+    loader_.enqueue([this, name, source, done]() {
+      Ptr<const Model> model;
+      try {
+        ScopedThrowExceptionOnAbort throwing;
+        model = create(checkName(name), source);
+      } catch(const std::exception& e) {
+        LOG(warn, "[models] Could not load model '{}': {}", name, e.what());
+        done(e.what(), nullptr);
+        return;
+      }
+      install(model);
+      done("", model);
+    });
+  }
+
+  // Loads a model again from the entry it was loaded from, e.g. after its files were replaced
+  bool reload(const std::string& name, const LoadCallback& done, std::string& error) {
+    auto model = get(name);
+    if(!model) {
+      error = "unknown model '" + name + "'";
+      return false;
+    }
+    load(model->name, model->source, done);
+    return true;
+  }
+
+  // Removes a model, requests that are using it are finished
+  bool unload(const std::string& name, std::string& error) {
+    Ptr<const Model> model;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = models_.find(name);
+    if(it == models_.end()) {
+      error = "unknown model '" + name + "'";
+      return false;
+    }
+    if(name == DEFAULT) {
+      error = "the default model cannot be unloaded";
+      return false;
+    }
+    model = it->second;  // released after the lock
+    models_.erase(it);
+    LOG(info, "[models] Unloaded model '{}'", name);
+    return true;
+  }
+
+private:
+  static const std::string& checkName(const std::string& name) {
+    ABORT_IF(name.empty() || name.find_first_of(" \t\n=") != std::string::npos,
+             "Invalid model name '{}'",
+             name);
+    return name;
+  }
+
+  Ptr<Options> createOptions(const YAML::Node& source) const {
+    auto options = New<Options>(options_->clone());
+    if(source.IsScalar())
+      options->merge(YAML::LoadFile(source.as<std::string>()), /*overwrite=*/true);
+    else if(source.IsMap())
+      options->merge(source, /*overwrite=*/true);
+    else
+      ABORT_IF(source.IsDefined() && !source.IsNull(), "A model is given by a config file or a map of options");
+
+    auto models = options->get<std::vector<std::string>>("models");
+    ABORT_IF(models.empty(), "No model files given");
+    if(source.IsDefined() && !source.IsNull() && !options->get<bool>("ignore-model-config")) {
+      YAML::Node config;
+      try {
+        io::getYamlFromModel(config, "special:model.yml", models[0]);
+        options->merge(config, /*overwrite=*/true);
+      } catch(std::runtime_error&) {
+        LOG(info, "[models] No model configuration found in {}", models[0]);
+      }
+    }
+    return options;
+  }
+
+  Ptr<Model> create(const std::string& name, const YAML::Node& source) {
+    timer::Timer timer;
+    LOG(info, "[models] Loading model '{}'", name);
+    Ptr<Options> options = createOptions(source);
+
+    auto model = New<Model>();
+    model->name = name;
+    model->source = YAML::Clone(source);
+    model->service = New<Service>(options);
+
+    // the first translation allocates the workspaces and initializes the lazily created parts of the
+    // graphs; a single field does not fit inputs with several tab-separated fields
+    if(!warmup_.empty() && !options->get<bool>("tsv", false))
+      model->service->run(warmup_);
+
+    model->seconds = timer.elapsed();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      model->generation = ++generations_[name];
+    }
+    LOG(info, "[models] Loaded model '{}' generation {} in {:.2f}s", name, model->generation, model->seconds);
+    return model;
+  }
+
+  void install(Ptr<const Model> model) {
+    Ptr<const Model> previous;  // released after the lock, or by the last request using it
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& current = models_[model->name];
+    previous = current;
+    current = model;
+  }
+
+  Ptr<Options> options_;
+  std::string warmup_;
+
+  std::map<std::string, Ptr<const Model>> models_;
+  std::map<std::string, size_t> generations_;
+  mutable std::mutex mutex_;
+
+  ThreadPool loader_;
+};
+
+template <class Service>
+const std::string ModelRegistry<Service>::DEFAULT = "default";
+
+}  // namespace marian
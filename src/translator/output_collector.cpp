@@ -7,75 +7,127 @@
 namespace marian {
 
 OutputCollector::OutputCollector()
-  : nextId_(0),
-    printing_(new DefaultPrinting()) {}
+  : printing_(new DefaultPrinting()) {
+  start();
+}
 
 OutputCollector::OutputCollector(std::string outFile)
-  : nextId_(0),
-    outStrm_(new std::ostream(std::cout.rdbuf())),
+  : outStrm_(new std::ostream(std::cout.rdbuf())),
     printing_(new DefaultPrinting()) {
   if (outFile != "stdout")
     outStrm_.reset(new io::OutputFileStream(outFile));
+  start();
+}
+
+OutputCollector::~OutputCollector() {
+  close();
+}
+
+void OutputCollector::close() {
+  {
+    std::lock_guard<std::mutex> lock(waitMutex_);
+    done_ = true;
+  }
+  available_.notify_one();
+  if(writer_.joinable())
+    writer_.join();
+}
+
+void OutputCollector::start() {
+  ring_.reset(new Slot[RING_SIZE]);
+  writer_ = std::thread([this]() { writeLines(); });
 }
 
 void OutputCollector::Write(long sourceId,
                             const std::string& best1,
                             const std::string& bestn,
                             bool nbest) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if(sourceId == nextId_) {
-    if(printing_->shouldBePrinted(sourceId))
-      LOG(info, "Best translation {} : {}", sourceId, best1);
-
-    if(outStrm_) {
-      if(nbest)
-        *outStrm_ << bestn << std::endl;
-      else
-        *outStrm_ << best1 << std::endl;
-    }
+  if(sourceId - nextId_ < RING_SIZE) {
+    // the slot's previous line has been written, nobody else writes to it until it is ready
+    auto& slot = ring_[sourceId % RING_SIZE];
+    assert(!slot.ready);
+    slot.output.best1 = best1;  // reuses the capacity of the previous line
+    slot.output.bestn = bestn;
+    slot.output.nbest = nbest;
+    slot.ready = true;
+  } else {
+    // far ahead, e.g. with a large maxi-batch, keep it until the ring reaches it
+    std::lock_guard<std::mutex> lock(outputsMutex_);
+    auto& output = outputs_[sourceId];
+    output.best1 = best1;
+    output.bestn = bestn;
+    output.nbest = nbest;
+    firstOutput_ = outputs_.begin()->first;
+  }
 
-    ++nextId_;
-
-    Outputs::const_iterator iter, iterNext;
-    iter = outputs_.begin();
-    while(iter != outputs_.end()) {
-      long currId = iter->first;
-
-      if(currId == nextId_) {
-        // 1st element in the map is the next
-        const auto& currOutput = iter->second;
-        if(printing_->shouldBePrinted(currId))
-          LOG(info, "Best translation {} : {}", currId, currOutput.first);
-
-        if(outStrm_) {
-          if(nbest)
-            *outStrm_ << currOutput.second << std::endl;
-          else
-            *outStrm_ << currOutput.first << std::endl;
-        }
-
-        ++nextId_;
-
-        // delete current record, move iter on 1
-        iterNext = iter;
-        ++iterNext;
-        outputs_.erase(iter);
-        iter = iterNext;
-      } else {
-        // not the next. stop iterating
-        assert(nextId_ < currId);
-        break;
+  // waiting_ and ready are sequentially consistent: either the writer sees the line before it
+  // waits or we see that it waits
+  if(waiting_) {
+    std::lock_guard<std::mutex> lock(waitMutex_);
+    available_.notify_one();
+  }
+}
+
+bool OutputCollector::nextAvailable() {
+  long next = nextId_;
+  return ring_[next % RING_SIZE].ready || firstOutput_ == next;
+}
+
+bool OutputCollector::takeNext(Output& output) {
+  long next = nextId_;
+  auto& slot = ring_[next % RING_SIZE];
+  if(slot.ready) {
+    std::swap(output, slot.output);
+    slot.ready = false;
+  } else if(firstOutput_ == next) {
+    std::lock_guard<std::mutex> lock(outputsMutex_);
+    auto first = outputs_.begin();
+    std::swap(output, first->second);
+    outputs_.erase(first);
+    firstOutput_ = outputs_.empty() ? -1 : outputs_.begin()->first;
+  } else {
+    return false;
+  }
+  nextId_ = next + 1;
+  return true;
+}
+
+void OutputCollector::writeLines() {
+  std::string buffer;
+  buffer.reserve(WRITE_BYTES + (WRITE_BYTES >> 2));
+  Output output;
+
+  auto write = [&]() {
+    if(outStrm_ && !buffer.empty()) {
+      outStrm_->write(buffer.data(), buffer.size());
+      // flush so that the lines can be consumed immediately by an external process
+      outStrm_->flush();
+    }
+    buffer.clear();
+  };
+
+  for(;;) {
+    long id = nextId_;
+    if(takeNext(output)) {
+      if(printing_->shouldBePrinted(id))
+        LOG(info, "Best translation {} : {}", id, output.best1);
+      if(outStrm_) {
+        buffer += output.nbest ? output.bestn : output.best1;
+        buffer += '\n';
+        if(buffer.size() >= WRITE_BYTES)
+          write();
       }
+      continue;
     }
 
-    // for 1-best, flush stdout so that we can consume this immediately from an
-    // external process
-    if(outStrm_ && !nbest)
-      *outStrm_ << std::flush;
+    write();
 
-  } else {
-    // save for later
-    outputs_[sourceId] = std::make_pair(best1, bestn);
+    std::unique_lock<std::mutex> lock(waitMutex_);
+    if(done_ && !nextAvailable())
+      break;
+    waiting_ = true;
+    available_.wait(lock, [&]() { return done_ || nextAvailable(); });
+    waiting_ = false;
   }
 }
 
@@ -87,15 +139,19 @@ void StringCollector::add(long sourceId,
   std::lock_guard<std::mutex> lock(mutex_);
   if(!quiet_)
     LOG(info, "Best translation {} : {}", sourceId, best1);
-  outputs_[sourceId] = std::make_pair(best1, bestn);
+  if((long)outputs_.size() <= sourceId)
+    outputs_.resize(sourceId + 1);
+  outputs_[sourceId].first = best1;
+  outputs_[sourceId].second = bestn;
   if(maxId_ <= sourceId)
     maxId_ = sourceId;
 }
 
 std::vector<std::string> StringCollector::collect(bool nbest) {
   std::vector<std::string> outputs;
-  for(int id = 0; id <= maxId_; ++id)
-    outputs.emplace_back(nbest ? outputs_[id].second : outputs_[id].first);
+  outputs.reserve(maxId_ + 1);
+  for(long id = 0; id <= maxId_; ++id)
+    outputs.emplace_back(std::move(nbest ? outputs_[id].second : outputs_[id].first));
   return outputs;
 }
 }  // namespace marian
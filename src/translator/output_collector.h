@@ -3,9 +3,13 @@
 #include "common/definitions.h"
 #include "common/file_stream.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <iostream>
 #include <map>
+#include <thread>
+#include <vector>
 
 namespace marian {
 
@@ -44,34 +48,81 @@ private:
   long next_{10};
 };
 
+// Writes translations in the order of their line numbers while they arrive in any order from the
+// decoding threads. Write() copies the translation into a slot of a ring buffer indexed by the line
+// number and returns, without taking a lock, unless the line is too far ahead of the next one to be
+// written for the ring. A separate thread takes the lines in order, logs them according to the
+// printing strategy and writes them to the output in large blocks. The output is flushed whenever
+// the next line is not available yet, so that other processes can consume it right away.
+//
+// The destructor writes the remaining lines and waits for the writer thread.
 class OutputCollector {
 public:
   OutputCollector();
   OutputCollector(std::string outFile);
 
   template <class T>
-  OutputCollector(T&& arg) : nextId_(0), outStrm_(new io::OutputFileStream(arg)) {}
+  OutputCollector(T&& arg) : outStrm_(new io::OutputFileStream(arg)), printing_(new DefaultPrinting()) {
+    start();
+  }
 
   OutputCollector(const OutputCollector&) = delete;
+  ~OutputCollector();
 
   void Write(long sourceId,
              const std::string& best1,
              const std::string& bestn,
              bool nbest);
 
+  // Writes all remaining lines and stops the writer thread, no Write() may follow. Called by the
+  // destructor, call it explicitly if the output is read while the collector may still be alive.
+  void close();
+
+  // Has to be set before the first Write()
   void setPrintingStrategy(Ptr<PrintingStrategy> strategy) {
     printing_ = strategy;
   }
 
 protected:
-  typedef std::map<long, std::pair<std::string, std::string>> Outputs;
+  struct Output {
+    std::string best1;
+    std::string bestn;
+    bool nbest{false};
+  };
+
+  struct Slot {
+    std::atomic<bool> ready{false};
+    Output output;
+  };
+
+  void start();
+  bool takeNext(Output& output);
+  bool nextAvailable();
+  void writeLines();
+
+  static const long RING_SIZE = 16384;     // lines that can be ahead of the next one to write
+  static const size_t WRITE_BYTES = 1 << 20;  // written at once if enough lines are available
+
+  std::unique_ptr<Slot[]> ring_;
+  std::atomic<long> nextId_{0};  // the next line to write, only advanced by the writer
+
+  // lines that were RING_SIZE or more ahead of the next one when they arrived
+  typedef std::map<long, Output> Outputs;
   Outputs outputs_;
-  long nextId_;
+  std::mutex outputsMutex_;
+  std::atomic<long> firstOutput_{-1};  // smallest line in outputs_ or -1
+
   UPtr<std::ostream> outStrm_;
   Ptr<PrintingStrategy> printing_;
-  std::mutex mutex_;
+
+  std::mutex waitMutex_;
+  std::condition_variable available_;
+  std::atomic<bool> waiting_{false};
+  std::atomic<bool> done_{false};
+  std::thread writer_;
 };
 
+// Collects translations in memory, see TranslateService
 class StringCollector {
 public:
   StringCollector(bool quiet = false);
@@ -85,7 +136,6 @@ protected:
   bool quiet_;  // if true do not log best translations
   std::mutex mutex_;
 
-  typedef std::map<long, std::pair<std::string, std::string>> Outputs;
-  Outputs outputs_;
+  std::vector<std::pair<std::string, std::string>> outputs_;  // by line number
 };
 }  // namespace marian
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdio>
+#include <ostream>
+#include <string>
 #include <vector>
 
 #include "common/options.h"
@@ -11,6 +14,35 @@
 
 namespace marian {
 
+// Appends what OutputPrinter::print() writes to a string, without the construction, locale and
+// allocation overhead of a std::stringstream per sentence. Numbers are formatted as a default
+// std::ostream does.
+class StringAppender {
+public:
+  explicit StringAppender(std::string& str) : str_(str) {}
+
+  StringAppender& operator<<(const std::string& s) { str_ += s; return *this; }
+  StringAppender& operator<<(const char* s) { str_ += s; return *this; }
+  StringAppender& operator<<(size_t n) { str_ += std::to_string(n); return *this; }
+
+  StringAppender& operator<<(float x) {
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%g", x);
+    str_.append(buffer, length);
+    return *this;
+  }
+
+  // std::endl and std::flush
+  StringAppender& operator<<(std::ostream& (*manipulator)(std::ostream&)) {
+    if(manipulator == static_cast<std::ostream& (*)(std::ostream&)>(std::endl))
+      str_ += '\n';
+    return *this;
+  }
+
+private:
+  std::string& str_;
+};
+
 class OutputPrinter {
 public:
   OutputPrinter(Ptr<const Options> options, Ptr<const Vocab> vocab)
@@ -85,6 +117,15 @@ public:
     best1 << std::flush;
   }
 
+  // Prints into the given strings, which are cleared first. Callers that keep the strings across
+  // sentences, e.g. as thread_local buffers, do not allocate once the buffers are large enough.
+  void print(Ptr<const History> history, std::string& best1, std::string& bestn) {
+    best1.clear();
+    bestn.clear();
+    StringAppender best1Appender(best1), bestnAppender(bestn);
+    print(history, best1Appender, bestnAppender);
+  }
+
 private:
   Ptr<Vocab const> vocab_;
   bool reverse_{false};            // If it is a right-to-left model that needs reversed word order
@@ -0,0 +1,141 @@
+#include "translator/request_queue.h"
+#include "common/logging.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace marian {
+
+std::string RequestQueueMetrics::toString() const {
+  std::stringstream ss;
+  size_t total = 0;
+  for(const auto& q : queued)
+    total += q.second;
+  ss << "queued=" << total;
+  for(const auto& q : queued)
+    ss << " queued[" << q.first << "]=" << q.second;
+  ss << " running=" << running
+     << " admitted=" << admitted
+     << " rejected=" << rejected
+     << " expired=" << expired
+     << " completed=" << completed
+     << " mean-wait=" << meanWait
+     << " max-wait=" << maxWait
+     << " service-time=" << serviceTime;
+  return ss.str();
+}
+
+RequestQueue::RequestQueue(Handler process, Handler expire, size_t maxQueued, double maxWait)
+    : process_(process), expire_(expire), maxQueued_(maxQueued), maxWait_(maxWait) {
+  worker_ = std::thread([this]() { work(); });
+}
+
+RequestQueue::~RequestQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  available_.notify_all();
+  worker_.join();
+}
+
+bool RequestQueue::submit(Ptr<ServiceRequest> request, std::string& reason) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // requests that will be started before this one, plus the running one
+  size_t ahead = metrics_.running;
+  for(const auto& q : queues_)
+    if(q.first <= request->priority)
+      ahead += q.second.size();
+  double expectedWait = ahead * metrics_.serviceTime;
+
+  reason.clear();
+  if(maxQueued_ > 0 && waiting_ >= maxQueued_)
+    reason = "queue is full";
+  else if(maxWait_ > 0 && expectedWait > maxWait_)
+    reason = "expected wait exceeds the limit";
+  else if(request->deadline != Clock::time_point::max()
+          && Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(expectedWait)) > request->deadline)
+    reason = "deadline cannot be met";
+
+  if(!reason.empty()) {
+    metrics_.rejected++;
+    return false;
+  }
+
+  queues_[request->priority].push_back(request);
+  waiting_++;
+  metrics_.admitted++;
+  lock.unlock();
+  available_.notify_one();
+  return true;
+}
+
+RequestQueueMetrics RequestQueue::metrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RequestQueueMetrics metrics = metrics_;
+  for(const auto& q : queues_)
+    if(!q.second.empty())
+      metrics.queued[q.first] = q.second.size();
+  return metrics;
+}
+
+void RequestQueue::work() {
+  for(;;) {
+    Ptr<ServiceRequest> request;
+    bool expired;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      available_.wait(lock, [this]() { return stop_ || waiting_ > 0; });
+      if(stop_)
+        return;
+      // the map is ordered, the first non-empty queue has the most urgent priority
+      for(auto& q : queues_) {
+        if(!q.second.empty()) {
+          request = q.second.front();
+          q.second.pop_front();
+          break;
+        }
+      }
+      waiting_--;
+
+      expired = request->expired();
+      if(expired) {
+        metrics_.expired++;
+      } else {
+        double wait = std::chrono::duration<double>(Clock::now() - request->arrival).count();
+        started_++;
+        totalWait_ += wait;
+        metrics_.meanWait = totalWait_ / started_;
+        metrics_.maxWait = std::max(metrics_.maxWait, wait);
+        metrics_.running++;
+      }
+    }
+
+    if(expired) {
+      expire_(request);
+      continue;
+    }
+
+    auto start = Clock::now();
+    try {
+      process_(request);
+    } catch(const std::exception& e) {
+      LOG(error, "Request failed: {}", e.what());
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    metrics_.running--;
+    if(request->expired()) {
+      metrics_.expired++;
+    } else {
+      // moving average, the first measurement replaces the initial zero
+      const double alpha = 0.1;
+      metrics_.completed++;
+      metrics_.serviceTime = metrics_.completed == 1 ? seconds : (1 - alpha) * metrics_.serviceTime + alpha * seconds;
+    }
+  }
+}
+
+}  // namespace marian
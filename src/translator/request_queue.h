@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common/definitions.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace marian {
+
+// A request to the translation service. Lower priority values are more urgent. Requests past their
+// deadline are not started, and the service is expected to stop running ones (see expired()). The
+// same holds for requests that are cancelled, e.g. because their client has closed the connection.
+struct ServiceRequest {
+  typedef std::chrono::steady_clock Clock;
+
+  std::string input;
+  size_t priority{0};
+  Clock::time_point deadline{Clock::time_point::max()};
+  Clock::time_point arrival{Clock::now()};
+  std::atomic<bool> cancelled{false};
+
+  bool expired() const { return cancelled || Clock::now() > deadline; }
+};
+
+struct RequestQueueMetrics {
+  std::map<size_t, size_t> queued;  // waiting requests per priority
+  size_t running{0};
+  size_t admitted{0};
+  size_t rejected{0};     // by admission control
+  size_t expired{0};      // deadline passed or cancelled, while waiting or running
+  size_t completed{0};
+  double meanWait{0};     // seconds from arrival to start, over all started requests
+  double maxWait{0};
+  double serviceTime{0};  // moving average of the seconds from start to end
+
+  std::string toString() const;
+};
+
+// Admission control and scheduling in front of a service that handles one request at a time, such
+// as TranslateService. A worker thread takes the most urgent waiting request (lowest priority, then
+// earliest arrival) and calls process(request). Requests whose deadline passes while waiting are
+// given to expire() instead.
+//
+// submit() rejects a request if maxQueued requests are waiting already, or if the expected wait,
+// i.e. the number of requests ahead of it times the average service time, exceeds maxWait seconds
+// or its deadline. 0 disables either limit.
+class RequestQueue {
+public:
+  typedef std::function<void(Ptr<ServiceRequest>)> Handler;
+
+  RequestQueue(Handler process, Handler expire, size_t maxQueued = 0, double maxWait = 0);
+  ~RequestQueue();
+
+  // Returns false and the reason if the request was rejected, the handlers are not called for it then.
+  bool submit(Ptr<ServiceRequest> request, std::string& reason);
+
+  RequestQueueMetrics metrics() const;
+
+private:
+  typedef ServiceRequest::Clock Clock;
+
+  void work();
+
+  Handler process_;
+  Handler expire_;
+  size_t maxQueued_;
+  double maxWait_;
+
+  std::map<size_t, std::deque<Ptr<ServiceRequest>>> queues_;  // per priority
+  size_t waiting_{0};
+  RequestQueueMetrics metrics_;
+  size_t started_{0};
+  double totalWait_{0};
+
+  mutable std::mutex mutex_;
+  std::condition_variable available_;
+  bool stop_{false};
+  std::thread worker_;
+};
+
+}  // namespace marian
@@ -97,6 +97,7 @@ public:
           graph->getBackend()->setOptimized(options_->get<bool>("optimize"));
           graph->getBackend()->setGemmType(options_->get<std::string>("gemm-type"));
           graph->getBackend()->setQuantizeRange(options_->get<float>("quantize-range"));
+          graph->setElementwiseFusion(options_->get<bool>("fuse-elementwise", false));
         }
         graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
         graphs_[id] = graph;
@@ -193,13 +194,10 @@ public:
         auto histories = search->search(graph, batch);
 
         for(auto history : histories) {
-          std::stringstream best1;
-          std::stringstream bestn;
+          // reused by every sentence of this thread
+          thread_local std::string best1, bestn;
           printer->print(history, best1, bestn);
-          collector->Write((long)history->getLineNum(),
-                           best1.str(),
-                           bestn.str(),
-                           doNbest);
+          collector->Write((long)history->getLineNum(), best1, bestn, doNbest);
         }
 
         // if we asked for speed information display this
@@ -257,6 +255,8 @@ private:
 
   size_t numDevices_;
 
+  std::vector<mio::mmap_source> model_mmaps_; // with --model-mmap the graphs use these directly
+
 public:
   virtual ~TranslateService() {}
 
@@ -294,9 +294,15 @@ public:
     // preload models
     std::vector<std::vector<io::Item>> model_items_;
     auto models = options->get<std::vector<std::string>>("models");
+    bool mmap = options_->get<bool>("model-mmap", false);
     for(auto model : models) {
-      auto items = io::loadItems(model);
-      model_items_.push_back(std::move(items));
+      if(mmap) {
+        ABORT_IF(!io::isBin(model), "Non-binarized models cannot be mmapped");
+        model_mmaps_.push_back(mio::mmap_source(model));
+      } else {
+        auto items = io::loadItems(model);
+        model_items_.push_back(std::move(items));
+      }
     }
 
     // initialize scorers
@@ -310,11 +316,12 @@ public:
         graph->getBackend()->setOptimized(options_->get<bool>("optimize"));
         graph->getBackend()->setGemmType(options_->get<std::string>("gemm-type"));
         graph->getBackend()->setQuantizeRange(options_->get<float>("quantize-range"));
+        graph->setElementwiseFusion(options_->get<bool>("fuse-elementwise", false));
       }
       graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
       graphs_.push_back(graph);
 
-      auto scorers = createScorers(options_, model_items_);
+      auto scorers = mmap ? createScorers(options_, model_mmaps_) : createScorers(options_, model_items_);
       for(auto scorer : scorers) {
         scorer->init(graph);
         if(shortlistGenerator_)
@@ -324,7 +331,23 @@ public:
     }
   }
 
+  // Receives translations while run() is still working: (line number within the input, text, final).
+  // Final translations (1-best, or the n-best list with --n-best) are passed as soon as a sentence is
+  // finished, hence not in input order. Partial ones are the best prefix of a sentence that is still
+  // being translated and are passed after every decoding step.
+  typedef std::function<void(size_t, const std::string&, bool)> StreamCallback;
+
   std::string run(const std::string& input) override {
+    return run(input, nullptr, /*partial=*/false);
+  }
+
+  // If cancelled() becomes true, batches that have not started are skipped and the sentences of
+  // running batches are dropped after the current decoding step. Sentences that are not finished by
+  // then are missing from the result and are not streamed.
+  std::string run(const std::string& input,
+                  const StreamCallback& stream,
+                  bool partial,
+                  const std::function<bool()>& cancelled = nullptr) {
     // split tab-separated input into fields if necessary
     auto inputs = options_->get<bool>("tsv", false)
                       ? convertTsvToLists(input, options_->get<size_t>("tsv-fields", 1))
@@ -334,6 +357,7 @@ public:
 
     auto collector = New<StringCollector>(options_->get<bool>("quiet-translation", false));
     auto printer = New<OutputPrinter>(options_, trgVocab_);
+    bool nbest = options_->get<bool>("n-best");
     size_t batchId = 0;
 
     batchGenerator.prepare();
@@ -351,15 +375,31 @@ public:
             scorers = scorers_[id % numDevices_];
           }
 
+          if(cancelled && cancelled())
+            return;
+
+          auto output = [&](Ptr<History> history) {
+            thread_local std::string best1, bestn;
+            printer->print(history, best1, bestn);
+            collector->add((long)history->getLineNum(), best1, bestn);
+            if(stream)
+              stream(history->getLineNum(), nbest ? bestn : best1, /*final=*/true);
+          };
+
           auto search = New<Search>(options_, scorers, trgVocab_);
+          if(stream || cancelled)
+            search->setFinishedCallback(output);
+          if(stream && partial)
+            search->setPartialCallback([&](size_t lineNum, const Words& words) {
+              stream(lineNum, trgVocab_->decode(words), /*final=*/false);
+            });
+          if(cancelled)
+            search->setCancelledCallback([&](size_t /*lineNum*/) { return cancelled(); });
           auto histories = search->search(graph, batch);
 
-          for(auto history : histories) {
-            std::stringstream best1;
-            std::stringstream bestn;
-            printer->print(history, best1, bestn);
-            collector->add((long)history->getLineNum(), best1.str(), bestn.str());
-          }
+          if(!stream && !cancelled)
+            for(auto history : histories)
+              output(history);
         };
 
         threadPool_.enqueue(task, batchId);
@@ -367,7 +407,7 @@ public:
       }
     }
 
-    auto translations = collector->collect(options_->get<bool>("n-best"));
+    auto translations = collector->collect(nbest);
     return utils::join(translations, "\n");
   }
 